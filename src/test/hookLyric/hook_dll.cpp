@@ -1,8 +1,15 @@
 #include "hook_dll.h"
 #include "utils/hook.h"
+#include "utils/hook_stats.h"
 
 static std::unique_ptr<HookLyric> hook_lyric;
 
+// UpdateLayeredWindowÿ봥ٴΡͼãutils::SnapshotHookStats
+// Ĭϲ¼ʱHOOK_LYRIC_STATSŴ򿪣ʱÿHookStatScopeֻһζһ֧
+static const utils::HookStatId stat_update_layered = utils::RegisterHookStat("UpdateLayeredWindow");
+static const utils::HookStatId stat_update_layered_indirect = utils::RegisterHookStat("UpdateLayeredWindowIndirect");
+static const utils::HookStatId stat_capture = utils::RegisterHookStat("Capture");
+
 bool HookInit()
 {
 	if (!hook_lyric)
@@ -40,6 +47,7 @@ BOOL WINAPI HookUpdateLayeredWindow(
 	DWORD         dwFlags
 )
 {
+	utils::HookStatScope stat(stat_update_layered);
 	if (hook_lyric)
 	{
 		hook_lyric->Capture(hdcSrc, psize->cx, psize->cy);
@@ -53,6 +61,7 @@ BOOL WINAPI HookUpdateLayeredWindowIndirect(
 	_In_ const UPDATELAYEREDWINDOWINFO *pULWInfo
 )
 {
+	utils::HookStatScope stat(stat_update_layered_indirect);
 	if (hook_lyric)
 	{
 		hook_lyric->Capture(pULWInfo->hdcSrc, pULWInfo->psize->cx, pULWInfo->psize->cy);
@@ -67,12 +76,20 @@ bool HookLyric::Init()
 	m_hMap = OpenFileMapping(FILE_MAP_ALL_ACCESS, TRUE, L"LyricShareMem");
 	m_pBuffer = (BYTE*)MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 1024 * 1024);
 
-	// HookһapiȻִв
+#ifdef HOOK_LYRIC_STATS
+	utils::EnableHookStats(true);
+#endif
+
+	// HookһapiȻִвһװֻͣһĿ
 	HMODULE hUser32 = GetModuleHandle(L"user32.dll");
-	bool success = true;
-	success &= utils::HookFuncByName(hUser32, "UpdateLayeredWindow", HookUpdateLayeredWindow, &m_oldUpdateLayerdWindow, false);
-	success &= utils::HookFuncByName(hUser32, "UpdateLayeredWindowIndirect", HookUpdateLayeredWindowIndirect, &m_oldUpdateLayerdWindowIndirect, false);
-	return success;
+	m_hooks.resize(2);
+	m_hooks[0].funcName = "UpdateLayeredWindow";
+	m_hooks[0].newFuncAddr = HookUpdateLayeredWindow;
+	m_hooks[0].oldFuncAddr = &m_oldUpdateLayerdWindow;
+	m_hooks[1].funcName = "UpdateLayeredWindowIndirect";
+	m_hooks[1].newFuncAddr = HookUpdateLayeredWindowIndirect;
+	m_hooks[1].oldFuncAddr = &m_oldUpdateLayerdWindowIndirect;
+	return utils::HookFuncs(hUser32, m_hooks, false);
 }
 
 void HookLyric::UnInit()
@@ -90,12 +107,13 @@ void HookLyric::UnInit()
 	}
 	
 
-	utils::UnHookFunc(HookUpdateLayeredWindow, m_oldUpdateLayerdWindow);
-	utils::UnHookFunc(HookUpdateLayeredWindowIndirect, m_oldUpdateLayerdWindowIndirect);
+	utils::UnHookFuncs(m_hooks, false);
+	m_hooks.clear();
 }
 
 void HookLyric::Capture(HDC hdc, LONG cx, LONG cy)
 {
+	utils::HookStatScope stat(stat_capture);
 	HDC hMemDC = CreateCompatibleDC(hdc);
 	HBITMAP hBitmap = CreateCompatibleBitmap(hdc, cx, cy);
 	SelectObject(hMemDC, hBitmap);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Windows.h>
+#include <vector>
+#include "utils/hook.h"
 
 bool HookInit();
 void HookUninit();
@@ -44,4 +46,7 @@ public:
 
 	HANDLE m_hMap = nullptr;
 	BYTE* m_pBuffer = nullptr;
+
+private:
+	std::vector<utils::HookInfo> m_hooks;
 };
\ No newline at end of file
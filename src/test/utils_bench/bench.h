@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// utils_bench 的用例注册、计时和检查
+//
+// 每个用例用 BENCH_CASE 定义，在自己的 bench_*.cpp 里注册，main.cpp 按名字运行。
+// 用例既报告数字，也检查结果：优化前后的两条路径必须给出同样的答案，
+// 任何 Check 失败都会让进程以非 0 退出。
+
+namespace utils {
+	class PeImage;
+	class Signature;
+}
+
+namespace bench {
+
+	struct Options
+	{
+		std::string image;		// PE 文件，为空时跳过依赖映像的用例
+		int repeat = 3;			// 计时取 repeat 次中最快的一次
+	};
+
+	class Context
+	{
+	public:
+		explicit Context(const Options& options) : m_options(options) {}
+
+		const Options& Opt() const { return m_options; }
+		int Repeat() const { return m_options.repeat; }
+
+		// 文件形式的映像内容，第一次调用时读入，失败时为空
+		const std::vector<uint8_t>& ImageFile();
+
+		void Report(const char* format, ...);
+		bool Check(bool condition, const char* format, ...);
+		size_t Failures() const { return m_failures; }
+
+	private:
+		Options m_options;
+		std::vector<uint8_t> m_image;
+		bool m_imageLoaded = false;
+		size_t m_failures = 0;
+	};
+
+	// 全部可执行节的原始字节，按节的顺序拼接
+	std::vector<uint8_t> CodeBytes(const utils::PeImage& image);
+
+	// 作为参考答案的函数入口rva，升序去重：有.pdata时取.pdata，
+	// 否则取COFF符号表里落在可执行节中的外部符号（如Go程序），都没有时为空
+	std::vector<uint32_t> ReferenceEntries(const std::vector<uint8_t>& file, const utils::PeImage& image);
+
+	const size_t kSignatureLength = 16;
+
+	// 从代码里截取count个kSignatureLength字节的特征码，每个有3个通配字节，奇数编号的再改掉一个确定字节，多半就找不到了
+	std::vector<utils::Signature> SampleSignatures(const std::vector<uint8_t>& code, size_t count, uint32_t seed);
+
+	typedef void (*CaseFunc)(Context& ctx);
+
+	struct Case
+	{
+		const char* name;
+		const char* summary;
+		bool needImage;
+		CaseFunc func;
+	};
+
+	bool Register(const Case& c);
+	const std::vector<Case>& Cases();
+
+	typedef std::chrono::steady_clock Clock;
+
+	inline double Seconds(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double>(end - begin).count();
+	}
+
+	// 运行 repeat 次，返回最快一次的秒数
+	template <typename Func>
+	double BestOf(int repeat, Func&& func)
+	{
+		double best = 0;
+		for (int i = 0; i < std::max(repeat, 1); i++)
+		{
+			Clock::time_point begin = Clock::now();
+			func();
+			double elapsed = Seconds(begin, Clock::now());
+			if (i == 0 || elapsed < best)
+				best = elapsed;
+		}
+		return best;
+	}
+
+	// 排好序的样本的 p 分位数
+	template <typename T>
+	T Percentile(const std::vector<T>& sorted, double p)
+	{
+		if (sorted.empty())
+			return T();
+		return sorted[(size_t)(p * (sorted.size() - 1))];
+	}
+
+	// 阻止编译器把结果当成无用代码删掉
+	template <typename T>
+	inline void Keep(const T& value)
+	{
+		asm volatile("" : : "g"(&value) : "memory");
+	}
+
+}
+
+#define BENCH_CASE(name, summary, needImage) \
+	static void bench_##name(bench::Context& ctx); \
+	static bool bench_registered_##name = bench::Register({ #name, summary, needImage, bench_##name }); \
+	static void bench_##name(bench::Context& ctx)
@@ -0,0 +1,142 @@
+// 映像分析：控制流图和函数发现
+//
+// 同样的入口分别单线程和放到线程池里构建，得到的每个函数、每个块和每条边都必须相同。
+// DiscoverFunctions 同样比较有无线程池的结果，并以 .pdata 或符号表为参考计算精确率和召回率。
+
+#include "bench.h"
+#include "include/control_flow.h"
+#include "include/function_discovery.h"
+#include "include/pe_image.h"
+#include "include/thread_pool.h"
+#include <iterator>
+
+namespace {
+
+	bool SameBlock(const utils::CfgBlock& a, const utils::CfgBlock& b)
+	{
+		return a.rva == b.rva && a.size == b.size && a.instructionCount == b.instructionCount && a.flags == b.flags
+			&& a.successorCount == b.successorCount
+			&& std::equal(a.successors, a.successors + a.successorCount, b.successors);
+	}
+
+	bool SameFunction(const utils::CfgFunction& a, const utils::CfgFunction& b)
+	{
+		if (a.entryRva != b.entryRva || a.entryBlock != b.entryBlock || a.blockCount != b.blockCount
+			|| a.callCount != b.callCount || a.truncated != b.truncated)
+			return false;
+		if (!std::equal(a.calls, a.calls + a.callCount, b.calls))
+			return false;
+		for (uint32_t i = 0; i < a.blockCount; i++)
+		{
+			if (!SameBlock(a.blocks[i], b.blocks[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// 第一个不同的函数下标，全部相同返回-1
+	long FirstDifference(const utils::ControlFlowGraph& a, const utils::ControlFlowGraph& b)
+	{
+		const std::vector<const utils::CfgFunction*>& fa = a.Functions();
+		const std::vector<const utils::CfgFunction*>& fb = b.Functions();
+		size_t count = std::min(fa.size(), fb.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!SameFunction(*fa[i], *fb[i]))
+				return (long)i;
+		}
+		return fa.size() == fb.size() ? -1 : (long)count;
+	}
+
+	size_t BlockCount(const utils::ControlFlowGraph& graph)
+	{
+		size_t count = 0;
+		for (const utils::CfgFunction* function : graph.Functions())
+			count += function->blockCount;
+		return count;
+	}
+
+	void CompareBuilds(bench::Context& ctx, const utils::PeImage& image, utils::ThreadPool& pool,
+		const char* name, const std::vector<uint32_t>& entries, bool followCalls)
+	{
+		std::unique_ptr<utils::ControlFlowGraph> serial, parallel;
+		double serialSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+			serial.reset(new utils::ControlFlowGraph(image));
+			serial->Build(entries, followCalls);
+		});
+		double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+			parallel.reset(new utils::ControlFlowGraph(image));
+			parallel->Build(entries, followCalls, &pool);
+		});
+
+		size_t functions = serial->Functions().size();
+		ctx.Check(functions > 0, "%s: no function built", name);
+		long difference = FirstDifference(*serial, *parallel);
+		ctx.Check(difference < 0, "%s: pool build differs at function %ld (%zu vs %zu functions)",
+			name, difference, functions, parallel->Functions().size());
+		ctx.Report("%-14s %6zu functions, %7zu blocks: %7.1f ms, %6.0f functions/s; pool %7.1f ms (%.1fx)",
+			name, functions, BlockCount(*serial), serialSeconds * 1000, functions / serialSeconds,
+			poolSeconds * 1000, serialSeconds / poolSeconds);
+	}
+
+}
+
+BENCH_CASE(cfg_build, "control-flow graphs with and without a thread pool", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+
+	utils::ThreadPool pool;
+	CompareBuilds(ctx, image, pool, "entry + calls", { image.EntryPointRva() }, true);
+
+	std::vector<uint32_t> entries = bench::ReferenceEntries(file, image);
+	if (!entries.empty())
+		CompareBuilds(ctx, image, pool, "known entries", entries, false);
+}
+
+BENCH_CASE(function_discovery, "DiscoverFunctions precision and recall against known entries", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+
+	utils::ThreadPool pool;
+	utils::FunctionDiscoveryStats stats;
+	utils::PeFunctionTable serial(std::vector<utils::PeFunction>{}), parallel(std::vector<utils::PeFunction>{});
+	double serialSeconds = bench::BestOf(ctx.Repeat(), [&]() { serial = utils::DiscoverFunctions(image, nullptr, &stats); });
+	double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() { parallel = utils::DiscoverFunctions(image, &pool); });
+
+	const std::vector<utils::PeFunction>& a = serial.Functions();
+	const std::vector<utils::PeFunction>& b = parallel.Functions();
+	bool same = a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const utils::PeFunction& x, const utils::PeFunction& y) {
+		return x.beginRva == y.beginRva && x.endRva == y.endRva && x.unwindRva == y.unwindRva && x.primary == y.primary;
+	});
+	ctx.Check(same, "pool found %zu functions, one thread %zu", b.size(), a.size());
+
+	size_t codeSize = 0;
+	for (const utils::PeCodeRange& range : image.ExecutableRanges())
+		codeSize += range.size;
+	ctx.Report("%zu KB code, %zu instructions, %zu call targets, %zu boundaries, %zu seeds",
+		codeSize >> 10, stats.instructions, stats.callTargets, stats.boundaries, stats.seeds);
+	ctx.Report("one thread %6.1f ms, %5.1f MB/s; pool %6.1f ms (%.1fx)", serialSeconds * 1000,
+		codeSize / serialSeconds / (1024 * 1024), poolSeconds * 1000, serialSeconds / poolSeconds);
+
+	std::vector<uint32_t> known = bench::ReferenceEntries(file, image);
+	if (known.empty())
+	{
+		ctx.Report("no .pdata or symbols to score against");
+		return;
+	}
+	std::vector<uint32_t> found = serial.Entries();
+	std::vector<uint32_t> hits;
+	std::set_intersection(found.begin(), found.end(), known.begin(), known.end(), std::back_inserter(hits));
+	double precision = found.empty() ? 0 : 100.0 * hits.size() / found.size();
+	double recall = 100.0 * hits.size() / known.size();
+	ctx.Report("%zu found, %zu known, %zu both: precision %.1f%%, recall %.1f%%", found.size(), known.size(), hits.size(), precision, recall);
+	// tools/QuerySoftDir.exe 上是 88% 和 98%，低很多说明启发式退化了
+	ctx.Check(precision >= 80, "precision %.1f%% is below 80%%", precision);
+	ctx.Check(recall >= 90, "recall %.1f%% is below 90%%", recall);
+}
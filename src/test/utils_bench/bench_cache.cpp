@@ -0,0 +1,132 @@
+// 特征码的磁盘缓存
+//
+// 同一个模块第二次启动时应该全部从缓存取到结果，找不到的特征码也不再扫描；
+// 偏移处的代码变了只重扫那一个，模块标识变了全部重扫。结果都和直接扫描对照。
+
+#include "bench.h"
+#include "include/pe_image.h"
+#include "include/signature.h"
+#include "include/signature_cache.h"
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+	const size_t kCacheSignatures = 40;
+	const char* const kModuleName = "QuerySoftDir.exe";
+
+	// 扫描一次，记下扫了几个特征码
+	struct CountingScan
+	{
+		const utils::PeImage& image;
+		size_t scans = 0;
+		size_t signatures = 0;
+
+		std::vector<const uint8_t*> operator()(const utils::SignatureSet& missing)
+		{
+			scans++;
+			signatures += missing.Size();
+			return missing.Find(image);
+		}
+	};
+
+	struct CacheRun
+	{
+		std::vector<const uint8_t*> found;
+		size_t scans = 0;
+		size_t signatures = 0;
+		double seconds = 0;
+	};
+
+	// 每次都重新打开缓存文件，和进程重启后一样只有磁盘上的内容
+	CacheRun RunCached(const std::string& path, const utils::PeImage& image, const utils::SignatureSet& set)
+	{
+		CacheRun run;
+		bench::Clock::time_point begin = bench::Clock::now();
+		utils::SignatureCache cache;
+		cache.Open(path);
+		CountingScan scan{ image };
+		run.found = utils::FindSignaturesCached(cache, kModuleName, image, set,
+			[&scan](const utils::SignatureSet& missing) { return scan(missing); });
+		run.seconds = bench::Seconds(begin, bench::Clock::now());
+		run.scans = scan.scans;
+		run.signatures = scan.signatures;
+		return run;
+	}
+
+	// 两次的结果按各自映像里的偏移比较
+	bool SameOffsets(const std::vector<const uint8_t*>& left, const uint8_t* leftBase,
+		const std::vector<const uint8_t*>& right, const uint8_t* rightBase)
+	{
+		if (left.size() != right.size())
+			return false;
+		for (size_t i = 0; i < left.size(); i++)
+		{
+			if (!left[i] != !right[i] || (left[i] && left[i] - leftBase != right[i] - rightBase))
+				return false;
+		}
+		return true;
+	}
+
+}
+
+BENCH_CASE(signature_cache, "cached signature offsets: warm start, negative entries, stale entries and module changes", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+	std::vector<uint8_t> code = bench::CodeBytes(image);
+	if (!ctx.Check(code.size() > bench::kSignatureLength, "no executable section"))
+		return;
+
+	utils::SignatureSet set(bench::SampleSignatures(code, kCacheSignatures, 4));
+	std::vector<const uint8_t*> expected = set.Find(image);
+	size_t absent = std::count(expected.begin(), expected.end(), nullptr);
+	ctx.Check(absent > 0 && absent < kCacheSignatures, "%zu of %zu signatures absent, the case needs both kinds", absent, kCacheSignatures);
+
+	std::string path = "/tmp/utils_bench_sigcache." + std::to_string(getpid());
+	unlink(path.c_str());
+
+	CacheRun cold = RunCached(path, image, set);
+	ctx.Check(cold.found == expected, "cold run differs from a direct scan");
+	ctx.Check(cold.scans == 1 && cold.signatures == kCacheSignatures, "cold run scanned %zu signatures in %zu scans", cold.signatures, cold.scans);
+
+	// 命中的和确定没有的都在缓存里，一次也不扫
+	CacheRun warm = RunCached(path, image, set);
+	ctx.Check(warm.found == expected, "warm run differs from a direct scan");
+	ctx.Check(warm.scans == 0, "warm run scanned %zu signatures", warm.signatures);
+
+	// 标识不变、代码变了：改掉第一个命中处的一个确定字节，只有它要重扫
+	size_t hit = std::find_if(expected.begin(), expected.end(), [](const uint8_t* p) { return p != nullptr; }) - expected.begin();
+	std::vector<uint8_t> patched(file);
+	if (ctx.Check(hit < expected.size(), "no signature found in the image"))
+	{
+		const utils::Signature& sig = set.At(hit);
+		size_t at = expected[hit] - file.data();
+		size_t fixed = std::find(sig.Mask().begin(), sig.Mask().end(), 0xFF) - sig.Mask().begin();
+		patched[at + fixed] ^= 0xff;
+		utils::PeImage patchedImage(patched.data(), patched.size(), false);
+		CacheRun stale = RunCached(path, patchedImage, set);
+		ctx.Check(SameOffsets(stale.found, patched.data(), set.Find(patchedImage), patched.data()),
+			"stale run differs from a direct scan of the patched image");
+		ctx.Check(stale.scans == 1 && stale.signatures == 1, "stale run scanned %zu signatures, expected 1", stale.signatures);
+	}
+
+	// 模块标识变了（IMAGE_FILE_HEADER的TimeDateStamp），全部重扫
+	std::vector<uint8_t> rebuilt(file);
+	uint32_t ntOffset = 0;
+	memcpy(&ntOffset, &rebuilt[0x3c], 4);
+	rebuilt[ntOffset + 8] ^= 1;
+	utils::PeImage rebuiltImage(rebuilt.data(), rebuilt.size(), false);
+	CacheRun changed = RunCached(path, rebuiltImage, set);
+	ctx.Check(SameOffsets(changed.found, rebuilt.data(), expected, file.data()), "changed-module run differs from a direct scan");
+	ctx.Check(changed.signatures == kCacheSignatures, "changed-module run scanned %zu signatures, expected all %zu",
+		changed.signatures, kCacheSignatures);
+	CacheRun rewarm = RunCached(path, rebuiltImage, set);
+	ctx.Check(rewarm.scans == 0, "second run after the module change scanned %zu signatures", rewarm.signatures);
+	unlink(path.c_str());
+
+	ctx.Report("%zu signatures (%zu absent): cold %.2f ms, warm %.3f ms (%.0fx), changed module %.2f ms",
+		kCacheSignatures, absent, cold.seconds * 1000, warm.seconds * 1000, cold.seconds / warm.seconds, changed.seconds * 1000);
+}
@@ -0,0 +1,230 @@
+// 只改写调用点的挂钩
+//
+// 一个目标函数被三处调用：call rel32、尾调用的 jmp rel32、call [槽]，另有一处 call rel32 不挂。
+// 按 HookCallSites/UnHookCallSites 的做法在一个事务里改写选中的调用点，检查：
+// 只有选中的调用点进钩子，钩子看到的返回地址是调用方自己的，目标函数本身和没选中的调用点不受影响；
+// 调用点只改了最后 4 字节，卸载后逐字节恢复；事务里有一个调用点失败时一个都不改。
+// hook.cpp 只在 Windows 上编译，这里直接调它包装的 DetourAttachCallSite/DetourDetachCallSite。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <cstring>
+
+extern "C" long bench_site_target(long);
+extern "C" long bench_site_caller(long);
+extern "C" long bench_site_other(long);
+extern "C" long bench_site_tail(long);
+extern "C" long bench_site_slot_caller(long);
+
+// 调用指令本身的地址
+extern "C" unsigned char bench_site_call[];
+extern "C" unsigned char bench_site_other_call[];
+extern "C" unsigned char bench_site_jmp[];
+extern "C" unsigned char bench_site_slot_call[];
+extern "C" unsigned char bench_site_after_call[];
+extern "C" unsigned char bench_site_after_slot_call[];
+
+extern "C" void* bench_site_slot;
+
+// 调用方按 SysV 约定对齐栈再 call，钩子是普通的 C++ 函数
+asm(".text\n"
+	".p2align 4\n"
+	".globl bench_site_target\n"
+	"bench_site_target:\n"
+	"	lea 1(%rdi), %rax\n"
+	"	ret\n"
+	".p2align 4\n"
+	".globl bench_site_caller\n"
+	"bench_site_caller:\n"
+	"	sub $8, %rsp\n"
+	".globl bench_site_call\n"
+	"bench_site_call:\n"
+	"	call bench_site_target\n"
+	".globl bench_site_after_call\n"
+	"bench_site_after_call:\n"
+	"	add $8, %rsp\n"
+	"	ret\n"
+	".p2align 4\n"
+	".globl bench_site_other\n"
+	"bench_site_other:\n"
+	"	sub $8, %rsp\n"
+	".globl bench_site_other_call\n"
+	"bench_site_other_call:\n"
+	"	call bench_site_target\n"
+	"	add $8, %rsp\n"
+	"	ret\n"
+	".p2align 4\n"
+	".globl bench_site_tail\n"
+	"bench_site_tail:\n"
+	".globl bench_site_jmp\n"
+	"bench_site_jmp:\n"
+	"	{disp32} jmp bench_site_target\n"
+	".p2align 4\n"
+	".globl bench_site_slot_caller\n"
+	"bench_site_slot_caller:\n"
+	"	sub $8, %rsp\n"
+	".globl bench_site_slot_call\n"
+	"bench_site_slot_call:\n"
+	"	call *bench_site_slot(%rip)\n"
+	".globl bench_site_after_slot_call\n"
+	"bench_site_after_slot_call:\n"
+	"	add $8, %rsp\n"
+	"	ret\n"
+	".data\n"
+	".p2align 3\n"
+	".globl bench_site_slot\n"
+	"bench_site_slot:\n"
+	"	.quad bench_site_target\n"
+	".text\n");
+
+namespace {
+
+	typedef long (*TargetFunc)(long);
+
+	const long kHookDelta = 1000;
+	const int kCalls = 1000 * 1000;
+
+	enum { kCall, kJmp, kSlotCall, kSiteCount };
+
+	unsigned char* const s_sites[kSiteCount] = { bench_site_call, bench_site_jmp, bench_site_slot_call };
+	const size_t kSiteSize[kSiteCount] = { 5, 5, 6 };
+
+	// 每个调用点装同一个钩子，原函数都是 bench_site_target
+	TargetFunc s_original = nullptr;
+	long s_hookCalls = 0;
+	void* s_lastReturn = nullptr;
+
+	__attribute__((noinline)) long SiteHook(long value)
+	{
+		s_hookCalls++;
+		s_lastReturn = __builtin_return_address(0);
+		return s_original(value) + kHookDelta;
+	}
+
+	// 同 HookCallSites：所有调用点在一个事务里改写，有一个失败就放弃整个事务
+	bool AttachSites(unsigned char* const* sites, size_t count, void** original)
+	{
+		if (DetourTransactionBegin() != NO_ERROR)
+			return false;
+		void* first = nullptr;
+		for (size_t i = 0; i < count; i++)
+		{
+			void* siteOriginal = nullptr;
+			if (DetourAttachCallSite(sites[i], (void*)SiteHook, &siteOriginal) != NO_ERROR
+				|| (first && siteOriginal != first))
+			{
+				DetourTransactionAbort();
+				return false;
+			}
+			first = siteOriginal;
+		}
+		DetourUpdateAllThreads();
+		if (DetourTransactionCommit() != NO_ERROR)
+			return false;
+		*original = first;
+		return true;
+	}
+
+	bool DetachSites(unsigned char* const* sites, size_t count)
+	{
+		if (DetourTransactionBegin() != NO_ERROR)
+			return false;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (DetourDetachCallSite(sites[i], (void*)SiteHook) != NO_ERROR)
+			{
+				DetourTransactionAbort();
+				return false;
+			}
+		}
+		DetourUpdateAllThreads();
+		return DetourTransactionCommit() == NO_ERROR;
+	}
+
+	// 调一次 func，返回钩子进了几次，returnAddress 是钩子看到的返回地址
+	long HookCallsOf(TargetFunc func, long& result, void*& returnAddress)
+	{
+		long before = s_hookCalls;
+		s_lastReturn = nullptr;
+		result = func(1);
+		returnAddress = s_lastReturn;
+		return s_hookCalls - before;
+	}
+
+	double NsPerCall(bench::Context& ctx, TargetFunc func)
+	{
+		TargetFunc volatile call = func;
+		double seconds = bench::BestOf(ctx.Repeat(), [&]() {
+			long sum = 0;
+			for (int i = 0; i < kCalls; i++)
+				sum += call(i);
+			bench::Keep(sum);
+		});
+		return seconds * 1e9 / kCalls;
+	}
+
+}
+
+BENCH_CASE(call_site, "call-site hooks: only the patched sites reach the detour, unhook restores the bytes", false)
+{
+	unsigned char saved[kSiteCount][8];
+	for (int i = 0; i < kSiteCount; i++)
+		memcpy(saved[i], s_sites[i], kSiteSize[i]);
+	double plainNs = NsPerCall(ctx, bench_site_caller);
+
+	// 有一个调用点不对时整个事务放弃：目标函数入口不是调用指令
+	unsigned char* const badSites[] = { bench_site_call, (unsigned char*)bench_site_target };
+	void* original = nullptr;
+	ctx.Check(!AttachSites(badSites, 2, &original), "attach with a bad site succeeded");
+	ctx.Check(memcmp(saved[kCall], bench_site_call, kSiteSize[kCall]) == 0, "call site changed by an aborted transaction");
+	ctx.Check(bench_site_caller(1) == 2, "call site hooked by an aborted transaction");
+
+	if (!ctx.Check(AttachSites(s_sites, kSiteCount, &original), "attach failed"))
+		return;
+	ctx.Check(original == (void*)bench_site_target, "original is %p, not the target %p", original, (void*)bench_site_target);
+	s_original = (TargetFunc)original;
+
+	// 调用指令和长度不变，只有最后 4 字节的位移变了
+	for (int i = 0; i < kSiteCount; i++)
+	{
+		size_t size = kSiteSize[i];
+		ctx.Check(memcmp(saved[i], s_sites[i], size - 4) == 0 && memcmp(saved[i] + size - 4, s_sites[i] + size - 4, 4) != 0,
+			"site %d: expected only the trailing disp32 to change", i);
+	}
+	ctx.Check(bench_site_slot == (void*)bench_site_target, "call [slot] hook wrote the slot itself");
+
+	long result = 0;
+	void* returnAddress = nullptr;
+	ctx.Check(HookCallsOf(bench_site_caller, result, returnAddress) == 1 && result == 2 + kHookDelta
+		&& returnAddress == bench_site_after_call, "call rel32 site: result %ld, returned to %p", result, returnAddress);
+	ctx.Check(HookCallsOf(bench_site_slot_caller, result, returnAddress) == 1 && result == 2 + kHookDelta
+		&& returnAddress == bench_site_after_slot_call, "call [slot] site: result %ld, returned to %p", result, returnAddress);
+	ctx.Check(HookCallsOf(bench_site_tail, result, returnAddress) == 1 && result == 2 + kHookDelta,
+		"tail jmp site: result %ld", result);
+	ctx.Check(HookCallsOf(bench_site_other, result, returnAddress) == 0 && result == 2, "unselected call site reached the hook");
+	ctx.Check(HookCallsOf(bench_site_target, result, returnAddress) == 0 && result == 2, "direct call of the target reached the hook");
+	ctx.Check(memcmp(saved[kCall], bench_site_other_call, kSiteSize[kCall] - 4) == 0, "unselected call site changed");
+
+	// 钩子只能用自己的函数摘，别的函数摘会失败且不动调用点
+	unsigned char hooked[8];
+	memcpy(hooked, bench_site_call, kSiteSize[kCall]);
+	if (DetourTransactionBegin() == NO_ERROR)
+	{
+		ctx.Check(DetourDetachCallSite(bench_site_call, (void*)bench_site_target) != NO_ERROR, "detach with the wrong detour succeeded");
+		DetourTransactionAbort();
+	}
+	ctx.Check(memcmp(hooked, bench_site_call, kSiteSize[kCall]) == 0, "failed detach changed the site");
+
+	double hookedNs = NsPerCall(ctx, bench_site_caller);
+	double otherNs = NsPerCall(ctx, bench_site_other);
+
+	if (!ctx.Check(DetachSites(s_sites, kSiteCount), "detach failed"))
+		return;
+	for (int i = 0; i < kSiteCount; i++)
+		ctx.Check(memcmp(saved[i], s_sites[i], kSiteSize[i]) == 0, "site %d not restored byte for byte", i);
+	ctx.Check(HookCallsOf(bench_site_caller, result, returnAddress) == 0 && result == 2, "call site still hooked after detach");
+	ctx.Check(HookCallsOf(bench_site_tail, result, returnAddress) == 0 && result == 2, "tail site still hooked after detach");
+	ctx.Check(HookCallsOf(bench_site_slot_caller, result, returnAddress) == 0 && result == 2, "slot site still hooked after detach");
+
+	ctx.Report("call %.1f ns, through the hook %.1f ns, unselected site while hooked %.1f ns", plainNs, hookedNs, otherNs);
+}
@@ -0,0 +1,150 @@
+// 代码洞里的跳板
+//
+// 打开 DetourSetCodeCaves 后，挂钩本模块里的函数，跳板应该放进模块自己的 int3 填充里，
+// 不再另外分配区域；摘钩后填充恢复原样。另外比较打开前后一次挂上再摘下的耗时。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <dlfcn.h>
+
+// 4 个目标函数，后面跟一长串 int3 作为代码洞
+#define CAVE_TARGET(n) \
+	".p2align 4\n" \
+	".globl bench_cave_target" #n "\n" \
+	"bench_cave_target" #n ":\n" \
+	"	push %rbp\n" \
+	"	mov %rsp, %rbp\n" \
+	"	lea " #n "(%rdi), %rax\n" \
+	"	pop %rbp\n" \
+	"	ret\n"
+
+extern "C" long bench_cave_target0(long);
+extern "C" long bench_cave_target1(long);
+extern "C" long bench_cave_target2(long);
+extern "C" long bench_cave_target3(long);
+extern "C" const uint8_t bench_cave_fill[];
+extern "C" const uint8_t bench_cave_fill_end[];
+
+asm(".text\n"
+	CAVE_TARGET(0) CAVE_TARGET(1) CAVE_TARGET(2) CAVE_TARGET(3)
+	".globl bench_cave_fill\n"
+	"bench_cave_fill:\n"
+	".fill 2048, 1, 0xcc\n"
+	".globl bench_cave_fill_end\n"
+	"bench_cave_fill_end:\n");
+
+namespace {
+
+	const int kTargetCount = 4;
+	const long kHookDelta = 1000;
+
+	typedef long (*TargetFunc)(long);
+
+	const TargetFunc s_targets[kTargetCount] = {
+		bench_cave_target0, bench_cave_target1, bench_cave_target2, bench_cave_target3,
+	};
+
+	TargetFunc s_real[kTargetCount];
+
+	template <int n>
+	long Detour(long value)
+	{
+		return s_real[n](value) + kHookDelta;
+	}
+
+	const TargetFunc s_detours[kTargetCount] = {
+		Detour<0>, Detour<1>, Detour<2>, Detour<3>,
+	};
+
+	LONG Commit(bool attach)
+	{
+		DetourTransactionBegin();
+		for (int i = 0; i < kTargetCount; i++)
+		{
+			if (attach)
+			{
+				s_real[i] = s_targets[i];
+				DetourAttach((PVOID*)&s_real[i], (PVOID)s_detours[i]);
+			}
+			else
+				DetourDetach((PVOID*)&s_real[i], (PVOID)s_detours[i]);
+		}
+		DetourUpdateAllThreads();
+		return DetourTransactionCommit();
+	}
+
+	bool SameModule(const void* a, const void* b)
+	{
+		Dl_info ia, ib;
+		return dladdr(a, &ia) && dladdr(b, &ib) && ia.dli_fbase == ib.dli_fbase;
+	}
+
+	bool IsFiller(const uint8_t* code, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			if (code[i] != code[0] || (code[0] != 0xcc && code[0] != 0x90))
+				return false;
+		}
+		return true;
+	}
+
+	// 挂上再摘下cycles次，返回每次的微秒数
+	double CycleMicroseconds(bench::Context& ctx, int cycles)
+	{
+		bench::Clock::time_point begin = bench::Clock::now();
+		for (int i = 0; i < cycles; i++)
+		{
+			if (!ctx.Check(Commit(true) == NO_ERROR && Commit(false) == NO_ERROR, "attach/detach cycle %d failed", i))
+				break;
+		}
+		return bench::Seconds(begin, bench::Clock::now()) * 1e6 / cycles;
+	}
+
+}
+
+BENCH_CASE(code_caves, "trampolines in the module's own int3 padding", false)
+{
+	BOOL previous = DetourSetCodeCaves(TRUE);
+
+	DETOUR_TRAMPOLINE_STATS before, after;
+	DetourGetTrampolineStats(&before);
+	if (!ctx.Check(Commit(true) == NO_ERROR, "attach failed"))
+	{
+		DetourSetCodeCaves(previous);
+		return;
+	}
+	DetourGetTrampolineStats(&after);
+
+	const uint8_t* trampolines[kTargetCount];
+	size_t inFill = 0;
+	for (int i = 0; i < kTargetCount; i++)
+	{
+		trampolines[i] = (const uint8_t*)s_real[i];
+		ctx.Check(s_targets[i](10) == 10 + i + kHookDelta, "target %d: hooked call returned %ld", i, s_targets[i](10));
+		ctx.Check(SameModule(trampolines[i], (const void*)s_targets[i]), "target %d: trampoline %p is outside the module", i, trampolines[i]);
+		if (trampolines[i] >= bench_cave_fill && trampolines[i] < bench_cave_fill_end)
+			inFill++;
+	}
+	ULONG caves = after.cCaveTrampolines - before.cCaveTrampolines;
+	ctx.Check(caves == kTargetCount, "%u of %d trampolines placed in caves", caves, kTargetCount);
+	ctx.Check(after.cRegionsAllocated == before.cRegionsAllocated, "a region was allocated although caves were free");
+
+	ctx.Check(Commit(false) == NO_ERROR, "detach failed");
+	for (int i = 0; i < kTargetCount; i++)
+	{
+		ctx.Check(s_targets[i](10) == 10 + i, "target %d still hooked", i);
+		ctx.Check(IsFiller(trampolines[i], 32), "target %d: cave at %p not restored", i, trampolines[i]);
+	}
+	ctx.Check(IsFiller(bench_cave_fill, bench_cave_fill_end - bench_cave_fill), "the int3 run was not restored");
+
+	const int cycles = 200;
+	double caveCycle = CycleMicroseconds(ctx, cycles);
+	DetourSetCodeCaves(FALSE);
+	double regionCycle = CycleMicroseconds(ctx, cycles);
+	DetourSetCodeCaves(previous);
+
+	ctx.Report("%d trampolines in caves (%zu in the int3 run next to the targets), %u modules scanned, %u probes",
+		kTargetCount, inFill, after.cCaveModules - before.cCaveModules, after.cCaveProbes - before.cCaveProbes);
+	ctx.Report("attach + detach of %d functions: caves %6.1f us, regions %6.1f us", kTargetCount, caveCycle, regionCycle);
+}
@@ -0,0 +1,294 @@
+// 反汇编
+//
+// 在映像的可执行节上线性扫描，只解码的 DetourDecodeInstructionEx、批量的
+// DetourDecodeInstructionsEx 和复制指令的 DetourCopyInstructionEx 必须给出同样的长度和目标。
+// 随机字节的每个偏移上，x86、x64 和本机的打包解码表也逐一和复制用的表对照。
+// 多线程时每个线程用自己的 DETOUR_DISASM_CONTEXT，结果必须和单线程一致。
+// 代码放在自己的缓冲区里，上下文把引用限制在缓冲区内，call/jmp [mem] 不会读到别处。
+
+#include "bench.h"
+#include "include/pe_image.h"
+#include "detour/detours.h"
+#include <thread>
+
+namespace {
+
+	// 解码可能越过末尾最多15字节，多留一些
+	const size_t kCodePadding = 32;
+
+	struct SweepInstruction
+	{
+		uint32_t offset;
+		uint8_t length;
+		bool invalid;
+		PVOID target;
+
+		bool operator == (const SweepInstruction& other) const
+		{
+			return offset == other.offset && length == other.length && invalid == other.invalid && target == other.target;
+		}
+	};
+
+	struct DisasmInput
+	{
+		std::vector<uint8_t> code;
+		size_t size = 0;		// 不含尾部填充
+		DETOUR_DISASM_CONTEXT context;
+	};
+
+	bool LoadDisasmInput(bench::Context& ctx, DisasmInput& input)
+	{
+		const std::vector<uint8_t>& file = ctx.ImageFile();
+		utils::PeImage image(file.data(), file.size(), false);
+		if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+			return false;
+		if (!ctx.Check(image.Is64Bit(), "the native disassembler needs an x64 image"))
+			return false;
+		input.code = bench::CodeBytes(image);
+		input.size = input.code.size();
+		if (!ctx.Check(input.size > 0, "no executable section"))
+			return false;
+		input.code.resize(input.size + kCodePadding, 0xcc);
+		DetourInitializeDisasmContext(&input.context, input.code.data(), input.code.data() + input.size, TRUE);
+		return true;
+	}
+
+	SweepInstruction FromDecoded(const DETOUR_DECODED_INSTRUCTION& decoded, PBYTE base)
+	{
+		SweepInstruction insn;
+		insn.offset = (uint32_t)(decoded.pbCode - base);
+		insn.length = decoded.cbInstruction;
+		insn.invalid = (decoded.wFlags & DETOUR_DECODED_INVALID) != 0;
+		insn.target = decoded.pbTarget;
+		return insn;
+	}
+
+	// [begin, end)内从begin开始线性扫描，无法识别的字节也按解码器给的长度前进
+	std::vector<SweepInstruction> DecodeSweep(const DisasmInput& input, size_t begin, size_t end, const DETOUR_DISASM_CONTEXT* context)
+	{
+		std::vector<SweepInstruction> sweep;
+		sweep.reserve((end - begin) / 3);
+		PBYTE base = (PBYTE)input.code.data();
+		for (PBYTE code = base + begin; code < base + end;)
+		{
+			DETOUR_DECODED_INSTRUCTION decoded;
+			PBYTE next = (PBYTE)DetourDecodeInstructionEx(code, &decoded, context);
+			if (next == NULL)
+				break;
+			sweep.push_back(FromDecoded(decoded, base));
+			code = next;
+		}
+		return sweep;
+	}
+
+	// DetourDecodeInstructionsEx一次解码出的count条指令
+	std::vector<SweepInstruction> BatchSweep(const DisasmInput& input, const std::vector<DETOUR_DECODED_INSTRUCTION>& decoded, ULONG count)
+	{
+		PBYTE base = (PBYTE)input.code.data();
+		std::vector<SweepInstruction> sweep(count);
+		for (ULONG i = 0; i < count; i++)
+			sweep[i] = FromDecoded(decoded[i], base);
+		return sweep;
+	}
+
+	// 只解码不记录，和CopySweep的计时口径一致
+	size_t DecodeCount(const DisasmInput& input, const DETOUR_DISASM_CONTEXT* context)
+	{
+		size_t count = 0;
+		PBYTE base = (PBYTE)input.code.data();
+		for (PBYTE code = base; code < base + input.size; count++)
+		{
+			DETOUR_DECODED_INSTRUCTION decoded;
+			PBYTE next = (PBYTE)DetourDecodeInstructionEx(code, &decoded, context);
+			if (next == NULL)
+				break;
+			code = next;
+		}
+		return count;
+	}
+
+	// 复制引擎走一遍同样的指令，只计时
+	size_t CopySweep(const DisasmInput& input, const DETOUR_DISASM_CONTEXT* context)
+	{
+		size_t count = 0;
+		PBYTE base = (PBYTE)input.code.data();
+		for (PBYTE code = base; code < base + input.size; count++)
+		{
+			PBYTE next = (PBYTE)DetourCopyInstructionEx(NULL, NULL, code, NULL, NULL, context);
+			if (next == NULL || next <= code)
+				break;
+			code = next;
+		}
+		return count;
+	}
+
+	// 解码器认得的每条指令，复制引擎必须给出同样的长度和目标，返回第一处不同，没有则返回sweep.size()
+	size_t CheckAgainstCopy(const DisasmInput& input, const std::vector<SweepInstruction>& sweep, const DETOUR_DISASM_CONTEXT* context, size_t& copyLength, PVOID& copyTarget)
+	{
+		PBYTE base = (PBYTE)input.code.data();
+		for (size_t i = 0; i < sweep.size(); i++)
+		{
+			if (sweep[i].invalid)
+				continue;
+			copyTarget = NULL;
+			PBYTE code = base + sweep[i].offset;
+			PBYTE next = (PBYTE)DetourCopyInstructionEx(NULL, NULL, code, &copyTarget, NULL, context);
+			copyLength = next ? next - code : 0;
+			if (copyLength != sweep[i].length || copyTarget != sweep[i].target)
+				return i;
+		}
+		return sweep.size();
+	}
+
+	double NsPer(double seconds, size_t count)
+	{
+		return count ? seconds * 1e9 / count : 0;
+	}
+
+}
+
+BENCH_CASE(disasm_sweep, "decode-only engine against DetourCopyInstruction on a linear sweep", true)
+{
+	DisasmInput input;
+	if (!LoadDisasmInput(ctx, input))
+		return;
+
+	size_t copied = 0, counted = 0;
+	ULONG batched = 0;
+	std::vector<DETOUR_DECODED_INSTRUCTION> buffer(input.size);
+	double copySeconds = bench::BestOf(ctx.Repeat(), [&]() { copied = CopySweep(input, &input.context); });
+	double decodeSeconds = bench::BestOf(ctx.Repeat(), [&]() { counted = DecodeCount(input, &input.context); });
+	double batchSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+		batched = DetourDecodeInstructionsEx(input.code.data(), (ULONG)input.size, buffer.data(), (ULONG)buffer.size(), &input.context);
+	});
+
+	std::vector<SweepInstruction> decoded = DecodeSweep(input, 0, input.size, &input.context);
+	ctx.Check(counted == decoded.size(), "decode sweeps stopped at different places");
+	ctx.Check(BatchSweep(input, buffer, batched) == decoded, "DetourDecodeInstructionsEx differs from one call per instruction");
+
+	size_t copyLength = 0;
+	PVOID copyTarget = NULL;
+	size_t mismatch = CheckAgainstCopy(input, decoded, &input.context, copyLength, copyTarget);
+	if (!ctx.Check(mismatch == decoded.size(), "decode and copy differ at instruction %zu", mismatch))
+	{
+		ctx.Report("offset %x: decode %u bytes -> %p, copy %zu bytes -> %p", decoded[mismatch].offset,
+			decoded[mismatch].length, decoded[mismatch].target, copyLength, copyTarget);
+	}
+
+	size_t invalid = std::count_if(decoded.begin(), decoded.end(), [](const SweepInstruction& insn) { return insn.invalid; });
+	ctx.Report("%zu KB code, %zu instructions, %zu invalid", input.size >> 10, decoded.size(), invalid);
+	ctx.Report("%-26s %5.1f ns/instruction", "DetourCopyInstructionEx", NsPer(copySeconds, copied));
+	ctx.Report("%-26s %5.1f ns/instruction (%.1fx)", "DetourDecodeInstructionEx", NsPer(decodeSeconds, counted), copySeconds / decodeSeconds);
+	ctx.Report("%-26s %5.1f ns/instruction (%.1fx)", "DetourDecodeInstructionsEx", NsPer(batchSeconds, batched), copySeconds / batchSeconds);
+}
+
+BENCH_CASE(disasm_threads, "per-thread disassembler contexts against one thread", true)
+{
+	DisasmInput input;
+	if (!LoadDisasmInput(ctx, input))
+		return;
+	std::vector<SweepInstruction> expected;
+	double serialSeconds = bench::BestOf(ctx.Repeat(), [&]() { expected = DecodeSweep(input, 0, input.size, &input.context); });
+
+	// 按单线程的指令边界切块，每个线程用自己的上下文
+	const size_t threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 4);
+	std::vector<size_t> starts;
+	for (size_t i = 0; i < threadCount; i++)
+		starts.push_back(expected[expected.size() * i / threadCount].offset);
+	starts.push_back(input.size);
+
+	std::vector<std::vector<SweepInstruction>> parts(threadCount);
+	double threadSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			threads.emplace_back([&, i]() {
+				DETOUR_DISASM_CONTEXT context;
+				DetourInitializeDisasmContext(&context, input.code.data(), input.code.data() + input.size, TRUE);
+				parts[i] = DecodeSweep(input, starts[i], starts[i + 1], &context);
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	});
+
+	std::vector<SweepInstruction> joined;
+	for (const std::vector<SweepInstruction>& part : parts)
+		joined.insert(joined.end(), part.begin(), part.end());
+	ctx.Check(joined == expected, "%zu threads decoded %zu instructions, one thread %zu", threadCount, joined.size(), expected.size());
+	ctx.Report("one thread %6.2f ms, %zu threads %6.2f ms (%.1fx on %u cpus)", serialSeconds * 1000, threadCount,
+		threadSeconds * 1000, serialSeconds / threadSeconds, std::thread::hardware_concurrency());
+}
+
+namespace {
+
+	typedef PVOID (WINAPI *DecodeFunc)(PVOID, PDETOUR_DECODED_INSTRUCTION, const DETOUR_DISASM_CONTEXT*);
+	typedef PVOID (WINAPI *CopyFunc)(PVOID, PVOID*, PVOID, PVOID*, LONG*, const DETOUR_DISASM_CONTEXT*);
+	typedef BOOL (WINAPI *ContextFunc)(PDETOUR_DISASM_CONTEXT, PVOID, PVOID, BOOL);
+
+	struct DisasmArch
+	{
+		const char* name;
+		DecodeFunc decode;
+		CopyFunc copy;
+		ContextFunc initialize;
+	};
+
+	// 从每个字节偏移开始解码一次，返回比较过的指令数，不一致的偏移放进mismatches
+	size_t CompareEveryOffset(const DisasmArch& arch, const std::vector<uint8_t>& buffer, size_t size, std::vector<size_t>& mismatches)
+	{
+		PBYTE base = (PBYTE)buffer.data();
+		DETOUR_DISASM_CONTEXT context;
+		arch.initialize(&context, base, base + size, TRUE);
+		size_t compared = 0;
+		for (size_t offset = 0; offset < size; offset++)
+		{
+			DETOUR_DECODED_INSTRUCTION decoded;
+			PBYTE next = (PBYTE)arch.decode(base + offset, &decoded, &context);
+			if (next == NULL || (decoded.wFlags & DETOUR_DECODED_INVALID))
+				continue;
+			PVOID target = NULL;
+			PBYTE copied = (PBYTE)arch.copy(NULL, NULL, base + offset, &target, NULL, &context);
+			compared++;
+			if (copied != next || target != decoded.pbTarget)
+				mismatches.push_back(offset);
+		}
+		return compared;
+	}
+
+}
+
+BENCH_CASE(disasm_tables, "packed decode tables against the copy tables at every offset of random code", false)
+{
+	const size_t size = 256 * 1024;
+	std::vector<uint8_t> buffer(size + kCodePadding, 0xcc);
+	uint64_t state = 0x2545f4914f6cdd1dull;
+	for (size_t i = 0; i < size; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		buffer[i] = (uint8_t)state;
+	}
+
+	const DisasmArch arches[] = {
+		{ "x86", DetourDecodeInstructionExX86, DetourCopyInstructionExX86, DetourInitializeDisasmContextX86 },
+		{ "x64", DetourDecodeInstructionExX64, DetourCopyInstructionExX64, DetourInitializeDisasmContextX64 },
+		{ "native", DetourDecodeInstructionEx, DetourCopyInstructionEx, DetourInitializeDisasmContext },
+	};
+	for (const DisasmArch& arch : arches)
+	{
+		std::vector<size_t> mismatches;
+		size_t compared = CompareEveryOffset(arch, buffer, size, mismatches);
+		ctx.Report("%-6s %zu offsets, %zu decoded, %zu mismatches", arch.name, size, compared, mismatches.size());
+		if (!ctx.Check(mismatches.empty(), "%s: decode and copy differ at %zu offsets", arch.name, mismatches.size()))
+		{
+			for (size_t i = 0; i < std::min<size_t>(mismatches.size(), 5); i++)
+			{
+				const uint8_t* code = &buffer[mismatches[i]];
+				ctx.Report("  +%05zx: %02x %02x %02x %02x %02x %02x %02x %02x", mismatches[i],
+					code[0], code[1], code[2], code[3], code[4], code[5], code[6], code[7]);
+			}
+		}
+	}
+}
@@ -0,0 +1,104 @@
+// 参数过滤代码的调用开销
+//
+// 被过滤掉的调用经过过滤代码直接回到原函数，和直接调用、以及在 C++ 替换函数里
+// 自己比较参数再调原函数比较每次调用多出来的开销。满足条件的调用必须进替换函数。
+
+#include "bench.h"
+#include "include/hook_filter.h"
+
+namespace {
+
+	typedef long (*TargetFunc)(long, long);
+
+	const long kHookDelta = 1000;
+	const long kMatched = 7;
+	const long kFiltered = 3;
+	const size_t kCalls = 10 * 1000 * 1000;
+
+	__attribute__((noinline)) long Original(long a, long b)
+	{
+		asm volatile("");
+		return a + b;
+	}
+
+	__attribute__((noinline)) long Detour(long a, long b)
+	{
+		asm volatile("");
+		return a + b + kHookDelta;
+	}
+
+	TargetFunc volatile s_original = Original;
+
+	// 没有过滤代码时的写法：替换函数自己比较参数，不满足的转给原函数
+	__attribute__((noinline)) long WrapperDetour(long a, long b)
+	{
+		if (a != kMatched)
+			return s_original(a, b);
+		return Detour(a, b);
+	}
+
+	double CallNanoseconds(bench::Context& ctx, TargetFunc func, long a)
+	{
+		TargetFunc volatile call = func;
+		double seconds = bench::BestOf(ctx.Repeat(), [&]() {
+			long sum = 0;
+			for (size_t i = 0; i < kCalls; i++)
+				sum += call(a, (long)i);
+			bench::Keep(sum);
+		});
+		return seconds * 1e9 / kCalls;
+	}
+
+	// 满足条件的值进替换函数，其余的回原函数
+	void CheckRoutes(bench::Context& ctx, const char* name, TargetFunc func, std::initializer_list<long> matched)
+	{
+		for (long a = 0; a < 16; a++)
+		{
+			bool hit = std::find(matched.begin(), matched.end(), a) != matched.end();
+			long expected = a + 1 + (hit ? kHookDelta : 0);
+			long result = func(a, 1);
+			ctx.Check(result == expected, "%s: arg %ld returned %ld, expected %ld", name, a, result, expected);
+		}
+	}
+
+}
+
+BENCH_CASE(filter_thunk, "filtered-out calls through a filter thunk against a direct call and a C++ wrapper", false)
+{
+	utils::FilterTarget target;
+	target.original = (void*)Original;
+	target.detour = (void*)Detour;
+
+	void* one = utils::CreateFilterThunk({ utils::ArgEquals(0, kMatched) }, &target);
+	void* four = utils::CreateFilterThunk({ utils::ArgIn(0, { kMatched, 8, 9, 10 }) }, &target);
+	if (!ctx.Check(one && four, "CreateFilterThunk failed"))
+	{
+		utils::DestroyFilterThunk(one);
+		utils::DestroyFilterThunk(four);
+		return;
+	}
+
+	// 条件不合法时不生成代码
+	ctx.Check(utils::CreateFilterThunk({ utils::ArgIn(0, {}) }, &target) == nullptr, "empty values accepted");
+	ctx.Check(utils::CreateFilterThunk({ utils::ArgEquals(0, 1, 2) }, &target) == nullptr, "size 2 accepted");
+
+	CheckRoutes(ctx, "1 compare", (TargetFunc)one, { kMatched });
+	CheckRoutes(ctx, "4 compares", (TargetFunc)four, { kMatched, 8, 9, 10 });
+	CheckRoutes(ctx, "C++ wrapper", WrapperDetour, { kMatched });
+
+	double direct = CallNanoseconds(ctx, Original, kFiltered);
+	ctx.Report("%-22s %5.2f ns/call", "direct", direct);
+	struct { const char* name; TargetFunc func; } paths[] = {
+		{ "thunk, 1 compare", (TargetFunc)one },
+		{ "thunk, 4 compares", (TargetFunc)four },
+		{ "C++ wrapper", WrapperDetour },
+	};
+	for (const auto& path : paths)
+	{
+		double ns = CallNanoseconds(ctx, path.func, kFiltered);
+		ctx.Report("%-22s %5.2f ns/call (+%.2f ns)", path.name, ns, ns - direct);
+	}
+
+	utils::DestroyFilterThunk(one);
+	utils::DestroyFilterThunk(four);
+}
@@ -0,0 +1,228 @@
+// 挂钩事务的吞吐和停顿时间
+//
+// 反复挂上、摘下一组函数，其他线程或者空闲（睡眠）或者一直在调用被挂钩的函数。
+// 停顿时间取自 DetourGetCommitStats 的 usSuspended：从第一个线程被挂起到最后一个恢复。
+// 忙线程每次调用都检查返回值，只能是原函数或钩子的结果，不能是别的。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+// 目标函数前面留 8 字节 int3，首条指令 3 字节，既能走挂起线程的路径，
+// 也能在 DetourSetAtomicPatches 打开时走热补丁路径
+#define HOOK_TARGET(n) \
+	".p2align 4\n" \
+	".fill 8, 1, 0xcc\n" \
+	".globl bench_hook_target" #n "\n" \
+	"bench_hook_target" #n ":\n" \
+	"	mov %rdi, %rax\n" \
+	"	add $" #n ", %rax\n" \
+	"	ret\n"
+
+extern "C" long bench_hook_target0(long);
+extern "C" long bench_hook_target1(long);
+extern "C" long bench_hook_target2(long);
+extern "C" long bench_hook_target3(long);
+extern "C" long bench_hook_target4(long);
+extern "C" long bench_hook_target5(long);
+extern "C" long bench_hook_target6(long);
+extern "C" long bench_hook_target7(long);
+
+asm(".text\n"
+	HOOK_TARGET(0) HOOK_TARGET(1) HOOK_TARGET(2) HOOK_TARGET(3)
+	HOOK_TARGET(4) HOOK_TARGET(5) HOOK_TARGET(6) HOOK_TARGET(7));
+
+namespace utils {
+
+	// hook.cpp 只在 Windows 上编译，这里按同样的语义给 Hook<>（bench_typed_hook.cpp）实现底层接口
+	bool DetourAttachFunc(void** ppPointer, void* pDetour, bool hangAllThread)
+	{
+		if (DetourTransactionBegin() != NO_ERROR)
+			return false;
+		if (DetourAttach(ppPointer, pDetour) != NO_ERROR)
+		{
+			DetourTransactionAbort();
+			return false;
+		}
+		if (hangAllThread)
+			DetourUpdateAllThreads();
+		return DetourTransactionCommit() == NO_ERROR;
+	}
+
+	bool DetourDetachFunc(void** ppPointer, void* pDetour)
+	{
+		if (DetourTransactionBegin() != NO_ERROR)
+			return false;
+		if (DetourDetach(ppPointer, pDetour) != NO_ERROR)
+		{
+			DetourTransactionAbort();
+			return false;
+		}
+		DetourUpdateAllThreads();
+		return DetourTransactionCommit() == NO_ERROR;
+	}
+
+}
+
+namespace {
+
+	const int kTargetCount = 8;
+	const long kHookDelta = 1000;
+
+	typedef long (*TargetFunc)(long);
+
+	TargetFunc s_real[kTargetCount] = {
+		bench_hook_target0, bench_hook_target1, bench_hook_target2, bench_hook_target3,
+		bench_hook_target4, bench_hook_target5, bench_hook_target6, bench_hook_target7,
+	};
+
+	template <int n>
+	long Detour(long value)
+	{
+		return s_real[n](value) + kHookDelta;
+	}
+
+	const TargetFunc s_targets[kTargetCount] = {
+		bench_hook_target0, bench_hook_target1, bench_hook_target2, bench_hook_target3,
+		bench_hook_target4, bench_hook_target5, bench_hook_target6, bench_hook_target7,
+	};
+
+	const TargetFunc s_detours[kTargetCount] = {
+		Detour<0>, Detour<1>, Detour<2>, Detour<3>, Detour<4>, Detour<5>, Detour<6>, Detour<7>,
+	};
+
+	struct Workers
+	{
+		std::atomic<bool> stop{ false };
+		std::atomic<long> calls{ 0 };
+		std::atomic<long> bad{ 0 };
+		std::vector<std::thread> threads;
+
+		void Start(size_t count, bool busy)
+		{
+			for (size_t i = 0; i < count; i++)
+				threads.emplace_back([this, i, busy]() { Run(i, busy); });
+			usleep(10000);
+		}
+
+		void Run(size_t index, bool busy)
+		{
+			long done = 0;
+			for (long value = (long)index; !stop.load(std::memory_order_relaxed); value++)
+			{
+				if (!busy)
+				{
+					usleep(1000);
+					continue;
+				}
+				int n = (int)(value % kTargetCount);
+				TargetFunc volatile target = s_targets[n];
+				long result = target(value);
+				if (result != value + n && result != value + n + kHookDelta)
+					bad++;
+				done++;
+			}
+			calls += done;
+		}
+
+		void Join()
+		{
+			stop = true;
+			for (std::thread& thread : threads)
+				thread.join();
+			threads.clear();
+		}
+	};
+
+	struct CommitResult
+	{
+		LONG error = NO_ERROR;
+		bool suspended = false;
+		ULONG usSuspended = 0;
+	};
+
+	CommitResult Commit(bool attach, bool atomic)
+	{
+		CommitResult result;
+		DetourTransactionBegin();
+		for (int i = 0; i < kTargetCount; i++)
+		{
+			LONG error = attach ? DetourAttach((PVOID*)&s_real[i], (PVOID)s_detours[i])
+				: DetourDetach((PVOID*)&s_real[i], (PVOID)s_detours[i]);
+			if (error != NO_ERROR)
+			{
+				DetourTransactionAbort();
+				result.error = error;
+				return result;
+			}
+		}
+		if (!atomic || !DetourTransactionIsAtomic())
+		{
+			DetourUpdateAllThreads();
+			result.suspended = true;
+		}
+		result.error = DetourTransactionCommit();
+		DETOUR_COMMIT_STATS stats;
+		DetourGetCommitStats(&stats);
+		result.usSuspended = stats.usSuspended;
+		return result;
+	}
+
+	void RunHookCommits(bench::Context& ctx, bool atomic, size_t threads, bool busy)
+	{
+		DetourSetAtomicPatches(atomic);
+		Workers workers;
+		workers.Start(threads, busy);
+
+		std::vector<ULONG> pauses;
+		size_t transactions = 0, suspended = 0;
+		bool failed = false;
+		bench::Clock::time_point begin = bench::Clock::now();
+		bench::Clock::time_point end = begin + std::chrono::milliseconds(300);
+		while (!failed && bench::Clock::now() < end)
+		{
+			for (int attach = 1; attach >= 0; attach--)
+			{
+				CommitResult result = Commit(attach != 0, atomic);
+				if (!ctx.Check(result.error == NO_ERROR, "%s commit failed: %ld", attach ? "attach" : "detach", (long)result.error))
+				{
+					failed = true;
+					break;
+				}
+				transactions++;
+				if (result.suspended)
+				{
+					suspended++;
+					pauses.push_back(result.usSuspended);
+				}
+			}
+		}
+		double elapsed = bench::Seconds(begin, bench::Clock::now());
+		workers.Join();
+		DetourSetAtomicPatches(FALSE);
+
+		std::sort(pauses.begin(), pauses.end());
+		ctx.Report("%-7s %2zu %s: %8.0f tx/s, %5.1f%% suspended, pause p50 %4u us, p99 %5u us, max %5u us, %ld calls",
+			atomic ? "atomic" : "suspend", threads, busy ? "busy" : "idle", transactions / elapsed,
+			transactions ? 100.0 * suspended / transactions : 0.0,
+			bench::Percentile(pauses, 0.5), bench::Percentile(pauses, 0.99), pauses.empty() ? 0 : pauses.back(),
+			workers.calls.load());
+		ctx.Check(workers.bad == 0, "%ld calls returned neither the original nor the hooked result", workers.bad.load());
+		for (int i = 0; i < kTargetCount; i++)
+			ctx.Check(s_targets[i](1) == 1 + i, "target %d still hooked after the last detach", i);
+	}
+
+}
+
+BENCH_CASE(hook_commit, "attach/detach throughput and thread pause time", false)
+{
+	size_t busy = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 2u) - 1, 4);
+	for (int atomic = 0; atomic <= 1; atomic++)
+	{
+		RunHookCommits(ctx, atomic != 0, 0, false);
+		RunHookCommits(ctx, atomic != 0, 16, false);
+		RunHookCommits(ctx, atomic != 0, busy, true);
+	}
+}
@@ -0,0 +1,192 @@
+// HookFuncs/UnHookFuncs 批量挂钩
+//
+// 一批里有普通项、带参数过滤的项、装不上的项（函数太短）和按名字找不到的项。
+// 装不上的项让第一次事务作废，剩下的项重来一次：它们都要装上，失败的项代码不变、过滤代码退役。
+// 带过滤的项只有满足条件的调用进替换函数。卸载后每个函数逐字节恢复，再装一次时过滤代码被取回复用。
+// 比较一批挂钩一次提交和逐个提交的耗时。
+
+#include "bench.h"
+#include "include/hook.h"
+#include <cstring>
+#include <dlfcn.h>
+
+#define BATCH_TARGET(n) \
+	".p2align 4\n" \
+	".globl bench_batch_target" #n "\n" \
+	"bench_batch_target" #n ":\n" \
+	"	mov %rdi, %rax\n" \
+	"	add $" #n ", %rax\n" \
+	"	ret\n"
+
+extern "C" long bench_batch_target1(long);
+extern "C" long bench_batch_target2(long);
+extern "C" long bench_batch_target3(long);
+extern "C" long bench_batch_short(long);
+
+// short 只有 4 字节就返回，后面紧跟着别的代码，放不下 5 字节的跳转
+asm(".text\n"
+	BATCH_TARGET(1) BATCH_TARGET(2) BATCH_TARGET(3)
+	".p2align 4\n"
+	".globl bench_batch_short\n"
+	"bench_batch_short:\n"
+	"	mov %rdi, %rax\n"
+	"	ret\n"
+	"	mov %rsi, %rax\n"
+	"	ret\n");
+
+namespace {
+
+	typedef long (*TargetFunc)(long);
+
+	const long kHookDelta = 1000;
+	const long kMatched = 7;
+	const int kTimedRounds = 200;
+
+	enum { kPlain1, kPlain2, kShort, kFiltered, kMissing, kHookCount };
+
+	const TargetFunc kTargets[] = { bench_batch_target1, bench_batch_target2, bench_batch_short, bench_batch_target3, nullptr };
+	const long kOffsets[] = { 1, 2, 0, 3, 0 };
+	const size_t kSaved = 8;
+
+	TargetFunc s_original[kHookCount];
+	long s_hookCalls[kHookCount];
+
+	template <int N>
+	__attribute__((noinline)) long Detour(long value)
+	{
+		s_hookCalls[N]++;
+		return s_original[N](value) + kHookDelta;
+	}
+
+	const TargetFunc kDetours[] = { Detour<0>, Detour<1>, Detour<2>, Detour<3>, Detour<4> };
+
+	std::vector<utils::HookInfo> MakeHooks()
+	{
+		std::vector<utils::HookInfo> hooks(kHookCount);
+		for (int i = 0; i < kHookCount; i++)
+		{
+			hooks[i].funcAddr = (void*)kTargets[i];
+			hooks[i].newFuncAddr = (void*)kDetours[i];
+			hooks[i].oldFuncAddr = &s_original[i];
+			s_original[i] = kTargets[i];
+		}
+		hooks[kMissing].funcName = "bench_batch_no_such_function";
+		// 装不上的项也带过滤条件，失败时它的过滤代码要退役
+		hooks[kShort].filters = { utils::ArgEquals(0, kMatched) };
+		hooks[kFiltered].filters = { utils::ArgIn(0, { kMatched, kMatched + 2 }) };
+		return hooks;
+	}
+
+	// 返回进了几次替换函数
+	long HookCallsOf(int index, long value, long& result)
+	{
+		long before = s_hookCalls[index];
+		result = kTargets[index](value);
+		return s_hookCalls[index] - before;
+	}
+
+	void CheckUnhooked(bench::Context& ctx, const std::vector<utils::HookInfo>& hooks, const char* when)
+	{
+		for (int i = 0; i < kHookCount; i++)
+		{
+			if (!kTargets[i])
+				continue;
+			long result = 0;
+			ctx.Check(HookCallsOf(i, kMatched, result) == 0 && result == kMatched + kOffsets[i],
+				"%s: target %d returned %ld", when, i, result);
+			ctx.Check(!hooks[i].success && s_original[i] == kTargets[i], "%s: target %d still marked as hooked", when, i);
+		}
+	}
+
+}
+
+BENCH_CASE(hook_funcs, "HookFuncs/UnHookFuncs: partial failure, filter dispatch, byte-exact unhook", false)
+{
+	unsigned char saved[kHookCount][kSaved] = {};
+	for (int i = 0; i < kHookCount; i++)
+	{
+		if (kTargets[i])
+			memcpy(saved[i], (const void*)kTargets[i], kSaved);
+	}
+
+	HMODULE self = (HMODULE)dlopen(nullptr, RTLD_NOW);
+	std::vector<utils::HookInfo> hooks = MakeHooks();
+	ctx.Check(!utils::HookFuncs(self, hooks, true), "HookFuncs reported success with a failing entry");
+
+	const bool expected[kHookCount] = { true, true, false, true, false };
+	for (int i = 0; i < kHookCount; i++)
+		ctx.Check(hooks[i].success == expected[i], "entry %d: success %d, expected %d", i, hooks[i].success, expected[i]);
+
+	// 失败的项：代码不变，调用方拿到的还是函数本身，过滤代码已退役
+	ctx.Check(memcmp(saved[kShort], (const void*)bench_batch_short, kSaved) == 0, "failed entry's code was changed");
+	ctx.Check(s_original[kShort] == bench_batch_short && !hooks[kShort].filterStub && !hooks[kShort].filterTarget,
+		"failed entry left a trampoline or filter code behind");
+	ctx.Check(!hooks[kMissing].trampoline && s_original[kMissing] == nullptr, "missing name resolved to %p", hooks[kMissing].trampoline);
+
+	long result = 0;
+	for (int i : { kPlain1, kPlain2 })
+	{
+		ctx.Check(s_original[i] != kTargets[i], "entry %d: oldFuncAddr not set to the trampoline", i);
+		ctx.Check(HookCallsOf(i, 1, result) == 1 && result == 1 + kOffsets[i] + kHookDelta, "entry %d: hooked call returned %ld", i, result);
+	}
+	ctx.Check(HookCallsOf(kShort, kMatched, result) == 0 && result == kMatched, "failed entry's target reached the detour");
+
+	// 过滤：7 和 9 进替换函数，其余直接回原函数
+	void* firstStub = hooks[kFiltered].filterStub;
+	ctx.Check(firstStub != nullptr && s_original[kFiltered] == (TargetFunc)hooks[kFiltered].filterTarget->original,
+		"filtered entry: no filter code, or oldFuncAddr is not the trampoline");
+	for (long value = 0; value < 12; value++)
+	{
+		bool matched = value == kMatched || value == kMatched + 2;
+		long calls = HookCallsOf(kFiltered, value, result);
+		ctx.Check(calls == (matched ? 1 : 0) && result == value + 3 + (matched ? kHookDelta : 0),
+			"filtered entry: arg %ld went %s, returned %ld", value, calls ? "to the detour" : "to the original", result);
+	}
+
+	ctx.Check(utils::UnHookFuncs(hooks, true), "UnHookFuncs failed");
+	for (int i = 0; i < kHookCount; i++)
+	{
+		if (kTargets[i])
+			ctx.Check(memcmp(saved[i], (const void*)kTargets[i], kSaved) == 0, "target %d not restored byte for byte", i);
+	}
+	ctx.Check(!hooks[kFiltered].filterStub && !hooks[kFiltered].filterTarget, "filter code still attached after unhook");
+	CheckUnhooked(ctx, hooks, "after UnHookFuncs");
+
+	// 同样的过滤条件再装一次，退役的过滤代码被取回
+	std::vector<utils::HookInfo> again = MakeHooks();
+	utils::HookFuncs(self, again, true);
+	ctx.Check(again[kFiltered].success && again[kFiltered].filterStub == firstStub, "filter code not revived: %p, first %p",
+		again[kFiltered].filterStub, firstStub);
+	ctx.Check(HookCallsOf(kFiltered, kMatched, result) == 1 && HookCallsOf(kFiltered, kMatched + 1, result) == 0,
+		"revived filter code routes calls wrong");
+	ctx.Check(utils::UnHookFuncs(again, true), "second UnHookFuncs failed");
+	CheckUnhooked(ctx, again, "after the second UnHookFuncs");
+
+	// 只留能装上的三项，比较一次提交和逐个提交
+	std::vector<utils::HookInfo> batch = MakeHooks();
+	batch[kShort].funcAddr = nullptr;
+	batch[kMissing].funcName.clear();
+	double together = bench::BestOf(ctx.Repeat(), [&]() {
+		for (int round = 0; round < kTimedRounds; round++)
+		{
+			utils::HookFuncs(self, batch, true);
+			utils::UnHookFuncs(batch, true);
+		}
+	});
+	double apart = bench::BestOf(ctx.Repeat(), [&]() {
+		for (int round = 0; round < kTimedRounds; round++)
+		{
+			for (auto& hook : batch)
+			{
+				std::vector<utils::HookInfo> one(1, hook);
+				utils::HookFuncs(self, one, true);
+				utils::UnHookFuncs(one, true);
+			}
+		}
+	});
+	CheckUnhooked(ctx, batch, "after the timed rounds");
+	dlclose(self);
+
+	ctx.Report("3 hooks: one transaction %.1f us per attach+detach, one per hook %.1f us",
+		together * 1e6 / kTimedRounds, apart * 1e6 / kTimedRounds);
+}
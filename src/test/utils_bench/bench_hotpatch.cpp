@@ -0,0 +1,112 @@
+// 热补丁路径选用的填充
+//
+// DetourSetAtomicPatches 打开时，目标前面 5 字节空闲的填充可以写长跳转，目标只换成 2 字节短跳转。
+// int3 填充是空闲的，走热补丁路径；nop 可能是前一段代码里会执行的部分，不能当填充用：
+// 这里 live 的跳转落在目标前的 nop 中间，热补丁写进去的长跳转会把它拆开，所以必须改走别的路径。
+// x86 上 /hotpatch 放在 mov edi, edi 前面的 nop 仍然算填充，这个程序是 x64 的，检查不到那条路径。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <cstring>
+
+extern "C" long bench_hp_int3_target(long);
+extern "C" long bench_hp_live(long);
+extern "C" long bench_hp_nop_target(long);
+
+asm(".text\n"
+	".p2align 4\n"
+	".fill 8, 1, 0xcc\n"
+	".globl bench_hp_int3_target\n"
+	"bench_hp_int3_target:\n"
+	"	mov %rdi, %rax\n"
+	"	add $2, %rax\n"
+	"	ret\n"
+	".p2align 4\n"
+	".globl bench_hp_live\n"
+	"bench_hp_live:\n"
+	"	mov %rdi, %rax\n"
+	"	jmp 1f\n"
+	"	nop\n"
+	"	nop\n"
+	"	nop\n"
+	"1:	nop\n"
+	"	nop\n"
+	".globl bench_hp_nop_target\n"
+	"bench_hp_nop_target:\n"
+	"	lea 1(%rdi), %rax\n"
+	"	ret\n"
+	"	int3\n"
+	"	int3\n"
+	"	int3\n");
+
+namespace {
+
+	typedef long (*TargetFunc)(long);
+
+	const long kHookDelta = 1000;
+	const size_t kPadSize = 5;
+
+	TargetFunc s_int3Real = bench_hp_int3_target;
+	TargetFunc s_nopReal = bench_hp_nop_target;
+
+	long Int3Detour(long value)
+	{
+		return s_int3Real(value) + kHookDelta;
+	}
+
+	long NopDetour(long value)
+	{
+		return s_nopReal(value) + kHookDelta;
+	}
+
+	// 一个事务只挂一个函数，返回走热补丁路径的个数，失败返回 -1
+	long Commit(TargetFunc* real, TargetFunc detour, bool attach)
+	{
+		DetourTransactionBegin();
+		LONG error = attach ? DetourAttach((PVOID*)real, (PVOID)detour) : DetourDetach((PVOID*)real, (PVOID)detour);
+		if (error != NO_ERROR)
+		{
+			DetourTransactionAbort();
+			return -1;
+		}
+		if (!DetourTransactionIsAtomic())
+			DetourUpdateAllThreads();
+		if (DetourTransactionCommit() != NO_ERROR)
+			return -1;
+		DETOUR_COMMIT_STATS stats;
+		DetourGetCommitStats(&stats);
+		return stats.cHotPatches;
+	}
+
+	// 挂上、调用、摘下，检查路径和代码是否恢复
+	void CheckTarget(bench::Context& ctx, const char* name, TargetFunc target, TargetFunc* real, TargetFunc detour,
+		TargetFunc caller, long offset, bool hotPatch)
+	{
+		unsigned char saved[kPadSize + 8];
+		const unsigned char* pad = (const unsigned char*)target - kPadSize;
+		memcpy(saved, pad, sizeof(saved));
+
+		long hotPatches = Commit(real, detour, true);
+		if (!ctx.Check(hotPatches >= 0, "%s: attach failed", name))
+			return;
+		ctx.Check(hotPatches == (hotPatch ? 1 : 0), "%s: %ld hot patches, expected %d", name, hotPatches, hotPatch ? 1 : 0);
+		ctx.Check(hotPatch ? pad[0] == 0xe9 : memcmp(saved, pad, kPadSize) == 0, "%s: pad %s", name,
+			hotPatch ? "has no jmp" : "was written");
+		ctx.Check(caller(1) == 1 + offset + kHookDelta, "%s: hooked call returned %ld", name, caller(1));
+
+		ctx.Check(Commit(real, detour, false) >= 0, "%s: detach failed", name);
+		ctx.Check(caller(1) == 1 + offset, "%s: still hooked after detach", name);
+		// 热补丁摘下时只换回目标的 2 字节，填充里的跳转留着，下次挂钩复用
+		ctx.Check(memcmp(saved + kPadSize, pad + kPadSize, 8) == 0, "%s: target not restored", name);
+	}
+
+}
+
+BENCH_CASE(hot_patch_pad, "hot-patch path uses int3 padding, never nops that may run", false)
+{
+	DetourSetAtomicPatches(TRUE);
+	CheckTarget(ctx, "int3 pad", bench_hp_int3_target, &s_int3Real, Int3Detour, bench_hp_int3_target, 2, true);
+	// live 从 nop 中间进入目标，目标挂上后它也要进钩子，而不是落进半条跳转指令
+	CheckTarget(ctx, "nop pad", bench_hp_nop_target, &s_nopReal, NopDetour, bench_hp_live, 1, false);
+	DetourSetAtomicPatches(FALSE);
+}
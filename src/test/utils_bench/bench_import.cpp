@@ -0,0 +1,71 @@
+// 导入表挂钩（ELF 的 GOT）
+//
+// 改本程序 GOT 里 libc 的 getppid，经过 PLT 的调用应该进替换函数，dlsym 拿到的指针不受影响；
+// 摘钩后调用回到 libc，再挂一次也要成功。getppid 在这之前没调过，延迟绑定时槽还没解析。
+
+#include "bench.h"
+#include "include/import_hook.h"
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace {
+
+	const pid_t kHookDelta = 1000000;
+
+	utils::ImportHook s_hook;
+	long s_hookCalls = 0;
+
+	pid_t HookGetppid()
+	{
+		s_hookCalls++;
+		return ((pid_t (*)())s_hook.Original())() + kHookDelta;
+	}
+
+	// 经过本程序的 PLT 和 GOT
+	__attribute__((noinline)) pid_t CallGetppid()
+	{
+		asm volatile("");
+		return getppid();
+	}
+
+}
+
+BENCH_CASE(import_hook, "GOT hook of a libc import: call, original and restore", false)
+{
+	void* self = dlopen(nullptr, RTLD_LAZY);
+	void* real = dlsym(RTLD_DEFAULT, "getppid");
+	if (!ctx.Check(self && real, "dlopen/dlsym failed"))
+		return;
+
+	bench::Clock::time_point begin = bench::Clock::now();
+	size_t slots = s_hook.Attach(self, "", "getppid", (void*)HookGetppid);
+	double attachSeconds = bench::Seconds(begin, bench::Clock::now());
+	if (!ctx.Check(slots > 0, "no getppid slot found in the GOT"))
+	{
+		dlclose(self);
+		return;
+	}
+	ctx.Check(s_hook.Original() == real, "Original() is %p, expected libc's getppid %p", s_hook.Original(), real);
+	ctx.Check(s_hook.Attach(self, "", "getppid", (void*)HookGetppid) == 0, "a second Attach on the same hook succeeded");
+
+	pid_t expected = ((pid_t (*)())real)();
+	pid_t hooked = CallGetppid();
+	ctx.Check(hooked == expected + kHookDelta && s_hookCalls == 1, "hooked call returned %d after %ld hook calls, expected %d",
+		(int)hooked, s_hookCalls, (int)(expected + kHookDelta));
+	ctx.Check(((pid_t (*)())real)() == expected && s_hookCalls == 1, "the dlsym pointer went through the hook");
+
+	begin = bench::Clock::now();
+	size_t restored = s_hook.Detach();
+	double detachSeconds = bench::Seconds(begin, bench::Clock::now());
+	ctx.Check(restored == slots, "Detach restored %zu of %zu slots", restored, slots);
+	ctx.Check(CallGetppid() == expected && s_hookCalls == 1, "call still hooked after Detach");
+
+	// 槽已经解析过，再挂一次走的是另一条路径
+	ctx.Check(s_hook.Attach(self, "", "getppid", (void*)HookGetppid) == slots, "re-Attach found a different number of slots");
+	ctx.Check(s_hook.Original() == real, "Original() after re-Attach is %p, expected %p", s_hook.Original(), real);
+	ctx.Check(CallGetppid() == expected + kHookDelta && s_hookCalls == 2, "re-attached call did not reach the hook");
+	ctx.Check(s_hook.Detach() == slots && CallGetppid() == expected, "second Detach did not restore the call");
+	dlclose(self);
+
+	ctx.Report("%zu slot(s), attach %.0f us, detach %.0f us", slots, attachSeconds * 1e6, detachSeconds * 1e6);
+}
@@ -0,0 +1,283 @@
+// 指令边界索引和交叉引用索引
+//
+// InstructionIndex 从锚点向前解码，必须和从函数入口一路线性解码得到同样的指令边界，逐字节查询对照。
+// XrefIndex 分块（可能放到线程池里）扫描，必须和整节一次扫完得到同样的引用；
+// 其中直接 call/jmp 再按机器码（E8/E9/EB）逐字节暴力算目标，核对解码器给的目标。
+
+#include "bench.h"
+#include "include/function_discovery.h"
+#include "include/instruction_index.h"
+#include "include/pe_image.h"
+#include "include/thread_pool.h"
+#include "include/xref_index.h"
+#include "detour/detours.h"
+#include <cstring>
+#include <tuple>
+
+namespace {
+
+	const DETOUR_DISASM_CONTEXT kNoReferences = { nullptr, nullptr, TRUE };
+
+	// 和两个索引一样的解码规则：节尾不足 16 字节时拷出来解码，解码失败或无效的指令都不算
+	struct Decoder
+	{
+		bool x64;
+		uint8_t buffer[32];
+		DETOUR_DECODED_INSTRUCTION decoded;
+		PBYTE at = nullptr;		// 实际解码的地址，目标和操作数相对它计算
+
+		explicit Decoder(bool is64) : x64(is64) {}
+
+		bool Decode(const utils::PeCodeRange& range, size_t pos)
+		{
+			size_t available = range.size - pos;
+			at = (PBYTE)range.data + pos;
+			if (available < 16)
+			{
+				memset(buffer, 0, sizeof(buffer));
+				memcpy(buffer, at, available);
+				at = buffer;
+			}
+			PBYTE next = x64 ? (PBYTE)DetourDecodeInstructionExX64(at, &decoded, &kNoReferences)
+				: (PBYTE)DetourDecodeInstructionExX86(at, &decoded, &kNoReferences);
+			return next && decoded.cbInstruction != 0 && decoded.cbInstruction <= available
+				&& !(decoded.wFlags & DETOUR_DECODED_INVALID);
+		}
+	};
+
+	const utils::PeCodeRange* RangeOf(const std::vector<utils::PeCodeRange>& ranges, uint32_t rva)
+	{
+		for (const utils::PeCodeRange& range : ranges)
+		{
+			if (rva - range.rva < range.size)
+				return &range;
+		}
+		return nullptr;
+	}
+
+	// 有 .pdata 用 .pdata，否则用 DiscoverFunctions
+	utils::PeFunctionTable FunctionTable(const utils::PeImage& image, utils::ThreadPool& pool)
+	{
+		utils::PeFunctionTable table(image);
+		if (!table.Empty())
+			return table;
+		return utils::DiscoverFunctions(image, &pool);
+	}
+
+	struct Xref
+	{
+		uint32_t target;
+		uint32_t source;
+		uint8_t kind;
+
+		bool operator<(const Xref& other) const
+		{
+			return std::tie(target, source) < std::tie(other.target, other.source);
+		}
+	};
+
+	// 整节从头到尾扫一遍，记录规则同 XrefIndex
+	void SweepRange(const utils::PeImage& image, const utils::PeCodeRange& range, std::vector<Xref>& refs,
+		std::vector<uint32_t>& starts)
+	{
+		Decoder decoder(image.Is64Bit());
+		uint32_t imageSize = image.SizeOfImage();
+		for (size_t pos = 0; pos < range.size;)
+		{
+			if (!decoder.Decode(range, pos))
+			{
+				pos++;
+				continue;
+			}
+			const DETOUR_DECODED_INSTRUCTION& decoded = decoder.decoded;
+			uint32_t source = (uint32_t)(range.rva + pos);
+			starts.push_back(source);
+
+			if ((decoded.wFlags & (DETOUR_DECODED_CALL | DETOUR_DECODED_BRANCH)) && !(decoded.wFlags & DETOUR_DECODED_CONDITIONAL)
+				&& decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE && decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC)
+			{
+				intptr_t delta = decoded.pbTarget - decoder.at;
+				uint32_t target = (uint32_t)(source + delta);
+				if (delta != (intptr_t)decoded.cbInstruction && target < imageSize)
+					refs.push_back(Xref{ target, source, (uint8_t)((decoded.wFlags & DETOUR_DECODED_CALL) ? utils::kXrefCall : utils::kXrefJump) });
+			}
+
+			uint64_t data = 0;
+			bool hasData = false;
+			if (decoded.wFlags & DETOUR_DECODED_RIP_RELATIVE)
+			{
+				data = (uint64_t)(int64_t)(source + (decoded.pbData - decoder.at));
+				hasData = true;
+			}
+			else if (decoded.wFlags & DETOUR_DECODED_ABSOLUTE)
+			{
+				data = (uint64_t)(uintptr_t)decoded.pbData - image.ImageBase();
+				hasData = true;
+			}
+			if (hasData && data < imageSize)
+			{
+				uint8_t kind = utils::kXrefData;
+				if (decoded.wFlags & DETOUR_DECODED_CALL)
+					kind = utils::kXrefCallSlot;
+				else if (decoded.wFlags & DETOUR_DECODED_BRANCH)
+					kind = utils::kXrefJumpSlot;
+				refs.push_back(Xref{ (uint32_t)data, source, kind });
+			}
+			pos += decoded.cbInstruction;
+		}
+	}
+
+	bool Contains(const utils::XrefIndex& index, const Xref& ref)
+	{
+		utils::XrefRange range = index.RefsTo(ref.target);
+		for (size_t i = 0; i < range.count; i++)
+		{
+			if (range.sources[i] == ref.source && range.kinds[i] == ref.kind)
+				return true;
+		}
+		return false;
+	}
+
+	// 索引里每个目标的引用必须和参考答案逐项相同，数量也相同
+	size_t CompareXrefs(const utils::XrefIndex& index, const std::vector<Xref>& expected, size_t& targets)
+	{
+		size_t mismatches = 0;
+		targets = 0;
+		for (size_t i = 0; i < expected.size();)
+		{
+			size_t end = i;
+			while (end < expected.size() && expected[end].target == expected[i].target)
+				end++;
+			utils::XrefRange range = index.RefsTo(expected[i].target);
+			bool same = range.count == end - i;
+			for (size_t j = 0; same && j < range.count; j++)
+				same = range.sources[j] == expected[i + j].source && range.kinds[j] == expected[i + j].kind;
+			if (!same)
+				mismatches++;
+			targets++;
+			i = end;
+		}
+		return mismatches;
+	}
+
+}
+
+BENCH_CASE(instruction_index, "InstructionIndex lookups from anchors against a linear sweep of every function", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+
+	utils::ThreadPool pool;
+	utils::PeFunctionTable table = FunctionTable(image, pool);
+	if (!ctx.Check(!table.Empty(), "no functions to index"))
+		return;
+
+	std::unique_ptr<utils::InstructionIndex> index, pooled;
+	double buildSeconds = bench::BestOf(ctx.Repeat(), [&]() { index.reset(new utils::InstructionIndex(image, table)); });
+	double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() { pooled.reset(new utils::InstructionIndex(image, table, &pool)); });
+	ctx.Check(index->AnchorCount() == pooled->AnchorCount() && index->BytesUsed() == pooled->BytesUsed(),
+		"pool build has %zu anchors, one thread %zu", pooled->AnchorCount(), index->AnchorCount());
+
+	// 从每个函数入口线性解码，函数里每个字节都查一次
+	std::vector<utils::PeCodeRange> ranges = image.ExecutableRanges();
+	Decoder decoder(image.Is64Bit());
+	size_t queries = 0, mismatches = 0, codeSize = 0;
+	bench::Clock::time_point begin = bench::Clock::now();
+	double querySeconds = 0;
+	for (const utils::PeFunction& function : table.Functions())
+	{
+		const utils::PeCodeRange* range = RangeOf(ranges, function.beginRva);
+		if (!range)
+			continue;
+		codeSize += function.endRva - function.beginRva;
+		for (uint32_t rva = function.beginRva; rva < function.endRva;)
+		{
+			bool valid = rva - range->rva < range->size && decoder.Decode(*range, rva - range->rva);
+			uint32_t length = valid ? decoder.decoded.cbInstruction : 1;
+			for (uint32_t at = rva; at < rva + length && at < function.endRva; at++)
+			{
+				uint32_t start = 0, size = 0;
+				bench::Clock::time_point queryBegin = bench::Clock::now();
+				bool found = index->InstructionAt(at, start, size);
+				querySeconds += bench::Seconds(queryBegin, bench::Clock::now());
+				bool same = valid ? (found && start == rva && size == length) : !found;
+				if (!same && mismatches++ < 5)
+					ctx.Check(false, "rva %x: index says %s %x+%u, sweep says %s %x+%u", at,
+						found ? "instruction" : "none", start, size, valid ? "instruction" : "invalid", rva, length);
+				queries++;
+			}
+			rva += length;
+		}
+	}
+	double sweepSeconds = bench::Seconds(begin, bench::Clock::now());
+	ctx.Check(mismatches == 0, "%zu of %zu lookups differ from the sweep", mismatches, queries);
+
+	// 不在任何函数里的地址查不到
+	uint32_t start = 0, size = 0;
+	ctx.Check(!index->InstructionAt(0, start, size), "rva 0 found in an instruction");
+
+	ctx.Report("%zu functions, %zu KB: %zu anchors, %zu bytes (%.1f%% of code)", table.Count(), codeSize >> 10,
+		index->AnchorCount(), index->BytesUsed(), 100.0 * index->BytesUsed() / codeSize);
+	ctx.Report("build %.1f ms, pool %.1f ms; %zu lookups, %.0f ns each (sweep and check %.0f ms)", buildSeconds * 1000,
+		poolSeconds * 1000, queries, querySeconds * 1e9 / queries, sweepSeconds * 1000);
+}
+
+BENCH_CASE(xref_index, "XrefIndex RefsTo against a whole-section sweep and a brute-force rel32 scan", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+
+	utils::ThreadPool pool;
+	std::unique_ptr<utils::XrefIndex> index, pooled;
+	double buildSeconds = bench::BestOf(ctx.Repeat(), [&]() { index.reset(new utils::XrefIndex(image)); });
+	double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() { pooled.reset(new utils::XrefIndex(image, &pool)); });
+
+	std::vector<Xref> expected;
+	std::vector<uint32_t> starts;
+	for (const utils::PeCodeRange& range : image.ExecutableRanges())
+		SweepRange(image, range, expected, starts);
+	std::stable_sort(expected.begin(), expected.end());
+
+	size_t targets = 0;
+	size_t mismatches = CompareXrefs(*index, expected, targets);
+	ctx.Check(mismatches == 0, "%zu of %zu targets differ from the whole-section sweep", mismatches, targets);
+	ctx.Check(index->Count() == expected.size() && index->TargetCount() == targets,
+		"index has %zu refs to %zu targets, sweep %zu to %zu", index->Count(), index->TargetCount(), expected.size(), targets);
+	ctx.Check(CompareXrefs(*pooled, expected, targets) == 0 && pooled->Count() == expected.size(), "pool build differs from the sweep");
+
+	// 暴力核对：每个指令起点上的 E8/E9 rel32 和 EB rel8 自己算目标，索引里必须有这一项
+	std::vector<utils::PeCodeRange> ranges = image.ExecutableRanges();
+	size_t brute = 0, missing = 0;
+	for (uint32_t source : starts)
+	{
+		const utils::PeCodeRange* range = RangeOf(ranges, source);
+		size_t pos = source - range->rva;
+		uint8_t opcode = range->data[pos];
+		size_t length = opcode == 0xEB ? 2 : 5;
+		if ((opcode != 0xE8 && opcode != 0xE9 && opcode != 0xEB) || pos + length > range->size)
+			continue;
+		int32_t rel = 0;
+		if (opcode == 0xEB)
+			rel = (int8_t)range->data[pos + 1];
+		else
+			memcpy(&rel, range->data + pos + 1, 4);
+		uint32_t target = (uint32_t)(source + length + rel);
+		if (rel == 0 || target >= image.SizeOfImage())
+			continue;
+		brute++;
+		if (!Contains(*index, Xref{ target, source, (uint8_t)(opcode == 0xE8 ? utils::kXrefCall : utils::kXrefJump) }) && missing++ < 5)
+			ctx.Check(false, "%s at %x to %x is not in the index", opcode == 0xE8 ? "call" : "jmp", source, target);
+	}
+	ctx.Check(missing == 0, "%zu of %zu brute-force call/jmp refs missing", missing, brute);
+
+	size_t calls = 0;
+	for (const Xref& ref : expected)
+		calls += ref.kind == utils::kXrefCall;
+	ctx.Report("%zu refs to %zu targets (%zu calls), %zu bytes; %zu call/jmp rel found by brute force",
+		index->Count(), index->TargetCount(), calls, index->BytesUsed(), brute);
+	ctx.Report("build %.1f ms, pool %.1f ms (%.1fx)", buildSeconds * 1000, poolSeconds * 1000, buildSeconds / poolSeconds);
+}
@@ -0,0 +1,143 @@
+// 按页合并的保护修改和指令缓存刷新
+//
+// 一页上紧挨着 64 个小函数，一个事务全部挂上、一个事务全部摘下。
+// 同一页上的目标只应该改一次保护、刷一次指令缓存，而不是每个函数各一次。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <utility>
+
+extern "C" const uint8_t bench_page_targets[];
+
+// 每个函数占 16 字节：push rbp; mov rbp, rsp; lea rax, [rdi+i]; pop rbp; ret
+asm(".text\n"
+	".p2align 12\n"
+	".globl bench_page_targets\n"
+	"bench_page_targets:\n"
+	".set bench_page_index, 0\n"
+	".rept 64\n"
+	"	.p2align 4\n"
+	"	push %rbp\n"
+	"	mov %rsp, %rbp\n"
+	"	lea bench_page_index(%rdi), %rax\n"
+	"	pop %rbp\n"
+	"	ret\n"
+	"	.set bench_page_index, bench_page_index + 1\n"
+	".endr\n");
+
+namespace {
+
+	const size_t kPageTargets = 64;
+	const size_t kTargetStride = 16;
+	const long kHookDelta = 1000;
+
+	typedef long (*TargetFunc)(long);
+
+	TargetFunc s_real[kPageTargets];
+
+	TargetFunc Target(size_t index)
+	{
+		return (TargetFunc)(bench_page_targets + index * kTargetStride);
+	}
+
+	template <size_t n>
+	long Detour(long value)
+	{
+		return s_real[n](value) + kHookDelta;
+	}
+
+	template <size_t... n>
+	std::vector<TargetFunc> MakeDetours(std::index_sequence<n...>)
+	{
+		return { Detour<n>... };
+	}
+
+	const std::vector<TargetFunc> s_detours = MakeDetours(std::make_index_sequence<kPageTargets>());
+
+	// 在一个事务里挂上或摘下[first, last)的目标
+	LONG Commit(bool attach, size_t first, size_t last, DETOUR_COMMIT_STATS& stats)
+	{
+		DetourTransactionBegin();
+		for (size_t i = first; i < last; i++)
+		{
+			if (attach)
+			{
+				s_real[i] = Target(i);
+				DetourAttach((PVOID*)&s_real[i], (PVOID)s_detours[i]);
+			}
+			else
+				DetourDetach((PVOID*)&s_real[i], (PVOID)s_detours[i]);
+		}
+		DetourUpdateAllThreads();
+		LONG error = DetourTransactionCommit();
+		DetourGetCommitStats(&stats);
+		return error;
+	}
+
+	size_t CountResults(long delta)
+	{
+		size_t bad = 0;
+		for (size_t i = 0; i < kPageTargets; i++)
+		{
+			if (Target(i)(10) != 10 + (long)i + delta)
+				bad++;
+		}
+		return bad;
+	}
+
+}
+
+BENCH_CASE(page_coalescing, "VirtualProtect and icache flushes per commit for 64 functions on one page", false)
+{
+	DETOUR_COMMIT_STATS attach, detach;
+	bench::Clock::time_point begin = bench::Clock::now();
+	if (!ctx.Check(Commit(true, 0, kPageTargets, attach) == NO_ERROR, "attach failed"))
+		return;
+	double attachSeconds = bench::Seconds(begin, bench::Clock::now());
+	size_t bad = CountResults(kHookDelta);
+	ctx.Check(bad == 0, "%zu hooked calls returned the wrong value", bad);
+
+	begin = bench::Clock::now();
+	ctx.Check(Commit(false, 0, kPageTargets, detach) == NO_ERROR, "detach failed");
+	double detachSeconds = bench::Seconds(begin, bench::Clock::now());
+	bad = CountResults(0);
+	ctx.Check(bad == 0, "%zu calls still hooked after the detach", bad);
+
+	// 目标页和跳板区域各改一次、恢复一次，余量留给跨页的跳板区域
+	const ULONG kMaxProtect = 8;
+	const ULONG kMaxFlush = 4;
+	for (const DETOUR_COMMIT_STATS* stats : { &attach, &detach })
+	{
+		const char* name = stats == &attach ? "attach" : "detach";
+		ctx.Check(stats->cOperations == kPageTargets, "%s: %u operations", name, stats->cOperations);
+		ctx.Check(stats->cVirtualProtect <= kMaxProtect, "%s: %u VirtualProtect calls, expected at most %u",
+			name, stats->cVirtualProtect, kMaxProtect);
+		ctx.Check(stats->cFlushInstructionCache <= kMaxFlush, "%s: %u icache flushes, expected at most %u",
+			name, stats->cFlushInstructionCache, kMaxFlush);
+	}
+
+	ctx.Report("attach %zu functions: %u VirtualProtect, %u icache flushes, %5.0f us", kPageTargets,
+		attach.cVirtualProtect, attach.cFlushInstructionCache, attachSeconds * 1e6);
+	ctx.Report("detach %zu functions: %u VirtualProtect, %u icache flushes, %5.0f us", kPageTargets,
+		detach.cVirtualProtect, detach.cFlushInstructionCache, detachSeconds * 1e6);
+
+	// 对照：每个函数单独一个事务
+	ULONG protects = 0, flushes = 0;
+	begin = bench::Clock::now();
+	for (int attachOne = 1; attachOne >= 0; attachOne--)
+	{
+		for (size_t i = 0; i < kPageTargets; i++)
+		{
+			DETOUR_COMMIT_STATS stats;
+			if (!ctx.Check(Commit(attachOne != 0, i, i + 1, stats) == NO_ERROR, "commit for target %zu failed", i))
+				return;
+			protects += stats.cVirtualProtect;
+			flushes += stats.cFlushInstructionCache;
+		}
+	}
+	double singleSeconds = bench::Seconds(begin, bench::Clock::now());
+	bad = CountResults(0);
+	ctx.Check(bad == 0, "%zu calls still hooked after the one-by-one detach", bad);
+	ctx.Report("one function per transaction, attach + detach: %u VirtualProtect, %u icache flushes, %5.0f us",
+		protects, flushes, singleSeconds * 1e6);
+}
@@ -0,0 +1,171 @@
+// 特征码扫描
+//
+// 语料是映像可执行节的原始字节，重复拼接到 64MB。特征码从代码里随机截取，
+// 带几个通配字节，一半再改掉一个字节，多半就找不到了。
+// 每个结果都和逐字节比较的朴素实现对照。
+
+#include "bench.h"
+#include "include/pe_image.h"
+#include "include/signature.h"
+#include "include/thread_pool.h"
+
+namespace {
+
+	const size_t kCorpusSize = 64 * 1024 * 1024;
+	const size_t kSampleCount = 8;
+
+	std::vector<uint8_t> Corpus(const std::vector<uint8_t>& code, size_t size)
+	{
+		std::vector<uint8_t> corpus;
+		corpus.reserve(size);
+		while (corpus.size() < size)
+			corpus.insert(corpus.end(), code.begin(), code.begin() + std::min(code.size(), size - corpus.size()));
+		return corpus;
+	}
+
+	bool NaiveMatch(const uint8_t* data, const utils::Signature& sig)
+	{
+		const std::vector<uint8_t>& bytes = sig.Bytes();
+		const std::vector<uint8_t>& mask = sig.Mask();
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			if (mask[i] && data[i] != bytes[i])
+				return false;
+		}
+		return true;
+	}
+
+	std::vector<size_t> NaiveFindAll(const uint8_t* data, size_t dataLen, const utils::Signature& sig)
+	{
+		std::vector<size_t> offsets;
+		for (size_t i = 0; i + sig.Length() <= dataLen; i++)
+		{
+			if (NaiveMatch(data + i, sig))
+				offsets.push_back(i);
+		}
+		return offsets;
+	}
+
+	size_t NaiveFind(const uint8_t* data, size_t dataLen, const utils::Signature& sig)
+	{
+		for (size_t i = 0; i + sig.Length() <= dataLen; i++)
+		{
+			if (NaiveMatch(data + i, sig))
+				return i;
+		}
+		return utils::kSignatureNotFound;
+	}
+
+	double MBps(size_t bytes, double seconds)
+	{
+		return seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+	}
+
+	// 只在测量时使用的映像代码和语料
+	struct ScanInput
+	{
+		std::vector<uint8_t> code;
+		std::vector<uint8_t> corpus;
+	};
+
+	bool LoadScanInput(bench::Context& ctx, ScanInput& input)
+	{
+		const std::vector<uint8_t>& file = ctx.ImageFile();
+		utils::PeImage image(file.data(), file.size(), false);
+		if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+			return false;
+		input.code = bench::CodeBytes(image);
+		if (!ctx.Check(input.code.size() > bench::kSignatureLength, "no executable section"))
+			return false;
+		input.corpus = Corpus(input.code, kCorpusSize);
+		return true;
+	}
+
+}
+
+BENCH_CASE(signature_scan, "FindSignature/FindSignatureAll against a byte-by-byte scan", true)
+{
+	ScanInput input;
+	if (!LoadScanInput(ctx, input))
+		return;
+	const uint8_t* data = input.corpus.data();
+	size_t dataLen = input.corpus.size();
+
+	double naiveSeconds = 0, fastSeconds = 0, firstSeconds = 0;
+	size_t scanned = 0, hits = 0;
+	for (const utils::Signature& sig : bench::SampleSignatures(input.code, kSampleCount, 1))
+	{
+		std::vector<size_t> expected;
+		naiveSeconds += bench::BestOf(1, [&]() { expected = NaiveFindAll(data, dataLen, sig); });
+		std::vector<size_t> offsets;
+		fastSeconds += bench::BestOf(ctx.Repeat(), [&]() { offsets = utils::FindSignatureAll(data, dataLen, sig); });
+		ctx.Check(offsets == expected, "FindSignatureAll: %zu hits, expected %zu", offsets.size(), expected.size());
+
+		size_t first = 0;
+		firstSeconds += bench::BestOf(ctx.Repeat(), [&]() { first = utils::FindSignature(data, dataLen, sig); });
+		size_t expectedFirst = NaiveFind(data, dataLen, sig);
+		ctx.Check(first == expectedFirst, "FindSignature: offset %zx, expected %zx", first, expectedFirst);
+		scanned += first == utils::kSignatureNotFound ? dataLen : first;
+		hits += expected.size();
+	}
+
+	size_t total = dataLen * kSampleCount;
+	ctx.Report("corpus %zu MB of %zu KB code, %zu signatures, %zu hits", dataLen >> 20, input.code.size() >> 10, kSampleCount, hits);
+	ctx.Report("%-16s %6.0f MB/s", "naive", MBps(total, naiveSeconds));
+	ctx.Report("%-16s %6.0f MB/s (%.1fx)", "FindSignatureAll", MBps(total, fastSeconds), naiveSeconds / fastSeconds);
+	ctx.Report("%-16s %6.0f MB/s up to the first hit", "FindSignature", MBps(scanned, firstSeconds));
+}
+
+BENCH_CASE(signature_set, "SignatureSet single pass against one scan per signature", true)
+{
+	ScanInput input;
+	if (!LoadScanInput(ctx, input))
+		return;
+	const uint8_t* data = input.corpus.data();
+	size_t dataLen = input.corpus.size();
+
+	for (size_t count : { 5, 20, 50 })
+	{
+		std::vector<utils::Signature> signatures = bench::SampleSignatures(input.code, count, (uint32_t)count);
+		utils::SignatureSet set(signatures);
+
+		std::vector<size_t> expected(count);
+		double singleSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+			for (size_t i = 0; i < count; i++)
+				expected[i] = utils::FindSignature(data, dataLen, signatures[i]);
+		});
+		std::vector<size_t> offsets;
+		double setSeconds = bench::BestOf(ctx.Repeat(), [&]() { offsets = set.Find(data, dataLen); });
+		ctx.Check(offsets == expected, "%zu signatures: SignatureSet::Find differs from FindSignature", count);
+
+		size_t found = count - std::count(expected.begin(), expected.end(), utils::kSignatureNotFound);
+		ctx.Report("%2zu signatures (%2zu found): one by one %7.1f ms, set %7.1f ms (%.1fx)",
+			count, found, singleSeconds * 1000, setSeconds * 1000, singleSeconds / setSeconds);
+	}
+}
+
+BENCH_CASE(signature_parallel, "SignatureSet::Find on a thread pool against the sequential scan", true)
+{
+	const std::vector<uint8_t>& file = ctx.ImageFile();
+	utils::PeImage image(file.data(), file.size(), false);
+	if (!ctx.Check(!image.Invalid(), "%s is not a PE image", ctx.Opt().image.c_str()))
+		return;
+	std::vector<uint8_t> code = bench::CodeBytes(image);
+	if (!ctx.Check(code.size() > bench::kSignatureLength, "no executable section"))
+		return;
+
+	utils::SignatureSet set(bench::SampleSignatures(code, 50, 3));
+	utils::ThreadPool pool;
+	std::vector<const uint8_t*> expected;
+	double serialSeconds = bench::BestOf(ctx.Repeat(), [&]() { expected = set.Find(image); });
+	ctx.Report("sequential        %7.2f ms, %zu KB code", serialSeconds * 1000, code.size() >> 10);
+
+	// 小块让特征码跨块边界，检查重叠部分
+	for (size_t chunkSize : { (size_t)4096, (size_t)64 * 1024, utils::kSignatureChunkSize })
+	{
+		std::vector<const uint8_t*> found;
+		double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() { found = set.Find(image, pool, chunkSize); });
+		ctx.Check(found == expected, "chunk %zu: pool results differ from the sequential scan", chunkSize);
+		ctx.Report("pool, %4zu KB chunks %7.2f ms (%.1fx)", chunkSize >> 10, poolSeconds * 1000, serialSeconds / poolSeconds);
+	}
+}
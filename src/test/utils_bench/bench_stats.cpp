@@ -0,0 +1,89 @@
+// HookStatScope 的每次调用开销
+//
+// 同一个小函数，直接调用和在里面放一个 HookStatScope 比较，统计关闭和打开各测一次。
+// 打开时记下的调用数要和实际调用数一致，关闭时一次也不记。
+
+#include "bench.h"
+#include "include/hook_stats.h"
+
+namespace {
+
+	typedef long (*TargetFunc)(long);
+
+	const size_t kCalls = 2 * 1000 * 1000;
+
+	const utils::HookStatId s_statId = utils::RegisterHookStat("bench.scoped");
+
+	__attribute__((noinline)) long Bare(long value)
+	{
+		asm volatile("");
+		return value + 1;
+	}
+
+	__attribute__((noinline)) long Scoped(long value)
+	{
+		utils::HookStatScope stat(s_statId);
+		asm volatile("");
+		return value + 1;
+	}
+
+	double CallNanoseconds(bench::Context& ctx, TargetFunc func, size_t& calls)
+	{
+		TargetFunc volatile call = func;
+		int repeat = std::max(ctx.Repeat(), 1);
+		calls += kCalls * repeat;
+		double seconds = bench::BestOf(repeat, [&]() {
+			long sum = 0;
+			for (size_t i = 0; i < kCalls; i++)
+				sum += call((long)i);
+			bench::Keep(sum);
+		});
+		return seconds * 1e9 / kCalls;
+	}
+
+	uint64_t RecordedCalls()
+	{
+		for (const utils::HookStatSnapshot& snapshot : utils::SnapshotHookStats())
+		{
+			if (snapshot.name == "bench.scoped")
+				return snapshot.calls;
+		}
+		return 0;
+	}
+
+}
+
+BENCH_CASE(hook_stats, "HookStatScope per-call cost with statistics off and on", false)
+{
+	if (!ctx.Check(s_statId != utils::kInvalidHookStat, "RegisterHookStat failed"))
+		return;
+	bool wasEnabled = utils::HookStatsEnabled();
+	size_t calls = 0;
+
+	utils::EnableHookStats(false);
+	utils::ResetHookStats();
+	double bare = CallNanoseconds(ctx, Bare, calls);
+	calls = 0;
+	double off = CallNanoseconds(ctx, Scoped, calls);
+	ctx.Check(RecordedCalls() == 0, "%llu calls recorded with statistics off", (unsigned long long)RecordedCalls());
+
+	utils::EnableHookStats(true);
+	calls = 0;
+	double on = CallNanoseconds(ctx, Scoped, calls);
+	utils::EnableHookStats(wasEnabled);
+	ctx.Check(RecordedCalls() == calls, "%llu calls recorded, expected %zu", (unsigned long long)RecordedCalls(), calls);
+
+	// 顺便量一下 rdtsc 本身，打开时每次调用要读两次
+	double rdtsc = bench::BestOf(ctx.Repeat(), [&]() {
+		uint64_t sum = 0;
+		for (size_t i = 0; i < kCalls; i++)
+			sum += utils::HookStatTicks();
+		bench::Keep(sum);
+	}) * 1e9 / kCalls;
+	utils::ResetHookStats();
+
+	ctx.Report("%-16s %6.2f ns/call", "bare", bare);
+	ctx.Report("%-16s %6.2f ns/call (+%.2f ns)", "scope, stats off", off, off - bare);
+	ctx.Report("%-16s %6.2f ns/call (+%.2f ns)", "scope, stats on", on, on - bare);
+	ctx.Report("rdtsc %.2f ns, so recording costs %.2f ns per call besides the two reads", rdtsc, on - bare - 2 * rdtsc);
+}
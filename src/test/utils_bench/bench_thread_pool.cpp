@@ -0,0 +1,62 @@
+// 线程池
+//
+// ParallelFor 分别跑很小和稍重的任务，和单线程循环比较；
+// 嵌套 Submit 模拟任务里继续投递任务，检查每个任务都执行且只执行一次。
+
+#include "bench.h"
+#include "include/thread_pool.h"
+
+namespace {
+
+	// 与下标有关、编译器算不掉的一点计算
+	uint64_t Work(size_t index, int rounds)
+	{
+		uint64_t value = index * 0x9e3779b97f4a7c15ull;
+		for (int i = 0; i < rounds; i++)
+			value = (value ^ (value >> 29)) * 0xbf58476d1ce4e5b9ull;
+		return value;
+	}
+
+	void Spawn(utils::ThreadPool& pool, std::atomic<size_t>& done, int depth)
+	{
+		done++;
+		if (depth == 0)
+			return;
+		pool.Submit([&pool, &done, depth]() { Spawn(pool, done, depth - 1); });
+		pool.Submit([&pool, &done, depth]() { Spawn(pool, done, depth - 1); });
+	}
+
+}
+
+BENCH_CASE(thread_pool, "ThreadPool ParallelFor and nested Submit", false)
+{
+	utils::ThreadPool pool;
+	ctx.Report("%zu threads", pool.ThreadCount());
+
+	const size_t count = 1 << 20;
+	for (int rounds : { 1, 64 })
+	{
+		std::vector<uint64_t> expected(count), results(count);
+		double serialSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+			for (size_t i = 0; i < count; i++)
+				expected[i] = Work(i, rounds);
+		});
+		double poolSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+			pool.ParallelFor(count, [&](size_t i) { results[i] = Work(i, rounds); });
+		});
+		ctx.Check(results == expected, "ParallelFor with %d rounds: results differ from the loop", rounds);
+		ctx.Report("ParallelFor %zu items x %2d rounds: loop %6.1f ms, pool %6.1f ms (%.1fx), %5.1f M items/s",
+			count, rounds, serialSeconds * 1000, poolSeconds * 1000, serialSeconds / poolSeconds, count / poolSeconds / 1e6);
+	}
+
+	const int depth = 16;
+	const size_t tasks = (2u << depth) - 1;
+	std::atomic<size_t> done(0);
+	double nestedSeconds = bench::BestOf(ctx.Repeat(), [&]() {
+		done = 0;
+		pool.Submit([&pool, &done]() { Spawn(pool, done, depth); });
+		pool.Wait();
+	});
+	ctx.Check(done == tasks, "nested Submit ran %zu of %zu tasks", done.load(), tasks);
+	ctx.Report("nested Submit %zu tasks: %6.1f ms, %5.1f M tasks/s", tasks, nestedSeconds * 1000, tasks / nestedSeconds / 1e6);
+}
@@ -0,0 +1,162 @@
+// 跳板区域的分配和释放
+//
+// 在一个事务里，围绕 64 个相距很远的页各分配一批 thunk，再在另一个事务里全部释放。
+// 每个 thunk 必须在 rel32 能跳到的范围内，相互不重叠，写进去的内容提交后原样保留；
+// 释放后再分配同样多的 thunk 不应该再新建区域。
+
+#include "bench.h"
+#include "detour/detours.h"
+#include <cstring>
+#include <sys/mman.h>
+
+namespace {
+
+	const size_t kNearCount = 64;
+	const size_t kThunksPerNear = 160;
+	const ULONG kThunkSize = 32;
+	// 64 个地址分布在代码两侧各 1.5GB 内
+	const intptr_t kNearSpacing = 48 * 1024 * 1024;
+	const intptr_t kJumpReach = 0x7ff80000;
+
+	struct Thunk
+	{
+		PBYTE near;
+		PBYTE code;
+	};
+
+	// 分配时要读near处的代码，所以每个地址上映射一页，地址被占用时由内核另选
+	std::vector<PBYTE> MapNearPages()
+	{
+		std::vector<PBYTE> pages;
+		intptr_t base = (intptr_t)&MapNearPages & ~(intptr_t)0xfff;
+		for (size_t i = 0; i < kNearCount; i++)
+		{
+			void* hint = (void*)(base + ((intptr_t)i - (intptr_t)kNearCount / 2) * kNearSpacing);
+			void* page = mmap(hint, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (page != MAP_FAILED)
+				pages.push_back((PBYTE)page);
+		}
+		return pages;
+	}
+
+	void UnmapNearPages(const std::vector<PBYTE>& pages)
+	{
+		for (PBYTE page : pages)
+			munmap(page, 4096);
+	}
+
+	// 在一个事务里分配，每个thunk写上自己的序号，失败时thunks里只有成功的部分
+	LONG AllocateThunks(const std::vector<PBYTE>& nears, std::vector<Thunk>& thunks)
+	{
+		thunks.clear();
+		DetourTransactionBegin();
+		for (size_t i = 0; i < kThunksPerNear; i++)
+		{
+			for (PBYTE near : nears)
+			{
+				PBYTE code = (PBYTE)DetourAllocateThunk(near, kThunkSize);
+				if (code == NULL)
+				{
+					DetourTransactionAbort();
+					return GetLastError();
+				}
+				uint32_t index = (uint32_t)thunks.size();
+				memset(code, 0xcc, kThunkSize);
+				memcpy(code, &index, sizeof(index));
+				thunks.push_back({ near, code });
+			}
+		}
+		return DetourTransactionCommit();
+	}
+
+	LONG FreeThunks(std::vector<Thunk>& thunks)
+	{
+		DetourTransactionBegin();
+		for (const Thunk& thunk : thunks)
+			DetourFreeThunk(thunk.code);
+		thunks.clear();
+		return DetourTransactionCommit();
+	}
+
+	size_t CheckThunks(const std::vector<Thunk>& thunks)
+	{
+		size_t bad = 0;
+		std::vector<PBYTE> codes;
+		for (size_t i = 0; i < thunks.size(); i++)
+		{
+			intptr_t distance = thunks[i].code - thunks[i].near;
+			uint32_t index = 0;
+			memcpy(&index, thunks[i].code, sizeof(index));
+			if (distance <= -kJumpReach || distance >= kJumpReach || index != i)
+				bad++;
+			codes.push_back(thunks[i].code);
+		}
+		std::sort(codes.begin(), codes.end());
+		for (size_t i = 1; i < codes.size(); i++)
+		{
+			if (codes[i] < codes[i - 1] + kThunkSize)
+				bad++;
+		}
+		return bad;
+	}
+
+	DETOUR_TRAMPOLINE_STATS StatsSince(const DETOUR_TRAMPOLINE_STATS& before)
+	{
+		DETOUR_TRAMPOLINE_STATS now;
+		DetourGetTrampolineStats(&now);
+		now.cRegionProbes -= before.cRegionProbes;
+		now.cRegionsAllocated -= before.cRegionsAllocated;
+		return now;
+	}
+
+}
+
+BENCH_CASE(thunk_alloc, "trampoline-slot allocation near 64 spread addresses", false)
+{
+	std::vector<PBYTE> nears = MapNearPages();
+	if (!ctx.Check(nears.size() == kNearCount, "mapped %zu of %zu pages", nears.size(), kNearCount))
+	{
+		UnmapNearPages(nears);
+		return;
+	}
+	std::vector<Thunk> thunks;
+	BOOL retain = DetourSetRetainRegions(TRUE);
+
+	DETOUR_TRAMPOLINE_STATS before;
+	DetourGetTrampolineStats(&before);
+	bench::Clock::time_point begin = bench::Clock::now();
+	LONG error = AllocateThunks(nears, thunks);
+	double allocSeconds = bench::Seconds(begin, bench::Clock::now());
+	DETOUR_TRAMPOLINE_STATS first = StatsSince(before);
+	if (!ctx.Check(error == NO_ERROR, "allocating %zu thunks failed after %zu: %ld", kNearCount * kThunksPerNear, thunks.size(), (long)error))
+	{
+		DetourSetRetainRegions(retain);
+		UnmapNearPages(nears);
+		return;
+	}
+	size_t bad = CheckThunks(thunks);
+	ctx.Check(bad == 0, "%zu thunks out of reach, overlapping or overwritten", bad);
+
+	begin = bench::Clock::now();
+	ctx.Check(FreeThunks(thunks) == NO_ERROR, "freeing the thunks failed");
+	double freeSeconds = bench::Seconds(begin, bench::Clock::now());
+
+	// 区域保留着，第二轮只复用
+	DetourGetTrampolineStats(&before);
+	begin = bench::Clock::now();
+	error = AllocateThunks(nears, thunks);
+	double reuseSeconds = bench::Seconds(begin, bench::Clock::now());
+	DETOUR_TRAMPOLINE_STATS second = StatsSince(before);
+	ctx.Check(error == NO_ERROR && CheckThunks(thunks) == 0, "reallocating the thunks failed");
+	ctx.Check(second.cRegionsAllocated == 0, "reallocation created %u new regions", second.cRegionsAllocated);
+	FreeThunks(thunks);
+	DetourSetRetainRegions(retain);
+	UnmapNearPages(nears);
+
+	size_t count = kNearCount * kThunksPerNear;
+	ctx.Report("%zu thunks near %zu addresses: %u regions, %u region probes", count, kNearCount,
+		first.cRegionsAllocated, first.cRegionProbes);
+	ctx.Report("allocate %6.1f ms (%4.0f ns/thunk), free %6.1f ms (%4.0f ns/thunk), reuse %6.1f ms (%4.0f ns/thunk, %u probes)",
+		allocSeconds * 1000, allocSeconds * 1e9 / count, freeSeconds * 1000, freeSeconds * 1e9 / count,
+		reuseSeconds * 1000, reuseSeconds * 1e9 / count, second.cRegionProbes);
+}
@@ -0,0 +1,180 @@
+// 计时 stub 的嵌套和尾跳转
+//
+// 被计时的函数里再调被计时的函数，以及被计时的函数尾跳转到另一个被计时的函数，
+// 检查返回值、每层的事件和深度，尾跳转的几层应该在同一时刻结束。
+// 最后比较经过计时 stub 和直接调用每次多出来的开销。
+
+#include "bench.h"
+#include "include/hook_timing.h"
+
+extern "C" long bench_timing_leaf(long);
+extern "C" long bench_timing_tail(long);
+extern "C" long bench_timing_tail2(long);
+
+// tail 尾跳转到 leaf 的计时 stub，tail2 尾跳转到 tail 的计时 stub
+extern "C" {
+	void* bench_timing_leaf_thunk = nullptr;
+	void* bench_timing_tail_thunk = nullptr;
+}
+
+asm(".text\n"
+	".p2align 4\n"
+	".globl bench_timing_leaf\n"
+	"bench_timing_leaf:\n"
+	"	lea 1(%rdi), %rax\n"
+	"	ret\n"
+	".p2align 4\n"
+	".globl bench_timing_tail\n"
+	"bench_timing_tail:\n"
+	"	jmp *bench_timing_leaf_thunk(%rip)\n"
+	".p2align 4\n"
+	".globl bench_timing_tail2\n"
+	"bench_timing_tail2:\n"
+	"	jmp *bench_timing_tail_thunk(%rip)\n");
+
+namespace {
+
+	typedef long (*TargetFunc)(long);
+
+	const long kNestedDelta = 10;
+	const size_t kCalls = 1000 * 1000;
+
+	struct Timed
+	{
+		const char* name = nullptr;
+		utils::TimingTarget target;
+		TargetFunc thunk = nullptr;
+	};
+
+	enum { kLeaf, kTail, kTail2, kNested, kNestedTail, kTimedCount };
+
+	const char* const kTimedNames[kTimedCount] = {
+		"timing.leaf", "timing.tail", "timing.tail2", "timing.nested", "timing.nested_tail",
+	};
+
+	Timed s_timed[kTimedCount];
+
+	__attribute__((noinline)) long Nested(long value)
+	{
+		TargetFunc volatile leaf = s_timed[kLeaf].thunk;
+		return leaf(value) + kNestedDelta;
+	}
+
+	__attribute__((noinline)) long NestedTail(long value)
+	{
+		TargetFunc volatile tail = s_timed[kTail].thunk;
+		return tail(value) + kNestedDelta;
+	}
+
+	bool CreateThunks(bench::Context& ctx)
+	{
+		const TargetFunc originals[kTimedCount] = { bench_timing_leaf, bench_timing_tail, bench_timing_tail2, Nested, NestedTail };
+		for (int i = 0; i < kTimedCount; i++)
+		{
+			s_timed[i].name = kTimedNames[i];
+			s_timed[i].target.original = (void*)originals[i];
+			s_timed[i].target.id = utils::RegisterHookStat(s_timed[i].name);
+			s_timed[i].thunk = (TargetFunc)utils::CreateTimingThunk(&s_timed[i].target);
+			if (!ctx.Check(s_timed[i].thunk != nullptr, "CreateTimingThunk failed for %s", s_timed[i].name))
+				return false;
+		}
+		bench_timing_leaf_thunk = (void*)s_timed[kLeaf].thunk;
+		bench_timing_tail_thunk = (void*)s_timed[kTail].thunk;
+		return true;
+	}
+
+	void DestroyThunks()
+	{
+		for (Timed& timed : s_timed)
+		{
+			utils::DestroyTimingThunk((void*)timed.thunk);
+			timed.thunk = nullptr;
+		}
+	}
+
+	// 调一次，检查返回值和事件：expected按出口顺序列出，从最里层到最外层，chained是尾跳转上来的层数
+	void CheckCall(bench::Context& ctx, int which, long expectedResult, std::initializer_list<int> expected, size_t chained)
+	{
+		std::vector<utils::HookTimingEvent> events;
+		utils::DrainHookTimingEvents(events);
+		events.clear();
+
+		long result = s_timed[which].thunk(5);
+		ctx.Check(result == expectedResult, "%s returned %ld, expected %ld", s_timed[which].name, result, expectedResult);
+
+		utils::DrainHookTimingEvents(events);
+		if (!ctx.Check(events.size() == expected.size(), "%s: %zu events, expected %zu", s_timed[which].name, events.size(), expected.size()))
+			return;
+		size_t i = 0;
+		for (int id : expected)
+		{
+			const utils::HookTimingEvent& event = events[i];
+			uint32_t depth = (uint32_t)(expected.size() - 1 - i);
+			ctx.Check(event.id == s_timed[id].target.id && event.depth == depth, "%s: event %zu is %u at depth %u, expected %s at depth %u",
+				s_timed[which].name, i, event.id, event.depth, s_timed[id].name, depth);
+			ctx.Check(event.exitTicks >= event.enterTicks, "%s: event %zu exits before it enters", s_timed[which].name, i);
+			if (i > 0)
+			{
+				const utils::HookTimingEvent& inner = events[i - 1];
+				ctx.Check(inner.enterTicks >= event.enterTicks && inner.exitTicks <= event.exitTicks,
+					"%s: event %zu is not inside event %zu", s_timed[which].name, i - 1, i);
+				// 尾跳转上来的几层共用出口，结束时刻相同
+				if (i <= chained)
+					ctx.Check(inner.exitTicks == event.exitTicks, "%s: tail-called event %zu exits at a different time", s_timed[which].name, i - 1);
+			}
+			i++;
+		}
+	}
+
+	double CallNanoseconds(bench::Context& ctx, TargetFunc func)
+	{
+		TargetFunc volatile call = func;
+		std::vector<utils::HookTimingEvent> events;
+		double seconds = bench::BestOf(ctx.Repeat(), [&]() {
+			long sum = 0;
+			for (size_t i = 0; i < kCalls; i++)
+			{
+				sum += call((long)i);
+				// 环形缓冲只有 kTimingRingSize 格，一次调用最多产生 3 个事件，及时取走
+				if (i % 256 == 0)
+				{
+					events.clear();
+					utils::DrainHookTimingEvents(events);
+				}
+			}
+			bench::Keep(sum);
+		});
+		return seconds * 1e9 / kCalls;
+	}
+
+}
+
+BENCH_CASE(timing_stub, "timing stubs through nested calls and tail jumps", false)
+{
+	if (!CreateThunks(ctx))
+	{
+		DestroyThunks();
+		return;
+	}
+	uint64_t dropped = utils::DroppedHookTimingEvents();
+
+	CheckCall(ctx, kLeaf, 6, { kLeaf }, 0);
+	CheckCall(ctx, kNested, 6 + kNestedDelta, { kLeaf, kNested }, 0);
+	CheckCall(ctx, kTail, 6, { kLeaf, kTail }, 1);
+	CheckCall(ctx, kTail2, 6, { kLeaf, kTail, kTail2 }, 2);
+	CheckCall(ctx, kNestedTail, 6 + kNestedDelta, { kLeaf, kTail, kNestedTail }, 1);
+	// 尾跳转的帧结束后，下一次调用的深度要从头算起
+	CheckCall(ctx, kLeaf, 6, { kLeaf }, 0);
+
+	double direct = CallNanoseconds(ctx, bench_timing_leaf);
+	double timed = CallNanoseconds(ctx, s_timed[kLeaf].thunk);
+	double tail = CallNanoseconds(ctx, s_timed[kTail2].thunk);
+	CheckCall(ctx, kNestedTail, 6 + kNestedDelta, { kLeaf, kTail, kNestedTail }, 1);
+	ctx.Check(utils::DroppedHookTimingEvents() == dropped, "%llu events dropped",
+		(unsigned long long)(utils::DroppedHookTimingEvents() - dropped));
+
+	ctx.Report("%-26s %6.2f ns/call", "direct", direct);
+	ctx.Report("%-26s %6.2f ns/call (+%.2f ns)", "timed", timed, timed - direct);
+	ctx.Report("%-26s %6.2f ns/call (%.2f ns per level)", "timed, 2 tail jumps", tail, (tail - direct) / 3);
+	DestroyThunks();
+}
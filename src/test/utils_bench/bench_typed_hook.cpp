@@ -0,0 +1,107 @@
+// Hook<Func> 句柄
+//
+// 通过 Hook<Func>::operator() 调原函数，和自己保存跳板指针再调用比较每次调用的开销，
+// 两者都应该只是一次间接调用。同时检查移动和析构时的卸载。
+// hook.cpp 只在 Windows 上编译，Hook<> 用的 DetourAttachFunc 和 DetourDetachFunc 在 bench_hook.cpp 里。
+
+#include "bench.h"
+#include "include/hook.h"
+
+#define TYPED_HOOK_TARGET(name, n) \
+	".p2align 4\n" \
+	".globl " #name "\n" \
+	#name ":\n" \
+	"	push %rbp\n" \
+	"	mov %rsp, %rbp\n" \
+	"	lea " #n "(%rdi), %rax\n" \
+	"	pop %rbp\n" \
+	"	ret\n"
+
+extern "C" long bench_typed_raw_target(long);
+extern "C" long bench_typed_hook_target(long);
+
+asm(".text\n"
+	TYPED_HOOK_TARGET(bench_typed_raw_target, 1)
+	TYPED_HOOK_TARGET(bench_typed_hook_target, 2));
+
+namespace {
+
+	typedef long TargetFunc(long);
+
+	const long kHookDelta = 1000;
+
+	TargetFunc* s_rawOriginal = bench_typed_raw_target;
+	utils::Hook<TargetFunc> s_hook;
+
+	__attribute__((noinline)) long RawDetour(long value)
+	{
+		return s_rawOriginal(value) + kHookDelta;
+	}
+
+	__attribute__((noinline)) long HookDetour(long value)
+	{
+		return s_hook(value) + kHookDelta;
+	}
+
+	long ConstantDetour(long)
+	{
+		return -1;
+	}
+
+	// 经函数指针调用count次，返回结果之和
+	long CallLoop(TargetFunc* volatile func, long count)
+	{
+		long sum = 0;
+		for (long i = 0; i < count; i++)
+			sum += func(i);
+		return sum;
+	}
+
+	long ExpectedSum(long count, long delta)
+	{
+		return count * (count - 1) / 2 + count * delta;
+	}
+
+}
+
+BENCH_CASE(typed_hook, "Hook<Func> call overhead against a saved trampoline pointer", false)
+{
+	const long count = 10 * 1000 * 1000;
+
+	long sum = 0;
+	double directSeconds = bench::BestOf(ctx.Repeat(), [&]() { sum = CallLoop(bench_typed_hook_target, count); });
+	ctx.Check(sum == ExpectedSum(count, 2), "unhooked target returned the wrong sum");
+
+	if (!ctx.Check(utils::DetourAttachFunc((void**)&s_rawOriginal, (void*)RawDetour, true), "DetourAttachFunc failed"))
+		return;
+	double rawSeconds = bench::BestOf(ctx.Repeat(), [&]() { sum = CallLoop(bench_typed_raw_target, count); });
+	ctx.Check(sum == ExpectedSum(count, 1 + kHookDelta), "saved trampoline: wrong sum");
+	ctx.Check(utils::DetourDetachFunc((void**)&s_rawOriginal, (void*)RawDetour), "DetourDetachFunc failed");
+
+	if (!ctx.Check(s_hook.Attach(bench_typed_hook_target, HookDetour), "Hook<Func>::Attach failed"))
+		return;
+	double hookSeconds = bench::BestOf(ctx.Repeat(), [&]() { sum = CallLoop(bench_typed_hook_target, count); });
+	ctx.Check(sum == ExpectedSum(count, 2 + kHookDelta), "Hook<Func>: wrong sum");
+
+	// 移走的句柄不再负责卸载，移回来以后钩子还在
+	{
+		utils::Hook<TargetFunc> moved(std::move(s_hook));
+		ctx.Check(!s_hook.Attached() && moved.Attached(), "move did not transfer the hook");
+		ctx.Check(moved.Original() != bench_typed_hook_target, "Original() is not the trampoline");
+		s_hook = std::move(moved);
+	}
+	ctx.Check(s_hook.Attached() && bench_typed_hook_target(0) == 2 + kHookDelta, "hook lost by moving it");
+	ctx.Check(s_hook.Detach() && bench_typed_hook_target(0) == 2, "Detach did not restore the target");
+
+	// 析构时卸载
+	{
+		auto made = utils::MakeHook(bench_typed_hook_target, ConstantDetour);
+		ctx.Check(made.Attached() && bench_typed_hook_target(0) == -1, "MakeHook did not attach");
+	}
+	ctx.Check(bench_typed_hook_target(0) == 2, "destructor did not detach the hook");
+	ctx.Check(bench_typed_raw_target(0) == 1, "raw hook still attached");
+
+	ctx.Report("%-18s %5.2f ns/call", "unhooked", directSeconds * 1e9 / count);
+	ctx.Report("%-18s %5.2f ns/call", "saved trampoline", rawSeconds * 1e9 / count);
+	ctx.Report("%-18s %5.2f ns/call (%.2fx the saved pointer)", "Hook<Func>", hookSeconds * 1e9 / count, hookSeconds / rawSeconds);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// 在 Linux 上编译 include/hook.h 用的替身，只提供 hook.h 用到的 HMODULE、byte 和 GetProcAddress
+// HMODULE 和 Windows 上一样是不同于 void* 的类型，hook.h 里按 HMODULE 和 void* 重载的函数才能区分开
+// 只给 bench_typed_hook.cpp 用，这个文件不能再包含 detours.h
+
+#include <dlfcn.h>
+
+struct HINSTANCE__;
+typedef HINSTANCE__* HMODULE;
+typedef unsigned char byte;
+
+inline void* GetProcAddress(HMODULE hModule, const char* name)
+{
+	return dlsym(hModule, name);
+}
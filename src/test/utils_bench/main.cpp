@@ -0,0 +1,198 @@
+// utils_bench [-image path] [-repeat n] [case...]
+//
+// 不带用例名时运行全部用例。没有 -image 或文件读不出来时，跳过依赖映像的用例。
+// 退出码为 1 表示有检查失败。
+
+#include "bench.h"
+#include "include/pe_image.h"
+#include "include/signature.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace bench {
+
+	static std::vector<Case>& Registry()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	bool Register(const Case& c)
+	{
+		Registry().push_back(c);
+		return true;
+	}
+
+	const std::vector<Case>& Cases()
+	{
+		return Registry();
+	}
+
+	const std::vector<uint8_t>& Context::ImageFile()
+	{
+		if (m_imageLoaded)
+			return m_image;
+		m_imageLoaded = true;
+		if (m_options.image.empty())
+			return m_image;
+		FILE* file = fopen(m_options.image.c_str(), "rb");
+		if (!file)
+			return m_image;
+		uint8_t buffer[64 * 1024];
+		size_t got;
+		while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			m_image.insert(m_image.end(), buffer, buffer + got);
+		fclose(file);
+		return m_image;
+	}
+
+	std::vector<uint8_t> CodeBytes(const utils::PeImage& image)
+	{
+		std::vector<uint8_t> code;
+		for (const utils::PeCodeRange& range : image.ExecutableRanges())
+			code.insert(code.end(), range.data, range.data + range.size);
+		return code;
+	}
+
+	std::vector<uint32_t> ReferenceEntries(const std::vector<uint8_t>& file, const utils::PeImage& image)
+	{
+		utils::PeFunctionTable table(image);
+		if (!table.Empty())
+			return table.Entries();
+
+		// IMAGE_FILE_HEADER的PointerToSymbolTable和NumberOfSymbols，每个符号18字节
+		std::vector<uint32_t> entries;
+		uint32_t ntOffset = 0, symbolOffset = 0, symbolCount = 0;
+		if (file.size() < 0x40)
+			return entries;
+		memcpy(&ntOffset, &file[0x3c], 4);
+		if ((uint64_t)ntOffset + 24 > file.size())
+			return entries;
+		memcpy(&symbolOffset, &file[ntOffset + 12], 4);
+		memcpy(&symbolCount, &file[ntOffset + 16], 4);
+		const size_t kSymbolSize = 18;
+		const uint8_t kClassExternal = 2;
+		const std::vector<utils::PeSection>& sections = image.Sections();
+		for (uint64_t i = 0; i < symbolCount && symbolOffset + (i + 1) * kSymbolSize <= file.size(); i++)
+		{
+			const uint8_t* symbol = &file[symbolOffset + i * kSymbolSize];
+			uint32_t value = 0;
+			int16_t section = 0;
+			memcpy(&value, symbol + 8, 4);
+			memcpy(&section, symbol + 12, 2);
+			uint8_t storageClass = symbol[16];
+			uint8_t auxCount = symbol[17];
+			i += auxCount;
+			if (storageClass != kClassExternal || section < 1 || (size_t)section > sections.size())
+				continue;
+			const utils::PeSection& owner = sections[section - 1];
+			if (owner.Executable() && value < owner.virtualSize)
+				entries.push_back(owner.rva + value);
+		}
+		std::sort(entries.begin(), entries.end());
+		entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+		return entries;
+	}
+
+	std::vector<utils::Signature> SampleSignatures(const std::vector<uint8_t>& code, size_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<utils::Signature> signatures;
+		while (signatures.size() < count)
+		{
+			size_t offset = random() % (code.size() - kSignatureLength);
+			uint8_t bytes[kSignatureLength];
+			uint8_t mask[kSignatureLength];
+			memcpy(bytes, &code[offset], kSignatureLength);
+			memset(mask, 1, kSignatureLength);
+			for (int i = 0; i < 3; i++)
+				mask[1 + random() % (kSignatureLength - 2)] = 0;
+			if (signatures.size() % 2)
+				bytes[kSignatureLength - 1] ^= 0x5a;
+			utils::Signature sig(bytes, kSignatureLength, mask);
+			if (!sig.Invalid())
+				signatures.push_back(sig);
+		}
+		return signatures;
+	}
+
+	void Context::Report(const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		printf("  ");
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+	}
+
+	bool Context::Check(bool condition, const char* format, ...)
+	{
+		if (condition)
+			return true;
+		va_list args;
+		va_start(args, format);
+		printf("  FAIL: ");
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+		m_failures++;
+		return false;
+	}
+
+}
+
+static void Usage()
+{
+	printf("usage: utils_bench [-image path] [-repeat n] [case...]\n\ncases:\n");
+	for (const bench::Case& c : bench::Cases())
+		printf("  %-24s %s\n", c.name, c.summary);
+}
+
+int main(int argc, char** argv)
+{
+	bench::Options options;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-image") == 0 && i + 1 < argc)
+			options.image = argv[++i];
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc)
+			options.repeat = atoi(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			Usage();
+			return 2;
+		}
+		else
+			names.push_back(argv[i]);
+	}
+
+	bench::Context ctx(options);
+	size_t ran = 0;
+	for (const bench::Case& c : bench::Cases())
+	{
+		if (!names.empty() && std::find(names.begin(), names.end(), c.name) == names.end())
+			continue;
+		printf("== %s: %s\n", c.name, c.summary);
+		if (c.needImage && ctx.ImageFile().empty())
+		{
+			printf("  skipped: no image\n");
+			continue;
+		}
+		size_t failures = ctx.Failures();
+		c.func(ctx);
+		printf("  %s\n", ctx.Failures() == failures ? "ok" : "FAILED");
+		ran++;
+	}
+
+	if (ran == 0 && !names.empty())
+	{
+		Usage();
+		return 2;
+	}
+	printf("%zu case(s), %zu failure(s)\n", ran, ctx.Failures());
+	return ctx.Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include "include/arena.h"
+#include <algorithm>
+
+namespace utils {
+
+	Arena::Arena(size_t chunkSize/* = 64 * 1024*/)
+		: m_chunkSize(chunkSize ? chunkSize : 64 * 1024)
+	{
+	}
+
+	void* Arena::Allocate(size_t size, size_t align/* = alignof(std::max_align_t)*/)
+	{
+		size_t padding = (size_t)(-(intptr_t)m_cursor) & (align - 1);
+		if (!m_cursor || m_left < padding + size)
+		{
+			// Сĵһ飬˷ѵǰʣµĿռ
+			size_t chunkSize = (std::max)(m_chunkSize, size + align);
+			m_chunks.emplace_back(new uint8_t[chunkSize]);
+			m_reserved += chunkSize;
+
+			uint8_t* chunk = m_chunks.back().get();
+			if (chunkSize > m_chunkSize && m_cursor)
+			{
+				size_t bigPadding = (size_t)(-(intptr_t)chunk) & (align - 1);
+				m_used += size;
+				return chunk + bigPadding;
+			}
+
+			m_cursor = chunk;
+			m_left = chunkSize;
+			padding = (size_t)(-(intptr_t)m_cursor) & (align - 1);
+		}
+
+		uint8_t* result = m_cursor + padding;
+		m_cursor += padding + size;
+		m_left -= padding + size;
+		m_used += size;
+		return result;
+	}
+
+	size_t Arena::BytesUsed() const
+	{
+		return m_used;
+	}
+
+	size_t Arena::BytesReserved() const
+	{
+		return m_reserved;
+	}
+}
@@ -0,0 +1,113 @@
+#include "include/code_pool.h"
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace utils {
+
+	namespace {
+		const size_t kCodePageSize = 4096;
+		const size_t kCodeSlotSize = 32;
+
+		struct Pool
+		{
+			std::mutex lock;
+			uint8_t* page = nullptr;		// зֵҳ
+			size_t used = 0;
+			std::map<size_t, std::vector<uint8_t*>> freeCode;	// ֽ
+		};
+
+		Pool& GetPool()
+		{
+			static Pool pool;
+			return pool;
+		}
+
+		uint8_t* AllocPages(size_t size)
+		{
+#ifdef _WIN32
+			return (uint8_t*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READ);
+#else
+			void* memory = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return memory == MAP_FAILED ? nullptr : (uint8_t*)memory;
+#endif
+		}
+
+		bool ProtectPages(uint8_t* code, size_t size, bool writable)
+		{
+#ifdef _WIN32
+			DWORD old = 0;
+			if (!VirtualProtect(code, size, writable ? PAGE_EXECUTE_READWRITE : PAGE_EXECUTE_READ, &old)) return false;
+			if (!writable) FlushInstructionCache(GetCurrentProcess(), code, size);
+			return true;
+#else
+			return mprotect(code, size, PROT_READ | PROT_EXEC | (writable ? PROT_WRITE : 0)) == 0;
+#endif
+		}
+
+		size_t RoundUp(size_t size, size_t unit)
+		{
+			return (size + unit - 1) / unit * unit;
+		}
+	}
+
+	void* AllocCode(size_t size)
+	{
+		if (size == 0) return nullptr;
+
+		size_t bytes = RoundUp(size, kCodeSlotSize);
+		Pool& pool = GetPool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+
+		auto it = pool.freeCode.find(bytes);
+		if (it != pool.freeCode.end() && !it->second.empty())
+		{
+			uint8_t* code = it->second.back();
+			it->second.pop_back();
+			return code;
+		}
+
+		if (bytes > kCodePageSize) return AllocPages(RoundUp(bytes, kCodePageSize));
+
+		if (!pool.page || pool.used + bytes > kCodePageSize)
+		{
+			uint8_t* page = AllocPages(kCodePageSize);
+			if (!page) return nullptr;
+			pool.page = page;
+			pool.used = 0;
+		}
+
+		uint8_t* code = pool.page + pool.used;
+		pool.used += bytes;
+		return code;
+	}
+
+	bool WriteCode(void* dst, const void* code, size_t size)
+	{
+		if (!dst || !code) return false;
+
+		uint8_t* begin = (uint8_t*)((uintptr_t)dst & ~(uintptr_t)(kCodePageSize - 1));
+		size_t length = RoundUp((uint8_t*)dst + size - begin, kCodePageSize);
+
+		// ߳ͬʱдͬһҳʱһҳĻRXʱһڿ
+		Pool& pool = GetPool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+		if (!ProtectPages(begin, length, true)) return false;
+		memcpy(dst, code, size);
+		return ProtectPages(begin, length, false);
+	}
+
+	void FreeCode(void* code, size_t size)
+	{
+		if (!code || size == 0) return;
+
+		Pool& pool = GetPool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+		pool.freeCode[RoundUp(size, kCodeSlotSize)].push_back((uint8_t*)code);
+	}
+}
@@ -0,0 +1,722 @@
+#include "include/control_flow.h"
+#include "include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "detour/detours.h"
+
+namespace utils {
+
+	namespace {
+		const uint32_t kNoTarget = 0xFFFFFFFF;
+		// ָϸӵı־DETOUR_DECODED_*ص
+		const uint16_t kDecodedJumpTable = 0x8000;
+		// תģʽʱָ
+		const size_t kHistorySize = 16;
+
+		// κڴjmp [mem]һɰתӳļЩַܶ
+		const DETOUR_DISASM_CONTEXT kNoReferences = { nullptr, nullptr, TRUE };
+
+		inline bool TestBit(const std::vector<uint64_t>& bits, uint32_t index)
+		{
+			size_t word = index / 64;
+			return word < bits.size() && (bits[word] & (1ull << (index % 64))) != 0;
+		}
+
+		// ִ0Ϊ0ʱ±꣬ʱֻЩ
+		inline void SetBit(std::vector<uint64_t>& bits, uint32_t index, std::vector<uint32_t>& dirty)
+		{
+			size_t word = index / 64;
+			if (word >= bits.size()) return;
+			if (!bits[word]) dirty.push_back((uint32_t)word);
+			bits[word] |= 1ull << (index % 64);
+		}
+
+		// תʶֻҪ⼸ָModRM
+		struct ModRm
+		{
+			uint8_t opcode = 0;
+			uint8_t mod = 0;
+			uint8_t reg = 0;		// REX.R
+			uint8_t rm = 0;			// REX.B
+			bool sib = false;
+			uint8_t scale = 0;
+			uint8_t index = 0;		// REX.X
+			uint8_t base = 0;		// REX.B
+			bool noBase = false;	// [index*scale + disp32]
+			bool ripRelative = false;
+			int32_t disp = 0;
+			size_t end = 0;			// ModRM/SIB/disp֮ƫƣλ
+		};
+
+		bool ParseModRm(const uint8_t* code, size_t length, bool is64, ModRm& out)
+		{
+			size_t pos = 0;
+			uint8_t rex = 0;
+			for (; pos < length; ++pos)
+			{
+				uint8_t b = code[pos];
+				if (b == 0x66 || b == 0x67 || b == 0xF0 || b == 0xF2 || b == 0xF3 ||
+					b == 0x26 || b == 0x2E || b == 0x36 || b == 0x3E || b == 0x64 || b == 0x65)
+				{
+					continue;
+				}
+				break;
+			}
+			if (is64 && pos < length && (code[pos] & 0xF0) == 0x40) rex = code[pos++];
+			if (pos + 2 > length) return false;
+
+			out.opcode = code[pos++];
+			uint8_t modrm = code[pos++];
+			out.mod = modrm >> 6;
+			out.reg = ((modrm >> 3) & 7) | ((rex & 4) << 1);
+			out.rm = (modrm & 7) | ((rex & 1) << 3);
+
+			if (out.mod != 3 && (modrm & 7) == 4)
+			{
+				if (pos >= length) return false;
+				uint8_t sib = code[pos++];
+				out.sib = true;
+				out.scale = sib >> 6;
+				out.index = ((sib >> 3) & 7) | ((rex & 2) << 2);
+				out.base = (sib & 7) | ((rex & 1) << 3);
+				out.noBase = (out.mod == 0 && (sib & 7) == 5);
+			}
+			out.ripRelative = (out.mod == 0 && (modrm & 7) == 5);
+
+			size_t dispSize = 0;
+			if (out.mod == 1) dispSize = 1;
+			else if (out.mod == 2 || out.noBase || out.ripRelative) dispSize = 4;
+			if (pos + dispSize > length) return false;
+			if (dispSize == 1) out.disp = (int8_t)code[pos];
+			else if (dispSize == 4) memcpy(&out.disp, code + pos, 4);
+			out.end = pos + dispSize;
+			return true;
+		}
+	}
+
+	struct ControlFlowGraph::Instruction
+	{
+		uint32_t rva;
+		uint32_t target;		// ֱת/õĿ꣬kNoTargetʾûлδ֪
+		uint32_t tableBegin;	// תĿWorker::tableTargetsеλ
+		uint32_t tableCount;
+		uint16_t flags;			// DETOUR_DECODED_*kDecodedJumpTable
+		uint8_t length;
+		uint8_t reserved;
+	};
+
+	// ÿ߳ͬһʱֻһArenaControlFlowGraph
+	struct ControlFlowGraph::Worker
+	{
+		Arena arena;
+		std::vector<Instruction> instructions;
+		std::vector<uint32_t> stack;
+		std::vector<uint32_t> tableTargets;
+		std::vector<uint32_t> calls;
+		std::vector<CfgBlock> blocks;
+		std::vector<uint32_t> lastInstruction;
+		std::vector<uint32_t> edges;
+		std::vector<uint32_t> edgeBegin;
+
+		// ǰѽָͿ㣬rvaһλ
+		std::vector<uint64_t> seen;
+		std::vector<uint64_t> leaders;
+		std::vector<uint32_t> dirty;
+	};
+
+	const CfgBlock* CfgFunction::BlockContaining(uint32_t rva) const
+	{
+		const CfgBlock* end = blocks + blockCount;
+		const CfgBlock* found = std::upper_bound(blocks, end, rva, [](uint32_t value, const CfgBlock& block) { return value < block.rva; });
+		if (found == blocks) return nullptr;
+		--found;
+		return (rva - found->rva < found->size) ? found : nullptr;
+	}
+
+	ControlFlowGraph::ControlFlowGraph(const PeImage& image)
+		: m_image(image)
+	{
+		if (image.Invalid()) return;
+
+		m_64bit = image.Is64Bit();
+		m_ranges = image.ExecutableRanges();
+		std::sort(m_ranges.begin(), m_ranges.end(), [](const PeCodeRange& left, const PeCodeRange& right) { return left.rva < right.rva; });
+
+		m_claimedWords = ((size_t)image.SizeOfImage() + 63) / 64;
+		m_claimed.reset(new std::atomic<uint64_t>[m_claimedWords]);
+		for (size_t i = 0; i < m_claimedWords; ++i)
+		{
+			m_claimed[i] = 0;
+		}
+	}
+
+	ControlFlowGraph::~ControlFlowGraph()
+	{
+	}
+
+	const std::vector<const CfgFunction*>& ControlFlowGraph::Functions() const
+	{
+		return m_functions;
+	}
+
+	const CfgFunction* ControlFlowGraph::FunctionAt(uint32_t entryRva) const
+	{
+		auto found = std::lower_bound(m_functions.begin(), m_functions.end(), entryRva,
+			[](const CfgFunction* function, uint32_t value) { return function->entryRva < value; });
+		return (found != m_functions.end() && (*found)->entryRva == entryRva) ? *found : nullptr;
+	}
+
+	const PeCodeRange* ControlFlowGraph::RangeOf(uint32_t rva) const
+	{
+		auto found = std::upper_bound(m_ranges.begin(), m_ranges.end(), rva, [](uint32_t value, const PeCodeRange& range) { return value < range.rva; });
+		if (found == m_ranges.begin()) return nullptr;
+		--found;
+		return (rva - found->rva < found->size) ? &*found : nullptr;
+	}
+
+	bool ControlFlowGraph::Claim(uint32_t rva)
+	{
+		size_t word = rva / 64;
+		if (word >= m_claimedWords) return false;
+
+		uint64_t bit = 1ull << (rva % 64);
+		return (m_claimed[word].fetch_or(bit) & bit) == 0;
+	}
+
+	ControlFlowGraph::Worker* ControlFlowGraph::AcquireWorker()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (!m_idle.empty())
+		{
+			Worker* worker = m_idle.back();
+			m_idle.pop_back();
+			return worker;
+		}
+
+		m_workers.emplace_back(new Worker);
+		Worker* worker = m_workers.back().get();
+		worker->seen.resize(m_claimedWords);
+		worker->leaders.resize(m_claimedWords);
+		return worker;
+	}
+
+	void ControlFlowGraph::ReleaseWorker(Worker* worker)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_idle.push_back(worker);
+	}
+
+	size_t ControlFlowGraph::Build(const std::vector<uint32_t>& entries, bool followCalls/* = true*/, ThreadPool* pool/* = nullptr*/)
+	{
+		if (m_image.Invalid()) return 0;
+
+		size_t before = m_functions.size();
+
+		std::vector<uint32_t> pending;
+		for (uint32_t entry : entries)
+		{
+			if (RangeOf(entry) && Claim(entry)) pending.push_back(entry);
+		}
+
+		if (pool)
+		{
+			for (uint32_t entry : pending)
+			{
+				pool->Submit([this, entry, followCalls, pool]() { BuildOne(entry, followCalls, pool, nullptr); });
+			}
+			pool->Wait();
+		}
+		else
+		{
+			while (!pending.empty())
+			{
+				uint32_t entry = pending.back();
+				pending.pop_back();
+				BuildOne(entry, followCalls, nullptr, &pending);
+			}
+		}
+
+		std::sort(m_functions.begin(), m_functions.end(), [](const CfgFunction* left, const CfgFunction* right) { return left->entryRva < right->entryRva; });
+
+		// λͼֻڹʱãСģ
+		for (auto& worker : m_workers)
+		{
+			std::vector<uint64_t>().swap(worker->seen);
+			std::vector<uint64_t>().swap(worker->leaders);
+		}
+		return m_functions.size() - before;
+	}
+
+	void ControlFlowGraph::BuildOne(uint32_t entryRva, bool followCalls, ThreadPool* pool, std::vector<uint32_t>* pending)
+	{
+		Worker* worker = AcquireWorker();
+		if (worker->seen.empty())
+		{
+			worker->seen.resize(m_claimedWords);
+			worker->leaders.resize(m_claimedWords);
+		}
+
+		const CfgFunction* function = BuildFunction(*worker, entryRva);
+		ReleaseWorker(worker);
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_functions.push_back(function);
+		}
+
+		if (!followCalls) return;
+		for (uint32_t i = 0; i < function->callCount; ++i)
+		{
+			uint32_t callee = function->calls[i];
+			if (!RangeOf(callee) || !Claim(callee)) continue;
+
+			if (pool) pool->Submit([this, callee, followCalls, pool]() { BuildOne(callee, followCalls, pool, nullptr); });
+			else pending->push_back(callee);
+		}
+	}
+
+	bool ControlFlowGraph::Decode(uint32_t rva, Instruction& insn) const
+	{
+		insn.rva = rva;
+		insn.target = kNoTarget;
+		insn.tableBegin = 0;
+		insn.tableCount = 0;
+		insn.flags = DETOUR_DECODED_INVALID;
+		insn.length = 1;
+		insn.reserved = 0;
+
+		const PeCodeRange* range = RangeOf(rva);
+		if (!range) return false;
+
+		PBYTE code = (PBYTE)range->data + (rva - range->rva);
+		size_t available = range->size - (rva - range->rva);
+
+		// βһָʱ룬öӳ䷶Χ
+		uint8_t buffer[32] = { 0 };
+		if (available < 16)
+		{
+			memcpy(buffer, code, available);
+			code = buffer;
+		}
+
+		DETOUR_DECODED_INSTRUCTION decoded;
+		PBYTE next = m_64bit ?
+			(PBYTE)DetourDecodeInstructionExX64(code, &decoded, &kNoReferences) :
+			(PBYTE)DetourDecodeInstructionExX86(code, &decoded, &kNoReferences);
+		if (!next || decoded.cbInstruction == 0 || decoded.cbInstruction > available) return false;
+
+		insn.length = decoded.cbInstruction;
+		insn.flags = decoded.wFlags;
+		if (decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE &&
+			decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC)
+		{
+			// rva㣬ļ¿ڵĿҲǶԵ
+			insn.target = (uint32_t)(rva + ((uintptr_t)decoded.pbTarget - (uintptr_t)code));
+		}
+		return (insn.flags & DETOUR_DECODED_INVALID) == 0;
+	}
+
+	const CfgFunction* ControlFlowGraph::BuildFunction(Worker& worker, uint32_t entryRva)
+	{
+		worker.instructions.clear();
+		worker.stack.clear();
+		worker.tableTargets.clear();
+		worker.calls.clear();
+
+		bool truncated = false;
+		SetBit(worker.leaders, entryRva, worker.dirty);
+		worker.stack.push_back(entryRva);
+
+		while (!worker.stack.empty())
+		{
+			uint32_t rva = worker.stack.back();
+			worker.stack.pop_back();
+
+			// ˳ʱָתʶҪؿ
+			size_t history[kHistorySize];
+			size_t historyCount = 0;
+
+			for (;;)
+			{
+				if (TestBit(worker.seen, rva))
+				{
+					// 䵽ѾָϣǸ
+					SetBit(worker.leaders, rva, worker.dirty);
+					break;
+				}
+				if (worker.instructions.size() >= kCfgMaxInstructions)
+				{
+					truncated = true;
+					worker.stack.clear();
+					break;
+				}
+
+				Instruction insn;
+				bool valid = Decode(rva, insn);
+				SetBit(worker.seen, rva, worker.dirty);
+
+				size_t index = worker.instructions.size();
+				worker.instructions.push_back(insn);
+				if (historyCount == kHistorySize)
+				{
+					memmove(history, history + 1, sizeof(history) - sizeof(history[0]));
+					--historyCount;
+				}
+				history[historyCount++] = index;
+
+				if (!valid || (insn.flags & DETOUR_DECODED_RETURN)) break;
+
+				uint32_t next = rva + insn.length;
+				if (insn.flags & DETOUR_DECODED_CALL)
+				{
+					if (insn.target != kNoTarget && RangeOf(insn.target)) worker.calls.push_back(insn.target);
+					rva = next;
+					continue;
+				}
+
+				if (insn.flags & DETOUR_DECODED_BRANCH)
+				{
+					if (insn.target != kNoTarget)
+					{
+						if (RangeOf(insn.target))
+						{
+							SetBit(worker.leaders, insn.target, worker.dirty);
+							worker.stack.push_back(insn.target);
+						}
+					}
+					else if (!(insn.flags & DETOUR_DECODED_CONDITIONAL))
+					{
+						DecodeJumpTable(worker, index, history, historyCount);
+
+						const Instruction& jump = worker.instructions[index];
+						for (uint32_t i = 0; i < jump.tableCount; ++i)
+						{
+							uint32_t target = worker.tableTargets[jump.tableBegin + i];
+							SetBit(worker.leaders, target, worker.dirty);
+							worker.stack.push_back(target);
+						}
+					}
+
+					if (!(insn.flags & DETOUR_DECODED_CONDITIONAL)) break;
+
+					SetBit(worker.leaders, next, worker.dirty);
+				}
+				rva = next;
+			}
+		}
+
+		const CfgFunction* function = Finish(worker, entryRva, truncated);
+
+		for (uint32_t word : worker.dirty)
+		{
+			worker.seen[word] = 0;
+			worker.leaders[word] = 0;
+		}
+		worker.dirty.clear();
+		return function;
+	}
+
+	void ControlFlowGraph::DecodeJumpTable(Worker& worker, size_t jumpIndex, const size_t* history, size_t historyCount)
+	{
+		Instruction& jump = worker.instructions[jumpIndex];
+		const uint8_t* jumpCode = m_image.RvaToPtr(jump.rva, jump.length);
+
+		ModRm jmp;
+		if (!jumpCode || !ParseModRm(jumpCode, jump.length, m_64bit, jmp) || jmp.opcode != 0xFF || (jmp.reg & 7) != 4) return;
+
+		// ʽԵַrvaMSVC x64Աͷƫƣgcc/clang x64
+		enum { kAbsolute, kRva, kRelative } kind = kAbsolute;
+		uint32_t tableRva = 0;
+		size_t entrySize = m_64bit ? 8 : 4;
+
+		auto codeOf = [this, &worker](size_t index, ModRm& out) -> bool
+		{
+			const Instruction& insn = worker.instructions[index];
+			const uint8_t* code = m_image.RvaToPtr(insn.rva, insn.length);
+			return code && ParseModRm(code, insn.length, m_64bit, out);
+		};
+
+		// historyһjmp
+		size_t cursor = historyCount ? historyCount - 1 : 0;
+
+		if (jmp.mod == 0 && jmp.sib && jmp.noBase && ((size_t)1 << jmp.scale) == entrySize)
+		{
+			// jmp [index*4 + table]
+			uint64_t va = m_64bit ? (uint64_t)(int64_t)jmp.disp : (uint64_t)(uint32_t)jmp.disp;
+			if (va < m_image.ImageBase()) return;
+			tableRva = (uint32_t)(va - m_image.ImageBase());
+		}
+		else if (jmp.mod == 3 && m_64bit)
+		{
+			// add reg, base
+			uint8_t target = jmp.rm;
+			uint8_t base = 0xFF;
+			ModRm op;
+			while (cursor-- > 0)
+			{
+				if (!codeOf(history[cursor], op) || op.mod != 3) continue;
+				if (op.opcode == 0x03 && op.reg == target) base = op.rm;
+				else if (op.opcode == 0x01 && op.rm == target) base = op.reg;
+				else continue;
+				break;
+			}
+			if (base == 0xFF) return;
+
+			// mov reg32, [base + index*4 + rva]movsxd reg, [base + index*4]
+			bool found = false;
+			while (cursor-- > 0)
+			{
+				if (!codeOf(history[cursor], op) || op.reg != target) continue;
+				if (op.opcode == 0x8B && op.mod == 2 && op.sib && op.scale == 2 && op.base == base)
+				{
+					kind = kRva;
+					tableRva = (uint32_t)op.disp;
+				}
+				else if (op.opcode == 0x63 && op.mod == 0 && op.sib && !op.noBase && op.scale == 2 && op.base == base)
+				{
+					kind = kRelative;
+				}
+				else
+				{
+					continue;
+				}
+				found = true;
+				break;
+			}
+			if (!found) return;
+
+			if (kind == kRelative)
+			{
+				// lea base, [rip + table]
+				found = false;
+				while (cursor-- > 0)
+				{
+					const Instruction& insn = worker.instructions[history[cursor]];
+					if (!codeOf(history[cursor], op)) continue;
+					if (op.opcode == 0x8D && op.reg == base && op.ripRelative)
+					{
+						tableRva = (uint32_t)(insn.rva + insn.length + op.disp);
+						found = true;
+						break;
+					}
+				}
+				if (!found) return;
+			}
+			entrySize = 4;
+		}
+		else
+		{
+			return;
+		}
+
+		// Ͻ磺cmp x, immja/jaeand x, imm8
+		size_t limit = 0;
+		for (size_t i = historyCount - 1; i-- > 0 && !limit;)
+		{
+			const Instruction& insn = worker.instructions[history[i]];
+			const uint8_t* code = m_image.RvaToPtr(insn.rva, insn.length);
+			if (!code) break;
+
+			ModRm op;
+			if (!(insn.flags & DETOUR_DECODED_CONDITIONAL))
+			{
+				if (ParseModRm(code, insn.length, m_64bit, op) && op.opcode == 0x83 && op.mod == 3 && (op.reg & 7) == 4)
+				{
+					limit = (size_t)code[op.end] + 1;
+					break;
+				}
+				continue;
+			}
+
+			uint8_t cc = (code[0] == 0x0F) ? (uint8_t)(code[1] - 0x10) : code[0];
+			if (cc != 0x77 && cc != 0x73) break;
+			if (i == 0) break;
+
+			const Instruction& compare = worker.instructions[history[i - 1]];
+			const uint8_t* compareCode = m_image.RvaToPtr(compare.rva, compare.length);
+			uint32_t bound = 0;
+			if (!compareCode) break;
+			if (compareCode[0] == 0x3D || (m_64bit && (compareCode[0] & 0xF0) == 0x40 && compareCode[1] == 0x3D))
+			{
+				memcpy(&bound, compareCode + compare.length - 4, 4);
+			}
+			else if (ParseModRm(compareCode, compare.length, m_64bit, op) && (op.reg & 7) == 7 && op.mod == 3 &&
+				(op.opcode == 0x83 || op.opcode == 0x81))
+			{
+				if (op.opcode == 0x83) bound = (uint32_t)(int32_t)(int8_t)compareCode[op.end];
+				else memcpy(&bound, compareCode + op.end, 4);
+			}
+			else
+			{
+				break;
+			}
+
+			limit = (cc == 0x77) ? (size_t)bound + 1 : (size_t)bound;
+		}
+
+		// ϽʱǴûϽʱһǴΪ
+		bool bounded = (limit != 0 && limit <= kCfgMaxJumpTable);
+		if (!bounded) limit = kCfgMaxJumpTable;
+
+		jump.tableBegin = (uint32_t)worker.tableTargets.size();
+		for (size_t i = 0; i < limit; ++i)
+		{
+			const uint8_t* entry = m_image.RvaToPtr(tableRva + (uint32_t)(i * entrySize), entrySize);
+			if (!entry) break;
+
+			uint32_t target = kNoTarget;
+			if (kind == kAbsolute)
+			{
+				uint64_t va = 0;
+				memcpy(&va, entry, entrySize);
+				if (va >= m_image.ImageBase()) target = (uint32_t)(va - m_image.ImageBase());
+			}
+			else
+			{
+				int32_t value = 0;
+				memcpy(&value, entry, 4);
+				target = (kind == kRva) ? (uint32_t)value : (uint32_t)(tableRva + value);
+			}
+
+			if (!RangeOf(target))
+			{
+				if (bounded) continue;
+				break;
+			}
+			worker.tableTargets.push_back(target);
+		}
+
+		jump.tableCount = (uint32_t)worker.tableTargets.size() - jump.tableBegin;
+		if (jump.tableCount) jump.flags |= kDecodedJumpTable;
+	}
+
+	const CfgFunction* ControlFlowGraph::Finish(Worker& worker, uint32_t entryRva, bool truncated)
+	{
+		std::vector<Instruction>& instructions = worker.instructions;
+		std::sort(instructions.begin(), instructions.end(), [](const Instruction& left, const Instruction& right) { return left.rva < right.rva; });
+
+		// ֻ
+		worker.blocks.clear();
+		worker.lastInstruction.clear();
+		for (size_t i = 0; i < instructions.size(); ++i)
+		{
+			const Instruction& insn = instructions[i];
+			bool start = (i == 0) || TestBit(worker.leaders, insn.rva);
+			if (!start)
+			{
+				const Instruction& prev = instructions[i - 1];
+				start = (prev.rva + prev.length != insn.rva) ||
+					(prev.flags & (DETOUR_DECODED_BRANCH | DETOUR_DECODED_RETURN | DETOUR_DECODED_INVALID)) != 0;
+			}
+
+			if (start)
+			{
+				CfgBlock block = {};
+				block.rva = insn.rva;
+				worker.blocks.push_back(block);
+				worker.lastInstruction.push_back(0);
+			}
+
+			CfgBlock& block = worker.blocks.back();
+			block.size = insn.rva + insn.length - block.rva;
+			block.instructionCount++;
+			if (insn.flags & DETOUR_DECODED_CALL) block.flags |= kCfgBlockCall;
+			worker.lastInstruction.back() = (uint32_t)i;
+		}
+
+		auto blockAt = [&worker](uint32_t rva) -> uint32_t
+		{
+			auto found = std::lower_bound(worker.blocks.begin(), worker.blocks.end(), rva, [](const CfgBlock& block, uint32_t value) { return block.rva < value; });
+			return (found != worker.blocks.end() && found->rva == rva) ? (uint32_t)(found - worker.blocks.begin()) : kNoTarget;
+		};
+
+		// ȶŵedgesedgeBeginÿ
+		std::vector<uint32_t>& edgeBegin = worker.edgeBegin;
+		worker.edges.clear();
+		edgeBegin.assign(worker.blocks.size() + 1, 0);
+		for (size_t b = 0; b < worker.blocks.size(); ++b)
+		{
+			CfgBlock& block = worker.blocks[b];
+			const Instruction& last = instructions[worker.lastInstruction[b]];
+			edgeBegin[b] = (uint32_t)worker.edges.size();
+
+			auto addEdge = [&](uint32_t rva)
+			{
+				uint32_t index = blockAt(rva);
+				if (index == kNoTarget) return;
+				for (size_t e = edgeBegin[b]; e < worker.edges.size(); ++e)
+				{
+					if (worker.edges[e] == index) return;
+				}
+				worker.edges.push_back(index);
+			};
+
+			if (last.flags & DETOUR_DECODED_INVALID)
+			{
+				block.flags |= kCfgBlockInvalid;
+			}
+			else if (last.flags & DETOUR_DECODED_RETURN)
+			{
+				block.flags |= kCfgBlockReturn;
+			}
+			else if (last.flags & DETOUR_DECODED_BRANCH)
+			{
+				if (last.flags & kDecodedJumpTable)
+				{
+					block.flags |= kCfgBlockJumpTable;
+					for (uint32_t i = 0; i < last.tableCount; ++i)
+					{
+						addEdge(worker.tableTargets[last.tableBegin + i]);
+					}
+				}
+				else if (last.target != kNoTarget)
+				{
+					addEdge(last.target);
+				}
+				else
+				{
+					block.flags |= kCfgBlockIndirect;
+				}
+
+				if (last.flags & DETOUR_DECODED_CONDITIONAL) addEdge(last.rva + last.length);
+			}
+			else
+			{
+				addEdge(last.rva + last.length);
+			}
+		}
+		edgeBegin[worker.blocks.size()] = (uint32_t)worker.edges.size();
+
+		// Arena
+		Arena& arena = worker.arena;
+		CfgFunction* function = arena.AllocateArray<CfgFunction>(1);
+		CfgBlock* blocks = arena.AllocateArray<CfgBlock>(worker.blocks.size());
+		uint32_t* edges = arena.AllocateArray<uint32_t>(worker.edges.size());
+		if (!worker.edges.empty()) memcpy(edges, worker.edges.data(), worker.edges.size() * sizeof(uint32_t));
+
+		for (size_t b = 0; b < worker.blocks.size(); ++b)
+		{
+			blocks[b] = worker.blocks[b];
+			blocks[b].successors = edges + edgeBegin[b];
+			blocks[b].successorCount = edgeBegin[b + 1] - edgeBegin[b];
+		}
+
+		std::sort(worker.calls.begin(), worker.calls.end());
+		worker.calls.erase(std::unique(worker.calls.begin(), worker.calls.end()), worker.calls.end());
+		uint32_t* calls = arena.AllocateArray<uint32_t>(worker.calls.size());
+		if (!worker.calls.empty()) memcpy(calls, worker.calls.data(), worker.calls.size() * sizeof(uint32_t));
+
+		function->entryRva = entryRva;
+		function->entryBlock = blockAt(entryRva);
+		function->blocks = blocks;
+		function->blockCount = (uint32_t)worker.blocks.size();
+		function->calls = calls;
+		function->callCount = (uint32_t)worker.calls.size();
+		function->truncated = truncated;
+		return function;
+	}
+}
@@ -11,11 +11,18 @@
 //#define DETOUR_DEBUG 1
 #define DETOURS_INTERNAL
 #include "detours.h"
+#ifdef DETOURS_LINUX
+#include <elf.h>
+#endif
 
 #if DETOURS_VERSION != 0x4c0c1   // 0xMAJORcMINORcPATCH
 #error detours.h version mismatch
 #endif
 
+#if !defined(_WIN32) && !defined(DETOURS_LINUX)
+#error The transaction API needs Windows or Linux x86-64 (see detposix.h)
+#endif
+
 #define NOTHROW
 
 //////////////////////////////////////////////////////////////////////////////
@@ -37,6 +44,7 @@ static PVOID    s_pSystemRegionUpperBound   = (PVOID)(ULONG_PTR)0x80000000;
 
 //////////////////////////////////////////////////////////////////////////////
 //
+#ifdef _WIN32
 static bool detour_is_imported(PBYTE pbCode, PBYTE pbAddress)
 {
     MEMORY_BASIC_INFORMATION mbi;
@@ -71,6 +79,24 @@ static bool detour_is_imported(PBYTE pbCode, PBYTE pbAddress)
     }
     return false;
 }
+#else // !_WIN32
+//  The ELF equivalent of an IAT entry is a GOT slot: data in the same file
+//  as the PLT stub (or -fno-plt call) that jumps through it.
+//
+static bool detour_is_imported(PBYTE pbCode, PBYTE pbAddress)
+{
+    MEMORY_BASIC_INFORMATION mbiCode;
+    MEMORY_BASIC_INFORMATION mbiSlot;
+    if (!VirtualQuery(pbCode, &mbiCode, sizeof(mbiCode)) ||
+        !VirtualQuery(pbAddress, &mbiSlot, sizeof(mbiSlot))) {
+        return false;
+    }
+    return (mbiCode.Type == MEM_IMAGE &&
+            mbiSlot.Type == MEM_IMAGE &&
+            mbiSlot.AllocationBase == mbiCode.AllocationBase &&
+            (mbiSlot.Protect & (PAGE_READONLY | PAGE_READWRITE)) != 0);
+}
+#endif // !_WIN32
 
 inline ULONG_PTR detour_2gb_below(ULONG_PTR address)
 {
@@ -236,61 +262,9 @@ inline BOOL detour_does_code_end_function(PBYTE pbCode)
 
 inline ULONG detour_is_code_filler(PBYTE pbCode)
 {
-    // 1-byte through 11-byte NOPs.
-    if (pbCode[0] == 0x90) {
-        return 1;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x90) {
-        return 2;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x00) {
-        return 3;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x40 &&
-        pbCode[3] == 0x00) {
-        return 4;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x44 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00) {
-        return 5;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x0F && pbCode[2] == 0x1F &&
-        pbCode[3] == 0x44 && pbCode[4] == 0x00 && pbCode[5] == 0x00) {
-        return 6;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x80 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00) {
-        return 7;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x84 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00) {
-        return 8;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x0F && pbCode[2] == 0x1F &&
-        pbCode[3] == 0x84 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00) {
-        return 9;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x66 && pbCode[2] == 0x0F &&
-        pbCode[3] == 0x1F && pbCode[4] == 0x84 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00 &&
-        pbCode[9] == 0x00) {
-        return 10;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x66 && pbCode[2] == 0x66 &&
-        pbCode[3] == 0x0F && pbCode[4] == 0x1F && pbCode[5] == 0x84 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00 &&
-        pbCode[9] == 0x00 && pbCode[10] == 0x00) {
-        return 11;
-    }
-
-    // int 3.
-    if (pbCode[0] == 0xcc) {
-        return 1;
-    }
-    return 0;
+    // int 3 and the 1-byte through 11-byte NOPs, shared with the
+    // disassembler so mapped-image analysis sees the same padding.
+    return DetourIsCodeFiller(pbCode, 11);
 }
 
 #endif // DETOURS_X86
@@ -461,61 +435,9 @@ inline BOOL detour_does_code_end_function(PBYTE pbCode)
 
 inline ULONG detour_is_code_filler(PBYTE pbCode)
 {
-    // 1-byte through 11-byte NOPs.
-    if (pbCode[0] == 0x90) {
-        return 1;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x90) {
-        return 2;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x00) {
-        return 3;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x40 &&
-        pbCode[3] == 0x00) {
-        return 4;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x44 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00) {
-        return 5;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x0F && pbCode[2] == 0x1F &&
-        pbCode[3] == 0x44 && pbCode[4] == 0x00 && pbCode[5] == 0x00) {
-        return 6;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x80 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00) {
-        return 7;
-    }
-    if (pbCode[0] == 0x0F && pbCode[1] == 0x1F && pbCode[2] == 0x84 &&
-        pbCode[3] == 0x00 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00) {
-        return 8;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x0F && pbCode[2] == 0x1F &&
-        pbCode[3] == 0x84 && pbCode[4] == 0x00 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00) {
-        return 9;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x66 && pbCode[2] == 0x0F &&
-        pbCode[3] == 0x1F && pbCode[4] == 0x84 && pbCode[5] == 0x00 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00 &&
-        pbCode[9] == 0x00) {
-        return 10;
-    }
-    if (pbCode[0] == 0x66 && pbCode[1] == 0x66 && pbCode[2] == 0x66 &&
-        pbCode[3] == 0x0F && pbCode[4] == 0x1F && pbCode[5] == 0x84 &&
-        pbCode[6] == 0x00 && pbCode[7] == 0x00 && pbCode[8] == 0x00 &&
-        pbCode[9] == 0x00 && pbCode[10] == 0x00) {
-        return 11;
-    }
-
-    // int 3.
-    if (pbCode[0] == 0xcc) {
-        return 1;
-    }
-    return 0;
+    // int 3 and the 1-byte through 11-byte NOPs, shared with the
+    // disassembler so mapped-image analysis sees the same padding.
+    return DetourIsCodeFiller(pbCode, 11);
 }
 
 #endif // DETOURS_X64
@@ -1153,11 +1075,172 @@ inline ULONG detour_is_code_filler(PBYTE pbCode)
 
 #endif // DETOURS_ARM64
 
+////////////////////////////////////////////////////// Code Page Protection.
+//
+//  Code pages made writable by the pending transaction, sorted by address,
+//  with the protection each had before.  Operations on the same page share
+//  one VirtualProtect, and the commit puts back each run of contiguous pages
+//  with one VirtualProtect and one FlushInstructionCache.
+//
+#ifdef DETOURS_IA64
+const ULONG DETOUR_CODE_PAGE_SIZE = 0x2000;
+#else
+const ULONG DETOUR_CODE_PAGE_SIZE = 0x1000;
+#endif
+
+struct DetourPage
+{
+    PBYTE               pbPage;
+    ULONG               dwPerm;
+};
+
+static DetourPage *         s_pPendingPages         = NULL;
+static ULONG                s_cPendingPages         = 0;
+static ULONG                s_cPendingPagesMax      = 0;
+static DETOUR_COMMIT_STATS  s_CommitStats           = { 0 };
+
+static BOOL detour_protect(PVOID pv, SIZE_T cb, DWORD dwPerm, PDWORD pdwOld)
+{
+    s_CommitStats.cVirtualProtect++;
+    return VirtualProtect(pv, cb, dwPerm, pdwOld);
+}
+
+static void detour_flush(HANDLE hProcess, PVOID pv, SIZE_T cb)
+{
+    s_CommitStats.cFlushInstructionCache++;
+    FlushInstructionCache(hProcess, pv, cb);
+}
+
+// Returns the position of the first pending page at or above pbPage.
+static ULONG detour_pending_page_lower_bound(PBYTE pbPage)
+{
+    ULONG nLo = 0;
+    ULONG nHi = s_cPendingPages;
+    while (nLo < nHi) {
+        ULONG nMid = nLo + (nHi - nLo) / 2;
+        if (s_pPendingPages[nMid].pbPage < pbPage) {
+            nLo = nMid + 1;
+        }
+        else {
+            nHi = nMid;
+        }
+    }
+    return nLo;
+}
+
+// Makes [pbCode, pbCode + cbCode) writable until the transaction ends.
+static LONG detour_writable_code(PBYTE pbCode, ULONG cbCode)
+{
+    PBYTE pbPage = (PBYTE)((ULONG_PTR)pbCode & ~(ULONG_PTR)(DETOUR_CODE_PAGE_SIZE - 1));
+    PBYTE pbLim = (PBYTE)(((ULONG_PTR)pbCode + cbCode + DETOUR_CODE_PAGE_SIZE - 1) &
+                          ~(ULONG_PTR)(DETOUR_CODE_PAGE_SIZE - 1));
+
+    while (pbPage < pbLim) {
+        ULONG n = detour_pending_page_lower_bound(pbPage);
+        if (n < s_cPendingPages && s_pPendingPages[n].pbPage == pbPage) {
+            pbPage += DETOUR_CODE_PAGE_SIZE;
+            continue;
+        }
+
+        // Pages up to the next one already writable take a single call, as
+        // long as they share one protection: dwOld is recorded for each.
+        PBYTE pbEnd = pbLim;
+        if (n < s_cPendingPages && s_pPendingPages[n].pbPage < pbEnd) {
+            pbEnd = s_pPendingPages[n].pbPage;
+        }
+        if (pbEnd - pbPage > (LONG_PTR)DETOUR_CODE_PAGE_SIZE) {
+            MEMORY_BASIC_INFORMATION mbi;
+            ZeroMemory(&mbi, sizeof(mbi));
+            if (VirtualQuery(pbPage, &mbi, sizeof(mbi)) &&
+                (PBYTE)mbi.BaseAddress + mbi.RegionSize < pbEnd) {
+                pbEnd = (PBYTE)mbi.BaseAddress + mbi.RegionSize;
+            }
+        }
+        ULONG cPages = (ULONG)((pbEnd - pbPage) / DETOUR_CODE_PAGE_SIZE);
+
+        // Grow first, so a page is never left writable without a record.
+        if (s_cPendingPages + cPages > s_cPendingPagesMax) {
+            ULONG cPagesMax = s_cPendingPagesMax ? s_cPendingPagesMax * 2 : 16;
+            while (cPagesMax < s_cPendingPages + cPages) {
+                cPagesMax *= 2;
+            }
+            DetourPage *pPages = new NOTHROW DetourPage [cPagesMax];
+            if (pPages == NULL) {
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+            if (s_pPendingPages != NULL) {
+                CopyMemory(pPages, s_pPendingPages, s_cPendingPages * sizeof(DetourPage));
+                delete[] s_pPendingPages;
+            }
+            s_pPendingPages = pPages;
+            s_cPendingPagesMax = cPagesMax;
+        }
+
+        DWORD dwOld = 0;
+        if (!detour_protect(pbPage, pbEnd - pbPage, PAGE_EXECUTE_READWRITE, &dwOld)) {
+            return GetLastError();
+        }
+
+        MoveMemory(&s_pPendingPages[n + cPages], &s_pPendingPages[n],
+                   (s_cPendingPages - n) * sizeof(DetourPage));
+        for (ULONG i = 0; i < cPages; i++) {
+            s_pPendingPages[n + i].pbPage = pbPage + i * DETOUR_CODE_PAGE_SIZE;
+            s_pPendingPages[n + i].dwPerm = dwOld;
+        }
+        s_cPendingPages += cPages;
+        pbPage = pbEnd;
+    }
+    return NO_ERROR;
+}
+
+// Puts back the protection of every pending page, flushing if code changed.
+static void detour_restore_code_pages(BOOL fFlush)
+{
+    HANDLE hProcess = GetCurrentProcess();
+
+    for (ULONG n = 0; n < s_cPendingPages;) {
+        PBYTE pbBeg = s_pPendingPages[n].pbPage;
+        ULONG dwPerm = s_pPendingPages[n].dwPerm;
+        ULONG m = n + 1;
+        while (m < s_cPendingPages &&
+               s_pPendingPages[m].pbPage == s_pPendingPages[m - 1].pbPage + DETOUR_CODE_PAGE_SIZE &&
+               s_pPendingPages[m].dwPerm == dwPerm) {
+            m++;
+        }
+
+        // Adjacent pages of two modules are separate allocations, which
+        // VirtualProtect can't span; put those back a page at a time.  We
+        // don't care if this fails, because the code is still accessible.
+        DWORD dwOld;
+        if (!detour_protect(pbBeg, (m - n) * DETOUR_CODE_PAGE_SIZE, dwPerm, &dwOld)) {
+            for (ULONG i = n; i < m && m - n > 1; i++) {
+                detour_protect(s_pPendingPages[i].pbPage, DETOUR_CODE_PAGE_SIZE, dwPerm, &dwOld);
+            }
+        }
+        n = m;
+    }
+
+    if (fFlush) {
+        for (ULONG n = 0; n < s_cPendingPages;) {
+            ULONG m = n + 1;
+            while (m < s_cPendingPages &&
+                   s_pPendingPages[m].pbPage == s_pPendingPages[m - 1].pbPage + DETOUR_CODE_PAGE_SIZE) {
+                m++;
+            }
+            detour_flush(hProcess, s_pPendingPages[n].pbPage, (m - n) * DETOUR_CODE_PAGE_SIZE);
+            n = m;
+        }
+    }
+
+    s_cPendingPages = 0;
+}
+
 //////////////////////////////////////////////// Trampoline Memory Management.
 //
 struct DETOUR_REGION
 {
     ULONG               dwSignature;
+    ULONG               cFree;  // Number of trampolines on pFree.
     DETOUR_REGION *     pNext;  // Next region in list of regions.
     DETOUR_TRAMPOLINE * pFree;  // List of free trampolines in this region.
 };
@@ -1169,157 +1252,647 @@ const ULONG DETOUR_TRAMPOLINES_PER_REGION = (DETOUR_REGION_SIZE
                                              / sizeof(DETOUR_TRAMPOLINE)) - 1;
 static PDETOUR_REGION s_pRegions = NULL;            // List of all regions.
 static PDETOUR_REGION s_pRegion = NULL;             // Default region.
+static ULONG s_cEmptyRegions = 0;                   // Regions with no live trampolines.
+static DETOUR_TRAMPOLINE_STATS s_TrampolineStats = { 0 };
 
-static DWORD detour_writable_trampoline_regions()
+//  Regions sorted by address.  s_AllRegions holds every region and maps a
+//  pointer back to its region; s_FreeRegions holds only the regions with a
+//  free trampoline, so allocation is a binary search for the first region at
+//  or above the low jump bound instead of a walk of every region.
+//
+struct DETOUR_REGION_INDEX
 {
-    // Mark all of the regions as writable.
-    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
-        DWORD dwOld;
-        if (!VirtualProtect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READWRITE, &dwOld)) {
-            return GetLastError();
+    PDETOUR_REGION *    ppRegions;
+    ULONG               cRegions;
+    ULONG               cRegionsMax;
+};
+
+static DETOUR_REGION_INDEX s_AllRegions = { NULL, 0, 0 };
+static DETOUR_REGION_INDEX s_FreeRegions = { NULL, 0, 0 };
+
+// Returns the position of the first region at or above pbLo.
+static ULONG detour_region_index_lower_bound(DETOUR_REGION_INDEX *pIndex, PBYTE pbLo)
+{
+    ULONG nLo = 0;
+    ULONG nHi = pIndex->cRegions;
+    while (nLo < nHi) {
+        ULONG nMid = nLo + (nHi - nLo) / 2;
+        if ((PBYTE)pIndex->ppRegions[nMid] < pbLo) {
+            nLo = nMid + 1;
+        }
+        else {
+            nHi = nMid;
         }
     }
-    return NO_ERROR;
+    return nLo;
 }
 
-static void detour_runnable_trampoline_regions()
+static BOOL detour_region_index_insert(DETOUR_REGION_INDEX *pIndex, PDETOUR_REGION pRegion)
 {
-    HANDLE hProcess = GetCurrentProcess();
-
-    // Mark all of the regions as executable.
-    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
-        DWORD dwOld;
-        VirtualProtect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READ, &dwOld);
-        FlushInstructionCache(hProcess, pRegion, DETOUR_REGION_SIZE);
+    if (pIndex->cRegions == pIndex->cRegionsMax) {
+        ULONG cRegionsMax = pIndex->cRegionsMax ? pIndex->cRegionsMax * 2 : 16;
+        PDETOUR_REGION *ppRegions = new NOTHROW PDETOUR_REGION [cRegionsMax];
+        if (ppRegions == NULL) {
+            return FALSE;
+        }
+        if (pIndex->ppRegions != NULL) {
+            CopyMemory(ppRegions, pIndex->ppRegions,
+                       pIndex->cRegions * sizeof(PDETOUR_REGION));
+            delete[] pIndex->ppRegions;
+        }
+        pIndex->ppRegions = ppRegions;
+        pIndex->cRegionsMax = cRegionsMax;
     }
+
+    ULONG n = detour_region_index_lower_bound(pIndex, (PBYTE)pRegion);
+    MoveMemory(&pIndex->ppRegions[n + 1], &pIndex->ppRegions[n],
+               (pIndex->cRegions - n) * sizeof(PDETOUR_REGION));
+    pIndex->ppRegions[n] = pRegion;
+    pIndex->cRegions++;
+    return TRUE;
 }
 
-static PBYTE detour_alloc_round_down_to_region(PBYTE pbTry)
+static void detour_region_index_remove(DETOUR_REGION_INDEX *pIndex, PDETOUR_REGION pRegion)
 {
-    // WinXP64 returns free areas that aren't REGION aligned to 32-bit applications.
-    ULONG_PTR extra = ((ULONG_PTR)pbTry) & (DETOUR_REGION_SIZE - 1);
-    if (extra != 0) {
-        pbTry -= extra;
+    ULONG n = detour_region_index_lower_bound(pIndex, (PBYTE)pRegion);
+    if (n < pIndex->cRegions && pIndex->ppRegions[n] == pRegion) {
+        pIndex->cRegions--;
+        MoveMemory(&pIndex->ppRegions[n], &pIndex->ppRegions[n + 1],
+                   (pIndex->cRegions - n) * sizeof(PDETOUR_REGION));
     }
-    return pbTry;
 }
 
-static PBYTE detour_alloc_round_up_to_region(PBYTE pbTry)
+// Returns the region containing pbPointer, or NULL.
+static PDETOUR_REGION detour_region_index_find(DETOUR_REGION_INDEX *pIndex, PBYTE pbPointer)
 {
-    // WinXP64 returns free areas that aren't REGION aligned to 32-bit applications.
-    ULONG_PTR extra = ((ULONG_PTR)pbTry) & (DETOUR_REGION_SIZE - 1);
-    if (extra != 0) {
-        ULONG_PTR adjust = DETOUR_REGION_SIZE - extra;
-        pbTry += adjust;
+    ULONG n = detour_region_index_lower_bound(pIndex, pbPointer - (DETOUR_REGION_SIZE - 1));
+    if (n < pIndex->cRegions && (PBYTE)pIndex->ppRegions[n] <= pbPointer) {
+        return pIndex->ppRegions[n];
     }
-    return pbTry;
+    return NULL;
 }
 
-// Starting at pbLo, try to allocate a memory region, continue until pbHi.
+static BOOL detour_region_has_free_in_bounds(PDETOUR_REGION pRegion,
+                                             PDETOUR_TRAMPOLINE pLo,
+                                             PDETOUR_TRAMPOLINE pHi)
+{
+    // Every trampoline of the region must be in bounds, since any of them
+    // may be at the head of the free list.
+    return (pRegion != NULL && pRegion->pFree != NULL &&
+            (PBYTE)pRegion >= (PBYTE)pLo &&
+            (PBYTE)pRegion + DETOUR_REGION_SIZE - sizeof(DETOUR_TRAMPOLINE) <= (PBYTE)pHi);
+}
 
-static PVOID detour_alloc_region_from_lo(PBYTE pbLo, PBYTE pbHi)
+/////////////////////////////////////////////////////////////// Code Caves.
+//
+//  Before a region is probed for, detour_alloc_trampoline looks for room in
+//  the target's own module: the slack between the end of an executable
+//  section and the end of its last page, and long runs of int3 or nop
+//  padding between functions.  Each module is scanned once, the first time
+//  a target in it is hooked.  Cave pages are made writable only while a
+//  transaction uses them, like the target's own pages, and a freed cave gets
+//  its filler back.  Off unless DetourSetCodeCaves turns it on: a cave is
+//  part of the module, so its trampoline goes away if the module unloads.
+//
+static BOOL s_fCodeCaves = FALSE;
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+
+const ULONG DETOUR_CAVE_SIZE = (sizeof(DETOUR_TRAMPOLINE) + 15) & ~15;
+//  Leave the start of a padding run alone: DetourAttach consumes padding
+//  after a function too short for its jmp.
+const ULONG DETOUR_CAVE_MARGIN = 16;
+
+struct DETOUR_CAVE
 {
-    PBYTE pbTry = detour_alloc_round_up_to_region(pbLo);
+    PBYTE               pbCave;
+    BYTE                bFill;          // Byte the cave held before it was used.
+    BYTE                fUsed;
+};
 
-    DETOUR_TRACE((" Looking for free region in %p..%p from %p:\n", pbLo, pbHi, pbTry));
+struct DETOUR_CAVE_MODULE
+{
+    PBYTE                   pbModule;
+    PBYTE                   pbModuleLim;
+    DETOUR_CAVE_MODULE *    pNext;
+    DETOUR_CAVE *           pCaves;     // Sorted by address.
+    ULONG                   cCaves;
+    ULONG                   cFree;
+};
+typedef DETOUR_CAVE_MODULE * PDETOUR_CAVE_MODULE;
 
-    for (; pbTry < pbHi;) {
-        MEMORY_BASIC_INFORMATION mbi;
+static PDETOUR_CAVE_MODULE s_pCaveModules = NULL;
 
-        if (pbTry >= s_pSystemRegionLowerBound && pbTry <= s_pSystemRegionUpperBound) {
-            // Skip region reserved for system DLLs, but preserve address space entropy.
-            pbTry += 0x08000000;
-            continue;
+// Splits [pbBeg, pbEnd) into caves; only counts them when pCaves is NULL.
+static ULONG detour_carve_caves(PBYTE pbBeg, PBYTE pbEnd, BYTE bFill,
+                                DETOUR_CAVE *pCaves, ULONG cCaves)
+{
+    PBYTE pbCave = (PBYTE)(((ULONG_PTR)pbBeg + DETOUR_CAVE_MARGIN + 15) & ~(ULONG_PTR)15);
+    for (; pbCave + DETOUR_CAVE_SIZE <= pbEnd; pbCave += DETOUR_CAVE_SIZE) {
+        if (pCaves != NULL) {
+            pCaves[cCaves].pbCave = pbCave;
+            pCaves[cCaves].bFill = bFill;
+            pCaves[cCaves].fUsed = FALSE;
         }
+        cCaves++;
+    }
+    return cCaves;
+}
 
-        ZeroMemory(&mbi, sizeof(mbi));
-        if (!VirtualQuery(pbTry, &mbi, sizeof(mbi))) {
-            break;
+#ifdef _WIN32
+static ULONG detour_find_code_caves(PBYTE pbModule, DETOUR_CAVE *pCaves)
+{
+    ULONG cCaves = 0;
+    __try {
+        PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)pbModule;
+        if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
+            return 0;
+        }
+        PIMAGE_NT_HEADERS pNtHeader = (PIMAGE_NT_HEADERS)(pbModule + pDosHeader->e_lfanew);
+        if (pNtHeader->Signature != IMAGE_NT_SIGNATURE) {
+            return 0;
         }
 
-        DETOUR_TRACE(("  Try %p => %p..%p %6x\n",
-                      pbTry,
-                      mbi.BaseAddress,
-                      (PBYTE)mbi.BaseAddress + mbi.RegionSize - 1,
-                      mbi.State));
+        PIMAGE_SECTION_HEADER pSection = IMAGE_FIRST_SECTION(pNtHeader);
+        for (WORD n = 0; n < pNtHeader->FileHeader.NumberOfSections; n++, pSection++) {
+            if (!(pSection->Characteristics & IMAGE_SCN_MEM_EXECUTE)) {
+                continue;
+            }
 
-        if (mbi.State == MEM_FREE && mbi.RegionSize >= DETOUR_REGION_SIZE) {
+            PBYTE pbBeg = pbModule + pSection->VirtualAddress;
+            PBYTE pbEnd = pbBeg + pSection->Misc.VirtualSize;
 
-            PVOID pv = VirtualAlloc(pbTry,
-                                    DETOUR_REGION_SIZE,
-                                    MEM_COMMIT|MEM_RESERVE,
-                                    PAGE_EXECUTE_READWRITE);
-            if (pv != NULL) {
-                return pv;
+            // Long runs of a single int3 or nop byte.
+            for (PBYTE pbRun = pbBeg; pbRun < pbEnd;) {
+                PBYTE pbRunEnd = pbRun + 1;
+                while (pbRunEnd < pbEnd && *pbRunEnd == *pbRun) {
+                    pbRunEnd++;
+                }
+                if (pbRunEnd - pbRun >= (LONG_PTR)(DETOUR_CAVE_MARGIN + DETOUR_CAVE_SIZE) &&
+                    detour_is_code_filler(pbRun) == 1) {
+                    cCaves = detour_carve_caves(pbRun, pbRunEnd, *pbRun, pCaves, cCaves);
+                }
+                pbRun = pbRunEnd;
             }
-            else if (GetLastError() == ERROR_DYNAMIC_CODE_BLOCKED) {
-                return NULL;
+
+            // The zero-filled rest of the section's last page.  Sections
+            // packed tighter than a page share it with the next section.
+            if (pNtHeader->OptionalHeader.SectionAlignment >= DETOUR_CODE_PAGE_SIZE) {
+                PBYTE pbLim = (PBYTE)(((ULONG_PTR)pbEnd + DETOUR_CODE_PAGE_SIZE - 1) &
+                                      ~(ULONG_PTR)(DETOUR_CODE_PAGE_SIZE - 1));
+                cCaves = detour_carve_caves(pbEnd, pbLim, 0, pCaves, cCaves);
             }
-            pbTry += DETOUR_REGION_SIZE;
-        }
-        else {
-            pbTry = detour_alloc_round_up_to_region((PBYTE)mbi.BaseAddress + mbi.RegionSize);
         }
     }
-    return NULL;
+#pragma prefast(suppress:28940, "A bad pointer means this probably isn't a PE header.")
+    __except(GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION ?
+             EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return 0;
+    }
+    return cCaves;
 }
 
-// Starting at pbHi, try to allocate a memory region, continue until pbLo.
-
-static PVOID detour_alloc_region_from_hi(PBYTE pbLo, PBYTE pbHi)
+static PBYTE detour_image_limit(PBYTE pbModule)
 {
-    PBYTE pbTry = detour_alloc_round_down_to_region(pbHi - DETOUR_REGION_SIZE);
-
-    DETOUR_TRACE((" Looking for free region in %p..%p from %p:\n", pbLo, pbHi, pbTry));
-
-    for (; pbTry > pbLo;) {
-        MEMORY_BASIC_INFORMATION mbi;
+    PIMAGE_NT_HEADERS pNtHeader =
+        (PIMAGE_NT_HEADERS)(pbModule + ((PIMAGE_DOS_HEADER)pbModule)->e_lfanew);
+    return pbModule + pNtHeader->OptionalHeader.SizeOfImage;
+}
+#else // !_WIN32
+//  pbModule is the file's mapping at offset 0, so the ELF and program
+//  headers are readable there.  Returns the program headers and the load
+//  bias, or NULL if pbModule isn't an ELF image.
+//
+static const Elf64_Phdr * detour_elf_program_headers(PBYTE pbModule,
+                                                     ULONG *pcHeaders,
+                                                     PBYTE *ppbBias)
+{
+    const Elf64_Ehdr *pHeader = (const Elf64_Ehdr *)pbModule;
+    if (memcmp(pHeader->e_ident, ELFMAG, SELFMAG) != 0 ||
+        pHeader->e_ident[EI_CLASS] != ELFCLASS64 ||
+        pHeader->e_phentsize != sizeof(Elf64_Phdr) ||
+        pHeader->e_phoff + (ULONG_PTR)pHeader->e_phnum * sizeof(Elf64_Phdr) >
+        DETOUR_CODE_PAGE_SIZE) {
+        return NULL;
+    }
 
-        DETOUR_TRACE(("  Try %p\n", pbTry));
-        if (pbTry >= s_pSystemRegionLowerBound && pbTry <= s_pSystemRegionUpperBound) {
-            // Skip region reserved for system DLLs, but preserve address space entropy.
-            pbTry -= 0x08000000;
-            continue;
+    const Elf64_Phdr *pPhdrs = (const Elf64_Phdr *)(pbModule + pHeader->e_phoff);
+    ULONG_PTR nLowest = ~(ULONG_PTR)0;
+    for (ULONG n = 0; n < pHeader->e_phnum; n++) {
+        if (pPhdrs[n].p_type == PT_LOAD && pPhdrs[n].p_vaddr < nLowest) {
+            nLowest = pPhdrs[n].p_vaddr;
         }
+    }
+    if (nLowest == ~(ULONG_PTR)0) {
+        return NULL;
+    }
 
-        ZeroMemory(&mbi, sizeof(mbi));
-        if (!VirtualQuery(pbTry, &mbi, sizeof(mbi))) {
-            break;
-        }
+    *pcHeaders = pHeader->e_phnum;
+    *ppbBias = pbModule - (nLowest & ~(ULONG_PTR)(DETOUR_CODE_PAGE_SIZE - 1));
+    return pPhdrs;
+}
 
-        DETOUR_TRACE(("  Try %p => %p..%p %6x\n",
-                      pbTry,
-                      mbi.BaseAddress,
-                      (PBYTE)mbi.BaseAddress + mbi.RegionSize - 1,
-                      mbi.State));
+//  Only runs of int3 or nop: the rest of an executable segment's last page
+//  maps whatever follows it in the file.
+//
+static ULONG detour_find_code_caves(PBYTE pbModule, DETOUR_CAVE *pCaves)
+{
+    ULONG cHeaders = 0;
+    PBYTE pbBias = NULL;
+    const Elf64_Phdr *pPhdrs = detour_elf_program_headers(pbModule, &cHeaders, &pbBias);
+    if (pPhdrs == NULL) {
+        return 0;
+    }
 
-        if (mbi.State == MEM_FREE && mbi.RegionSize >= DETOUR_REGION_SIZE) {
+    ULONG cCaves = 0;
+    for (ULONG n = 0; n < cHeaders; n++) {
+        if (pPhdrs[n].p_type != PT_LOAD || !(pPhdrs[n].p_flags & PF_X)) {
+            continue;
+        }
 
-            PVOID pv = VirtualAlloc(pbTry,
-                                    DETOUR_REGION_SIZE,
-                                    MEM_COMMIT|MEM_RESERVE,
-                                    PAGE_EXECUTE_READWRITE);
-            if (pv != NULL) {
-                return pv;
+        PBYTE pbBeg = pbBias + pPhdrs[n].p_vaddr;
+        PBYTE pbEnd = pbBeg + pPhdrs[n].p_filesz;
+        for (PBYTE pbRun = pbBeg; pbRun < pbEnd;) {
+            PBYTE pbRunEnd = pbRun + 1;
+            while (pbRunEnd < pbEnd && *pbRunEnd == *pbRun) {
+                pbRunEnd++;
             }
-            else if (GetLastError() == ERROR_DYNAMIC_CODE_BLOCKED) {
-                return NULL;
+            if (pbRunEnd - pbRun >= (LONG_PTR)(DETOUR_CAVE_MARGIN + DETOUR_CAVE_SIZE) &&
+                detour_is_code_filler(pbRun) == 1) {
+                cCaves = detour_carve_caves(pbRun, pbRunEnd, *pbRun, pCaves, cCaves);
             }
-            pbTry -= DETOUR_REGION_SIZE;
-        }
-        else {
-            pbTry = detour_alloc_round_down_to_region((PBYTE)mbi.AllocationBase
-                                                      - DETOUR_REGION_SIZE);
+            pbRun = pbRunEnd;
         }
     }
-    return NULL;
+    return cCaves;
 }
 
-static PVOID detour_alloc_trampoline_allocate_new(PBYTE pbTarget,
-                                                  PDETOUR_TRAMPOLINE pLo,
-                                                  PDETOUR_TRAMPOLINE pHi)
+static PBYTE detour_image_limit(PBYTE pbModule)
 {
-    PVOID pbTry = NULL;
+    ULONG cHeaders = 0;
+    PBYTE pbBias = NULL;
+    const Elf64_Phdr *pPhdrs = detour_elf_program_headers(pbModule, &cHeaders, &pbBias);
+
+    PBYTE pbLimit = pbModule;
+    for (ULONG n = 0; n < cHeaders; n++) {
+        if (pPhdrs[n].p_type == PT_LOAD &&
+            pbBias + pPhdrs[n].p_vaddr + pPhdrs[n].p_memsz > pbLimit) {
+            pbLimit = pbBias + pPhdrs[n].p_vaddr + pPhdrs[n].p_memsz;
+        }
+    }
+    return pbLimit;
+}
+#endif // !_WIN32
+
+static PDETOUR_CAVE_MODULE detour_cave_module_from_pointer(PBYTE pbPointer)
+{
+    for (PDETOUR_CAVE_MODULE pModule = s_pCaveModules; pModule != NULL; pModule = pModule->pNext) {
+        if (pbPointer >= pModule->pbModule && pbPointer < pModule->pbModuleLim) {
+            return pModule;
+        }
+    }
+    return NULL;
+}
+
+// Returns the cave containing pbPointer, or NULL.
+static DETOUR_CAVE * detour_cave_from_pointer(PBYTE pbPointer)
+{
+    PDETOUR_CAVE_MODULE pModule = detour_cave_module_from_pointer(pbPointer);
+    if (pModule == NULL) {
+        return NULL;
+    }
+
+    ULONG nLo = 0;
+    ULONG nHi = pModule->cCaves;
+    while (nLo < nHi) {
+        ULONG nMid = nLo + (nHi - nLo) / 2;
+        if (pModule->pCaves[nMid].pbCave + DETOUR_CAVE_SIZE <= pbPointer) {
+            nLo = nMid + 1;
+        }
+        else {
+            nHi = nMid;
+        }
+    }
+    if (nLo < pModule->cCaves && pModule->pCaves[nLo].pbCave <= pbPointer) {
+        return &pModule->pCaves[nLo];
+    }
+    return NULL;
+}
+
+static PDETOUR_CAVE_MODULE detour_scan_cave_module(PBYTE pbTarget)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    ZeroMemory(&mbi, sizeof(mbi));
+    s_TrampolineStats.cCaveProbes++;
+    if (!VirtualQuery(pbTarget, &mbi, sizeof(mbi)) || mbi.Type != MEM_IMAGE) {
+        return NULL;
+    }
+
+    PBYTE pbModule = (PBYTE)mbi.AllocationBase;
+    ULONG cCaves = detour_find_code_caves(pbModule, NULL);
+
+    PDETOUR_CAVE_MODULE pModule = new NOTHROW DETOUR_CAVE_MODULE;
+    if (pModule == NULL) {
+        return NULL;
+    }
+    pModule->pCaves = NULL;
+    if (cCaves != 0) {
+        pModule->pCaves = new NOTHROW DETOUR_CAVE [cCaves];
+        if (pModule->pCaves == NULL) {
+            delete pModule;
+            return NULL;
+        }
+        cCaves = detour_find_code_caves(pbModule, pModule->pCaves);
+    }
+
+    // Keep modules without caves too, so they aren't scanned again.
+    pModule->pbModule = pbModule;
+    pModule->pbModuleLim = detour_image_limit(pbModule);
+    if (pModule->pbModuleLim < (PBYTE)mbi.BaseAddress + mbi.RegionSize) {
+        pModule->pbModuleLim = (PBYTE)mbi.BaseAddress + mbi.RegionSize;
+    }
+    pModule->cCaves = cCaves;
+    pModule->cFree = cCaves;
+    pModule->pNext = s_pCaveModules;
+    s_pCaveModules = pModule;
+    s_TrampolineStats.cCaveModules++;
+
+    DETOUR_TRACE(("  Module %p has %d code caves\n", pbModule, cCaves));
+    return pModule;
+}
+
+//  A record outlives its module: check the image is still the one that was
+//  scanned before touching any of its caves.
+//
+static BOOL detour_is_cave_module_mapped(PDETOUR_CAVE_MODULE pModule)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    ZeroMemory(&mbi, sizeof(mbi));
+    s_TrampolineStats.cCaveProbes++;
+    if (!VirtualQuery(pModule->pbModule, &mbi, sizeof(mbi)) ||
+        mbi.Type != MEM_IMAGE || mbi.AllocationBase != pModule->pbModule) {
+        return FALSE;
+    }
+
+    PBYTE pbLimit = detour_image_limit(pModule->pbModule);
+    if (pbLimit < (PBYTE)mbi.BaseAddress + mbi.RegionSize) {
+        pbLimit = (PBYTE)mbi.BaseAddress + mbi.RegionSize;
+    }
+    return pbLimit == pModule->pbModuleLim;
+}
+
+static void detour_drop_cave_module(PDETOUR_CAVE_MODULE pModule)
+{
+    PDETOUR_CAVE_MODULE *ppModule = &s_pCaveModules;
+    while (*ppModule != pModule) {
+        ppModule = &(*ppModule)->pNext;
+    }
+    *ppModule = pModule->pNext;
+    delete[] pModule->pCaves;
+    delete pModule;
+}
+
+static PDETOUR_TRAMPOLINE detour_alloc_cave_trampoline(PBYTE pbTarget,
+                                                       PDETOUR_TRAMPOLINE pLo,
+                                                       PDETOUR_TRAMPOLINE pHi)
+{
+    PDETOUR_CAVE_MODULE pModule = detour_cave_module_from_pointer(pbTarget);
+    if (pModule != NULL && !detour_is_cave_module_mapped(pModule)) {
+        // Trampolines still in the old caves were lost with the module, but
+        // their frees must keep finding the record, so it stays until then.
+        if (pModule->cFree != pModule->cCaves) {
+            return NULL;
+        }
+        detour_drop_cave_module(pModule);
+        pModule = NULL;
+    }
+    if (pModule == NULL) {
+        pModule = detour_scan_cave_module(pbTarget);
+        if (pModule == NULL) {
+            return NULL;
+        }
+    }
+
+    for (ULONG n = 0; n < pModule->cCaves && pModule->cFree != 0; n++) {
+        DETOUR_CAVE *pCave = &pModule->pCaves[n];
+        if (pCave->fUsed ||
+            pCave->pbCave < (PBYTE)pLo || pCave->pbCave > (PBYTE)pHi) {
+            continue;
+        }
+
+        // Skip caves whose filler changed since the scan, e.g. a module
+        // unloaded and another one loaded at the same address.
+        PBYTE pb = pCave->pbCave;
+        while (pb < pCave->pbCave + DETOUR_CAVE_SIZE && *pb == pCave->bFill) {
+            pb++;
+        }
+        if (pb < pCave->pbCave + DETOUR_CAVE_SIZE ||
+            detour_writable_code(pCave->pbCave, DETOUR_CAVE_SIZE) != NO_ERROR) {
+            continue;
+        }
+
+        pCave->fUsed = TRUE;
+        pModule->cFree--;
+        s_TrampolineStats.cCaveTrampolines++;
+
+        PDETOUR_TRAMPOLINE pTrampoline = (PDETOUR_TRAMPOLINE)pCave->pbCave;
+        memset(pTrampoline, 0xcc, sizeof(*pTrampoline));
+        return pTrampoline;
+    }
+    return NULL;
+}
+
+static BOOL detour_free_cave_trampoline(PDETOUR_TRAMPOLINE pTrampoline)
+{
+    DETOUR_CAVE *pCave = detour_cave_from_pointer((PBYTE)pTrampoline);
+    if (pCave == NULL || pCave->pbCave != (PBYTE)pTrampoline) {
+        return FALSE;
+    }
+
+    // Freed inside a transaction, so the cave is normally still writable.
+    PDETOUR_CAVE_MODULE pModule = detour_cave_module_from_pointer(pCave->pbCave);
+    if (detour_is_cave_module_mapped(pModule) &&
+        detour_writable_code(pCave->pbCave, DETOUR_CAVE_SIZE) == NO_ERROR) {
+        memset(pCave->pbCave, pCave->bFill, DETOUR_CAVE_SIZE);
+    }
+    pCave->fUsed = FALSE;
+    pModule->cFree++;
+    return TRUE;
+}
+
+#else // !DETOURS_X86 && !DETOURS_X64
+
+static PDETOUR_TRAMPOLINE detour_alloc_cave_trampoline(PBYTE pbTarget,
+                                                       PDETOUR_TRAMPOLINE pLo,
+                                                       PDETOUR_TRAMPOLINE pHi)
+{
+    (void)pbTarget;
+    (void)pLo;
+    (void)pHi;
+    return NULL;
+}
+
+static BOOL detour_free_cave_trampoline(PDETOUR_TRAMPOLINE pTrampoline)
+{
+    (void)pTrampoline;
+    return FALSE;
+}
+
+#endif // DETOURS_X86 || DETOURS_X64
+
+static DWORD detour_writable_trampoline_regions()
+{
+    // Mark all of the regions as writable.
+    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
+        DWORD dwOld;
+        if (!detour_protect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READWRITE, &dwOld)) {
+            return GetLastError();
+        }
+    }
+    return NO_ERROR;
+}
+
+static void detour_runnable_trampoline_regions()
+{
+    HANDLE hProcess = GetCurrentProcess();
+
+    // Mark all of the regions as executable.  Each region is its own
+    // allocation, and VirtualProtect can't span allocations.
+    for (PDETOUR_REGION pRegion = s_pRegions; pRegion != NULL; pRegion = pRegion->pNext) {
+        DWORD dwOld;
+        detour_protect(pRegion, DETOUR_REGION_SIZE, PAGE_EXECUTE_READ, &dwOld);
+        detour_flush(hProcess, pRegion, DETOUR_REGION_SIZE);
+    }
+}
+
+static PBYTE detour_alloc_round_down_to_region(PBYTE pbTry)
+{
+    // WinXP64 returns free areas that aren't REGION aligned to 32-bit applications.
+    ULONG_PTR extra = ((ULONG_PTR)pbTry) & (DETOUR_REGION_SIZE - 1);
+    if (extra != 0) {
+        pbTry -= extra;
+    }
+    return pbTry;
+}
+
+static PBYTE detour_alloc_round_up_to_region(PBYTE pbTry)
+{
+    // WinXP64 returns free areas that aren't REGION aligned to 32-bit applications.
+    ULONG_PTR extra = ((ULONG_PTR)pbTry) & (DETOUR_REGION_SIZE - 1);
+    if (extra != 0) {
+        ULONG_PTR adjust = DETOUR_REGION_SIZE - extra;
+        pbTry += adjust;
+    }
+    return pbTry;
+}
+
+// Starting at pbLo, try to allocate a memory region, continue until pbHi.
+
+static PVOID detour_alloc_region_from_lo(PBYTE pbLo, PBYTE pbHi)
+{
+    PBYTE pbTry = detour_alloc_round_up_to_region(pbLo);
+
+    DETOUR_TRACE((" Looking for free region in %p..%p from %p:\n", pbLo, pbHi, pbTry));
+
+    for (; pbTry < pbHi;) {
+        MEMORY_BASIC_INFORMATION mbi;
+
+        if (pbTry >= s_pSystemRegionLowerBound && pbTry <= s_pSystemRegionUpperBound) {
+            // Skip region reserved for system DLLs, but preserve address space entropy.
+            pbTry += 0x08000000;
+            continue;
+        }
+
+        ZeroMemory(&mbi, sizeof(mbi));
+        s_TrampolineStats.cRegionProbes++;
+        if (!VirtualQuery(pbTry, &mbi, sizeof(mbi))) {
+            break;
+        }
+
+        DETOUR_TRACE(("  Try %p => %p..%p %6x\n",
+                      pbTry,
+                      mbi.BaseAddress,
+                      (PBYTE)mbi.BaseAddress + mbi.RegionSize - 1,
+                      mbi.State));
+
+        if (mbi.State == MEM_FREE && mbi.RegionSize >= DETOUR_REGION_SIZE) {
+
+            PVOID pv = VirtualAlloc(pbTry,
+                                    DETOUR_REGION_SIZE,
+                                    MEM_COMMIT|MEM_RESERVE,
+                                    PAGE_EXECUTE_READWRITE);
+            if (pv != NULL) {
+                return pv;
+            }
+            else if (GetLastError() == ERROR_DYNAMIC_CODE_BLOCKED) {
+                return NULL;
+            }
+            pbTry += DETOUR_REGION_SIZE;
+        }
+        else {
+            pbTry = detour_alloc_round_up_to_region((PBYTE)mbi.BaseAddress + mbi.RegionSize);
+        }
+    }
+    return NULL;
+}
+
+// Starting at pbHi, try to allocate a memory region, continue until pbLo.
+
+static PVOID detour_alloc_region_from_hi(PBYTE pbLo, PBYTE pbHi)
+{
+    PBYTE pbTry = detour_alloc_round_down_to_region(pbHi - DETOUR_REGION_SIZE);
+
+    DETOUR_TRACE((" Looking for free region in %p..%p from %p:\n", pbLo, pbHi, pbTry));
+
+    for (; pbTry > pbLo;) {
+        MEMORY_BASIC_INFORMATION mbi;
+
+        DETOUR_TRACE(("  Try %p\n", pbTry));
+        if (pbTry >= s_pSystemRegionLowerBound && pbTry <= s_pSystemRegionUpperBound) {
+            // Skip region reserved for system DLLs, but preserve address space entropy.
+            pbTry -= 0x08000000;
+            continue;
+        }
+
+        ZeroMemory(&mbi, sizeof(mbi));
+        s_TrampolineStats.cRegionProbes++;
+        if (!VirtualQuery(pbTry, &mbi, sizeof(mbi))) {
+            break;
+        }
+
+        DETOUR_TRACE(("  Try %p => %p..%p %6x\n",
+                      pbTry,
+                      mbi.BaseAddress,
+                      (PBYTE)mbi.BaseAddress + mbi.RegionSize - 1,
+                      mbi.State));
+
+        if (mbi.State == MEM_FREE && mbi.RegionSize >= DETOUR_REGION_SIZE) {
+
+            PVOID pv = VirtualAlloc(pbTry,
+                                    DETOUR_REGION_SIZE,
+                                    MEM_COMMIT|MEM_RESERVE,
+                                    PAGE_EXECUTE_READWRITE);
+            if (pv != NULL) {
+                return pv;
+            }
+            else if (GetLastError() == ERROR_DYNAMIC_CODE_BLOCKED) {
+                return NULL;
+            }
+            pbTry -= DETOUR_REGION_SIZE;
+        }
+        else {
+            pbTry = detour_alloc_round_down_to_region((PBYTE)mbi.AllocationBase
+                                                      - DETOUR_REGION_SIZE);
+        }
+    }
+    return NULL;
+}
+
+static PVOID detour_alloc_trampoline_allocate_new(PBYTE pbTarget,
+                                                  PDETOUR_TRAMPOLINE pLo,
+                                                  PDETOUR_TRAMPOLINE pHi)
+{
+    PVOID pbTry = NULL;
 
     // NB: We must always also start the search at an offset from pbTarget
     //     in order to maintain ASLR entropy.
@@ -1384,74 +1957,106 @@ static PDETOUR_TRAMPOLINE detour_alloc_trampoline(PBYTE pbTarget)
     detour_find_jmp_bounds(pbTarget, &pLo, &pHi);
 
     PDETOUR_TRAMPOLINE pTrampoline = NULL;
+    PDETOUR_REGION pRegion = NULL;
 
-    // Insure that there is a default region.
-    if (s_pRegion == NULL && s_pRegions != NULL) {
-        s_pRegion = s_pRegions;
-    }
-
-    // First check the default region for an valid free block.
-    if (s_pRegion != NULL && s_pRegion->pFree != NULL &&
-        s_pRegion->pFree >= pLo && s_pRegion->pFree <= pHi) {
-
-      found_region:
-        pTrampoline = s_pRegion->pFree;
-        // do a last sanity check on region.
-        if (pTrampoline < pLo || pTrampoline > pHi) {
-            return NULL;
+    // Padding in the target's own module costs no new memory.
+    if (s_fCodeCaves) {
+        pTrampoline = detour_alloc_cave_trampoline(pbTarget, pLo, pHi);
+        if (pTrampoline != NULL) {
+            return pTrampoline;
         }
-        s_pRegion->pFree = (PDETOUR_TRAMPOLINE)pTrampoline->pbRemain;
-        memset(pTrampoline, 0xcc, sizeof(*pTrampoline));
-        return pTrampoline;
     }
 
-    // Then check the existing regions for a valid free block.
-    for (s_pRegion = s_pRegions; s_pRegion != NULL; s_pRegion = s_pRegion->pNext) {
-        if (s_pRegion != NULL && s_pRegion->pFree != NULL &&
-            s_pRegion->pFree >= pLo && s_pRegion->pFree <= pHi) {
-            goto found_region;
+    // First check the default region for an valid free block, then the
+    // lowest region with a free block above pLo.  Regions are never split by
+    // the bounds, so if that region doesn't end below pHi none will.
+    if (detour_region_has_free_in_bounds(s_pRegion, pLo, pHi)) {
+        pRegion = s_pRegion;
+    }
+    else {
+        ULONG n = detour_region_index_lower_bound(&s_FreeRegions, (PBYTE)pLo);
+        if (n < s_FreeRegions.cRegions &&
+            detour_region_has_free_in_bounds(s_FreeRegions.ppRegions[n], pLo, pHi)) {
+            pRegion = s_FreeRegions.ppRegions[n];
         }
     }
 
-    // We need to allocate a new region.
+    if (pRegion == NULL) {
+        // We need to allocate a new region.
 
-    // Round pbTarget down to 64KB block.
-    pbTarget = pbTarget - (PtrToUlong(pbTarget) & 0xffff);
+        // Round pbTarget down to 64KB block.
+        pbTarget = pbTarget - (PtrToUlong(pbTarget) & 0xffff);
 
-    PVOID pbNewlyAllocated =
-        detour_alloc_trampoline_allocate_new(pbTarget, pLo, pHi);
-    if (pbNewlyAllocated != NULL) {
-        s_pRegion = (DETOUR_REGION*)pbNewlyAllocated;
-        s_pRegion->dwSignature = DETOUR_REGION_SIGNATURE;
-        s_pRegion->pFree = NULL;
-        s_pRegion->pNext = s_pRegions;
-        s_pRegions = s_pRegion;
+        PVOID pbNewlyAllocated =
+            detour_alloc_trampoline_allocate_new(pbTarget, pLo, pHi);
+        if (pbNewlyAllocated == NULL) {
+            DETOUR_TRACE(("Couldn't find available memory region!\n"));
+            return NULL;
+        }
+
+        s_TrampolineStats.cRegionsAllocated++;
+        pRegion = (DETOUR_REGION*)pbNewlyAllocated;
+        if (!detour_region_index_insert(&s_AllRegions, pRegion)) {
+            VirtualFree(pRegion, 0, MEM_RELEASE);
+            return NULL;
+        }
+        if (!detour_region_index_insert(&s_FreeRegions, pRegion)) {
+            detour_region_index_remove(&s_AllRegions, pRegion);
+            VirtualFree(pRegion, 0, MEM_RELEASE);
+            return NULL;
+        }
+
+        pRegion->dwSignature = DETOUR_REGION_SIGNATURE;
+        pRegion->pNext = s_pRegions;
+        s_pRegions = pRegion;
         DETOUR_TRACE(("  Allocated region %p..%p\n\n",
-                      s_pRegion, ((PBYTE)s_pRegion) + DETOUR_REGION_SIZE - 1));
+                      pRegion, ((PBYTE)pRegion) + DETOUR_REGION_SIZE - 1));
 
-        // Put everything but the first trampoline on the free list.
+        // Put every trampoline after the region header on the free list.
         PBYTE pFree = NULL;
-        pTrampoline = ((PDETOUR_TRAMPOLINE)s_pRegion) + 1;
-        for (int i = DETOUR_TRAMPOLINES_PER_REGION - 1; i > 1; i--) {
+        pTrampoline = ((PDETOUR_TRAMPOLINE)pRegion) + 1;
+        for (int i = DETOUR_TRAMPOLINES_PER_REGION - 1; i >= 0; i--) {
             pTrampoline[i].pbRemain = pFree;
             pFree = (PBYTE)&pTrampoline[i];
         }
-        s_pRegion->pFree = (PDETOUR_TRAMPOLINE)pFree;
-        goto found_region;
+        pRegion->pFree = (PDETOUR_TRAMPOLINE)pFree;
+        pRegion->cFree = DETOUR_TRAMPOLINES_PER_REGION;
+        s_cEmptyRegions++;
     }
 
-    DETOUR_TRACE(("Couldn't find available memory region!\n"));
-    return NULL;
+    s_pRegion = pRegion;
+    pTrampoline = pRegion->pFree;
+    pRegion->pFree = (PDETOUR_TRAMPOLINE)pTrampoline->pbRemain;
+    if (pRegion->cFree-- == DETOUR_TRAMPOLINES_PER_REGION) {
+        s_cEmptyRegions--;
+    }
+    if (pRegion->cFree == 0) {
+        detour_region_index_remove(&s_FreeRegions, pRegion);
+    }
+    memset(pTrampoline, 0xcc, sizeof(*pTrampoline));
+    return pTrampoline;
 }
 
 static void detour_free_trampoline(PDETOUR_TRAMPOLINE pTrampoline)
 {
+    if (detour_free_cave_trampoline(pTrampoline)) {
+        return;
+    }
+
     PDETOUR_REGION pRegion = (PDETOUR_REGION)
         ((ULONG_PTR)pTrampoline & ~(ULONG_PTR)0xffff);
 
     memset(pTrampoline, 0, sizeof(*pTrampoline));
     pTrampoline->pbRemain = (PBYTE)pRegion->pFree;
     pRegion->pFree = pTrampoline;
+    if (pRegion->cFree++ == 0) {
+        // If the index can't grow, the region stays reachable as the default
+        // region until it fills again or is released.
+        detour_region_index_insert(&s_FreeRegions, pRegion);
+    }
+    if (pRegion->cFree == DETOUR_TRAMPOLINES_PER_REGION) {
+        s_cEmptyRegions++;
+    }
 }
 
 static BOOL detour_is_region_empty(PDETOUR_REGION pRegion)
@@ -1461,25 +2066,16 @@ static BOOL detour_is_region_empty(PDETOUR_REGION pRegion)
         return FALSE;
     }
 
-    PBYTE pbRegionBeg = (PBYTE)pRegion;
-    PBYTE pbRegionLim  = pbRegionBeg + DETOUR_REGION_SIZE;
-
-    // Stop if any of the trampolines aren't free.
-    PDETOUR_TRAMPOLINE pTrampoline = ((PDETOUR_TRAMPOLINE)pRegion) + 1;
-    for (int i = 0; i < DETOUR_TRAMPOLINES_PER_REGION; i++) {
-        if (pTrampoline[i].pbRemain != NULL &&
-            (pTrampoline[i].pbRemain < pbRegionBeg ||
-             pTrampoline[i].pbRemain >= pbRegionLim)) {
-            return FALSE;
-        }
-    }
-
-    // OK, the region is empty.
-    return TRUE;
+    return pRegion->cFree == DETOUR_TRAMPOLINES_PER_REGION;
 }
 
 static void detour_free_unused_trampoline_regions()
 {
+    // Nothing to release; skip the walk of the region list.
+    if (s_cEmptyRegions == 0) {
+        return;
+    }
+
     PDETOUR_REGION *ppRegionBase = &s_pRegions;
     PDETOUR_REGION pRegion = s_pRegions;
 
@@ -1487,8 +2083,13 @@ static void detour_free_unused_trampoline_regions()
         if (detour_is_region_empty(pRegion)) {
             *ppRegionBase = pRegion->pNext;
 
+            detour_region_index_remove(&s_AllRegions, pRegion);
+            detour_region_index_remove(&s_FreeRegions, pRegion);
+            s_cEmptyRegions--;
+            if (s_pRegion == pRegion) {
+                s_pRegion = NULL;
+            }
             VirtualFree(pRegion, 0, MEM_RELEASE);
-            s_pRegion = NULL;
         }
         else {
             ppRegionBase = &pRegion->pNext;
@@ -1509,20 +2110,35 @@ struct DetourOperation
 {
     DetourOperation *   pNext;
     BOOL                fIsRemove;
+    BOOL                fIsCallSite;    // pbTarget is a call site, see DetourAttachCallSite.
+    LONG                nCallSiteDisp;  // rel32/disp32 written by the attach.
+    BOOL                fIsRetired;     // Removed without suspension, see s_pRetiredOperations.
+    BOOL                fIsReclaimed;   // Attach reusing a retired trampoline.
+    BOOL                fIsOccupied;    // A thread was left in the trampoline.
+    DETOUR_PATCH_PATH   ePath;
     PBYTE *             ppbPointer;
     PBYTE               pbTarget;
     PDETOUR_TRAMPOLINE  pTrampoline;
-    ULONG               dwPerm;
 };
 
 static BOOL                 s_fIgnoreTooSmall       = FALSE;
 static BOOL                 s_fRetainRegions        = FALSE;
+static BOOL                 s_fAtomicPatches        = FALSE;
+static BOOL                 s_fSelectiveSuspend     = FALSE;
 
 static LONG                 s_nPendingThreadId      = 0; // Thread owning pending transaction.
 static LONG                 s_nPendingError         = NO_ERROR;
 static PVOID *              s_ppPendingError        = NULL;
 static DetourThread *       s_pPendingThreads       = NULL;
+static LARGE_INTEGER        s_llSuspendStart        = { 0 }; // At the first SuspendThread.
+static BOOL                 s_fAllThreadsUpdated    = FALSE; // See DetourSetAllThreadsUpdated.
 static DetourOperation *    s_pPendingOperations    = NULL;
+// Removals whose trampoline another thread may still be running, after an
+// atomic detach or a selective commit; freed by the next commit that
+// suspends every thread, once their IPs are fixed up.
+static DetourOperation *    s_pRetiredOperations    = NULL;
+//  DetourTransactionIsAtomic asks for a full suspension once this many wait.
+const ULONG DETOUR_RETIRED_RECLAIM = 32;
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1548,6 +2164,48 @@ BOOL WINAPI DetourSetRetainRegions(_In_ BOOL fRetain)
     return fPrevious;
 }
 
+BOOL WINAPI DetourSetCodeCaves(_In_ BOOL fCodeCaves)
+{
+    BOOL fPrevious = s_fCodeCaves;
+    s_fCodeCaves = fCodeCaves;
+    return fPrevious;
+}
+
+BOOL WINAPI DetourSetAtomicPatches(_In_ BOOL fAtomic)
+{
+    BOOL fPrevious = s_fAtomicPatches;
+    s_fAtomicPatches = fAtomic;
+    return fPrevious;
+}
+
+BOOL WINAPI DetourSetSelectiveSuspend(_In_ BOOL fSelective)
+{
+    BOOL fPrevious = s_fSelectiveSuspend;
+    s_fSelectiveSuspend = fSelective;
+    return fPrevious;
+}
+
+// Microseconds since the transaction suspended its first thread.
+static ULONG detour_suspended_us()
+{
+    LARGE_INTEGER llNow;
+    LARGE_INTEGER llFrequency;
+    QueryPerformanceCounter(&llNow);
+    QueryPerformanceFrequency(&llFrequency);
+    return (ULONG)((llNow.QuadPart - s_llSuspendStart.QuadPart) * 1000000 /
+                   llFrequency.QuadPart);
+}
+
+VOID WINAPI DetourGetTrampolineStats(_Out_ PDETOUR_TRAMPOLINE_STATS pStats)
+{
+    *pStats = s_TrampolineStats;
+}
+
+VOID WINAPI DetourGetCommitStats(_Out_ PDETOUR_COMMIT_STATS pStats)
+{
+    *pStats = s_CommitStats;
+}
+
 PVOID WINAPI DetourSetSystemRegionLowerBound(_In_ PVOID pSystemRegionLowerBound)
 {
     PVOID pPrevious = s_pSystemRegionLowerBound;
@@ -1578,7 +2236,10 @@ _Benign_race_end_
 
     s_pPendingOperations = NULL;
     s_pPendingThreads = NULL;
+    s_fAllThreadsUpdated = FALSE;
     s_ppPendingError = NULL;
+    s_cPendingPages = 0;
+    ZeroMemory(&s_CommitStats, sizeof(s_CommitStats));
 
     // Make sure the trampoline pages are writable.
     s_nPendingError = detour_writable_trampoline_regions();
@@ -1592,13 +2253,17 @@ LONG WINAPI DetourTransactionAbort()
         return ERROR_INVALID_OPERATION;
     }
 
-    // Restore all of the page permissions.
     for (DetourOperation *o = s_pPendingOperations; o != NULL;) {
-        // We don't care if this fails, because the code is still accessible.
-        DWORD dwOld;
-        VirtualProtect(o->pbTarget, o->pTrampoline->cbRestore,
-                       o->dwPerm, &dwOld);
-
+        DetourOperation *n = o->pNext;
+        if (o->fIsReclaimed) {
+            // Still possibly running on another thread.
+            o->fIsRemove = TRUE;
+            o->fIsRetired = TRUE;
+            o->pNext = s_pRetiredOperations;
+            s_pRetiredOperations = o;
+            o = n;
+            continue;
+        }
         if (!o->fIsRemove) {
             if (o->pTrampoline) {
                 detour_free_trampoline(o->pTrampoline);
@@ -1606,16 +2271,21 @@ LONG WINAPI DetourTransactionAbort()
             }
         }
 
-        DetourOperation *n = o->pNext;
         delete o;
         o = n;
     }
     s_pPendingOperations = NULL;
 
+    // Restore all of the page permissions.  Nothing was written yet.
+    detour_restore_code_pages(FALSE);
+
     // Make sure the trampoline pages are no longer writable.
     detour_runnable_trampoline_regions();
 
     // Resume any suspended threads.
+    if (s_pPendingThreads != NULL) {
+        s_CommitStats.usAllStopped = s_CommitStats.usSuspended = detour_suspended_us();
+    }
     for (DetourThread *t = s_pPendingThreads; t != NULL;) {
         // There is nothing we can do if this fails.
         ResumeThread(t->hThread);
@@ -1635,6 +2305,29 @@ LONG WINAPI DetourTransactionCommit()
     return DetourTransactionCommitEx(NULL);
 }
 
+LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer)
+{
+    return DetourTransactionCommitReport(pppFailedPointer, NULL, NULL);
+}
+
+BOOL WINAPI DetourTransactionIsAtomic(VOID)
+{
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        if (o->ePath == DETOUR_PATCH_SUSPENDED) {
+            return FALSE;
+        }
+    }
+
+    // Only a commit that sees every thread can free retired trampolines.
+    ULONG cRetired = 0;
+    for (DetourOperation *o = s_pRetiredOperations; o != NULL; o = o->pNext) {
+        if (++cRetired >= DETOUR_RETIRED_RECLAIM) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
 static BYTE detour_align_from_trampoline(PDETOUR_TRAMPOLINE pTrampoline, BYTE obTrampoline)
 {
     for (LONG n = 0; n < ARRAYSIZE(pTrampoline->rAlign); n++) {
@@ -1642,20 +2335,410 @@ static BYTE detour_align_from_trampoline(PDETOUR_TRAMPOLINE pTrampoline, BYTE ob
             return pTrampoline->rAlign[n].obTarget;
         }
     }
-    return 0;
+    return 0;
+}
+
+static LONG detour_align_from_target(PDETOUR_TRAMPOLINE pTrampoline, LONG obTarget)
+{
+    for (LONG n = 0; n < ARRAYSIZE(pTrampoline->rAlign); n++) {
+        if (pTrampoline->rAlign[n].obTarget == obTarget) {
+            return pTrampoline->rAlign[n].obTrampoline;
+        }
+    }
+    return 0;
+}
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+
+// A patchable call site is a call or unconditional jmp whose last four bytes
+// are its only reference: a rel32 target, or the [rip+disp32] (x64) or
+// [disp32] (x86) slot of an indirect call such as an IAT entry.  Returns the
+// instruction length, or 0 if the site can't be patched.
+static ULONG detour_decode_call_site(PBYTE pbSite, PBYTE *ppbReference, BOOL *pfIsSlot)
+{
+    // Don't read through the slot; the caller decides what to do with it.
+    DETOUR_DISASM_CONTEXT context = { NULL, NULL, TRUE };
+    DETOUR_DECODED_INSTRUCTION decoded;
+
+    if (DetourDecodeInstructionEx(pbSite, &decoded, &context) == NULL ||
+        (decoded.wFlags & DETOUR_DECODED_INVALID) ||
+        !(decoded.wFlags & (DETOUR_DECODED_CALL | DETOUR_DECODED_BRANCH)) ||
+        (decoded.wFlags & DETOUR_DECODED_CONDITIONAL) ||
+        decoded.cbInstruction < 5) {
+        return 0;
+    }
+
+    ULONG cbSite = decoded.cbInstruction;
+    PBYTE pbNext = pbSite + cbSite;
+    LONG nDisp = *(UNALIGNED LONG *)(pbNext - 4);
+
+    if (decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE &&
+        decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC &&
+        decoded.pbTarget == pbNext + nDisp) {
+        *ppbReference = decoded.pbTarget;
+        *pfIsSlot = FALSE;
+        return cbSite;
+    }
+#ifdef DETOURS_X64
+    if ((decoded.wFlags & DETOUR_DECODED_RIP_RELATIVE) &&
+        decoded.pbData == pbNext + nDisp) {
+#else
+    if ((decoded.wFlags & DETOUR_DECODED_ABSOLUTE) &&
+        decoded.pbData == (PBYTE)(ULONG_PTR)(ULONG)nDisp) {
+#endif
+        *ppbReference = decoded.pbData;
+        *pfIsSlot = TRUE;
+        return cbSite;
+    }
+    return 0;
+}
+
+// Maps any address inside a live trampoline region back to its trampoline.
+static PDETOUR_TRAMPOLINE detour_trampoline_from_pointer(PBYTE pbPointer)
+{
+    DETOUR_CAVE *pCave = detour_cave_from_pointer(pbPointer);
+    if (pCave != NULL) {
+        return pCave->fUsed ? (PDETOUR_TRAMPOLINE)pCave->pbCave : NULL;
+    }
+
+    PBYTE pbRegion = (PBYTE)detour_region_index_find(&s_AllRegions, pbPointer);
+    if (pbRegion == NULL || pbPointer < pbRegion + sizeof(DETOUR_TRAMPOLINE)) {
+        return NULL;
+    }
+    ULONG_PTR nIndex = (ULONG_PTR)(pbPointer - pbRegion) / sizeof(DETOUR_TRAMPOLINE);
+    return ((PDETOUR_TRAMPOLINE)pbRegion) + nIndex;
+}
+
+#endif // DETOURS_X86 || DETOURS_X64
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+// Code bytes inside one naturally aligned 8-byte word change in a single
+// locked store: a thread fetching them sees all old or all new instructions.
+static BOOL detour_fits_atomic_word(PBYTE pbCode, ULONG cbCode)
+{
+    return ((ULONG_PTR)pbCode & 7) + cbCode <= 8;
+}
+
+static void detour_write_atomic_word(PBYTE pbCode, const BYTE *pbNew, ULONG cbCode)
+{
+    LONGLONG volatile *pllWord = (LONGLONG volatile *)((ULONG_PTR)pbCode & ~(ULONG_PTR)7);
+    ULONG obCode = (ULONG)(pbCode - (PBYTE)pllWord);
+    LONGLONG llOld;
+    LONGLONG llNew;
+
+    // On x86 the plain read may tear; the compare catches that.
+    do {
+        llOld = *pllWord;
+        llNew = llOld;
+        CopyMemory((PBYTE)&llNew + obCode, pbNew, cbCode);
+    } while (InterlockedCompareExchange64(pllWord, llNew, llOld) != llOld);
+}
+
+// Where the jmp in a hot-patch pad goes: straight to the detour when a
+// rel32 reaches it, otherwise through the trampoline's relay.
+static PBYTE detour_hot_patch_jmp_val(PDETOUR_TRAMPOLINE pTrampoline,
+                                      PBYTE pbTarget,
+                                      PBYTE pbDetour)
+{
+#ifdef DETOURS_X64
+    LONG_PTR nDelta = pbDetour - pbTarget;
+    if (nDelta != (LONG)nDelta) {
+        return pTrampoline->rbCodeIn;
+    }
+#endif // DETOURS_X64
+    UNREFERENCED_PARAMETER(pTrampoline);
+    UNREFERENCED_PARAMETER(pbTarget);
+    return pbDetour;
+}
+
+// A hot-patchable target starts with mov edi, edi (x86) or an instruction of
+// at least 2 bytes (x64) that a short jmp can replace, behind 5 bytes of
+// padding free for the long jmp: int3 fill, or on x86 the nops /hotpatch
+// puts in front of mov edi, edi.  Nops anywhere else may be code that runs
+// (alignment inside the previous function, a branch into the run), so they
+// are not free.  A pad still holding the jmp to pbJmpVal from an earlier
+// attach is reused as it is; any other jmp is left alone, as a thread may
+// be on it.
+static BOOL detour_is_hot_patchable(PBYTE pbTarget, PBYTE pbJmpVal)
+{
+    PBYTE pbPad = pbTarget - SIZE_OF_JMP;
+
+    if (!detour_fits_atomic_word(pbTarget, 2)) {
+        return FALSE;
+    }
+    if (((ULONG_PTR)pbTarget & (DETOUR_CODE_PAGE_SIZE - 1)) < SIZE_OF_JMP) {
+        // The pad is on the page before, which has to be the same image.
+        MEMORY_BASIC_INFORMATION mbiPad;
+        MEMORY_BASIC_INFORMATION mbiTarget;
+        if (VirtualQuery(pbPad, &mbiPad, sizeof(mbiPad)) == 0 ||
+            VirtualQuery(pbTarget, &mbiTarget, sizeof(mbiTarget)) == 0 ||
+            mbiPad.State != MEM_COMMIT ||
+            mbiPad.AllocationBase != mbiTarget.AllocationBase) {
+            return FALSE;
+        }
+    }
+
+#ifdef DETOURS_X86
+    if (pbTarget[0] != 0x8b || pbTarget[1] != 0xff) {   // mov edi, edi
+        return FALSE;
+    }
+#else
+    if ((PBYTE)DetourCopyInstruction(NULL, NULL, pbTarget, NULL, NULL) < pbTarget + 2) {
+        return FALSE;
+    }
+#endif
+
+    BOOL fInt3 = TRUE;
+    BOOL fNop = TRUE;
+    for (ULONG n = 0; n < SIZE_OF_JMP; n++) {
+        if (pbPad[n] != 0xcc) {
+            fInt3 = FALSE;
+        }
+        if (pbPad[n] != 0x90) {
+            fNop = FALSE;
+        }
+    }
+    if (fInt3) {
+        return TRUE;
+    }
+#ifdef DETOURS_X86
+    if (fNop) {                                         // the /hotpatch pad
+        return TRUE;
+    }
+#else
+    UNREFERENCED_PARAMETER(fNop);
+#endif
+    return (pbPad[0] == 0xe9 &&
+            *(UNALIGNED INT32 *)&pbPad[1] == (INT32)(pbJmpVal - pbTarget));
+}
+
+// How DetourDetach can undo an attach: a hot-patch layout is the short jmp
+// into a pad that jumps on to this trampoline's detour.
+static DETOUR_PATCH_PATH detour_remove_path(PDETOUR_TRAMPOLINE pTrampoline, PBYTE pbTarget)
+{
+    if (!s_fAtomicPatches) {
+        return DETOUR_PATCH_SUSPENDED;
+    }
+
+    PBYTE pbPad = pbTarget - SIZE_OF_JMP;
+    PBYTE pbJmpVal = detour_hot_patch_jmp_val(pTrampoline, pbTarget, pTrampoline->pbDetour);
+    if (pbTarget[0] == 0xeb && pbTarget[1] == 0xf9 &&
+        pbPad[0] == 0xe9 &&
+        *(UNALIGNED INT32 *)&pbPad[1] == (INT32)(pbJmpVal - pbTarget) &&
+        detour_fits_atomic_word(pbTarget, 2)) {
+        return DETOUR_PATCH_HOTPATCH;
+    }
+    if (pTrampoline->rAlign[0].obTarget == pTrampoline->cbRestore &&
+        detour_fits_atomic_word(pbTarget, pTrampoline->cbRestore)) {
+        return DETOUR_PATCH_ATOMIC;
+    }
+    return DETOUR_PATCH_SUSPENDED;
+}
+
+// Re-attaching the detour an atomic detach removed takes its trampoline back
+// off the retired list: the code in it is unchanged, so a thread still
+// running it doesn't notice, and toggling a hook doesn't pile trampolines up.
+static DetourOperation * detour_reclaim_retired(PBYTE pbTarget, PBYTE pbDetour)
+{
+    for (DetourOperation **ppo = &s_pRetiredOperations; *ppo != NULL; ppo = &(*ppo)->pNext) {
+        DetourOperation *o = *ppo;
+        PDETOUR_TRAMPOLINE pTrampoline = o->pTrampoline;
+
+        if (o->pbTarget != pbTarget ||
+            pTrampoline->pbDetour != pbDetour ||
+            pTrampoline->rAlign[0].obTarget != pTrampoline->cbRestore ||
+            memcmp(pTrampoline->rbRestore, pbTarget, pTrampoline->cbRestore) != 0) {
+            continue;
+        }
+
+        if (detour_is_hot_patchable(pbTarget,
+                                    detour_hot_patch_jmp_val(pTrampoline, pbTarget, pbDetour))) {
+            o->ePath = DETOUR_PATCH_HOTPATCH;
+        }
+        else if (pTrampoline->cbRestore >= SIZE_OF_JMP &&
+                 detour_fits_atomic_word(pbTarget, pTrampoline->cbRestore)) {
+            o->ePath = DETOUR_PATCH_ATOMIC;
+        }
+        else {
+            return NULL;
+        }
+
+        *ppo = o->pNext;
+        o->fIsRemove = FALSE;
+        o->fIsRetired = FALSE;
+        o->fIsReclaimed = TRUE;
+        return o;
+    }
+    return NULL;
+}
+
+// The bytes an attach puts at the target: a jmp to the detour (x86) or to
+// the trampoline's relay (x64), int3 up to the end of the moved code.
+static void detour_gen_target_jmp(PBYTE pbPatch, PDETOUR_TRAMPOLINE pTrampoline, PBYTE pbTarget)
+{
+#ifdef DETOURS_X64
+    PBYTE pbJmpVal = pTrampoline->rbCodeIn;
+#else
+    PBYTE pbJmpVal = pTrampoline->pbDetour;
+#endif
+    pbPatch[0] = 0xe9;      // jmp +imm32
+    *(UNALIGNED INT32 *)&pbPatch[1] = (INT32)(pbJmpVal - (pbTarget + SIZE_OF_JMP));
+    for (ULONG n = SIZE_OF_JMP; n < pTrampoline->cbRestore; n++) {
+        pbPatch[n] = 0xcc;  // brk;
+    }
+}
+
+static void detour_commit_atomic(DetourOperation *o)
+{
+    PDETOUR_TRAMPOLINE pTrampoline = o->pTrampoline;
+    PBYTE pbTarget = o->pbTarget;
+    BYTE rbPatch[8];
+
+    if (o->fIsRemove) {
+        // The target goes back before the pointer does, so a detour that
+        // still calls through the pointer finds the trampoline intact.
+        detour_write_atomic_word(pbTarget, pTrampoline->rbRestore,
+                                 o->ePath == DETOUR_PATCH_HOTPATCH ? 2 : pTrampoline->cbRestore);
+        *o->ppbPointer = pbTarget;
+        return;
+    }
+
+    // And the pointer is live before the target jumps, or a detour calling
+    // through it straight away would land on itself.
+    *o->ppbPointer = pTrampoline->rbCode;
+#ifdef DETOURS_X64
+    detour_gen_jmp_indirect(pTrampoline->rbCodeIn, &pTrampoline->pbDetour);
+#endif // DETOURS_X64
+
+    if (o->ePath == DETOUR_PATCH_HOTPATCH) {
+        // Nothing runs the pad until the short jmp is in.
+        detour_gen_jmp_immediate(pbTarget - SIZE_OF_JMP,
+                                 detour_hot_patch_jmp_val(pTrampoline, pbTarget,
+                                                          pTrampoline->pbDetour));
+        rbPatch[0] = 0xeb;  // jmp $-5
+        rbPatch[1] = 0xf9;
+        detour_write_atomic_word(pbTarget, rbPatch, 2);
+        return;
+    }
+
+    detour_gen_target_jmp(rbPatch, pTrampoline, pbTarget);
+    detour_write_atomic_word(pbTarget, rbPatch, pTrampoline->cbRestore);
+}
+
+// With some threads released, a target that needs several stores changes
+// behind a gate: "jmp $" parks a thread arriving while the rest of the bytes
+// go in, and the last store opens it.  The gates close while every thread is
+// still suspended, so a released thread can't be part way into a target.
+static void detour_close_gates()
+{
+    static const BYTE rbGate[2] = { 0xeb, 0xfe };   // jmp $
+
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        if (!o->fIsRetired && !o->fIsCallSite && o->ePath == DETOUR_PATCH_SUSPENDED) {
+            detour_write_atomic_word(o->pbTarget, rbGate, 2);
+        }
+    }
+}
+
+static void detour_write_gated(PBYTE pbCode, const BYTE *pbNew, ULONG cbCode)
+{
+    CopyMemory(pbCode + 2, pbNew + 2, cbCode - 2);
+    detour_write_atomic_word(pbCode, pbNew, 2);
+}
+
+static void detour_commit_gated(DetourOperation *o)
+{
+    PDETOUR_TRAMPOLINE pTrampoline = o->pTrampoline;
+    BYTE rbPatch[sizeof(pTrampoline->rbRestore)];
+
+    if (o->fIsRemove) {
+        detour_write_gated(o->pbTarget, pTrampoline->rbRestore, pTrampoline->cbRestore);
+        *o->ppbPointer = o->pbTarget;
+        return;
+    }
+
+#ifdef DETOURS_X64
+    detour_gen_jmp_indirect(pTrampoline->rbCodeIn, &pTrampoline->pbDetour);
+#endif // DETOURS_X64
+    detour_gen_target_jmp(rbPatch, pTrampoline, o->pbTarget);
+    *o->ppbPointer = pTrampoline->rbCode;
+    detour_write_gated(o->pbTarget, rbPatch, pTrampoline->cbRestore);
+}
+
+static BOOL detour_can_gate_operations()
+{
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        if (o->fIsRetired || o->fIsCallSite || o->ePath != DETOUR_PATCH_SUSPENDED) {
+            continue;
+        }
+        if (!detour_fits_atomic_word(o->pbTarget, 2)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Code the commit rewrites, plus the trampolines it may free or redirect.
+static BOOL detour_is_ip_near_operation(ULONG_PTR nIp)
+{
+    for (DetourOperation *o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        ULONG_PTR nTarget = (ULONG_PTR)o->pbTarget;
+        ULONG_PTR cbTarget = o->pTrampoline->cbRestore;
+        if (o->ePath == DETOUR_PATCH_HOTPATCH) {
+            nTarget -= SIZE_OF_JMP;
+            cbTarget += SIZE_OF_JMP;
+        }
+        if (nIp - nTarget < cbTarget ||
+            nIp - (ULONG_PTR)o->pTrampoline < sizeof(*o->pTrampoline)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Resumes the suspended threads that are nowhere near the operations.  A
+// thread whose context can't be read stays suspended.
+static ULONG detour_release_distant_threads()
+{
+    ULONG cReleased = 0;
+
+    for (DetourThread **ppt = &s_pPendingThreads; *ppt != NULL;) {
+        DetourThread *t = *ppt;
+        CONTEXT cxt;
+        cxt.ContextFlags = CONTEXT_CONTROL;
+
+        if (!GetThreadContext(t->hThread, &cxt) ||
+#ifdef DETOURS_X64
+            detour_is_ip_near_operation((ULONG_PTR)cxt.Rip)
+#else
+            detour_is_ip_near_operation((ULONG_PTR)cxt.Eip)
+#endif
+           ) {
+            ppt = &t->pNext;
+            continue;
+        }
+
+        *ppt = t->pNext;
+        ResumeThread(t->hThread);
+        delete t;
+        cReleased++;
+    }
+    return cReleased;
 }
+#endif // DETOURS_X86 || DETOURS_X64
 
-static LONG detour_align_from_target(PDETOUR_TRAMPOLINE pTrampoline, LONG obTarget)
+static void detour_commit_call_site(DetourOperation *o)
 {
-    for (LONG n = 0; n < ARRAYSIZE(pTrampoline->rAlign); n++) {
-        if (pTrampoline->rAlign[n].obTarget == obTarget) {
-            return pTrampoline->rAlign[n].obTrampoline;
-        }
-    }
-    return 0;
+    // Only the trailing rel32/disp32 changes, in a single 4-byte store, so a
+    // thread that wasn't suspended sees either the old or the new reference
+    // unless the field straddles a cache line.
+    BYTE cbSite = o->pTrampoline->cbRestore;
+    *(volatile LONG *)(o->pbTarget + cbSite - 4) = o->nCallSiteDisp;
 }
 
-LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer)
+LONG WINAPI DetourTransactionCommitReport(_Out_opt_ PVOID **pppFailedPointer,
+                                          _In_opt_ PVOID pContext,
+                                          _In_opt_ PF_DETOUR_PATCH_CALLBACK pfPatch)
 {
     if (pppFailedPointer != NULL) {
         // Used to get the last error.
@@ -1676,10 +2759,47 @@ LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer)
     DetourOperation *o;
     DetourThread *t;
     BOOL freed = FALSE;
+    BOOL fSuspended = (s_pPendingThreads != NULL);
+    BOOL fAllThreads = s_fAllThreadsUpdated;
+    BOOL fGated = FALSE;
+
+    // With every thread suspended, retired trampolines get their IPs fixed
+    // up and are freed along with this transaction's removals.
+    if (fAllThreads && s_pRetiredOperations != NULL) {
+        DetourOperation **ppLast = &s_pPendingOperations;
+        while (*ppLast != NULL) {
+            ppLast = &(*ppLast)->pNext;
+        }
+        *ppLast = s_pRetiredOperations;
+        s_pRetiredOperations = NULL;
+    }
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    if (s_fSelectiveSuspend && fSuspended && detour_can_gate_operations()) {
+        detour_close_gates();
+        fGated = TRUE;
+        s_CommitStats.usAllStopped = detour_suspended_us();
+        s_CommitStats.cThreadsReleased = detour_release_distant_threads();
+    }
+#endif // DETOURS_X86 || DETOURS_X64
 
     // Insert or remove each of the detours.
     for (o = s_pPendingOperations; o != NULL; o = o->pNext) {
-        if (o->fIsRemove) {
+        if (o->fIsRetired) {
+            continue;
+        }
+        if (o->fIsCallSite) {
+            detour_commit_call_site(o);
+        }
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+        else if (o->ePath != DETOUR_PATCH_SUSPENDED) {
+            detour_commit_atomic(o);
+        }
+        else if (fGated) {
+            detour_commit_gated(o);
+        }
+#endif // DETOURS_X86 || DETOURS_X64
+        else if (o->fIsRemove) {
             CopyMemory(o->pbTarget,
                        o->pTrampoline->rbRestore,
                        o->pTrampoline->cbRestore);
@@ -1840,7 +2960,60 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
 
         if (GetThreadContext(t->hThread, &cxt)) {
             for (o = s_pPendingOperations; o != NULL; o = o->pNext) {
-                if (o->fIsRemove) {
+                if (o->fIsCallSite) {
+                    // Instruction boundaries at the site don't move.  A thread
+                    // parked on the relay goes straight to the detour instead.
+                    if (o->fIsRemove &&
+                        cxt.DETOURS_EIP >= (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline &&
+                        cxt.DETOURS_EIP < (DETOURS_EIP_TYPE)((ULONG_PTR)o->pTrampoline
+                                                             + sizeof(*o->pTrampoline))
+                       ) {
+
+                        cxt.DETOURS_EIP = (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline->pbDetour;
+                        SetThreadContext(t->hThread, &cxt);
+                    }
+                }
+                else if (o->fIsRemove) {
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+                    // Moved code maps back onto the target and the jmp after
+                    // it goes on to pbRemain.  On x64 a thread parked on the
+                    // relay into the detour finishes the call it started.
+                    DETOURS_EIP_TYPE obTrampoline =
+                        cxt.DETOURS_EIP - (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline;
+                    if (cxt.DETOURS_EIP >= (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline &&
+                        obTrampoline < sizeof(*o->pTrampoline)) {
+
+                        if (obTrampoline < o->pTrampoline->cbCode) {
+                            // A later attach may have rewritten the target;
+                            // the thread then stays and so does the trampoline.
+                            if (memcmp(o->pbTarget, o->pTrampoline->rbRestore,
+                                       o->pTrampoline->cbRestore) != 0) {
+                                o->fIsOccupied = TRUE;
+                                continue;
+                            }
+                            cxt.DETOURS_EIP = (DETOURS_EIP_TYPE)
+                                ((ULONG_PTR)o->pbTarget
+                                 + detour_align_from_trampoline(o->pTrampoline,
+                                                                (BYTE)obTrampoline));
+                        }
+#ifdef DETOURS_X64
+                        else if (obTrampoline >= offsetof(DETOUR_TRAMPOLINE, rbCodeIn)) {
+                            cxt.DETOURS_EIP = (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline->pbDetour;
+                        }
+#endif // DETOURS_X64
+                        else {
+                            cxt.DETOURS_EIP = (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline->pbRemain;
+                        }
+
+                        SetThreadContext(t->hThread, &cxt);
+                    }
+                    else if (o->ePath == DETOUR_PATCH_HOTPATCH &&
+                             cxt.DETOURS_EIP == (DETOURS_EIP_TYPE)(ULONG_PTR)(o->pbTarget - SIZE_OF_JMP)) {
+                        // The pad's jmp may go through the relay being freed.
+                        cxt.DETOURS_EIP = (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline->pbDetour;
+                        SetThreadContext(t->hThread, &cxt);
+                    }
+#else // !DETOURS_X86 && !DETOURS_X64
                     if (cxt.DETOURS_EIP >= (DETOURS_EIP_TYPE)(ULONG_PTR)o->pTrampoline &&
                         cxt.DETOURS_EIP < (DETOURS_EIP_TYPE)((ULONG_PTR)o->pTrampoline
                                                              + sizeof(o->pTrampoline))
@@ -1855,6 +3028,7 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
 
                         SetThreadContext(t->hThread, &cxt);
                     }
+#endif // !DETOURS_X86 && !DETOURS_X64
                 }
                 else {
                     if (cxt.DETOURS_EIP >= (DETOURS_EIP_TYPE)(ULONG_PTR)o->pbTarget &&
@@ -1877,25 +3051,30 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
 #undef DETOURS_EIP
     }
 
-    // Restore all of the page permissions and flush the icache.
-    HANDLE hProcess = GetCurrentProcess();
-    for (o = s_pPendingOperations; o != NULL;) {
-        // We don't care if this fails, because the code is still accessible.
-        DWORD dwOld;
-        VirtualProtect(o->pbTarget, o->pTrampoline->cbRestore, o->dwPerm, &dwOld);
-        FlushInstructionCache(hProcess, o->pbTarget, o->pTrampoline->cbRestore);
-
-        if (o->fIsRemove && o->pTrampoline) {
+    for (o = s_pPendingOperations; o != NULL; o = o->pNext) {
+        if (!o->fIsRetired) {
+            s_CommitStats.cOperations++;
+            if (o->ePath == DETOUR_PATCH_HOTPATCH) {
+                s_CommitStats.cHotPatches++;
+            }
+            else if (o->ePath == DETOUR_PATCH_ATOMIC) {
+                s_CommitStats.cAtomicPatches++;
+            }
+        }
+        // A released thread may be in a detour about to call through the
+        // old pointer, so its trampolines wait for a later commit too.
+        if (o->fIsRemove && o->pTrampoline && !o->fIsOccupied &&
+            (o->fIsRetired ||
+             (!fGated && (fAllThreads || o->ePath == DETOUR_PATCH_SUSPENDED)))) {
             detour_free_trampoline(o->pTrampoline);
             o->pTrampoline = NULL;
             freed = true;
         }
-
-        DetourOperation *n = o->pNext;
-        delete o;
-        o = n;
     }
-    s_pPendingOperations = NULL;
+
+    // Restore all of the page permissions and flush the icache, once per
+    // run of pages rather than once per operation.
+    detour_restore_code_pages(TRUE);
 
     // Free any trampoline regions that are now unused.
     if (freed && !s_fRetainRegions) {
@@ -1906,6 +3085,12 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
     detour_runnable_trampoline_regions();
 
     // Resume any suspended threads.
+    if (fSuspended) {
+        s_CommitStats.usSuspended = detour_suspended_us();
+        if (s_CommitStats.cThreadsReleased == 0) {
+            s_CommitStats.usAllStopped = s_CommitStats.usSuspended;
+        }
+    }
     for (t = s_pPendingThreads; t != NULL;) {
         // There is nothing we can do if this fails.
         ResumeThread(t->hThread);
@@ -1915,6 +3100,26 @@ typedef ULONG_PTR DETOURS_EIP_TYPE;
         t = n;
     }
     s_pPendingThreads = NULL;
+
+    // The report runs with the threads resumed, but before another
+    // transaction can start and touch the operation list.
+    for (o = s_pPendingOperations; o != NULL;) {
+        DetourOperation *n = o->pNext;
+        if (!o->fIsRetired && pfPatch != NULL) {
+            pfPatch(pContext, (PVOID *)o->ppbPointer, o->pbTarget, o->fIsRemove, o->ePath);
+        }
+        if (o->fIsRemove && o->pTrampoline) {
+            o->fIsRetired = TRUE;
+            o->fIsOccupied = FALSE;
+            o->pNext = s_pRetiredOperations;
+            s_pRetiredOperations = o;
+        }
+        else {
+            delete o;
+        }
+        o = n;
+    }
+    s_pPendingOperations = NULL;
     s_nPendingThreadId = 0;
 
     if (pppFailedPointer != NULL) {
@@ -1958,10 +3163,76 @@ LONG WINAPI DetourUpdateThread(_In_ HANDLE hThread)
         goto fail;
     }
 
+    if (s_pPendingThreads == NULL) {
+        QueryPerformanceCounter(&s_llSuspendStart);
+    }
     t->hThread = hThread;
     t->pNext = s_pPendingThreads;
     s_pPendingThreads = t;
+    s_CommitStats.cThreads++;
+
+    return NO_ERROR;
+}
+
+#ifdef DETOURS_LINUX
+static BOOL CALLBACK detour_update_thread_callback(PVOID pContext, DWORD dwThreadId)
+{
+    ULONG *pcAdded = (ULONG *)pContext;
+    HANDLE hThread = (HANDLE)(ULONG_PTR)dwThreadId;
+
+    if (dwThreadId == GetCurrentThreadId()) {
+        return TRUE;
+    }
+    for (DetourThread *t = s_pPendingThreads; t != NULL; t = t->pNext) {
+        if (t->hThread == hThread) {
+            return TRUE;
+        }
+    }
+
+    if (DetourUpdateThread(hThread) != NO_ERROR) {
+        return FALSE;
+    }
+    (*pcAdded)++;
+    return TRUE;
+}
+
+LONG WINAPI DetourUpdateAllThreads(VOID)
+{
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        return ERROR_INVALID_OPERATION;
+    }
+
+    // A thread may start while the list is read; it shows up in the next
+    // pass.  Once every other thread is suspended none can start.
+    for (;;) {
+        if (s_nPendingError != NO_ERROR) {
+            return s_nPendingError;
+        }
+
+        ULONG cAdded = 0;
+        if (!DetourPosixEnumerateThreads(&cAdded, detour_update_thread_callback)) {
+            s_nPendingError = GetLastError();
+            s_ppPendingError = NULL;
+            return s_nPendingError;
+        }
+        if (s_nPendingError == NO_ERROR && cAdded == 0) {
+            s_fAllThreadsUpdated = TRUE;
+            return NO_ERROR;
+        }
+    }
+}
+#endif // DETOURS_LINUX
+
+LONG WINAPI DetourSetAllThreadsUpdated(VOID)
+{
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        return ERROR_INVALID_OPERATION;
+    }
+    if (s_nPendingError != NO_ERROR) {
+        return s_nPendingError;
+    }
 
+    s_fAllThreadsUpdated = TRUE;
     return NO_ERROR;
 }
 
@@ -2059,6 +3330,39 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
         *ppRealDetour = pDetour;
     }
 
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    if (s_fAtomicPatches) {
+        o = detour_reclaim_retired(pbTarget, (PBYTE)pDetour);
+        if (o != NULL) {
+            pTrampoline = o->pTrampoline;
+            if (o->ePath == DETOUR_PATCH_HOTPATCH) {
+                error = detour_writable_code(pbTarget - SIZE_OF_JMP, SIZE_OF_JMP + 2);
+            }
+            else {
+                error = detour_writable_code(pbTarget, pTrampoline->cbRestore);
+            }
+            if (error != NO_ERROR) {
+                o->fIsRemove = TRUE;
+                o->fIsRetired = TRUE;
+                o->fIsReclaimed = FALSE;
+                o->pNext = s_pRetiredOperations;
+                s_pRetiredOperations = o;
+                o = NULL;
+                pTrampoline = NULL;
+                DETOUR_BREAK();
+                goto fail;
+            }
+            if (ppRealTrampoline != NULL) {
+                *ppRealTrampoline = pTrampoline;
+            }
+            o->ppbPointer = (PBYTE*)ppPointer;
+            o->pNext = s_pPendingOperations;
+            s_pPendingOperations = o;
+            return NO_ERROR;
+        }
+    }
+#endif // DETOURS_X86 || DETOURS_X64
+
     o = new NOTHROW DetourOperation;
     if (o == NULL) {
         error = ERROR_NOT_ENOUGH_MEMORY;
@@ -2107,6 +3411,17 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
     ULONG cbTarget = 0;
     ULONG cbJump = SIZE_OF_JMP;
     ULONG nAlign = 0;
+    DETOUR_PATCH_PATH ePath = DETOUR_PATCH_SUSPENDED;
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    // A hot-patch target only gives up its first instruction.
+    if (s_fAtomicPatches &&
+        detour_is_hot_patchable(pbTarget,
+                                detour_hot_patch_jmp_val(pTrampoline, pbTarget, (PBYTE)pDetour))) {
+        ePath = DETOUR_PATCH_HOTPATCH;
+        cbJump = 2;
+    }
+#endif // DETOURS_X86 || DETOURS_X64
 
 #ifdef DETOURS_ARM
     // On ARM, we need an extra instruction when the function isn't 32-bit aligned.
@@ -2226,6 +3541,16 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
     pTrampoline->pbRemain = pbTarget + cbTarget;
     pTrampoline->pbDetour = (PBYTE)pDetour;
 
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    // One instruction inside one aligned word: no thread can be part way
+    // through the bytes the jmp replaces.
+    if (s_fAtomicPatches && ePath == DETOUR_PATCH_SUSPENDED &&
+        nAlign == 1 && pTrampoline->rAlign[0].obTarget == cbTarget &&
+        detour_fits_atomic_word(pbTarget, cbTarget)) {
+        ePath = DETOUR_PATCH_ATOMIC;
+    }
+#endif // DETOURS_X86 || DETOURS_X64
+
 #ifdef DETOURS_IA64
     pTrampoline->ppldDetour = ppldDetour;
     pTrampoline->ppldTarget = ppldTarget;
@@ -2289,9 +3614,13 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
 
     (void)pbTrampoline;
 
-    DWORD dwOld = 0;
-    if (!VirtualProtect(pbTarget, cbTarget, PAGE_EXECUTE_READWRITE, &dwOld)) {
-        error = GetLastError();
+    if (ePath == DETOUR_PATCH_HOTPATCH) {
+        error = detour_writable_code(pbTarget - SIZE_OF_JMP, SIZE_OF_JMP + cbTarget);
+    }
+    else {
+        error = detour_writable_code(pbTarget, cbTarget);
+    }
+    if (error != NO_ERROR) {
         DETOUR_BREAK();
         goto fail;
     }
@@ -2317,10 +3646,14 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
                   pTrampoline->rbCode[10], pTrampoline->rbCode[11]));
 
     o->fIsRemove = FALSE;
+    o->fIsCallSite = FALSE;
+    o->fIsRetired = FALSE;
+    o->fIsReclaimed = FALSE;
+    o->fIsOccupied = FALSE;
+    o->ePath = ePath;
     o->ppbPointer = (PBYTE*)ppPointer;
     o->pTrampoline = pTrampoline;
     o->pbTarget = pbTarget;
-    o->dwPerm = dwOld;
     o->pNext = s_pPendingOperations;
     s_pPendingOperations = o;
 
@@ -2447,25 +3780,274 @@ LONG WINAPI DetourDetach(_Inout_ PVOID *ppPointer,
         }
     }
 
-    DWORD dwOld = 0;
-    if (!VirtualProtect(pbTarget, cbTarget,
-                        PAGE_EXECUTE_READWRITE, &dwOld)) {
-        error = GetLastError();
+    error = detour_writable_code(pbTarget, cbTarget);
+    if (error != NO_ERROR) {
         DETOUR_BREAK();
         goto fail;
     }
 
     o->fIsRemove = TRUE;
+    o->fIsCallSite = FALSE;
+    o->fIsRetired = FALSE;
+    o->fIsReclaimed = FALSE;
+    o->fIsOccupied = FALSE;
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    o->ePath = detour_remove_path(pTrampoline, pbTarget);
+#else
+    o->ePath = DETOUR_PATCH_SUSPENDED;
+#endif
     o->ppbPointer = (PBYTE*)ppPointer;
     o->pTrampoline = pTrampoline;
     o->pbTarget = pbTarget;
-    o->dwPerm = dwOld;
     o->pNext = s_pPendingOperations;
     s_pPendingOperations = o;
 
     return NO_ERROR;
 }
 
+//  Call-site detours leave the target alone and retarget one call instead:
+//  the rel32 of a "call target" is pointed at a relay in a trampoline near
+//  the site, the disp32 of a "call [slot]" at the trampoline's pbDetour.
+//  Instruction length and boundaries at the site never change, so the return
+//  address seen by the detour is the caller's own, and threads need no fixup.
+//
+LONG WINAPI DetourAttachCallSite(_In_ PVOID pCallSite,
+                                 _In_ PVOID pDetour,
+                                 _Out_opt_ PVOID *ppOriginal)
+{
+    if (ppOriginal != NULL) {
+        *ppOriginal = NULL;
+    }
+    if (pCallSite == NULL || pDetour == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        return ERROR_INVALID_OPERATION;
+    }
+
+    // If any of the pending operations failed, then we don't need to do this.
+    if (s_nPendingError != NO_ERROR) {
+        return s_nPendingError;
+    }
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    LONG error = NO_ERROR;
+    PBYTE pbSite = (PBYTE)pCallSite;
+    PBYTE pbReference = NULL;
+    PBYTE pbNew = NULL;
+    BOOL fIsSlot = FALSE;
+    ULONG cbSite = 0;
+    LONG_PTR nNew = 0;
+    PDETOUR_TRAMPOLINE pTrampoline = NULL;
+    DetourOperation *o = NULL;
+
+    pDetour = DetourCodeFromPointer(pDetour, NULL);
+
+    cbSite = detour_decode_call_site(pbSite, &pbReference, &fIsSlot);
+    if (cbSite == 0) {
+        error = ERROR_INVALID_BLOCK;
+        goto fail;
+    }
+
+    o = new NOTHROW DetourOperation;
+    if (o == NULL) {
+        error = ERROR_NOT_ENOUGH_MEMORY;
+        goto fail;
+    }
+
+    pTrampoline = detour_alloc_trampoline(pbSite);
+    if (pTrampoline == NULL) {
+        error = ERROR_NOT_ENOUGH_MEMORY;
+        goto fail;
+    }
+
+    // The relay reaches the detour from anywhere; rel32 sites call it.
+    pTrampoline->pbDetour = (PBYTE)pDetour;
+    pTrampoline->pbRemain = pbSite + cbSite;
+    memset(pTrampoline->rAlign, 0, sizeof(pTrampoline->rAlign));
+    CopyMemory(pTrampoline->rbRestore, pbSite, cbSite);
+    pTrampoline->cbRestore = (BYTE)cbSite;
+#ifdef DETOURS_X64
+    pbNew = detour_gen_jmp_indirect(pTrampoline->rbCode, &pTrampoline->pbDetour);
+#else
+    pbNew = detour_gen_jmp_immediate(pTrampoline->rbCode, pTrampoline->pbDetour);
+#endif
+    pTrampoline->cbCode = (BYTE)(pbNew - pTrampoline->rbCode);
+
+    pbNew = fIsSlot ? (PBYTE)&pTrampoline->pbDetour : pTrampoline->rbCode;
+#ifdef DETOURS_X86
+    if (fIsSlot) {
+        nNew = (LONG_PTR)pbNew;
+    }
+    else
+#endif
+    {
+        nNew = pbNew - (pbSite + cbSite);
+        if (nNew != (LONG)nNew) {
+            error = ERROR_INVALID_BLOCK;
+            goto fail;
+        }
+    }
+
+    error = detour_writable_code(pbSite, cbSite);
+    if (error != NO_ERROR) {
+        goto fail;
+    }
+
+    if (ppOriginal != NULL) {
+        *ppOriginal = fIsSlot ? *(PVOID *)pbReference : pbReference;
+    }
+
+    o->fIsRemove = FALSE;
+    o->fIsCallSite = TRUE;
+    o->fIsRetired = FALSE;
+    o->fIsReclaimed = FALSE;
+    o->fIsOccupied = FALSE;
+    o->ePath = DETOUR_PATCH_SUSPENDED;
+    o->nCallSiteDisp = (LONG)nNew;
+    o->ppbPointer = NULL;
+    o->pTrampoline = pTrampoline;
+    o->pbTarget = pbSite;
+    o->pNext = s_pPendingOperations;
+    s_pPendingOperations = o;
+
+    return NO_ERROR;
+
+  fail:
+    DETOUR_BREAK();
+    if (pTrampoline != NULL) {
+        detour_free_trampoline(pTrampoline);
+    }
+    if (o != NULL) {
+        delete o;
+    }
+    s_nPendingError = error;
+    s_ppPendingError = (PVOID *)pCallSite;
+    return error;
+#else
+    return ERROR_NOT_SUPPORTED;
+#endif // DETOURS_X86 || DETOURS_X64
+}
+
+LONG WINAPI DetourDetachCallSite(_In_ PVOID pCallSite,
+                                 _In_ PVOID pDetour)
+{
+    if (pCallSite == NULL || pDetour == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        return ERROR_INVALID_OPERATION;
+    }
+
+    // If any of the pending operations failed, then we don't need to do this.
+    if (s_nPendingError != NO_ERROR) {
+        return s_nPendingError;
+    }
+
+#if defined(DETOURS_X86) || defined(DETOURS_X64)
+    LONG error = NO_ERROR;
+    PBYTE pbSite = (PBYTE)pCallSite;
+    PBYTE pbReference = NULL;
+    BOOL fIsSlot = FALSE;
+    ULONG cbSite = 0;
+    PDETOUR_TRAMPOLINE pTrampoline = NULL;
+    DetourOperation *o = NULL;
+
+    pDetour = DetourCodeFromPointer(pDetour, NULL);
+
+    ////////////////////////////////////// Verify that the site is ours.
+    //
+    cbSite = detour_decode_call_site(pbSite, &pbReference, &fIsSlot);
+    if (cbSite != 0) {
+        pTrampoline = detour_trampoline_from_pointer(pbReference);
+    }
+    if (pTrampoline == NULL ||
+        pbReference != (fIsSlot ? (PBYTE)&pTrampoline->pbDetour : pTrampoline->rbCode) ||
+        pTrampoline->pbDetour != pDetour ||
+        pTrampoline->pbRemain != pbSite + cbSite ||
+        pTrampoline->cbRestore != cbSite) {
+        error = ERROR_INVALID_BLOCK;
+        goto fail;
+    }
+
+    o = new NOTHROW DetourOperation;
+    if (o == NULL) {
+        error = ERROR_NOT_ENOUGH_MEMORY;
+        goto fail;
+    }
+
+    error = detour_writable_code(pbSite, cbSite);
+    if (error != NO_ERROR) {
+        goto fail;
+    }
+
+    o->fIsRemove = TRUE;
+    o->fIsCallSite = TRUE;
+    o->fIsRetired = FALSE;
+    o->fIsReclaimed = FALSE;
+    o->fIsOccupied = FALSE;
+    o->ePath = DETOUR_PATCH_SUSPENDED;
+    o->nCallSiteDisp = *(UNALIGNED LONG *)&pTrampoline->rbRestore[cbSite - 4];
+    o->ppbPointer = NULL;
+    o->pTrampoline = pTrampoline;
+    o->pbTarget = pbSite;
+    o->pNext = s_pPendingOperations;
+    s_pPendingOperations = o;
+
+    return NO_ERROR;
+
+  fail:
+    DETOUR_BREAK();
+    if (o != NULL) {
+        delete o;
+    }
+    s_nPendingError = error;
+    s_ppPendingError = (PVOID *)pCallSite;
+    return error;
+#else
+    return ERROR_NOT_SUPPORTED;
+#endif // DETOURS_X86 || DETOURS_X64
+}
+
+PVOID WINAPI DetourAllocateThunk(_In_ PVOID pbNear,
+                                 _In_ ULONG cbThunk)
+{
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        SetLastError(ERROR_INVALID_OPERATION);
+        return NULL;
+    }
+    if (s_nPendingError != NO_ERROR) {
+        SetLastError(s_nPendingError);
+        return NULL;
+    }
+    if (cbThunk == 0 || cbThunk > sizeof(DETOUR_TRAMPOLINE)) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    // A thunk is just a trampoline slot holding caller code, so it lives in
+    // the same writable-until-commit memory and keeps its region alive.
+    PDETOUR_TRAMPOLINE pThunk = detour_alloc_trampoline((PBYTE)pbNear);
+    if (pThunk == NULL) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    return pThunk;
+}
+
+LONG WINAPI DetourFreeThunk(_In_ PVOID pThunk)
+{
+    if (pThunk == NULL) {
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (s_nPendingThreadId != (LONG)GetCurrentThreadId()) {
+        return ERROR_INVALID_OPERATION;
+    }
+
+    detour_free_trampoline((PDETOUR_TRAMPOLINE)pThunk);
+    return NO_ERROR;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Helpers for manipulating page protection.
@@ -37,6 +37,7 @@
 #define _KERNEL32_ 1
 #define _USER32_ 1
 
+#ifdef _WIN32
 #include <windows.h>
 #if (_MSC_VER < 1310)
 #else
@@ -47,6 +48,7 @@
 #include <strsafe.h>
 #pragma warning(pop)
 #endif
+#endif // _WIN32
 
 // From winerror.h, as this error isn't found in some SDKs:
 //
@@ -60,6 +62,13 @@
 
 #endif // DETOURS_INTERNAL
 
+//  Outside Windows only the disassembler is available, plus the transaction
+//  API on Linux x86-64 (see detposix.h).
+//
+#ifndef _WIN32
+#include "detposix.h"
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 //
 
@@ -94,7 +103,7 @@
 #error Unknown architecture (x86, amd64, ia64, arm, arm64)
 #endif
 
-#ifdef _WIN64
+#if defined(_WIN64) || defined(DETOURS_POSIX_64BIT)
 #undef DETOURS_32BIT
 #define DETOURS_64BIT 1
 #define DETOURS_BITS 64
@@ -118,7 +127,7 @@
 //////////////////////////////////////////////////////////////////////////////
 //
 
-#if (_MSC_VER < 1299)
+#if defined(_MSC_VER) && (_MSC_VER < 1299)
 typedef LONG LONG_PTR;
 typedef ULONG ULONG_PTR;
 #endif
@@ -268,6 +277,10 @@ typedef ULONG ULONG_PTR;
 #define _Out_writes_(x)
 #endif
 
+#ifndef _Out_writes_to_
+#define _Out_writes_to_(x,y)
+#endif
+
 #ifndef _Outptr_result_maybenull_
 #define _Outptr_result_maybenull_
 #endif
@@ -364,6 +377,17 @@ extern "C" {
 //
 #define DETOUR_INSTRUCTION_TARGET_NONE          ((PVOID)0)
 #define DETOUR_INSTRUCTION_TARGET_DYNAMIC       ((PVOID)(LONG_PTR)-1)
+
+/////////////////////////////////////////////////// Decoded Instruction Flags.
+//
+#define DETOUR_DECODED_BRANCH                   0x0001  // jmp, jcc, loop, jcxz.
+#define DETOUR_DECODED_CONDITIONAL              0x0002  // jcc, loop, jcxz.
+#define DETOUR_DECODED_CALL                     0x0004
+#define DETOUR_DECODED_RETURN                   0x0008  // ret, retf, iret.
+#define DETOUR_DECODED_DYNAMIC                  0x0010  // Target not known statically.
+#define DETOUR_DECODED_RIP_RELATIVE             0x0020  // x64 [rip+disp32] operand.
+#define DETOUR_DECODED_INVALID                  0x0040
+#define DETOUR_DECODED_ABSOLUTE                 0x0080  // [disp32] (x86) or moffs operand.
 #define DETOUR_SECTION_HEADER_SIGNATURE         0x00727444   // "Dtr\0"
 
 extern const GUID DETOUR_EXE_RESTORE_GUID;
@@ -374,6 +398,54 @@ typedef struct _DETOUR_TRAMPOLINE DETOUR_TRAMPOLINE, *PDETOUR_TRAMPOLINE;
 
 /////////////////////////////////////////////////////////// Binary Structures.
 //
+typedef struct _DETOUR_DECODED_INSTRUCTION
+{
+    PBYTE       pbCode;         // Address of the instruction.
+    PBYTE       pbTarget;       // Code target, same as DetourCopyInstruction's *ppTarget.
+    PBYTE       pbData;         // RIP-relative, [disp32] (x86) or moffs operand.
+    BYTE        cbInstruction;  // Length including prefixes.
+    BYTE        bReserved;
+    WORD        wFlags;         // DETOUR_DECODED_* flags.
+} DETOUR_DECODED_INSTRUCTION, *PDETOUR_DECODED_INSTRUCTION;
+
+typedef struct _DETOUR_DISASM_CONTEXT
+{
+    PBYTE       pbModuleBeg;                // Bounds for call/jmp [mem] slots.
+    PBYTE       pbModuleEnd;
+    BOOL        fLimitReferencesToModule;   // Slots outside the bounds are dynamic.
+} DETOUR_DISASM_CONTEXT, *PDETOUR_DISASM_CONTEXT;
+
+typedef struct _DETOUR_TRAMPOLINE_STATS
+{
+    ULONG       cRegionProbes;      // VirtualQuery calls made looking for room for a new region.
+    ULONG       cRegionsAllocated;
+    ULONG       cCaveProbes;        // VirtualQuery calls finding or re-checking a module.
+    ULONG       cCaveModules;       // Modules scanned for code caves.
+    ULONG       cCaveTrampolines;   // Trampolines placed in module padding.
+} DETOUR_TRAMPOLINE_STATS, *PDETOUR_TRAMPOLINE_STATS;
+
+typedef struct _DETOUR_COMMIT_STATS
+{
+    ULONG       cOperations;
+    ULONG       cThreads;                   // Threads suspended for the transaction.
+    ULONG       cVirtualProtect;            // Calls from DetourTransactionBegin through the commit.
+    ULONG       cFlushInstructionCache;
+    ULONG       cHotPatches;                // Operations through a hot-patch pad.
+    ULONG       cAtomicPatches;             // Operations written as one 8-byte store.
+    ULONG       cThreadsReleased;           // Resumed before patching, see DetourSetSelectiveSuspend.
+    ULONG       usAllStopped;               // First SuspendThread until any thread resumes.
+    ULONG       usSuspended;                // First SuspendThread until the last one resumes.
+} DETOUR_COMMIT_STATS, *PDETOUR_COMMIT_STATS;
+
+//  How the commit wrote an operation.  Only the first needs the other threads
+//  suspended; see DetourSetAtomicPatches.
+typedef enum _DETOUR_PATCH_PATH
+{
+    DETOUR_PATCH_SUSPENDED  = 0,    // Plain write, threads fixed up afterwards.
+    DETOUR_PATCH_HOTPATCH   = 1,    // jmp in the padding, 2-byte short jmp at the target.
+    DETOUR_PATCH_ATOMIC     = 2,    // Whole patch inside one aligned 8-byte word.
+} DETOUR_PATCH_PATH;
+
 #pragma pack(push, 8)
 typedef struct _DETOUR_SECTION_HEADER
 {
@@ -407,6 +479,7 @@ typedef struct _DETOUR_SECTION_RECORD
     GUID        guid;
 } DETOUR_SECTION_RECORD, *PDETOUR_SECTION_RECORD;
 
+#ifdef _WIN32
 typedef struct _DETOUR_CLR_HEADER
 {
     // Header versioning
@@ -470,6 +543,7 @@ typedef struct _DETOUR_EXE_HELPER
     DWORD               nDlls;
     CHAR                rDlls[4];
 } DETOUR_EXE_HELPER, *PDETOUR_EXE_HELPER;
+#endif // _WIN32
 
 #pragma pack(pop)
 
@@ -536,6 +610,13 @@ typedef BOOL (CALLBACK *PF_DETOUR_IMPORT_FUNC_CALLBACK_EX)(_In_opt_ PVOID pConte
                                                            _In_opt_ LPCSTR pszFunc,
                                                            _In_opt_ PVOID* ppvFunc);
 
+//  ppPointer is NULL for a call site; pTarget is the code that was patched.
+typedef BOOL (CALLBACK *PF_DETOUR_PATCH_CALLBACK)(_In_opt_ PVOID pContext,
+                                                  _In_opt_ PVOID *ppPointer,
+                                                  _In_ PVOID pTarget,
+                                                  _In_ BOOL fIsRemove,
+                                                  _In_ DETOUR_PATCH_PATH ePath);
+
 typedef VOID * PDETOUR_BINARY;
 typedef VOID * PDETOUR_LOADED_BINARY;
 
@@ -545,8 +626,27 @@ LONG WINAPI DetourTransactionBegin(VOID);
 LONG WINAPI DetourTransactionAbort(VOID);
 LONG WINAPI DetourTransactionCommit(VOID);
 LONG WINAPI DetourTransactionCommitEx(_Out_opt_ PVOID **pppFailedPointer);
+//  CommitEx that calls pfPatch once per operation, after the threads are
+//  resumed, with the path the commit took for it.
+LONG WINAPI DetourTransactionCommitReport(_Out_opt_ PVOID **pppFailedPointer,
+                                          _In_opt_ PVOID pContext,
+                                          _In_opt_ PF_DETOUR_PATCH_CALLBACK pfPatch);
+//  TRUE when every pending operation will be written without suspending
+//  threads, so DetourUpdateThread can be skipped for this transaction.
+//  FALSE as well once enough retired trampolines wait for a commit that
+//  suspends every thread.
+BOOL WINAPI DetourTransactionIsAtomic(VOID);
 
 LONG WINAPI DetourUpdateThread(_In_ HANDLE hThread);
+#ifdef DETOURS_LINUX
+//  DetourUpdateThread for every other thread in /proc/self/task, re-reading
+//  it until a pass finds no thread that isn't suspended yet.
+LONG WINAPI DetourUpdateAllThreads(VOID);
+#endif
+//  Tells the commit that every other thread went through DetourUpdateThread,
+//  so it may free retired trampolines (see DetourSetAtomicPatches).
+//  DetourUpdateAllThreads implies it.
+LONG WINAPI DetourSetAllThreadsUpdated(VOID);
 
 LONG WINAPI DetourAttach(_Inout_ PVOID *ppPointer,
                          _In_ PVOID pDetour);
@@ -560,8 +660,46 @@ LONG WINAPI DetourAttachEx(_Inout_ PVOID *ppPointer,
 LONG WINAPI DetourDetach(_Inout_ PVOID *ppPointer,
                          _In_ PVOID pDetour);
 
+//  Retarget a single call rel32, call [slot] or tail-call jmp (x86/x64 only).
+//  *ppOriginal receives the function the site called before the attach.
+LONG WINAPI DetourAttachCallSite(_In_ PVOID pCallSite,
+                                 _In_ PVOID pDetour,
+                                 _Out_opt_ PVOID *ppOriginal);
+LONG WINAPI DetourDetachCallSite(_In_ PVOID pCallSite,
+                                 _In_ PVOID pDetour);
+
+//  Trampoline-slot memory near pbNear for a caller-generated stub of at most
+//  one trampoline's size.  Only valid inside a transaction: the memory stays
+//  writable until the commit makes it executable.  A freed thunk is reused
+//  immediately, even if the transaction is later aborted.
+PVOID WINAPI DetourAllocateThunk(_In_ PVOID pbNear,
+                                 _In_ ULONG cbThunk);
+LONG WINAPI DetourFreeThunk(_In_ PVOID pThunk);
+
 BOOL WINAPI DetourSetIgnoreTooSmall(_In_ BOOL fIgnore);
 BOOL WINAPI DetourSetRetainRegions(_In_ BOOL fRetain);
+//  Place trampolines in int3/nop padding and section slack of the target's
+//  module before falling back to regions (x86/x64 only, off by default).
+//  Only for modules that stay loaded while hooked.
+BOOL WINAPI DetourSetCodeCaves(_In_ BOOL fCodeCaves);
+//  Attach and detach without suspending threads where one store can do it
+//  (x86/x64 only, off by default): a hot-patchable target (mov edi, edi on
+//  x86, a first instruction of 2+ bytes on x64, behind 5 bytes of int3/nop
+//  padding) or one whose first instruction alone covers the jmp inside an
+//  aligned 8-byte word.  Other operations keep the suspended path.  The
+//  trampoline of a hook removed this way may still be running on another
+//  thread, so it is kept until a later commit that suspends every thread
+//  finds no thread left in it.
+BOOL WINAPI DetourSetAtomicPatches(_In_ BOOL fAtomic);
+//  At commit, resume every suspended thread whose IP isn't in code the commit
+//  changes or frees, then patch behind a "jmp $" gate at each target so the
+//  released threads never run a half-written jmp (x86/x64 only, off by
+//  default).  Falls back to keeping all threads when a target's first two
+//  bytes straddle an 8-byte word.
+BOOL WINAPI DetourSetSelectiveSuspend(_In_ BOOL fSelective);
+VOID WINAPI DetourGetTrampolineStats(_Out_ PDETOUR_TRAMPOLINE_STATS pStats);
+//  Counters for the last (or pending) transaction.
+VOID WINAPI DetourGetCommitStats(_Out_ PDETOUR_COMMIT_STATS pStats);
 PVOID WINAPI DetourSetSystemRegionLowerBound(_In_ PVOID pSystemRegionLowerBound);
 PVOID WINAPI DetourSetSystemRegionUpperBound(_In_ PVOID pSystemRegionUpperBound);
 
@@ -578,11 +716,96 @@ PVOID WINAPI DetourCopyInstruction(_In_opt_ PVOID pDst,
                                    _Out_opt_ LONG *plExtra);
 BOOL WINAPI DetourSetCodeModule(_In_ HMODULE hModule,
                                 _In_ BOOL fLimitReferencesToModule);
+PVOID WINAPI DetourDecodeInstruction(_In_ PVOID pSrc,
+                                     _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction);
+ULONG WINAPI DetourDecodeInstructions(_In_ PVOID pSrc,
+                                      _In_ ULONG cbSrc,
+                                      _Out_writes_to_(cInstructions, return)
+                                      PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                      _In_ ULONG cInstructions);
+BOOL WINAPI DetourInitializeDisasmContext(_Out_ PDETOUR_DISASM_CONTEXT pContext,
+                                          _In_opt_ PVOID pvModuleBeg,
+                                          _In_opt_ PVOID pvModuleEnd,
+                                          _In_ BOOL fLimitReferencesToModule);
+PVOID WINAPI DetourCopyInstructionEx(_In_opt_ PVOID pDst,
+                                     _Inout_opt_ PVOID *ppDstPool,
+                                     _In_ PVOID pSrc,
+                                     _Out_opt_ PVOID *ppTarget,
+                                     _Out_opt_ LONG *plExtra,
+                                     _In_opt_ const DETOUR_DISASM_CONTEXT *pContext);
+PVOID WINAPI DetourDecodeInstructionEx(_In_ PVOID pSrc,
+                                       _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction,
+                                       _In_opt_ const DETOUR_DISASM_CONTEXT *pContext);
+ULONG WINAPI DetourDecodeInstructionsEx(_In_ PVOID pSrc,
+                                        _In_ ULONG cbSrc,
+                                        _Out_writes_to_(cInstructions, return)
+                                        PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                        _In_ ULONG cInstructions,
+                                        _In_opt_ const DETOUR_DISASM_CONTEXT *pContext);
+ULONG WINAPI DetourIsCodeFiller(_In_reads_bytes_(cbCode) PVOID pCode,
+                                _In_ ULONG cbCode);
 PVOID WINAPI DetourAllocateRegionWithinJumpBounds(_In_ LPCVOID pbTarget,
                                                   _Out_ PDWORD pcbAllocatedSize);
 
+//  Per-architecture disassemblers (disolx86.cpp, disolx64.cpp, ...), for
+//  code that is not native to the current process, such as a mapped file.
+//
+#define DETOUR_OFFLINE_LIBRARY(x)                                       \
+PVOID WINAPI DetourCopyInstruction##x(_In_opt_ PVOID pDst,              \
+                                      _Inout_opt_ PVOID *ppDstPool,     \
+                                      _In_ PVOID pSrc,                  \
+                                      _Out_opt_ PVOID *ppTarget,        \
+                                      _Out_opt_ LONG *plExtra);         \
+                                                                        \
+BOOL WINAPI DetourSetCodeModule##x(_In_ HMODULE hModule,                \
+                                   _In_ BOOL fLimitReferencesToModule); \
+                                                                        \
+PVOID WINAPI DetourDecodeInstruction##x(_In_ PVOID pSrc,                \
+                                        _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction); \
+                                                                        \
+ULONG WINAPI DetourDecodeInstructions##x(_In_ PVOID pSrc,               \
+                                         _In_ ULONG cbSrc,              \
+                                         _Out_writes_to_(cInstructions, return) \
+                                         PDETOUR_DECODED_INSTRUCTION pInstructions, \
+                                         _In_ ULONG cInstructions);     \
+                                                                        \
+BOOL WINAPI DetourInitializeDisasmContext##x(_Out_ PDETOUR_DISASM_CONTEXT pContext, \
+                                             _In_opt_ PVOID pvModuleBeg, \
+                                             _In_opt_ PVOID pvModuleEnd, \
+                                             _In_ BOOL fLimitReferencesToModule); \
+                                                                        \
+PVOID WINAPI DetourCopyInstructionEx##x(_In_opt_ PVOID pDst,            \
+                                        _Inout_opt_ PVOID *ppDstPool,   \
+                                        _In_ PVOID pSrc,                \
+                                        _Out_opt_ PVOID *ppTarget,      \
+                                        _Out_opt_ LONG *plExtra,        \
+                                        _In_opt_ const DETOUR_DISASM_CONTEXT *pContext); \
+                                                                        \
+PVOID WINAPI DetourDecodeInstructionEx##x(_In_ PVOID pSrc,              \
+                                          _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction, \
+                                          _In_opt_ const DETOUR_DISASM_CONTEXT *pContext); \
+                                                                        \
+ULONG WINAPI DetourDecodeInstructionsEx##x(_In_ PVOID pSrc,             \
+                                           _In_ ULONG cbSrc,            \
+                                           _Out_writes_to_(cInstructions, return) \
+                                           PDETOUR_DECODED_INSTRUCTION pInstructions, \
+                                           _In_ ULONG cInstructions,    \
+                                           _In_opt_ const DETOUR_DISASM_CONTEXT *pContext); \
+                                                                        \
+ULONG WINAPI DetourIsCodeFiller##x(_In_reads_bytes_(cbCode) PVOID pCode, \
+                                   _In_ ULONG cbCode);                  \
+
+DETOUR_OFFLINE_LIBRARY(X86)
+DETOUR_OFFLINE_LIBRARY(X64)
+DETOUR_OFFLINE_LIBRARY(ARM)
+DETOUR_OFFLINE_LIBRARY(ARM64)
+DETOUR_OFFLINE_LIBRARY(IA64)
+
+#undef DETOUR_OFFLINE_LIBRARY
+
 ///////////////////////////////////////////////////// Loaded Binary Functions.
 //
+#ifdef _WIN32
 HMODULE WINAPI DetourGetContainingModule(_In_ PVOID pvAddr);
 HMODULE WINAPI DetourEnumerateModules(_In_opt_ HMODULE hModuleLast);
 PVOID WINAPI DetourGetEntryPoint(_In_opt_ HMODULE hModule);
@@ -832,6 +1055,8 @@ VOID CALLBACK DetourFinishHelperProcess(_In_ HWND,
 
 //
 //////////////////////////////////////////////////////////////////////////////
+#endif // _WIN32
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -846,7 +1071,9 @@ VOID CALLBACK DetourFinishHelperProcess(_In_ HWND,
 
 //////////////////////////////////////////////////////////////////////////////
 //
-#if (_MSC_VER < 1299)
+#if !defined(_WIN32)
+// No symbol APIs; only the disassembler builds here.
+#elif (_MSC_VER < 1299)
 #include <imagehlp.h>
 typedef IMAGEHLP_MODULE IMAGEHLP_MODULE64;
 typedef PIMAGEHLP_MODULE PIMAGEHLP_MODULE64;
@@ -1079,24 +1306,6 @@ __declspec(align(16)) struct DETOUR_IA64_BUNDLE
 extern "C" {
 #endif // __cplusplus
 
-#define DETOUR_OFFLINE_LIBRARY(x)                                       \
-PVOID WINAPI DetourCopyInstruction##x(_In_opt_ PVOID pDst,              \
-                                      _Inout_opt_ PVOID *ppDstPool,     \
-                                      _In_ PVOID pSrc,                  \
-                                      _Out_opt_ PVOID *ppTarget,        \
-                                      _Out_opt_ LONG *plExtra);         \
-                                                                        \
-BOOL WINAPI DetourSetCodeModule##x(_In_ HMODULE hModule,                \
-                                   _In_ BOOL fLimitReferencesToModule); \
-
-DETOUR_OFFLINE_LIBRARY(X86)
-DETOUR_OFFLINE_LIBRARY(X64)
-DETOUR_OFFLINE_LIBRARY(ARM)
-DETOUR_OFFLINE_LIBRARY(ARM64)
-DETOUR_OFFLINE_LIBRARY(IA64)
-
-#undef DETOUR_OFFLINE_LIBRARY
-
 //////////////////////////////////////////////////////////////////////////////
 //
 // Helpers for manipulating page protection.
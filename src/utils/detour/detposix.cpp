@@ -0,0 +1,749 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Memory and Thread Functions for Linux (detposix.cpp of detours.lib)
+//
+//  Microsoft Research Detours Package, Version 4.0.1
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+
+//  The Win32 calls detours.cpp makes, over the Linux equivalents.  See
+//  detposix.h for what is (and isn't) emulated.
+//
+
+#define DETOURS_INTERNAL
+#include "detours.h"
+
+#ifdef DETOURS_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+//  Highest user address with 4-level paging; [vsyscall] lies above it.
+//
+const ULONG_PTR DETOUR_USER_LIMIT = (ULONG_PTR)0x800000000000;
+
+static ULONG_PTR detour_page_size()
+{
+    static ULONG_PTR s_cbPage = 0;
+    if (s_cbPage == 0) {
+        s_cbPage = (ULONG_PTR)sysconf(_SC_PAGESIZE);
+    }
+    return s_cbPage;
+}
+
+static DWORD detour_protect_from_perms(const char *pszPerms)
+{
+    bool fRead = pszPerms[0] == 'r';
+    bool fWrite = pszPerms[1] == 'w';
+    bool fExecute = pszPerms[2] == 'x';
+
+    if (fExecute) {
+        return fWrite ? PAGE_EXECUTE_READWRITE : (fRead ? PAGE_EXECUTE_READ : PAGE_EXECUTE);
+    }
+    return fWrite ? PAGE_READWRITE : (fRead ? PAGE_READONLY : PAGE_NOACCESS);
+}
+
+static int detour_prot_from_protect(DWORD dwProtect)
+{
+    switch (dwProtect & 0xff) {
+      case PAGE_READONLY:           return PROT_READ;
+      case PAGE_READWRITE:
+      case PAGE_WRITECOPY:          return PROT_READ | PROT_WRITE;
+      case PAGE_EXECUTE:            return PROT_EXEC;
+      case PAGE_EXECUTE_READ:       return PROT_READ | PROT_EXEC;
+      case PAGE_EXECUTE_READWRITE:
+      case PAGE_EXECUTE_WRITECOPY:  return PROT_READ | PROT_WRITE | PROT_EXEC;
+      default:                      return PROT_NONE;
+    }
+}
+
+static DWORD detour_error_from_errno(int nErrno)
+{
+    switch (nErrno) {
+      case ENOMEM:  return ERROR_NOT_ENOUGH_MEMORY;
+      case EACCES:
+      case EPERM:   return ERROR_DYNAMIC_CODE_BLOCKED;
+      case ESRCH:   return ERROR_INVALID_HANDLE;
+      default:      return ERROR_INVALID_PARAMETER;
+    }
+}
+
+///////////////////////////////////////////////////////////// /proc/self/maps.
+//
+struct DETOUR_MAPS_LINE
+{
+    ULONG_PTR   nStart;
+    ULONG_PTR   nEnd;
+    char        szPerms[5];
+    ULONG_PTR   nOffset;
+    ULONG_PTR   nDevice;
+    ULONG_PTR   nInode;
+};
+
+static const char * detour_parse_hex(const char *psz, ULONG_PTR *pnValue)
+{
+    ULONG_PTR nValue = 0;
+    for (;; psz++) {
+        char c = *psz;
+        if (c >= '0' && c <= '9') {
+            nValue = (nValue << 4) | (ULONG_PTR)(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f') {
+            nValue = (nValue << 4) | (ULONG_PTR)(c - 'a' + 10);
+        }
+        else {
+            break;
+        }
+    }
+    *pnValue = nValue;
+    return psz;
+}
+
+// "start-end perms offset major:minor inode path"
+static bool detour_parse_maps_line(const char *psz, DETOUR_MAPS_LINE *pLine)
+{
+    psz = detour_parse_hex(psz, &pLine->nStart);
+    if (*psz++ != '-') {
+        return false;
+    }
+    psz = detour_parse_hex(psz, &pLine->nEnd);
+    if (*psz++ != ' ') {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (*psz == '\0') {
+            return false;
+        }
+        pLine->szPerms[i] = *psz++;
+    }
+    pLine->szPerms[4] = '\0';
+    if (*psz++ != ' ') {
+        return false;
+    }
+    psz = detour_parse_hex(psz, &pLine->nOffset);
+    if (*psz++ != ' ') {
+        return false;
+    }
+    ULONG_PTR nMajor = 0;
+    ULONG_PTR nMinor = 0;
+    psz = detour_parse_hex(psz, &nMajor);
+    if (*psz++ != ':') {
+        return false;
+    }
+    psz = detour_parse_hex(psz, &nMinor);
+    pLine->nDevice = (nMajor << 32) | nMinor;
+    if (*psz++ != ' ') {
+        return false;
+    }
+    pLine->nInode = 0;
+    for (; *psz >= '0' && *psz <= '9'; psz++) {
+        pLine->nInode = pLine->nInode * 10 + (ULONG_PTR)(*psz - '0');
+    }
+    return true;
+}
+
+//  Reads /proc/self/maps with plain read(2) calls and a stack buffer, so it
+//  doesn't take the malloc or stdio locks a suspended thread might hold.
+//  Calls pfLine for each mapping until it returns false.
+//
+typedef bool (*PF_DETOUR_MAPS_LINE)(PVOID pContext, const DETOUR_MAPS_LINE *pLine);
+
+static bool detour_enumerate_maps(PVOID pContext, PF_DETOUR_MAPS_LINE pfLine)
+{
+    int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    char rbBuffer[4096];
+    size_t cbBuffer = 0;
+    bool fSkipping = false;         // Rest of a line too long for the buffer.
+    bool fDone = false;
+
+    while (!fDone) {
+        ssize_t cbRead = read(fd, rbBuffer + cbBuffer, sizeof(rbBuffer) - 1 - cbBuffer);
+        if (cbRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (cbRead <= 0) {
+            break;
+        }
+        cbBuffer += (size_t)cbRead;
+        rbBuffer[cbBuffer] = '\0';
+
+        char *pszLine = rbBuffer;
+        for (;;) {
+            char *pszEnd = (char *)memchr(pszLine, '\n', cbBuffer - (pszLine - rbBuffer));
+            if (pszEnd == NULL) {
+                break;
+            }
+            *pszEnd = '\0';
+
+            DETOUR_MAPS_LINE line;
+            if (!fSkipping && detour_parse_maps_line(pszLine, &line) && !pfLine(pContext, &line)) {
+                fDone = true;
+                break;
+            }
+            fSkipping = false;
+            pszLine = pszEnd + 1;
+        }
+
+        size_t cbLeft = cbBuffer - (pszLine - rbBuffer);
+        if (cbLeft == sizeof(rbBuffer) - 1) {
+            // The fields we want come first; parse them and drop the path.
+            DETOUR_MAPS_LINE line;
+            if (!fSkipping && detour_parse_maps_line(rbBuffer, &line) && !pfLine(pContext, &line)) {
+                fDone = true;
+            }
+            fSkipping = true;
+            cbLeft = 0;
+        }
+        memmove(rbBuffer, pszLine, cbLeft);
+        cbBuffer = cbLeft;
+    }
+
+    close(fd);
+    return true;
+}
+
+struct DETOUR_QUERY
+{
+    ULONG_PTR                   nAddress;
+    PMEMORY_BASIC_INFORMATION   pmbi;
+    bool                        fFound;
+    ULONG_PTR                   nFree;          // Start of the gap before the current line.
+    ULONG_PTR                   nImage;         // Lowest mapping of the last file seen at offset 0.
+    ULONG_PTR                   nImageDevice;
+    ULONG_PTR                   nImageInode;
+};
+
+static bool detour_query_line(PVOID pContext, const DETOUR_MAPS_LINE *pLine)
+{
+    DETOUR_QUERY *pQuery = (DETOUR_QUERY *)pContext;
+    PMEMORY_BASIC_INFORMATION pmbi = pQuery->pmbi;
+
+    if (pLine->nStart >= DETOUR_USER_LIMIT) {
+        return false;
+    }
+    if (pLine->nInode != 0 && pLine->nOffset == 0) {
+        pQuery->nImage = pLine->nStart;
+        pQuery->nImageDevice = pLine->nDevice;
+        pQuery->nImageInode = pLine->nInode;
+    }
+
+    if (pQuery->nAddress < pLine->nStart) {
+        // In the gap below this mapping.
+        pQuery->fFound = true;
+        pmbi->BaseAddress = (PVOID)pQuery->nFree;
+        pmbi->AllocationBase = (PVOID)pQuery->nFree;
+        pmbi->RegionSize = pLine->nStart - pQuery->nFree;
+        pmbi->State = MEM_FREE;
+        pmbi->Protect = PAGE_NOACCESS;
+        return false;
+    }
+    if (pQuery->nAddress < pLine->nEnd) {
+        pQuery->fFound = true;
+        bool fImage = (pLine->nInode != 0 &&
+                       pLine->nInode == pQuery->nImageInode &&
+                       pLine->nDevice == pQuery->nImageDevice);
+        pmbi->BaseAddress = (PVOID)pLine->nStart;
+        pmbi->AllocationBase = (PVOID)(fImage ? pQuery->nImage : pLine->nStart);
+        pmbi->RegionSize = pLine->nEnd - pLine->nStart;
+        pmbi->State = MEM_COMMIT;
+        pmbi->Protect = detour_protect_from_perms(pLine->szPerms);
+        pmbi->AllocationProtect = pmbi->Protect;
+        pmbi->Type = (pLine->nInode != 0) ? MEM_IMAGE : MEM_PRIVATE;
+        return false;
+    }
+    pQuery->nFree = pLine->nEnd;
+    return true;
+}
+
+HANDLE GetCurrentProcess()
+{
+    return (HANDLE)(LONG_PTR)-1;
+}
+
+HANDLE GetCurrentThread()
+{
+    return (HANDLE)(LONG_PTR)-2;
+}
+
+DWORD GetCurrentThreadId()
+{
+    return (DWORD)syscall(SYS_gettid);
+}
+
+BOOL QueryPerformanceCounter(PLARGE_INTEGER pllCount)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    pllCount->QuadPart = (LONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(PLARGE_INTEGER pllFrequency)
+{
+    pllFrequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+SIZE_T VirtualQuery(LPCVOID pvAddress, PMEMORY_BASIC_INFORMATION pmbi, SIZE_T cbmbi)
+{
+    ULONG_PTR nAddress = (ULONG_PTR)pvAddress & ~(detour_page_size() - 1);
+    if (cbmbi < sizeof(*pmbi) || nAddress >= DETOUR_USER_LIMIT) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    DETOUR_QUERY query;
+    ZeroMemory(&query, sizeof(query));
+    query.nAddress = nAddress;
+    query.pmbi = pmbi;
+
+    ZeroMemory(pmbi, sizeof(*pmbi));
+    if (!detour_enumerate_maps(&query, detour_query_line)) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return 0;
+    }
+    if (!query.fFound) {
+        // Above the last mapping.
+        pmbi->BaseAddress = (PVOID)query.nFree;
+        pmbi->AllocationBase = (PVOID)query.nFree;
+        pmbi->RegionSize = DETOUR_USER_LIMIT - query.nFree;
+        pmbi->State = MEM_FREE;
+        pmbi->Protect = PAGE_NOACCESS;
+    }
+    return sizeof(*pmbi);
+}
+
+SIZE_T VirtualQueryEx(HANDLE hProcess, LPCVOID pvAddress,
+                      PMEMORY_BASIC_INFORMATION pmbi, SIZE_T cbmbi)
+{
+    if (hProcess != GetCurrentProcess()) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return 0;
+    }
+    return VirtualQuery(pvAddress, pmbi, cbmbi);
+}
+
+///////////////////////////////////////////////////////////////// Allocation.
+//
+//  munmap needs the size VirtualFree(MEM_RELEASE) doesn't pass, and adjacent
+//  anonymous mappings merge in /proc/self/maps, so remember each one.
+//
+struct DETOUR_ALLOCATION
+{
+    PVOID   pvBase;
+    SIZE_T  cbSize;
+};
+
+const ULONG DETOUR_MAX_ALLOCATIONS = 4096;
+
+static DETOUR_ALLOCATION    s_rAllocations[DETOUR_MAX_ALLOCATIONS];
+static ULONG                s_cAllocations = 0;
+static pthread_mutex_t      s_AllocationLock = PTHREAD_MUTEX_INITIALIZER;
+
+PVOID VirtualAlloc(PVOID pvAddress, SIZE_T cbSize, DWORD dwType, DWORD dwProtect)
+{
+    UNREFERENCED_PARAMETER(dwType);
+
+    ULONG_PTR cbPage = detour_page_size();
+    if (cbSize == 0 || ((ULONG_PTR)pvAddress & (cbPage - 1)) != 0) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+    cbSize = (cbSize + cbPage - 1) & ~(cbPage - 1);
+
+    pthread_mutex_lock(&s_AllocationLock);
+    if (s_cAllocations == DETOUR_MAX_ALLOCATIONS) {
+        pthread_mutex_unlock(&s_AllocationLock);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (pvAddress != NULL ? MAP_FIXED_NOREPLACE : 0);
+    PVOID pv = mmap(pvAddress, cbSize, detour_prot_from_protect(dwProtect), flags, -1, 0);
+    if (pv == MAP_FAILED) {
+        DWORD dwError = (errno == EEXIST) ? ERROR_INVALID_PARAMETER : detour_error_from_errno(errno);
+        pthread_mutex_unlock(&s_AllocationLock);
+        SetLastError(dwError);
+        return NULL;
+    }
+    if (pvAddress != NULL && pv != pvAddress) {
+        // Kernels before 4.17 take MAP_FIXED_NOREPLACE as a hint.
+        munmap(pv, cbSize);
+        pthread_mutex_unlock(&s_AllocationLock);
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    s_rAllocations[s_cAllocations].pvBase = pv;
+    s_rAllocations[s_cAllocations].cbSize = cbSize;
+    s_cAllocations++;
+    pthread_mutex_unlock(&s_AllocationLock);
+    return pv;
+}
+
+BOOL VirtualFree(PVOID pvAddress, SIZE_T cbSize, DWORD dwType)
+{
+    if (dwType != MEM_RELEASE || cbSize != 0) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&s_AllocationLock);
+    for (ULONG n = 0; n < s_cAllocations; n++) {
+        if (s_rAllocations[n].pvBase == pvAddress) {
+            munmap(pvAddress, s_rAllocations[n].cbSize);
+            s_rAllocations[n] = s_rAllocations[--s_cAllocations];
+            pthread_mutex_unlock(&s_AllocationLock);
+            return TRUE;
+        }
+    }
+    pthread_mutex_unlock(&s_AllocationLock);
+
+    SetLastError(ERROR_INVALID_PARAMETER);
+    return FALSE;
+}
+
+BOOL VirtualProtect(PVOID pvAddress, SIZE_T cbSize, DWORD dwProtect, PDWORD pdwOld)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    if (VirtualQuery(pvAddress, &mbi, sizeof(mbi)) == 0 || mbi.State != MEM_COMMIT) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    ULONG_PTR cbPage = detour_page_size();
+    ULONG_PTR nBeg = (ULONG_PTR)pvAddress & ~(cbPage - 1);
+    ULONG_PTR nEnd = ((ULONG_PTR)pvAddress + cbSize + cbPage - 1) & ~(cbPage - 1);
+    if (mprotect((PVOID)nBeg, nEnd - nBeg, detour_prot_from_protect(dwProtect)) != 0) {
+        SetLastError(detour_error_from_errno(errno));
+        return FALSE;
+    }
+
+    if (pdwOld != NULL) {
+        *pdwOld = mbi.Protect;
+    }
+    return TRUE;
+}
+
+BOOL VirtualProtectEx(HANDLE hProcess, PVOID pvAddress, SIZE_T cbSize,
+                      DWORD dwProtect, PDWORD pdwOld)
+{
+    if (hProcess != GetCurrentProcess()) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    return VirtualProtect(pvAddress, cbSize, dwProtect, pdwOld);
+}
+
+BOOL FlushInstructionCache(HANDLE hProcess, LPCVOID pvAddress, SIZE_T cbSize)
+{
+    UNREFERENCED_PARAMETER(hProcess);
+
+    // x86 keeps the icache coherent; this only orders the compiler.
+    __builtin___clear_cache((char *)pvAddress, (char *)pvAddress + cbSize);
+    return TRUE;
+}
+
+//////////////////////////////////////////////////////////////// Suspension.
+//
+//  A suspended thread sits in detour_suspend_handler on its own stack, in
+//  a DETOUR_SUSPENDED that SuspendThread links into s_pSuspended.  The
+//  handshake uses plain atomics and futexes; the handler is async-signal
+//  safe.
+//
+struct DETOUR_SUSPENDED
+{
+    DWORD               dwThreadId;
+    DWORD               cSuspend;
+    ucontext_t *        puc;
+    int                 nResume;        // Futex; the handler returns once it is 1.
+    DETOUR_SUSPENDED *  pNext;
+};
+
+#define DETOUR_SUSPEND_ABANDONED ((DETOUR_SUSPENDED *)1)
+
+static DETOUR_SUSPENDED *   s_pSuspended        = NULL;
+static pthread_mutex_t      s_SuspendLock       = PTHREAD_MUTEX_INITIALIZER;
+static bool                 s_fSuspendHandler   = false;
+
+// Handshake for the one SuspendThread in flight.
+static DWORD                s_dwSuspendTarget   = 0;
+static DETOUR_SUSPENDED *   s_pSuspendAck       = NULL;
+static int                  s_nSuspendAcks      = 0;    // Futex.
+
+static long detour_futex(int *pnWord, int op, int nValue, const struct timespec *pTimeout)
+{
+    return syscall(SYS_futex, pnWord, op, nValue, pTimeout, NULL, 0);
+}
+
+static void detour_suspend_handler(int nSignal, siginfo_t *pInfo, void *pvContext)
+{
+    UNREFERENCED_PARAMETER(nSignal);
+    UNREFERENCED_PARAMETER(pInfo);
+
+    int nErrno = errno;
+    DWORD dwThreadId = (DWORD)syscall(SYS_gettid);
+
+    // A signal left over from a SuspendThread that gave up is ignored.
+    if (__atomic_load_n(&s_dwSuspendTarget, __ATOMIC_ACQUIRE) == dwThreadId) {
+        DETOUR_SUSPENDED suspended = { dwThreadId, 1, (ucontext_t *)pvContext, 0, NULL };
+        DETOUR_SUSPENDED *pExpected = NULL;
+        if (__atomic_compare_exchange_n(&s_pSuspendAck, &pExpected, &suspended, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_add_fetch(&s_nSuspendAcks, 1, __ATOMIC_RELEASE);
+            detour_futex(&s_nSuspendAcks, FUTEX_WAKE_PRIVATE, 1, NULL);
+
+            while (__atomic_load_n(&suspended.nResume, __ATOMIC_ACQUIRE) == 0) {
+                detour_futex(&suspended.nResume, FUTEX_WAIT_PRIVATE, 0, NULL);
+            }
+        }
+    }
+    errno = nErrno;
+}
+
+static bool detour_install_suspend_handler()
+{
+    if (s_fSuspendHandler) {
+        return true;
+    }
+
+    struct sigaction action;
+    ZeroMemory(&action, sizeof(action));
+    action.sa_sigaction = detour_suspend_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigfillset(&action.sa_mask);
+    if (sigaction(DETOUR_SUSPEND_SIGNAL, &action, NULL) != 0) {
+        return false;
+    }
+    s_fSuspendHandler = true;
+    return true;
+}
+
+static DETOUR_SUSPENDED * detour_find_suspended(DWORD dwThreadId, DETOUR_SUSPENDED ***pppPrev)
+{
+    DETOUR_SUSPENDED **ppPrev = &s_pSuspended;
+    for (DETOUR_SUSPENDED *p = s_pSuspended; p != NULL; ppPrev = &p->pNext, p = p->pNext) {
+        if (p->dwThreadId == dwThreadId) {
+            if (pppPrev != NULL) {
+                *pppPrev = ppPrev;
+            }
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Waits for the handler's ack; returns it, or NULL after the timeout.
+static DETOUR_SUSPENDED * detour_wait_suspend_ack(int nAcks)
+{
+    struct timespec tsNow;
+    clock_gettime(CLOCK_MONOTONIC, &tsNow);
+    LONGLONG nDeadline = (LONGLONG)tsNow.tv_sec * 1000000000 + tsNow.tv_nsec
+        + (LONGLONG)DETOUR_SUSPEND_TIMEOUT_MS * 1000000;
+
+    for (;;) {
+        DETOUR_SUSPENDED *p = __atomic_load_n(&s_pSuspendAck, __ATOMIC_ACQUIRE);
+        if (p != NULL) {
+            return p;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &tsNow);
+        LONGLONG nLeft = nDeadline - ((LONGLONG)tsNow.tv_sec * 1000000000 + tsNow.tv_nsec);
+        if (nLeft <= 0) {
+            // Give up, unless the handler got there first.
+            DETOUR_SUSPENDED *pExpected = NULL;
+            if (__atomic_compare_exchange_n(&s_pSuspendAck, &pExpected, DETOUR_SUSPEND_ABANDONED,
+                                            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return NULL;
+            }
+            return pExpected;
+        }
+
+        struct timespec tsLeft = { (time_t)(nLeft / 1000000000), (long)(nLeft % 1000000000) };
+        detour_futex(&s_nSuspendAcks, FUTEX_WAIT_PRIVATE, nAcks, &tsLeft);
+    }
+}
+
+DWORD SuspendThread(HANDLE hThread)
+{
+    DWORD dwThreadId = (DWORD)(ULONG_PTR)hThread;
+    if (hThread == GetCurrentThread() || dwThreadId == GetCurrentThreadId()) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return (DWORD)-1;
+    }
+
+    pthread_mutex_lock(&s_SuspendLock);
+
+    DETOUR_SUSPENDED *p = detour_find_suspended(dwThreadId, NULL);
+    if (p != NULL) {
+        DWORD cPrevious = p->cSuspend++;
+        pthread_mutex_unlock(&s_SuspendLock);
+        return cPrevious;
+    }
+
+    if (!detour_install_suspend_handler()) {
+        pthread_mutex_unlock(&s_SuspendLock);
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return (DWORD)-1;
+    }
+
+    int nAcks = __atomic_load_n(&s_nSuspendAcks, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&s_pSuspendAck, (DETOUR_SUSPENDED *)NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&s_dwSuspendTarget, dwThreadId, __ATOMIC_RELEASE);
+
+    DWORD dwError = NO_ERROR;
+    if (syscall(SYS_tgkill, getpid(), dwThreadId, DETOUR_SUSPEND_SIGNAL) != 0) {
+        // A thread that has already exited won't run anything either.
+        dwError = (errno == ESRCH) ? NO_ERROR : detour_error_from_errno(errno);
+        p = NULL;
+    }
+    else {
+        p = detour_wait_suspend_ack(nAcks);
+        if (p == NULL) {
+            dwError = ERROR_TIMEOUT;
+        }
+    }
+    __atomic_store_n(&s_dwSuspendTarget, (DWORD)0, __ATOMIC_RELEASE);
+
+    if (p != NULL) {
+        p->pNext = s_pSuspended;
+        s_pSuspended = p;
+    }
+    pthread_mutex_unlock(&s_SuspendLock);
+
+    if (dwError != NO_ERROR) {
+        SetLastError(dwError);
+        return (DWORD)-1;
+    }
+    return 0;
+}
+
+DWORD ResumeThread(HANDLE hThread)
+{
+    pthread_mutex_lock(&s_SuspendLock);
+
+    DETOUR_SUSPENDED **ppPrev = NULL;
+    DETOUR_SUSPENDED *p = detour_find_suspended((DWORD)(ULONG_PTR)hThread, &ppPrev);
+    if (p == NULL) {
+        pthread_mutex_unlock(&s_SuspendLock);
+        SetLastError(ERROR_INVALID_HANDLE);
+        return (DWORD)-1;
+    }
+
+    DWORD cPrevious = p->cSuspend--;
+    if (p->cSuspend == 0) {
+        *ppPrev = p->pNext;
+        // p lives on the thread's stack; don't touch it after the store.
+        __atomic_store_n(&p->nResume, 1, __ATOMIC_RELEASE);
+        detour_futex(&p->nResume, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+
+    pthread_mutex_unlock(&s_SuspendLock);
+    return cPrevious;
+}
+
+BOOL GetThreadContext(HANDLE hThread, PCONTEXT pContext)
+{
+    pthread_mutex_lock(&s_SuspendLock);
+
+    DETOUR_SUSPENDED *p = detour_find_suspended((DWORD)(ULONG_PTR)hThread, NULL);
+    if (p != NULL) {
+        pContext->Rip = (DWORD64)p->puc->uc_mcontext.gregs[REG_RIP];
+        pContext->Rsp = (DWORD64)p->puc->uc_mcontext.gregs[REG_RSP];
+    }
+
+    pthread_mutex_unlock(&s_SuspendLock);
+
+    if (p == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL SetThreadContext(HANDLE hThread, const CONTEXT *pContext)
+{
+    pthread_mutex_lock(&s_SuspendLock);
+
+    DETOUR_SUSPENDED *p = detour_find_suspended((DWORD)(ULONG_PTR)hThread, NULL);
+    if (p != NULL) {
+        p->puc->uc_mcontext.gregs[REG_RIP] = (greg_t)pContext->Rip;
+        p->puc->uc_mcontext.gregs[REG_RSP] = (greg_t)pContext->Rsp;
+    }
+
+    pthread_mutex_unlock(&s_SuspendLock);
+
+    if (p == NULL) {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+////////////////////////////////////////////////////////// Thread Enumeration.
+//
+struct DETOUR_DIRENT64
+{
+    ULONGLONG       d_ino;
+    LONGLONG        d_off;
+    USHORT          d_reclen;
+    BYTE            d_type;
+    char            d_name[1];
+};
+
+BOOL DetourPosixEnumerateThreads(PVOID pContext,
+                                 PF_DETOUR_ENUMERATE_THREAD_CALLBACK pfThread)
+{
+    int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    alignas(8) char rbBuffer[4096];
+    for (;;) {
+        long cbRead = syscall(SYS_getdents64, fd, rbBuffer, sizeof(rbBuffer));
+        if (cbRead <= 0) {
+            break;
+        }
+        for (long ib = 0; ib < cbRead;) {
+            DETOUR_DIRENT64 *pEntry = (DETOUR_DIRENT64 *)(rbBuffer + ib);
+            ib += pEntry->d_reclen;
+
+            DWORD dwThreadId = 0;
+            const char *psz = pEntry->d_name;
+            for (; *psz >= '0' && *psz <= '9'; psz++) {
+                dwThreadId = dwThreadId * 10 + (DWORD)(*psz - '0');
+            }
+            if (*psz != '\0' || dwThreadId == 0) {
+                continue;                           // "." and ".."
+            }
+            if (!pfThread(pContext, dwThreadId)) {
+                close(fd);
+                return TRUE;
+            }
+        }
+    }
+
+    close(fd);
+    return TRUE;
+}
+
+#endif // DETOURS_LINUX
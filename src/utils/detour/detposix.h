@@ -0,0 +1,239 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Win32 Types for Non-Windows Builds (detposix.h of detours.lib)
+//
+//  Microsoft Research Detours Package, Version 4.0.1
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+
+//  Outside Windows the x86/x64 disassembler builds everywhere; it is used
+//  to analyze PE files mapped from disk.  This header supplies the handful
+//  of Win32 types, calling-convention macros and error codes that detours.h
+//  and disasm.cpp need, and maps the compiler's architecture macros onto
+//  the ones detours.h expects.  Nothing here is meant to match the Windows
+//  SDK beyond that.
+//
+//  On Linux x86-64 the transaction API (detours.cpp) builds as well.  The
+//  second half of this header declares the memory and thread functions it
+//  calls, implemented over mmap, mprotect, /proc/self/maps and signals in
+//  detposix.cpp.
+//
+
+#pragma once
+#ifndef _DETPOSIX_H_
+#define _DETPOSIX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#ifndef _AMD64_
+#define _AMD64_
+#endif
+#define DETOURS_POSIX_64BIT 1
+#elif defined(__i386__)
+#ifndef _X86_
+#define _X86_
+#endif
+#elif defined(__aarch64__)
+#ifndef _ARM64_
+#define _ARM64_
+#endif
+#define DETOURS_POSIX_64BIT 1
+#endif
+
+#define WINAPI
+#define CALLBACK
+#define UNALIGNED
+#define VOID                void
+
+#ifndef TRUE
+#define TRUE                1
+#endif
+#ifndef FALSE
+#define FALSE               0
+#endif
+
+typedef int                 BOOL;
+typedef BOOL *              PBOOL;
+typedef unsigned char       BYTE;
+typedef BYTE *              PBYTE;
+typedef char                CHAR;
+typedef short               SHORT;
+typedef unsigned short      WORD;
+typedef unsigned short      USHORT;
+typedef int                 INT;
+typedef unsigned int        UINT;
+typedef int32_t             INT32;
+typedef int32_t             LONG;
+typedef LONG *              PLONG;
+typedef uint32_t            ULONG;
+typedef ULONG *             PULONG;
+typedef uint32_t            DWORD;
+typedef DWORD *             PDWORD;
+typedef DWORD *             LPDWORD;
+typedef int64_t             LONGLONG;
+typedef uint64_t            ULONGLONG;
+typedef uint64_t            UINT64;
+typedef uint64_t            DWORD64;
+typedef intptr_t            LONG_PTR;
+typedef uintptr_t           ULONG_PTR;
+typedef uintptr_t           DWORD_PTR;
+typedef uintptr_t           SIZE_T;
+typedef void *              PVOID;
+typedef void *              LPVOID;
+typedef const void *        LPCVOID;
+typedef void *              HANDLE;
+typedef void *              HMODULE;
+typedef char *              LPSTR;
+typedef const char *        LPCSTR;
+
+#define NO_ERROR                    0L
+#define ERROR_INVALID_HANDLE        6L
+#define ERROR_NOT_ENOUGH_MEMORY     8L
+#define ERROR_INVALID_BLOCK         9L
+#define ERROR_INVALID_DATA          13L
+#define ERROR_NOT_SUPPORTED         50L
+#define ERROR_INVALID_PARAMETER     87L
+#define ERROR_TIMEOUT               1460L
+#define ERROR_INVALID_OPERATION     4317L
+
+#define CopyMemory(d, s, n)         memcpy((d), (s), (n))
+#define MoveMemory(d, s, n)         memmove((d), (s), (n))
+#define ZeroMemory(d, n)            memset((d), 0, (n))
+#define PtrToUlong(p)               ((ULONG)(ULONG_PTR)(p))
+#define UNREFERENCED_PARAMETER(P)   ((void)(P))
+#define C_ASSERT(e)                 static_assert(e, #e)
+
+//  Only the IA64 bundle uses __declspec(align(16)), and the IA64
+//  disassembler never builds here.
+//
+#define __declspec(x)
+
+//  Last-error value, per thread as on Windows.
+//
+inline DWORD& DetourPosixLastError()
+{
+    static thread_local DWORD s_dwLastError = 0;
+    return s_dwLastError;
+}
+
+inline void SetLastError(DWORD dwErrCode)
+{
+    DetourPosixLastError() = dwErrCode;
+}
+
+inline DWORD GetLastError()
+{
+    return DetourPosixLastError();
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+#define DETOURS_LINUX 1
+
+//////////////////////////////////////////////// Memory and Thread Functions.
+//
+//  Just enough of VirtualAlloc, VirtualQuery, SuspendThread and friends for
+//  detours.cpp.  Only the current process is supported.
+//
+//  A thread HANDLE is the kernel thread id cast to a pointer, e.g.
+//  (HANDLE)(ULONG_PTR)gettid().  GetCurrentThread() returns a pseudo handle
+//  that DetourUpdateThread ignores, as on Windows.
+//
+//  SuspendThread sends the thread DETOUR_SUSPEND_SIGNAL and waits until the
+//  handler has parked it; the handler keeps the interrupted context so that
+//  SetThreadContext can move the thread's Rip before ResumeThread lets it
+//  return.  A thread that blocks the signal can't be suspended.  A thread
+//  that has already exited counts as suspended.
+//
+#define DETOUR_SUSPEND_SIGNAL       (SIGRTMIN + 5)
+#define DETOUR_SUSPEND_TIMEOUT_MS   1000
+
+#define MEM_COMMIT                  0x00001000
+#define MEM_RESERVE                 0x00002000
+#define MEM_RELEASE                 0x00008000
+#define MEM_FREE                    0x00010000
+#define MEM_PRIVATE                 0x00020000
+#define MEM_IMAGE                   0x01000000
+
+#define PAGE_NOACCESS               0x01
+#define PAGE_READONLY               0x02
+#define PAGE_READWRITE              0x04
+#define PAGE_WRITECOPY              0x08
+#define PAGE_EXECUTE                0x10
+#define PAGE_EXECUTE_READ           0x20
+#define PAGE_EXECUTE_READWRITE      0x40
+#define PAGE_EXECUTE_WRITECOPY      0x80
+
+#define CONTEXT_CONTROL             0x00100001
+
+typedef struct _MEMORY_BASIC_INFORMATION
+{
+    PVOID   BaseAddress;
+    PVOID   AllocationBase;     // Lowest mapping of the same file, or BaseAddress.
+    DWORD   AllocationProtect;
+    SIZE_T  RegionSize;
+    DWORD   State;              // MEM_COMMIT or MEM_FREE.
+    DWORD   Protect;
+    DWORD   Type;               // MEM_IMAGE for file mappings, else MEM_PRIVATE.
+} MEMORY_BASIC_INFORMATION, *PMEMORY_BASIC_INFORMATION;
+
+typedef struct _CONTEXT
+{
+    DWORD   ContextFlags;
+    DWORD64 Rip;
+    DWORD64 Rsp;
+} CONTEXT, *PCONTEXT;
+
+HANDLE  GetCurrentProcess();
+HANDLE  GetCurrentThread();
+DWORD   GetCurrentThreadId();
+
+//  CLOCK_MONOTONIC in nanoseconds.
+typedef union _LARGE_INTEGER
+{
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+BOOL    QueryPerformanceCounter(PLARGE_INTEGER pllCount);
+BOOL    QueryPerformanceFrequency(PLARGE_INTEGER pllFrequency);
+
+PVOID   VirtualAlloc(PVOID pvAddress, SIZE_T cbSize, DWORD dwType, DWORD dwProtect);
+BOOL    VirtualFree(PVOID pvAddress, SIZE_T cbSize, DWORD dwType);
+SIZE_T  VirtualQuery(LPCVOID pvAddress, PMEMORY_BASIC_INFORMATION pmbi, SIZE_T cbmbi);
+BOOL    VirtualProtect(PVOID pvAddress, SIZE_T cbSize, DWORD dwProtect, PDWORD pdwOld);
+SIZE_T  VirtualQueryEx(HANDLE hProcess, LPCVOID pvAddress,
+                       PMEMORY_BASIC_INFORMATION pmbi, SIZE_T cbmbi);
+BOOL    VirtualProtectEx(HANDLE hProcess, PVOID pvAddress, SIZE_T cbSize,
+                         DWORD dwProtect, PDWORD pdwOld);
+BOOL    FlushInstructionCache(HANDLE hProcess, LPCVOID pvAddress, SIZE_T cbSize);
+
+DWORD   SuspendThread(HANDLE hThread);
+DWORD   ResumeThread(HANDLE hThread);
+BOOL    GetThreadContext(HANDLE hThread, PCONTEXT pContext);
+BOOL    SetThreadContext(HANDLE hThread, const CONTEXT *pContext);
+
+//  Calls pfThread with the id of each thread in the process, from
+//  /proc/self/task, until it returns FALSE.  Doesn't allocate memory.
+//
+typedef BOOL (CALLBACK *PF_DETOUR_ENUMERATE_THREAD_CALLBACK)(PVOID pContext, DWORD dwThreadId);
+BOOL    DetourPosixEnumerateThreads(PVOID pContext,
+                                    PF_DETOUR_ENUMERATE_THREAD_CALLBACK pfThread);
+
+inline LONG InterlockedCompareExchange(LONG volatile *plDest, LONG lExchange, LONG lComparand)
+{
+    return __sync_val_compare_and_swap(plDest, lComparand, lExchange);
+}
+
+inline LONGLONG InterlockedCompareExchange64(LONGLONG volatile *pllDest, LONGLONG llExchange, LONGLONG llComparand)
+{
+    return __sync_val_compare_and_swap(pllDest, llComparand, llExchange);
+}
+
+#define __debugbreak()  __builtin_trap()
+
+#endif // __linux__ && __x86_64__
+
+#endif // _DETPOSIX_H_
@@ -42,6 +42,13 @@
 
 #define DetourCopyInstruction   DetourCopyInstructionX86
 #define DetourSetCodeModule     DetourSetCodeModuleX86
+#define DetourDecodeInstruction DetourDecodeInstructionX86
+#define DetourDecodeInstructions DetourDecodeInstructionsX86
+#define DetourCopyInstructionEx DetourCopyInstructionExX86
+#define DetourDecodeInstructionEx DetourDecodeInstructionExX86
+#define DetourDecodeInstructionsEx DetourDecodeInstructionsExX86
+#define DetourInitializeDisasmContext DetourInitializeDisasmContextX86
+#define DetourIsCodeFiller      DetourIsCodeFillerX86
 #define CDetourDis              CDetourDisX86
 #define DETOURS_X86
 
@@ -54,6 +61,13 @@
 
 #define DetourCopyInstruction   DetourCopyInstructionX64
 #define DetourSetCodeModule     DetourSetCodeModuleX64
+#define DetourDecodeInstruction DetourDecodeInstructionX64
+#define DetourDecodeInstructions DetourDecodeInstructionsX64
+#define DetourCopyInstructionEx DetourCopyInstructionExX64
+#define DetourDecodeInstructionEx DetourDecodeInstructionExX64
+#define DetourDecodeInstructionsEx DetourDecodeInstructionsExX64
+#define DetourInitializeDisasmContext DetourInitializeDisasmContextX64
+#define DetourIsCodeFiller      DetourIsCodeFillerX64
 #define CDetourDis              CDetourDisX64
 #define DETOURS_X64
 
@@ -61,6 +75,12 @@
 
 #define DetourCopyInstruction   DetourCopyInstructionARM
 #define DetourSetCodeModule     DetourSetCodeModuleARM
+#define DetourDecodeInstruction DetourDecodeInstructionARM
+#define DetourDecodeInstructions DetourDecodeInstructionsARM
+#define DetourCopyInstructionEx DetourCopyInstructionExARM
+#define DetourDecodeInstructionEx DetourDecodeInstructionExARM
+#define DetourDecodeInstructionsEx DetourDecodeInstructionsExARM
+#define DetourInitializeDisasmContext DetourInitializeDisasmContextARM
 #define CDetourDis              CDetourDisARM
 #define DETOURS_ARM
 
@@ -68,6 +88,12 @@
 
 #define DetourCopyInstruction   DetourCopyInstructionARM64
 #define DetourSetCodeModule     DetourSetCodeModuleARM64
+#define DetourDecodeInstruction DetourDecodeInstructionARM64
+#define DetourDecodeInstructions DetourDecodeInstructionsARM64
+#define DetourCopyInstructionEx DetourCopyInstructionExARM64
+#define DetourDecodeInstructionEx DetourDecodeInstructionExARM64
+#define DetourDecodeInstructionsEx DetourDecodeInstructionsExARM64
+#define DetourInitializeDisasmContext DetourInitializeDisasmContextARM64
 #define CDetourDis              CDetourDisARM64
 #define DETOURS_ARM64
 
@@ -75,6 +101,12 @@
 
 #define DetourCopyInstruction   DetourCopyInstructionIA64
 #define DetourSetCodeModule     DetourSetCodeModuleIA64
+#define DetourDecodeInstruction DetourDecodeInstructionIA64
+#define DetourDecodeInstructions DetourDecodeInstructionsIA64
+#define DetourCopyInstructionEx DetourCopyInstructionExIA64
+#define DetourDecodeInstructionEx DetourDecodeInstructionExIA64
+#define DetourDecodeInstructionsEx DetourDecodeInstructionsExIA64
+#define DetourInitializeDisasmContext DetourInitializeDisasmContextIA64
 #define DETOURS_IA64
 
 #else
@@ -143,6 +175,56 @@
 //      targets remain constant.  It does so by adjusting any IP relative
 //      offsets.
 //
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Function:
+//      DetourDecodeInstructions(PVOID pSrc,
+//                               ULONG cbSrc,
+//                               PDETOUR_DECODED_INSTRUCTION pInstructions,
+//                               ULONG cInstructions)
+//  Purpose:
+//      Decode up to cInstructions consecutive instructions from pSrc
+//      without copying or relocating them.
+//
+//  Arguments:
+//      pSrc:
+//          Source address of the first instruction.
+//      cbSrc:
+//          Number of bytes available at pSrc.  An instruction that would
+//          run past the end is not returned.
+//      pInstructions:
+//          Out array receiving the length, DETOUR_DECODED_* flags and
+//          targets of each instruction.
+//      cInstructions:
+//          Capacity of pInstructions.
+//
+//  Returns:
+//      Returns the number of instructions decoded.
+//
+//  Comments:
+//      Uses the same tables as DetourCopyInstruction, so lengths and
+//      pbTarget agree with DetourCopyInstruction(NULL, ...), but never
+//      touches a destination buffer.  Meant for callers that only need
+//      instruction boundaries or branch targets.  DetourDecodeInstruction
+//      decodes a single instruction and returns the address of the next.
+//
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Function:
+//      DetourCopyInstructionEx, DetourDecodeInstructionEx,
+//      DetourDecodeInstructionsEx
+//  Purpose:
+//      Same as the functions above, but take the module bounds for
+//      call/jmp [mem] targets from a caller-owned DETOUR_DISASM_CONTEXT
+//      instead of the process-wide bounds set by DetourSetCodeModule.
+//
+//  Comments:
+//      The disassembler keeps no other shared state, so threads that each
+//      use their own context (or share a read-only one) can decode
+//      different modules concurrently without locking.  A NULL context
+//      means the process-wide bounds.  DetourInitializeDisasmContext fills
+//      a context from an address range.
+//
 
 #pragma data_seg(".detourd")
 #pragma const_seg(".detourc")
@@ -157,9 +239,11 @@ class CDetourDis
 {
   public:
     CDetourDis(_Out_opt_ PBYTE *ppbTarget,
-               _Out_opt_ LONG *plExtra);
+               _Out_opt_ LONG *plExtra,
+               _In_opt_ const DETOUR_DISASM_CONTEXT *pContext = NULL);
 
     PBYTE   CopyInstruction(PBYTE pbDst, PBYTE pbSrc);
+    PBYTE   DecodeInstruction(PBYTE pbSrc, PDETOUR_DECODED_INSTRUCTION pInstruction);
     static BOOL SanityCheckSystem();
     static BOOL SetCodeModule(PBYTE pbBeg, PBYTE pbEnd, BOOL fLimitReferencesToModule);
 
@@ -196,64 +280,122 @@ class CDetourDis
         COPYFUNC    pfCopy;                 // Function pointer.
     };
 
+    // Handler ids for PACKEDENTRY, one per Copy* handler used in the tables.
+    enum {
+        HANDLER_CopyBytes           = 0,
+        HANDLER_CopyBytesPrefix,
+        HANDLER_CopyBytesSegment,
+        HANDLER_CopyBytesRax,
+        HANDLER_CopyBytesJump,
+        HANDLER_Invalid,
+        HANDLER_Copy0F,
+        HANDLER_Copy0F00,
+        HANDLER_Copy0F78,
+        HANDLER_Copy0FB8,
+        HANDLER_Copy66,
+        HANDLER_Copy67,
+        HANDLER_CopyF2,
+        HANDLER_CopyF3,
+        HANDLER_CopyF6,
+        HANDLER_CopyF7,
+        HANDLER_CopyFF,
+        HANDLER_CopyVex2,
+        HANDLER_CopyVex3,
+        HANDLER_CopyEvex,
+        HANDLER_CopyXop,
+        HANDLER_NONE,                       // End marker, pfCopy == NULL.
+    };
+
+    // Packed COPYENTRY for the decode-only engine.  Built at compile time
+    // from the same ENTRY_* macros; 4 bytes instead of a bitfield plus a
+    // member pointer, and dispatched by switch on bHandler.
+    struct PACKEDENTRY
+    {
+        BYTE        bFixedSizes;            // nFixedSize | nFixedSize16 << 4
+        BYTE        bOffsets;               // nModOffset | nRelOffset << 4
+        BYTE        bFlagBits;
+        BYTE        bHandler;               // HANDLER_*
+
+        constexpr PACKEDENTRY(ULONG /*nOpcode*/, ULONG nFixedSize, ULONG nFixedSize16,
+                              ULONG nModOffset, ULONG nRelOffset, ULONG nFlagBits,
+                              ULONG nHandler)
+            : bFixedSizes((BYTE)(nFixedSize | (nFixedSize16 << 4))),
+              bOffsets((BYTE)(nModOffset | (nRelOffset << 4))),
+              bFlagBits((BYTE)nFlagBits),
+              bHandler((BYTE)nHandler)
+        {
+        }
+
+        constexpr UINT FixedSize() const { return bFixedSizes & 0xf; }
+        constexpr UINT FixedSize16() const { return bFixedSizes >> 4; }
+        constexpr UINT ModOffset() const { return bOffsets & 0xf; }
+        constexpr UINT RelOffset() const { return bOffsets >> 4; }
+    };
+    typedef const PACKEDENTRY * REFPACKEDENTRY;
+
   protected:
+// ENTRY_HANDLER names an entry's Copy* handler: a COPYFUNC here, a HANDLER_*
+// id while the packed tables are built (see disasmtab.h).
+#define ENTRY_HANDLER(x)            &CDetourDis::x
+#define ENTRY_HANDLER_NONE          NULL
+
 // These macros define common uses of nFixedSize, nFixedSize16, nModOffset, nRelOffset, nFlagBits, pfCopy.
 #define ENTRY_DataIgnored           0, 0, 0, 0, 0,
-#define ENTRY_CopyBytes1            1, 1, 0, 0, 0, &CDetourDis::CopyBytes
+#define ENTRY_CopyBytes1            1, 1, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
 #ifdef DETOURS_X64
-#define ENTRY_CopyBytes1Address     9, 5, 0, 0, ADDRESS, &CDetourDis::CopyBytes
+#define ENTRY_CopyBytes1Address     9, 5, 0, 0, ADDRESS, ENTRY_HANDLER(CopyBytes)
 #else
-#define ENTRY_CopyBytes1Address     5, 3, 0, 0, ADDRESS, &CDetourDis::CopyBytes
+#define ENTRY_CopyBytes1Address     5, 3, 0, 0, ADDRESS, ENTRY_HANDLER(CopyBytes)
 #endif
-#define ENTRY_CopyBytes1Dynamic     1, 1, 0, 0, DYNAMIC, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2            2, 2, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2Jump        ENTRY_DataIgnored &CDetourDis::CopyBytesJump
-#define ENTRY_CopyBytes2CantJump    2, 2, 0, 1, NOENLARGE, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2Dynamic     2, 2, 0, 0, DYNAMIC, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3            3, 3, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Dynamic     3, 3, 0, 0, DYNAMIC, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Or5         5, 3, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Or5Dynamic  5, 3, 0, 0, DYNAMIC, &CDetourDis::CopyBytes // x86 only
+#define ENTRY_CopyBytes1Dynamic     1, 1, 0, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2            2, 2, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2Jump        ENTRY_DataIgnored ENTRY_HANDLER(CopyBytesJump)
+#define ENTRY_CopyBytes2CantJump    2, 2, 0, 1, NOENLARGE, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2Dynamic     2, 2, 0, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3            3, 3, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Dynamic     3, 3, 0, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Or5         5, 3, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Or5Dynamic  5, 3, 0, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes) // x86 only
 #ifdef DETOURS_X64
-#define ENTRY_CopyBytes3Or5Rax      5, 3, 0, 0, RAX, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Or5Target   5, 5, 0, 1, 0, &CDetourDis::CopyBytes
+#define ENTRY_CopyBytes3Or5Rax      5, 3, 0, 0, RAX, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Or5Target   5, 5, 0, 1, 0, ENTRY_HANDLER(CopyBytes)
 #else
-#define ENTRY_CopyBytes3Or5Rax      5, 3, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Or5Target   5, 3, 0, 1, 0, &CDetourDis::CopyBytes
+#define ENTRY_CopyBytes3Or5Rax      5, 3, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Or5Target   5, 3, 0, 1, 0, ENTRY_HANDLER(CopyBytes)
 #endif
-#define ENTRY_CopyBytes4            4, 4, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes5            5, 5, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes5Or7Dynamic  7, 5, 0, 0, DYNAMIC, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes7            7, 7, 0, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2Mod         2, 2, 1, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2ModDynamic  2, 2, 1, 0, DYNAMIC, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2Mod1        3, 3, 1, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes2ModOperand  6, 4, 1, 0, 0, &CDetourDis::CopyBytes
-#define ENTRY_CopyBytes3Mod         3, 3, 2, 0, 0, &CDetourDis::CopyBytes // SSE3 0F 38 opcode modrm
-#define ENTRY_CopyBytes3Mod1        4, 4, 2, 0, 0, &CDetourDis::CopyBytes // SSE3 0F 3A opcode modrm .. imm8
-#define ENTRY_CopyBytesPrefix       ENTRY_DataIgnored &CDetourDis::CopyBytesPrefix
-#define ENTRY_CopyBytesSegment      ENTRY_DataIgnored &CDetourDis::CopyBytesSegment
-#define ENTRY_CopyBytesRax          ENTRY_DataIgnored &CDetourDis::CopyBytesRax
-#define ENTRY_CopyF2                ENTRY_DataIgnored &CDetourDis::CopyF2
-#define ENTRY_CopyF3                ENTRY_DataIgnored &CDetourDis::CopyF3   // 32bit x86 only
-#define ENTRY_Copy0F                ENTRY_DataIgnored &CDetourDis::Copy0F
-#define ENTRY_Copy0F78              ENTRY_DataIgnored &CDetourDis::Copy0F78
-#define ENTRY_Copy0F00              ENTRY_DataIgnored &CDetourDis::Copy0F00 // 32bit x86 only
-#define ENTRY_Copy0FB8              ENTRY_DataIgnored &CDetourDis::Copy0FB8 // 32bit x86 only
-#define ENTRY_Copy66                ENTRY_DataIgnored &CDetourDis::Copy66
-#define ENTRY_Copy67                ENTRY_DataIgnored &CDetourDis::Copy67
-#define ENTRY_CopyF6                ENTRY_DataIgnored &CDetourDis::CopyF6
-#define ENTRY_CopyF7                ENTRY_DataIgnored &CDetourDis::CopyF7
-#define ENTRY_CopyFF                ENTRY_DataIgnored &CDetourDis::CopyFF
-#define ENTRY_CopyVex2              ENTRY_DataIgnored &CDetourDis::CopyVex2
-#define ENTRY_CopyVex3              ENTRY_DataIgnored &CDetourDis::CopyVex3
-#define ENTRY_CopyEvex              ENTRY_DataIgnored &CDetourDis::CopyEvex // 62, 3 byte payload, then normal with implied prefixes like vex
-#define ENTRY_CopyXop               ENTRY_DataIgnored &CDetourDis::CopyXop   // 0x8F ... POP /0 or AMD XOP
-#define ENTRY_CopyBytesXop          5, 5, 4, 0, 0, &CDetourDis::CopyBytes // 0x8F xop1 xop2 opcode modrm
-#define ENTRY_CopyBytesXop1         6, 6, 4, 0, 0, &CDetourDis::CopyBytes // 0x8F xop1 xop2 opcode modrm ... imm8
-#define ENTRY_CopyBytesXop4         9, 9, 4, 0, 0, &CDetourDis::CopyBytes // 0x8F xop1 xop2 opcode modrm ... imm32
-#define ENTRY_Invalid               ENTRY_DataIgnored &CDetourDis::Invalid
-#define ENTRY_End                   ENTRY_DataIgnored NULL
+#define ENTRY_CopyBytes4            4, 4, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes5            5, 5, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes5Or7Dynamic  7, 5, 0, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes7            7, 7, 0, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2Mod         2, 2, 1, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2ModDynamic  2, 2, 1, 0, DYNAMIC, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2Mod1        3, 3, 1, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes2ModOperand  6, 4, 1, 0, 0, ENTRY_HANDLER(CopyBytes)
+#define ENTRY_CopyBytes3Mod         3, 3, 2, 0, 0, ENTRY_HANDLER(CopyBytes) // SSE3 0F 38 opcode modrm
+#define ENTRY_CopyBytes3Mod1        4, 4, 2, 0, 0, ENTRY_HANDLER(CopyBytes) // SSE3 0F 3A opcode modrm .. imm8
+#define ENTRY_CopyBytesPrefix       ENTRY_DataIgnored ENTRY_HANDLER(CopyBytesPrefix)
+#define ENTRY_CopyBytesSegment      ENTRY_DataIgnored ENTRY_HANDLER(CopyBytesSegment)
+#define ENTRY_CopyBytesRax          ENTRY_DataIgnored ENTRY_HANDLER(CopyBytesRax)
+#define ENTRY_CopyF2                ENTRY_DataIgnored ENTRY_HANDLER(CopyF2)
+#define ENTRY_CopyF3                ENTRY_DataIgnored ENTRY_HANDLER(CopyF3)   // 32bit x86 only
+#define ENTRY_Copy0F                ENTRY_DataIgnored ENTRY_HANDLER(Copy0F)
+#define ENTRY_Copy0F78              ENTRY_DataIgnored ENTRY_HANDLER(Copy0F78)
+#define ENTRY_Copy0F00              ENTRY_DataIgnored ENTRY_HANDLER(Copy0F00) // 32bit x86 only
+#define ENTRY_Copy0FB8              ENTRY_DataIgnored ENTRY_HANDLER(Copy0FB8) // 32bit x86 only
+#define ENTRY_Copy66                ENTRY_DataIgnored ENTRY_HANDLER(Copy66)
+#define ENTRY_Copy67                ENTRY_DataIgnored ENTRY_HANDLER(Copy67)
+#define ENTRY_CopyF6                ENTRY_DataIgnored ENTRY_HANDLER(CopyF6)
+#define ENTRY_CopyF7                ENTRY_DataIgnored ENTRY_HANDLER(CopyF7)
+#define ENTRY_CopyFF                ENTRY_DataIgnored ENTRY_HANDLER(CopyFF)
+#define ENTRY_CopyVex2              ENTRY_DataIgnored ENTRY_HANDLER(CopyVex2)
+#define ENTRY_CopyVex3              ENTRY_DataIgnored ENTRY_HANDLER(CopyVex3)
+#define ENTRY_CopyEvex              ENTRY_DataIgnored ENTRY_HANDLER(CopyEvex) // 62, 3 byte payload, then normal with implied prefixes like vex
+#define ENTRY_CopyXop               ENTRY_DataIgnored ENTRY_HANDLER(CopyXop)   // 0x8F ... POP /0 or AMD XOP
+#define ENTRY_CopyBytesXop          5, 5, 4, 0, 0, ENTRY_HANDLER(CopyBytes) // 0x8F xop1 xop2 opcode modrm
+#define ENTRY_CopyBytesXop1         6, 6, 4, 0, 0, ENTRY_HANDLER(CopyBytes) // 0x8F xop1 xop2 opcode modrm ... imm8
+#define ENTRY_CopyBytesXop4         9, 9, 4, 0, 0, ENTRY_HANDLER(CopyBytes) // 0x8F xop1 xop2 opcode modrm ... imm32
+#define ENTRY_Invalid               ENTRY_DataIgnored ENTRY_HANDLER(Invalid)
+#define ENTRY_End                   ENTRY_DataIgnored ENTRY_HANDLER_NONE
 
     PBYTE CopyBytes(REFCOPYENTRY pEntry, PBYTE pbDst, PBYTE pbSrc);
     PBYTE CopyBytesPrefix(REFCOPYENTRY pEntry, PBYTE pbDst, PBYTE pbSrc);
@@ -285,13 +427,29 @@ class CDetourDis
     PBYTE CopyEvex(REFCOPYENTRY pEntry, PBYTE pbDst, PBYTE pbSrc);
     PBYTE CopyXop(REFCOPYENTRY pEntry, PBYTE pbDst, PBYTE pbSrc);
 
+  protected:
+    // Decode-only counterparts: packed tables, no destination and no
+    // pfCopy dispatch.  Results go to m_pDecoded.
+    PBYTE DecodeOpcode(PBYTE pbSrc);
+    PBYTE Decode0F(PBYTE pbSrc);
+    PBYTE DecodeBytes(REFPACKEDENTRY pEntry, PBYTE pbSrc);
+    PBYTE DecodeJump(PBYTE pbSrc);
+    PBYTE DecodeFF(PBYTE pbSrc);
+    PBYTE DecodeVex3(PBYTE pbSrc);
+    PBYTE DecodeVex2(PBYTE pbSrc);
+    PBYTE DecodeEvex(PBYTE pbSrc);
+    PBYTE DecodeXop(PBYTE pbSrc);
+    PBYTE DecodeVexEvexCommon(BYTE m, PBYTE pbSrc, BYTE p);
+    PBYTE DecodeInvalid(PBYTE pbSrc);
+    static BOOL SamePackedEntry(REFCOPYENTRY pEntry, REFPACKEDENTRY pPacked);
+
   protected:
     static const COPYENTRY  s_rceCopyTable[257];
     static const COPYENTRY  s_rceCopyTable0F[257];
     static const BYTE       s_rbModRm[256];
-    static PBYTE            s_pbModuleBeg;
-    static PBYTE            s_pbModuleEnd;
-    static BOOL             s_fLimitReferencesToModule;
+    static const PACKEDENTRY s_rpeCopyTable[257];
+    static const PACKEDENTRY s_rpeCopyTable0F[257];
+    static DETOUR_DISASM_CONTEXT s_dcDefault;   // Set by DetourSetCodeModule.
 
   protected:
     BOOL                m_bOperandOverride;
@@ -309,6 +467,9 @@ class CDetourDis
     LONG                m_lScratchExtra;
     PBYTE               m_pbScratchTarget;
     BYTE                m_rbScratchDst[64]; // matches or exceeds rbCode
+
+    PDETOUR_DECODED_INSTRUCTION m_pDecoded;
+    const DETOUR_DISASM_CONTEXT * m_pContext;
 };
 
 PVOID WINAPI DetourCopyInstruction(_In_opt_ PVOID pDst,
@@ -316,16 +477,161 @@ PVOID WINAPI DetourCopyInstruction(_In_opt_ PVOID pDst,
                                    _In_ PVOID pSrc,
                                    _Out_opt_ PVOID *ppTarget,
                                    _Out_opt_ LONG *plExtra)
+{
+    return DetourCopyInstructionEx(pDst, ppDstPool, pSrc, ppTarget, plExtra, NULL);
+}
+
+PVOID WINAPI DetourCopyInstructionEx(_In_opt_ PVOID pDst,
+                                     _Inout_opt_ PVOID *ppDstPool,
+                                     _In_ PVOID pSrc,
+                                     _Out_opt_ PVOID *ppTarget,
+                                     _Out_opt_ LONG *plExtra,
+                                     _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
 {
     UNREFERENCED_PARAMETER(ppDstPool);  // x86 & x64 don't use a constant pool.
 
-    CDetourDis oDetourDisasm((PBYTE*)ppTarget, plExtra);
+    CDetourDis oDetourDisasm((PBYTE*)ppTarget, plExtra, pContext);
     return oDetourDisasm.CopyInstruction((PBYTE)pDst, (PBYTE)pSrc);
 }
 
+PVOID WINAPI DetourDecodeInstruction(_In_ PVOID pSrc,
+                                     _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction)
+{
+    return DetourDecodeInstructionEx(pSrc, pInstruction, NULL);
+}
+
+PVOID WINAPI DetourDecodeInstructionEx(_In_ PVOID pSrc,
+                                       _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction,
+                                       _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
+{
+    CDetourDis oDetourDisasm(NULL, NULL, pContext);
+    return oDetourDisasm.DecodeInstruction((PBYTE)pSrc, pInstruction);
+}
+
+ULONG WINAPI DetourDecodeInstructions(_In_ PVOID pSrc,
+                                      _In_ ULONG cbSrc,
+                                      _Out_writes_to_(cInstructions, return)
+                                      PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                      _In_ ULONG cInstructions)
+{
+    return DetourDecodeInstructionsEx(pSrc, cbSrc, pInstructions, cInstructions, NULL);
+}
+
+ULONG WINAPI DetourDecodeInstructionsEx(_In_ PVOID pSrc,
+                                        _In_ ULONG cbSrc,
+                                        _Out_writes_to_(cInstructions, return)
+                                        PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                        _In_ ULONG cInstructions,
+                                        _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
+{
+    if (pSrc == NULL || pInstructions == NULL) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    // One disassembler for the whole run; DecodeInstruction resets the
+    // per-instruction prefix state itself.
+    CDetourDis oDetourDisasm(NULL, NULL, pContext);
+    PBYTE pbSrc = (PBYTE)pSrc;
+    PBYTE pbEnd = pbSrc + cbSrc;
+    ULONG n = 0;
+
+    while (n < cInstructions && pbSrc < pbEnd) {
+        PBYTE pbNext = oDetourDisasm.DecodeInstruction(pbSrc, &pInstructions[n]);
+        if (pbNext > pbEnd) {
+            break;
+        }
+        pbSrc = pbNext;
+        n++;
+    }
+    return n;
+}
+
+//  Padding between functions: int 3, nop, and the multi-byte NOP forms
+//  emitted by compilers and assemblers (0F 1F /0 with any 66/2E prefixes,
+//  and on x86 the lea/mov forms GNU as uses).  Unlike the helper in
+//  detours.cpp this never reads past cbCode, so it is safe at the end of a
+//  mapped section.
+//
+ULONG WINAPI DetourIsCodeFiller(_In_reads_bytes_(cbCode) PVOID pCode,
+                                _In_ ULONG cbCode)
+{
+    PBYTE pbCode = (PBYTE)pCode;
+    if (pbCode == NULL || cbCode == 0) {
+        return 0;
+    }
+    if (pbCode[0] == 0xcc || pbCode[0] == 0x90) {
+        return 1;
+    }
+
+    ULONG cbPrefix = 0;
+    while (cbPrefix < cbCode && cbPrefix < 14 &&
+           (pbCode[cbPrefix] == 0x66 || pbCode[cbPrefix] == 0x2e)) {
+        cbPrefix++;
+    }
+    if (cbPrefix < cbCode && cbPrefix > 0 && pbCode[cbPrefix] == 0x90) {
+        return cbPrefix + 1;                            // xchg ax, ax
+    }
+
+    //  Only nopw/nopl (0F 1F /0) and, on x86, lea reg, [reg+0] have
+    //  operands worth measuring.
+    PBYTE pbModRm = NULL;
+    if (cbPrefix + 2 < cbCode && pbCode[cbPrefix] == 0x0f && pbCode[cbPrefix + 1] == 0x1f &&
+        (pbCode[cbPrefix + 2] & 0x38) == 0) {
+        pbModRm = pbCode + cbPrefix + 2;
+    }
+#ifdef DETOURS_X86
+    else if (cbPrefix == 0 && cbCode >= 2 && pbCode[0] == 0x89 && pbCode[1] == 0xf6) {
+        return 2;                                       // mov esi, esi
+    }
+    else if (cbPrefix == 0 && cbCode >= 3 && pbCode[0] == 0x8d &&
+             (pbCode[1] & 0xc0) != 0xc0 && (pbCode[1] & 0xc0) != 0) {
+        //  lea esi, [esi+0] or lea esi, [esi+eiz*1+0].
+        BYTE bReg = (pbCode[1] >> 3) & 7;
+        if ((pbCode[1] & 7) == 4 ? pbCode[2] == (0x20 | bReg) : (pbCode[1] & 7) == bReg) {
+            pbModRm = pbCode + 1;
+        }
+    }
+#endif
+    if (pbModRm == NULL) {
+        return 0;
+    }
+
+    BYTE bMod = pbModRm[0] >> 6;
+    BYTE bRm = pbModRm[0] & 7;
+    ULONG cbOperand = 1;
+    if (bMod != 3 && bRm == 4) {
+        cbOperand++;                                    // SIB
+    }
+    if (bMod == 1) {
+        cbOperand += 1;
+    }
+    else if (bMod == 2 || (bMod == 0 && bRm == 5)) {
+        cbOperand += 4;
+    }
+
+    ULONG cbFiller = (ULONG)(pbModRm - pbCode) + cbOperand;
+    if (cbFiller > cbCode) {
+        return 0;
+    }
+#ifdef DETOURS_X86
+    //  The lea forms are only a NOP with a zero displacement.
+    if (pbCode[cbPrefix] == 0x8d) {
+        for (PBYTE pb = pbModRm + cbOperand - (bMod == 1 ? 1 : 4); pb < pbCode + cbFiller; pb++) {
+            if (*pb != 0) {
+                return 0;
+            }
+        }
+    }
+#endif
+    return cbFiller;
+}
+
 /////////////////////////////////////////////////////////// Disassembler Code.
 //
-CDetourDis::CDetourDis(_Out_opt_ PBYTE *ppbTarget, _Out_opt_ LONG *plExtra)
+CDetourDis::CDetourDis(_Out_opt_ PBYTE *ppbTarget,
+                       _Out_opt_ LONG *plExtra,
+                       _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
 {
     m_bOperandOverride = FALSE;
     m_bAddressOverride = FALSE;
@@ -334,12 +640,16 @@ CDetourDis::CDetourDis(_Out_opt_ PBYTE *ppbTarget, _Out_opt_ LONG *plExtra)
     m_bF3 = FALSE;
     m_bVex = FALSE;
     m_bEvex = FALSE;
+    m_nSegmentOverride = 0;
 
     m_ppbTarget = ppbTarget ? ppbTarget : &m_pbScratchTarget;
     m_plExtra = plExtra ? plExtra : &m_lScratchExtra;
 
     *m_ppbTarget = (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE;
     *m_plExtra = 0;
+
+    m_pDecoded = NULL;
+    m_pContext = pContext ? pContext : &s_dcDefault;
 }
 
 PBYTE CDetourDis::CopyInstruction(PBYTE pbDst, PBYTE pbSrc)
@@ -727,8 +1037,8 @@ PBYTE CDetourDis::CopyFF(REFCOPYENTRY pEntry, PBYTE pbDst, PBYTE pbSrc)
 #else
             PBYTE *ppbTarget = (PBYTE *)(SIZE_T)*(UNALIGNED ULONG*)&pbSrc[2];
 #endif
-            if (s_fLimitReferencesToModule &&
-                (ppbTarget < (PVOID)s_pbModuleBeg || ppbTarget >= (PVOID)s_pbModuleEnd)) {
+            if (m_pContext->fLimitReferencesToModule &&
+                (ppbTarget < (PVOID)m_pContext->pbModuleBeg || ppbTarget >= (PVOID)m_pContext->pbModuleEnd)) {
 
                 *m_ppbTarget = (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC;
             }
@@ -916,11 +1226,409 @@ pp is like VEX but only instructions with 0 are defined
     }
 }
 
+///////////////////////////////////////////////////////// Decode-Only Engine.
+//
+//  Mirrors the Copy* handlers above but never writes a destination, never
+//  relocates and dispatches with a switch on PACKEDENTRY::bHandler instead
+//  of through pfCopy.  CopyBytes entries are decoded straight from their
+//  packed sizes.  ENTRY_* macros below build PACKEDENTRY values.
+//
+#undef ENTRY_HANDLER
+#undef ENTRY_HANDLER_NONE
+#define ENTRY_HANDLER(x)            HANDLER_##x
+#define ENTRY_HANDLER_NONE          HANDLER_NONE
+
+PBYTE CDetourDis::DecodeInstruction(PBYTE pbSrc, PDETOUR_DECODED_INSTRUCTION pInstruction)
+{
+    if (NULL == pbSrc || NULL == pInstruction) {
+        SetLastError(ERROR_INVALID_DATA);
+        return NULL;
+    }
+
+    m_bOperandOverride = FALSE;
+    m_bAddressOverride = FALSE;
+    m_bRaxOverride = FALSE;
+    m_bF2 = FALSE;
+    m_bF3 = FALSE;
+    m_bVex = FALSE;
+    m_bEvex = FALSE;
+    m_nSegmentOverride = 0;
+
+    m_pDecoded = pInstruction;
+    m_pDecoded->pbCode = pbSrc;
+    m_pDecoded->pbTarget = (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE;
+    m_pDecoded->pbData = NULL;
+    m_pDecoded->cbInstruction = 0;
+    m_pDecoded->bReserved = 0;
+    m_pDecoded->wFlags = 0;
+
+    PBYTE pbNext = DecodeOpcode(pbSrc);
+    m_pDecoded->cbInstruction = (BYTE)(pbNext - pbSrc);
+    return pbNext;
+}
+
+PBYTE CDetourDis::DecodeOpcode(PBYTE pbSrc)
+{
+    // Prefixes loop here rather than recursing.  No instruction is longer
+    // than 15 bytes, so a runaway prefix chain (padding, string data) is
+    // reported as invalid instead of walking off the buffer.
+    for (PBYTE pbLimit = pbSrc + 15; pbSrc < pbLimit; pbSrc++) {
+        BYTE const bOpcode = pbSrc[0];
+        REFPACKEDENTRY pEntry = &s_rpeCopyTable[bOpcode];
+
+        switch (pEntry->bHandler) {
+          case HANDLER_CopyBytes:
+            if (bOpcode >= 0x9A) {
+                switch (bOpcode) {
+                  case 0xC2: case 0xC3: case 0xCA: case 0xCB: case 0xCF:
+                    m_pDecoded->wFlags |= DETOUR_DECODED_RETURN;
+                    break;
+                  case 0x9A: case 0xE8:
+                    m_pDecoded->wFlags |= DETOUR_DECODED_CALL;
+                    break;
+                  case 0xE9: case 0xEA:
+                    m_pDecoded->wFlags |= DETOUR_DECODED_BRANCH;
+                    break;
+                  case 0xE0: case 0xE1: case 0xE2: case 0xE3:
+                    m_pDecoded->wFlags |= DETOUR_DECODED_BRANCH | DETOUR_DECODED_CONDITIONAL;
+                    break;
+                }
+            }
+            return DecodeBytes(pEntry, pbSrc);
+
+          case HANDLER_Copy0F:
+            return Decode0F(pbSrc + 1);
+
+          case HANDLER_CopyBytesSegment:
+            m_nSegmentOverride = bOpcode;
+            continue;
+          case HANDLER_CopyBytesRax:
+            if (bOpcode & 0x8) {
+                m_bRaxOverride = TRUE;
+            }
+            continue;
+          case HANDLER_Copy66:
+            m_bOperandOverride = TRUE;
+            continue;
+          case HANDLER_Copy67:
+            m_bAddressOverride = TRUE;
+            continue;
+          case HANDLER_CopyBytesPrefix:
+            continue;
+          case HANDLER_CopyF2:
+            m_bF2 = TRUE;
+            continue;
+          case HANDLER_CopyF3:
+            m_bF3 = TRUE;
+            continue;
+
+          case HANDLER_CopyBytesJump:
+            return DecodeJump(pbSrc);
+          case HANDLER_CopyEvex:
+            return DecodeEvex(pbSrc);
+          case HANDLER_CopyXop:
+            return DecodeXop(pbSrc);
+          case HANDLER_CopyVex3:
+            return DecodeVex3(pbSrc);
+          case HANDLER_CopyVex2:
+            return DecodeVex2(pbSrc);
+
+          case HANDLER_CopyF6:
+          {
+            static const PACKEDENTRY ceTest = { 0xf6, ENTRY_CopyBytes2Mod1 };
+            static const PACKEDENTRY ce = { 0xf6, ENTRY_CopyBytes2Mod };
+            return DecodeBytes((0x00 == (0x38 & pbSrc[1])) ? &ceTest : &ce, pbSrc);
+          }
+          case HANDLER_CopyF7:
+          {
+            static const PACKEDENTRY ceTest = { 0xf7, ENTRY_CopyBytes2ModOperand };
+            static const PACKEDENTRY ce = { 0xf7, ENTRY_CopyBytes2Mod };
+            return DecodeBytes((0x00 == (0x38 & pbSrc[1])) ? &ceTest : &ce, pbSrc);
+          }
+          case HANDLER_CopyFF:
+            return DecodeFF(pbSrc);
+        }
+        return DecodeInvalid(pbSrc);
+    }
+    return DecodeInvalid(pbSrc);
+}
+
+PBYTE CDetourDis::Decode0F(PBYTE pbSrc)
+{
+    BYTE const bOpcode = pbSrc[0];
+    REFPACKEDENTRY pEntry = &s_rpeCopyTable0F[bOpcode];
+
+    switch (pEntry->bHandler) {
+      case HANDLER_CopyBytes:
+        if (bOpcode >= 0x80 && bOpcode <= 0x8F && !m_bVex && !m_bEvex) {
+            m_pDecoded->wFlags |= DETOUR_DECODED_BRANCH | DETOUR_DECODED_CONDITIONAL;
+        }
+        return DecodeBytes(pEntry, pbSrc);
+
+      case HANDLER_Copy0F00:
+      {
+        static const PACKEDENTRY other = { 0xB8, ENTRY_CopyBytes2Mod };
+        static const PACKEDENTRY jmpe = { 0xB8, ENTRY_CopyBytes2ModDynamic };
+        return DecodeBytes(((6 << 3) == ((7 << 3) & pbSrc[1])) ? &jmpe : &other, pbSrc);
+      }
+      case HANDLER_Copy0FB8:
+      {
+        static const PACKEDENTRY popcnt = { 0xB8, ENTRY_CopyBytes2Mod };
+        static const PACKEDENTRY jmpe = { 0xB8, ENTRY_CopyBytes3Or5Dynamic };
+        return DecodeBytes(m_bF3 ? &popcnt : &jmpe, pbSrc);
+      }
+      case HANDLER_Copy0F78:
+      {
+        static const PACKEDENTRY vmread = { 0x78, ENTRY_CopyBytes2Mod };
+        static const PACKEDENTRY extrq_insertq = { 0x78, ENTRY_CopyBytes4 };
+        return DecodeBytes((m_bF2 || m_bOperandOverride) ? &extrq_insertq : &vmread, pbSrc);
+      }
+    }
+    return DecodeInvalid(pbSrc);
+}
+
+PBYTE CDetourDis::DecodeBytes(REFPACKEDENTRY pEntry, PBYTE pbSrc)
+{
+    ASSERT(pEntry->bHandler == HANDLER_CopyBytes);
+
+    UINT nBytesFixed;
+    UINT const nModOffset = pEntry->ModOffset();
+    UINT const nFlagBits = pEntry->bFlagBits;
+
+    if (nFlagBits & ADDRESS) {
+        nBytesFixed = m_bAddressOverride ? pEntry->FixedSize16() : pEntry->FixedSize();
+
+        // mov al/eax, [moffs] and back; FS and GS address the TEB, not the image.
+        if (!m_bAddressOverride && m_nSegmentOverride != 0x64 && m_nSegmentOverride != 0x65) {
+#ifdef DETOURS_X64
+            m_pDecoded->pbData = (PBYTE)(ULONG_PTR)*(UNALIGNED ULONGLONG*)&pbSrc[1];
+#else
+            m_pDecoded->pbData = (PBYTE)(SIZE_T)*(UNALIGNED ULONG*)&pbSrc[1];
+#endif
+            m_pDecoded->wFlags |= DETOUR_DECODED_ABSOLUTE;
+        }
+    }
+#ifdef DETOURS_X64
+    // REX.W trumps 66
+    else if (m_bRaxOverride) {
+        nBytesFixed = pEntry->FixedSize() + ((nFlagBits & RAX) ? 4 : 0);
+    }
+#endif
+    else {
+        nBytesFixed = m_bOperandOverride ? pEntry->FixedSize16() : pEntry->FixedSize();
+    }
+
+    UINT nBytes = nBytesFixed;
+    UINT nRelOffset = pEntry->RelOffset();
+    UINT cbTarget = nBytes - nRelOffset;
+    if (nModOffset > 0) {
+        BYTE const bModRm = pbSrc[nModOffset];
+        BYTE const bFlags = s_rbModRm[bModRm];
+
+        nBytes += bFlags & NOTSIB;
+
+        if (bFlags & SIB) {
+            // SIB base 5 adds a displacement sized by mod (mod 3 has no SIB).
+            static const BYTE rbSibDisp[4] = { 4, 1, 4, 0 };
+            BYTE const bSib = pbSrc[nModOffset + 1];
+
+            nBytes += ((bSib & 0x07) == 0x05) ? rbSibDisp[bModRm >> 6] : 0;
+        }
+#ifdef DETOURS_X64
+        else if (bFlags & RIP) {
+            // Data reference, not a code target.
+            LONG_PTR nOffset = *(UNALIGNED LONG*)&pbSrc[nModOffset + 1];
+            m_pDecoded->pbData = pbSrc + nBytes + nOffset;
+            m_pDecoded->wFlags |= DETOUR_DECODED_RIP_RELATIVE;
+        }
+#else
+        else if ((bFlags & RIP) && !m_bAddressOverride &&
+                 m_nSegmentOverride != 0x64 && m_nSegmentOverride != 0x65) {
+            // Same encoding on x86 is an absolute [disp32], such as
+            // mov esi, [__imp__Foo@4] before a run of call esi.
+            m_pDecoded->pbData = (PBYTE)(SIZE_T)*(UNALIGNED ULONG*)&pbSrc[nModOffset + 1];
+            m_pDecoded->wFlags |= DETOUR_DECODED_ABSOLUTE;
+        }
+#endif
+    }
+    else if (nRelOffset) {
+        LONG_PTR nOffset = 0;
+        switch (cbTarget) {
+          case 1: nOffset = *(signed char*)&pbSrc[nRelOffset]; break;
+          case 2: nOffset = *(UNALIGNED SHORT*)&pbSrc[nRelOffset]; break;
+          case 4: nOffset = *(UNALIGNED LONG*)&pbSrc[nRelOffset]; break;
+          default: ASSERT(!"cbTarget is invalid."); break;
+        }
+        m_pDecoded->pbTarget = pbSrc + nBytes + nOffset;
+    }
+    if (nFlagBits & DYNAMIC) {
+        m_pDecoded->pbTarget = (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC;
+        m_pDecoded->wFlags |= DETOUR_DECODED_DYNAMIC;
+    }
+    return pbSrc + nBytes;
+}
+
+PBYTE CDetourDis::DecodeJump(PBYTE pbSrc)
+{
+    // EB and 7x: 8-bit relative jumps.
+    m_pDecoded->pbTarget = pbSrc + 2 + *(signed char*)&pbSrc[1];
+    m_pDecoded->wFlags |= DETOUR_DECODED_BRANCH;
+    if (pbSrc[0] != 0xeb) {
+        m_pDecoded->wFlags |= DETOUR_DECODED_CONDITIONAL;
+    }
+    return pbSrc + 2;
+}
+
+PBYTE CDetourDis::DecodeFF(PBYTE pbSrc)
+{   // See CopyFF.
+    static const PACKEDENTRY ce = { 0xff, ENTRY_CopyBytes2Mod };
+    PBYTE pbOut = DecodeBytes(&ce, pbSrc);
+
+    BYTE const b1 = pbSrc[1];
+
+    if (0x10 == (0x30 & b1)) {          // CALL /2 or /3
+        m_pDecoded->wFlags |= DETOUR_DECODED_CALL;
+    }
+    else if (0x20 == (0x30 & b1)) {     // JMP /4 or /5
+        m_pDecoded->wFlags |= DETOUR_DECODED_BRANCH;
+    }
+    else {
+        return pbOut;
+    }
+
+    m_pDecoded->pbTarget = (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC;
+
+    if (0x15 == b1 || 0x25 == b1) {     // CALL [], JMP []
+#ifdef DETOURS_X86
+        m_pDecoded->pbData = (PBYTE)(SIZE_T)*(UNALIGNED ULONG*)&pbSrc[2];
+#endif
+#ifdef DETOURS_X64
+        // All segments but FS and GS are equivalent.
+        if (m_nSegmentOverride != 0x64 && m_nSegmentOverride != 0x65)
+#else
+        if (m_nSegmentOverride == 0 || m_nSegmentOverride == 0x2E)
+#endif
+        {
+            PBYTE *ppbTarget = (PBYTE *)m_pDecoded->pbData;
+            if (!m_pContext->fLimitReferencesToModule ||
+                (ppbTarget >= (PVOID)m_pContext->pbModuleBeg && ppbTarget < (PVOID)m_pContext->pbModuleEnd)) {
+
+                // This can access violate on random bytes. Use DetourSetCodeModule.
+                m_pDecoded->pbTarget = *ppbTarget;
+                return pbOut;
+            }
+        }
+    }
+    m_pDecoded->wFlags |= DETOUR_DECODED_DYNAMIC;
+    return pbOut;
+}
+
+PBYTE CDetourDis::DecodeVexEvexCommon(BYTE m, PBYTE pbSrc, BYTE p)
+{
+    static const PACKEDENTRY ceF38 = { 0x38, ENTRY_CopyBytes2Mod };
+    static const PACKEDENTRY ceF3A = { 0x3A, ENTRY_CopyBytes2Mod1 };
+
+    switch (p & 3) {
+    case 0: break;
+    case 1: m_bOperandOverride = TRUE; break;
+    case 2: m_bF3 = TRUE; break;
+    case 3: m_bF2 = TRUE; break;
+    }
+
+    switch (m) {
+    default: return DecodeInvalid(pbSrc);
+    case 1:  return Decode0F(pbSrc);
+    case 2:  return DecodeBytes(&ceF38, pbSrc);
+    case 3:  return DecodeBytes(&ceF3A, pbSrc);
+    }
+}
+
+PBYTE CDetourDis::DecodeVex3(PBYTE pbSrc)
+{
+#ifdef DETOURS_X86
+    static const PACKEDENTRY ceLES = { 0xC4, ENTRY_CopyBytes2Mod };
+    if ((pbSrc[1] & 0xC0) != 0xC0) {
+        return DecodeBytes(&ceLES, pbSrc);
+    }
+#endif
+#ifdef DETOURS_X64
+    m_bRaxOverride |= !!(pbSrc[2] & 0x80);
+#endif
+    m_bVex = TRUE;
+    return DecodeVexEvexCommon(pbSrc[1] & 0x1F, pbSrc + 3, (BYTE)(pbSrc[2] & 3));
+}
+
+PBYTE CDetourDis::DecodeVex2(PBYTE pbSrc)
+{
+#ifdef DETOURS_X86
+    static const PACKEDENTRY ceLDS = { 0xC5, ENTRY_CopyBytes2Mod };
+    if ((pbSrc[1] & 0xC0) != 0xC0) {
+        return DecodeBytes(&ceLDS, pbSrc);
+    }
+#endif
+    m_bVex = TRUE;
+    return DecodeVexEvexCommon(1, pbSrc + 2, (BYTE)(pbSrc[1] & 3));
+}
+
+PBYTE CDetourDis::DecodeEvex(PBYTE pbSrc)
+{
+    BYTE const p0 = pbSrc[1];
+
+#ifdef DETOURS_X86
+    static const PACKEDENTRY ceBound = { 0x62, ENTRY_CopyBytes2Mod };
+    if ((p0 & 0xC0) != 0xC0) {
+        return DecodeBytes(&ceBound, pbSrc);
+    }
+#endif
+
+    if ((p0 & 0x0C) != 0) {
+        return DecodeInvalid(pbSrc);
+    }
+
+    BYTE const p1 = pbSrc[2];
+
+    if ((p1 & 0x04) != 0x04) {
+        return DecodeInvalid(pbSrc);
+    }
+
+    m_bEvex = TRUE;
+
+#ifdef DETOURS_X64
+    m_bRaxOverride |= !!(p1 & 0x80); // w
+#endif
+
+    return DecodeVexEvexCommon(p0 & 3u, pbSrc + 4, p1 & 3u);
+}
+
+PBYTE CDetourDis::DecodeXop(PBYTE pbSrc)
+{
+    static const PACKEDENTRY cePop = { 0x8F, ENTRY_CopyBytes2Mod };
+    static const PACKEDENTRY ceXop = { 0x8F, ENTRY_CopyBytesXop };
+    static const PACKEDENTRY ceXop1 = { 0x8F, ENTRY_CopyBytesXop1 };
+    static const PACKEDENTRY ceXop4 = { 0x8F, ENTRY_CopyBytesXop4 };
+
+    switch (pbSrc[1] & 0x1F) {
+    default: return DecodeBytes(&cePop, pbSrc);
+    case 8:  return DecodeBytes(&ceXop1, pbSrc);
+    case 9:  return DecodeBytes(&ceXop, pbSrc);
+    case 10: return DecodeBytes(&ceXop4, pbSrc);
+    }
+}
+
+PBYTE CDetourDis::DecodeInvalid(PBYTE pbSrc)
+{
+    m_pDecoded->wFlags |= DETOUR_DECODED_INVALID;
+    return pbSrc + 1;
+}
+
+#undef ENTRY_HANDLER
+#undef ENTRY_HANDLER_NONE
+#define ENTRY_HANDLER(x)            &CDetourDis::x
+#define ENTRY_HANDLER_NONE          NULL
+
 //////////////////////////////////////////////////////////////////////////////
 //
-PBYTE CDetourDis::s_pbModuleBeg = NULL;
-PBYTE CDetourDis::s_pbModuleEnd = (PBYTE)~(ULONG_PTR)0;
-BOOL CDetourDis::s_fLimitReferencesToModule = FALSE;
+DETOUR_DISASM_CONTEXT CDetourDis::s_dcDefault = { NULL, (PBYTE)~(ULONG_PTR)0, FALSE };
 
 BOOL CDetourDis::SetCodeModule(PBYTE pbBeg, PBYTE pbEnd, BOOL fLimitReferencesToModule)
 {
@@ -928,9 +1636,11 @@ BOOL CDetourDis::SetCodeModule(PBYTE pbBeg, PBYTE pbEnd, BOOL fLimitReferencesTo
         return FALSE;
     }
 
-    s_pbModuleBeg = pbBeg;
-    s_pbModuleEnd = pbEnd;
-    s_fLimitReferencesToModule = fLimitReferencesToModule;
+    // Only the shared default context; decoders given their own
+    // DETOUR_DISASM_CONTEXT never look at it.
+    s_dcDefault.pbModuleBeg = pbBeg;
+    s_dcDefault.pbModuleEnd = pbEnd;
+    s_dcDefault.fLimitReferencesToModule = fLimitReferencesToModule;
 
     return TRUE;
 }
@@ -958,647 +1668,78 @@ const BYTE CDetourDis::s_rbModRm[256] = {
 
 const CDetourDis::COPYENTRY CDetourDis::s_rceCopyTable[257] =
 {
-    { 0x00, ENTRY_CopyBytes2Mod },                      // ADD /r
-    { 0x01, ENTRY_CopyBytes2Mod },                      // ADD /r
-    { 0x02, ENTRY_CopyBytes2Mod },                      // ADD /r
-    { 0x03, ENTRY_CopyBytes2Mod },                      // ADD /r
-    { 0x04, ENTRY_CopyBytes2 },                         // ADD ib
-    { 0x05, ENTRY_CopyBytes3Or5 },                      // ADD iw
-#ifdef DETOURS_X64
-    { 0x06, ENTRY_Invalid },                            // Invalid
-    { 0x07, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x06, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x07, ENTRY_CopyBytes1 },                         // POP
-#endif
-    { 0x08, ENTRY_CopyBytes2Mod },                      // OR /r
-    { 0x09, ENTRY_CopyBytes2Mod },                      // OR /r
-    { 0x0A, ENTRY_CopyBytes2Mod },                      // OR /r
-    { 0x0B, ENTRY_CopyBytes2Mod },                      // OR /r
-    { 0x0C, ENTRY_CopyBytes2 },                         // OR ib
-    { 0x0D, ENTRY_CopyBytes3Or5 },                      // OR iw
-#ifdef DETOURS_X64
-    { 0x0E, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x0E, ENTRY_CopyBytes1 },                         // PUSH
-#endif
-    { 0x0F, ENTRY_Copy0F },                             // Extension Ops
-    { 0x10, ENTRY_CopyBytes2Mod },                      // ADC /r
-    { 0x11, ENTRY_CopyBytes2Mod },                      // ADC /r
-    { 0x12, ENTRY_CopyBytes2Mod },                      // ADC /r
-    { 0x13, ENTRY_CopyBytes2Mod },                      // ADC /r
-    { 0x14, ENTRY_CopyBytes2 },                         // ADC ib
-    { 0x15, ENTRY_CopyBytes3Or5 },                      // ADC id
-#ifdef DETOURS_X64
-    { 0x16, ENTRY_Invalid },                            // Invalid
-    { 0x17, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x16, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x17, ENTRY_CopyBytes1 },                         // POP
-#endif
-    { 0x18, ENTRY_CopyBytes2Mod },                      // SBB /r
-    { 0x19, ENTRY_CopyBytes2Mod },                      // SBB /r
-    { 0x1A, ENTRY_CopyBytes2Mod },                      // SBB /r
-    { 0x1B, ENTRY_CopyBytes2Mod },                      // SBB /r
-    { 0x1C, ENTRY_CopyBytes2 },                         // SBB ib
-    { 0x1D, ENTRY_CopyBytes3Or5 },                      // SBB id
-#ifdef DETOURS_X64
-    { 0x1E, ENTRY_Invalid },                            // Invalid
-    { 0x1F, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x1E, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x1F, ENTRY_CopyBytes1 },                         // POP
-#endif
-    { 0x20, ENTRY_CopyBytes2Mod },                      // AND /r
-    { 0x21, ENTRY_CopyBytes2Mod },                      // AND /r
-    { 0x22, ENTRY_CopyBytes2Mod },                      // AND /r
-    { 0x23, ENTRY_CopyBytes2Mod },                      // AND /r
-    { 0x24, ENTRY_CopyBytes2 },                         // AND ib
-    { 0x25, ENTRY_CopyBytes3Or5 },                      // AND id
-    { 0x26, ENTRY_CopyBytesSegment },                   // ES prefix
-#ifdef DETOURS_X64
-    { 0x27, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x27, ENTRY_CopyBytes1 },                         // DAA
-#endif
-    { 0x28, ENTRY_CopyBytes2Mod },                      // SUB /r
-    { 0x29, ENTRY_CopyBytes2Mod },                      // SUB /r
-    { 0x2A, ENTRY_CopyBytes2Mod },                      // SUB /r
-    { 0x2B, ENTRY_CopyBytes2Mod },                      // SUB /r
-    { 0x2C, ENTRY_CopyBytes2 },                         // SUB ib
-    { 0x2D, ENTRY_CopyBytes3Or5 },                      // SUB id
-    { 0x2E, ENTRY_CopyBytesSegment },                   // CS prefix
-#ifdef DETOURS_X64
-    { 0x2F, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x2F, ENTRY_CopyBytes1 },                         // DAS
-#endif
-    { 0x30, ENTRY_CopyBytes2Mod },                      // XOR /r
-    { 0x31, ENTRY_CopyBytes2Mod },                      // XOR /r
-    { 0x32, ENTRY_CopyBytes2Mod },                      // XOR /r
-    { 0x33, ENTRY_CopyBytes2Mod },                      // XOR /r
-    { 0x34, ENTRY_CopyBytes2 },                         // XOR ib
-    { 0x35, ENTRY_CopyBytes3Or5 },                      // XOR id
-    { 0x36, ENTRY_CopyBytesSegment },                   // SS prefix
-#ifdef DETOURS_X64
-    { 0x37, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x37, ENTRY_CopyBytes1 },                         // AAA
-#endif
-    { 0x38, ENTRY_CopyBytes2Mod },                      // CMP /r
-    { 0x39, ENTRY_CopyBytes2Mod },                      // CMP /r
-    { 0x3A, ENTRY_CopyBytes2Mod },                      // CMP /r
-    { 0x3B, ENTRY_CopyBytes2Mod },                      // CMP /r
-    { 0x3C, ENTRY_CopyBytes2 },                         // CMP ib
-    { 0x3D, ENTRY_CopyBytes3Or5 },                      // CMP id
-    { 0x3E, ENTRY_CopyBytesSegment },                   // DS prefix
-#ifdef DETOURS_X64
-    { 0x3F, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x3F, ENTRY_CopyBytes1 },                         // AAS
-#endif
-#ifdef DETOURS_X64 // For Rax Prefix
-    { 0x40, ENTRY_CopyBytesRax },                       // Rax
-    { 0x41, ENTRY_CopyBytesRax },                       // Rax
-    { 0x42, ENTRY_CopyBytesRax },                       // Rax
-    { 0x43, ENTRY_CopyBytesRax },                       // Rax
-    { 0x44, ENTRY_CopyBytesRax },                       // Rax
-    { 0x45, ENTRY_CopyBytesRax },                       // Rax
-    { 0x46, ENTRY_CopyBytesRax },                       // Rax
-    { 0x47, ENTRY_CopyBytesRax },                       // Rax
-    { 0x48, ENTRY_CopyBytesRax },                       // Rax
-    { 0x49, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4A, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4B, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4C, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4D, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4E, ENTRY_CopyBytesRax },                       // Rax
-    { 0x4F, ENTRY_CopyBytesRax },                       // Rax
-#else
-    { 0x40, ENTRY_CopyBytes1 },                         // INC
-    { 0x41, ENTRY_CopyBytes1 },                         // INC
-    { 0x42, ENTRY_CopyBytes1 },                         // INC
-    { 0x43, ENTRY_CopyBytes1 },                         // INC
-    { 0x44, ENTRY_CopyBytes1 },                         // INC
-    { 0x45, ENTRY_CopyBytes1 },                         // INC
-    { 0x46, ENTRY_CopyBytes1 },                         // INC
-    { 0x47, ENTRY_CopyBytes1 },                         // INC
-    { 0x48, ENTRY_CopyBytes1 },                         // DEC
-    { 0x49, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4A, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4B, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4C, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4D, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4E, ENTRY_CopyBytes1 },                         // DEC
-    { 0x4F, ENTRY_CopyBytes1 },                         // DEC
-#endif
-    { 0x50, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x51, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x52, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x53, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x54, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x55, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x56, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x57, ENTRY_CopyBytes1 },                         // PUSH
-    { 0x58, ENTRY_CopyBytes1 },                         // POP
-    { 0x59, ENTRY_CopyBytes1 },                         // POP
-    { 0x5A, ENTRY_CopyBytes1 },                         // POP
-    { 0x5B, ENTRY_CopyBytes1 },                         // POP
-    { 0x5C, ENTRY_CopyBytes1 },                         // POP
-    { 0x5D, ENTRY_CopyBytes1 },                         // POP
-    { 0x5E, ENTRY_CopyBytes1 },                         // POP
-    { 0x5F, ENTRY_CopyBytes1 },                         // POP
-#ifdef DETOURS_X64
-    { 0x60, ENTRY_Invalid },                            // Invalid
-    { 0x61, ENTRY_Invalid },                            // Invalid
-    { 0x62, ENTRY_CopyEvex },                           // EVEX / AVX512
-#else
-    { 0x60, ENTRY_CopyBytes1 },                         // PUSHAD
-    { 0x61, ENTRY_CopyBytes1 },                         // POPAD
-    { 0x62, ENTRY_CopyEvex },                           // BOUND /r and EVEX / AVX512
-#endif
-    { 0x63, ENTRY_CopyBytes2Mod },                      // 32bit ARPL /r, 64bit MOVSXD
-    { 0x64, ENTRY_CopyBytesSegment },                   // FS prefix
-    { 0x65, ENTRY_CopyBytesSegment },                   // GS prefix
-    { 0x66, ENTRY_Copy66 },                             // Operand Prefix
-    { 0x67, ENTRY_Copy67 },                             // Address Prefix
-    { 0x68, ENTRY_CopyBytes3Or5 },                      // PUSH
-    { 0x69, ENTRY_CopyBytes2ModOperand },               // IMUL /r iz
-    { 0x6A, ENTRY_CopyBytes2 },                         // PUSH
-    { 0x6B, ENTRY_CopyBytes2Mod1 },                     // IMUL /r ib
-    { 0x6C, ENTRY_CopyBytes1 },                         // INS
-    { 0x6D, ENTRY_CopyBytes1 },                         // INS
-    { 0x6E, ENTRY_CopyBytes1 },                         // OUTS/OUTSB
-    { 0x6F, ENTRY_CopyBytes1 },                         // OUTS/OUTSW
-    { 0x70, ENTRY_CopyBytes2Jump },                     // JO           // 0f80
-    { 0x71, ENTRY_CopyBytes2Jump },                     // JNO          // 0f81
-    { 0x72, ENTRY_CopyBytes2Jump },                     // JB/JC/JNAE   // 0f82
-    { 0x73, ENTRY_CopyBytes2Jump },                     // JAE/JNB/JNC  // 0f83
-    { 0x74, ENTRY_CopyBytes2Jump },                     // JE/JZ        // 0f84
-    { 0x75, ENTRY_CopyBytes2Jump },                     // JNE/JNZ      // 0f85
-    { 0x76, ENTRY_CopyBytes2Jump },                     // JBE/JNA      // 0f86
-    { 0x77, ENTRY_CopyBytes2Jump },                     // JA/JNBE      // 0f87
-    { 0x78, ENTRY_CopyBytes2Jump },                     // JS           // 0f88
-    { 0x79, ENTRY_CopyBytes2Jump },                     // JNS          // 0f89
-    { 0x7A, ENTRY_CopyBytes2Jump },                     // JP/JPE       // 0f8a
-    { 0x7B, ENTRY_CopyBytes2Jump },                     // JNP/JPO      // 0f8b
-    { 0x7C, ENTRY_CopyBytes2Jump },                     // JL/JNGE      // 0f8c
-    { 0x7D, ENTRY_CopyBytes2Jump },                     // JGE/JNL      // 0f8d
-    { 0x7E, ENTRY_CopyBytes2Jump },                     // JLE/JNG      // 0f8e
-    { 0x7F, ENTRY_CopyBytes2Jump },                     // JG/JNLE      // 0f8f
-    { 0x80, ENTRY_CopyBytes2Mod1 },                     // ADD/0 OR/1 ADC/2 SBB/3 AND/4 SUB/5 XOR/6 CMP/7 byte reg, immediate byte
-    { 0x81, ENTRY_CopyBytes2ModOperand },               // ADD/0 OR/1 ADC/2 SBB/3 AND/4 SUB/5 XOR/6 CMP/7 byte reg, immediate word or dword
-#ifdef DETOURS_X64
-    { 0x82, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x82, ENTRY_CopyBytes2Mod1 },                     // MOV al,x
-#endif
-    { 0x83, ENTRY_CopyBytes2Mod1 },                     // ADD/0 OR/1 ADC/2 SBB/3 AND/4 SUB/5 XOR/6 CMP/7 reg, immediate byte
-    { 0x84, ENTRY_CopyBytes2Mod },                      // TEST /r
-    { 0x85, ENTRY_CopyBytes2Mod },                      // TEST /r
-    { 0x86, ENTRY_CopyBytes2Mod },                      // XCHG /r @todo
-    { 0x87, ENTRY_CopyBytes2Mod },                      // XCHG /r @todo
-    { 0x88, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x89, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x8A, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x8B, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x8C, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x8D, ENTRY_CopyBytes2Mod },                      // LEA /r
-    { 0x8E, ENTRY_CopyBytes2Mod },                      // MOV /r
-    { 0x8F, ENTRY_CopyXop },                            // POP /0 or AMD XOP
-    { 0x90, ENTRY_CopyBytes1 },                         // NOP
-    { 0x91, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x92, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x93, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x94, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x95, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x96, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x97, ENTRY_CopyBytes1 },                         // XCHG
-    { 0x98, ENTRY_CopyBytes1 },                         // CWDE
-    { 0x99, ENTRY_CopyBytes1 },                         // CDQ
-#ifdef DETOURS_X64
-    { 0x9A, ENTRY_Invalid },                            // Invalid
-#else
-    { 0x9A, ENTRY_CopyBytes5Or7Dynamic },               // CALL cp
-#endif
-    { 0x9B, ENTRY_CopyBytes1 },                         // WAIT/FWAIT
-    { 0x9C, ENTRY_CopyBytes1 },                         // PUSHFD
-    { 0x9D, ENTRY_CopyBytes1 },                         // POPFD
-    { 0x9E, ENTRY_CopyBytes1 },                         // SAHF
-    { 0x9F, ENTRY_CopyBytes1 },                         // LAHF
-    { 0xA0, ENTRY_CopyBytes1Address },                  // MOV
-    { 0xA1, ENTRY_CopyBytes1Address },                  // MOV
-    { 0xA2, ENTRY_CopyBytes1Address },                  // MOV
-    { 0xA3, ENTRY_CopyBytes1Address },                  // MOV
-    { 0xA4, ENTRY_CopyBytes1 },                         // MOVS
-    { 0xA5, ENTRY_CopyBytes1 },                         // MOVS/MOVSD
-    { 0xA6, ENTRY_CopyBytes1 },                         // CMPS/CMPSB
-    { 0xA7, ENTRY_CopyBytes1 },                         // CMPS/CMPSW
-    { 0xA8, ENTRY_CopyBytes2 },                         // TEST
-    { 0xA9, ENTRY_CopyBytes3Or5 },                      // TEST
-    { 0xAA, ENTRY_CopyBytes1 },                         // STOS/STOSB
-    { 0xAB, ENTRY_CopyBytes1 },                         // STOS/STOSW
-    { 0xAC, ENTRY_CopyBytes1 },                         // LODS/LODSB
-    { 0xAD, ENTRY_CopyBytes1 },                         // LODS/LODSW
-    { 0xAE, ENTRY_CopyBytes1 },                         // SCAS/SCASB
-    { 0xAF, ENTRY_CopyBytes1 },                         // SCAS/SCASD
-    { 0xB0, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB1, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB2, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB3, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB4, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB5, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB6, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB7, ENTRY_CopyBytes2 },                         // MOV B0+rb
-    { 0xB8, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xB9, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBA, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBB, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBC, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBD, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBE, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xBF, ENTRY_CopyBytes3Or5Rax },                   // MOV B8+rb
-    { 0xC0, ENTRY_CopyBytes2Mod1 },                     // RCL/2 ib, etc.
-    { 0xC1, ENTRY_CopyBytes2Mod1 },                     // RCL/2 ib, etc.
-    { 0xC2, ENTRY_CopyBytes3 },                         // RET
-    { 0xC3, ENTRY_CopyBytes1 },                         // RET
-    { 0xC4, ENTRY_CopyVex3 },                           // LES, VEX 3-byte opcodes.
-    { 0xC5, ENTRY_CopyVex2 },                           // LDS, VEX 2-byte opcodes.
-    { 0xC6, ENTRY_CopyBytes2Mod1 },                     // MOV
-    { 0xC7, ENTRY_CopyBytes2ModOperand },               // MOV/0 XBEGIN/7
-    { 0xC8, ENTRY_CopyBytes4 },                         // ENTER
-    { 0xC9, ENTRY_CopyBytes1 },                         // LEAVE
-    { 0xCA, ENTRY_CopyBytes3Dynamic },                  // RET
-    { 0xCB, ENTRY_CopyBytes1Dynamic },                  // RET
-    { 0xCC, ENTRY_CopyBytes1Dynamic },                  // INT 3
-    { 0xCD, ENTRY_CopyBytes2Dynamic },                  // INT ib
-#ifdef DETOURS_X64
-    { 0xCE, ENTRY_Invalid },                            // Invalid
-#else
-    { 0xCE, ENTRY_CopyBytes1Dynamic },                  // INTO
-#endif
-    { 0xCF, ENTRY_CopyBytes1Dynamic },                  // IRET
-    { 0xD0, ENTRY_CopyBytes2Mod },                      // RCL/2, etc.
-    { 0xD1, ENTRY_CopyBytes2Mod },                      // RCL/2, etc.
-    { 0xD2, ENTRY_CopyBytes2Mod },                      // RCL/2, etc.
-    { 0xD3, ENTRY_CopyBytes2Mod },                      // RCL/2, etc.
-#ifdef DETOURS_X64
-    { 0xD4, ENTRY_Invalid },                            // Invalid
-    { 0xD5, ENTRY_Invalid },                            // Invalid
-#else
-    { 0xD4, ENTRY_CopyBytes2 },                         // AAM
-    { 0xD5, ENTRY_CopyBytes2 },                         // AAD
-#endif
-    { 0xD6, ENTRY_Invalid },                            // Invalid
-    { 0xD7, ENTRY_CopyBytes1 },                         // XLAT/XLATB
-    { 0xD8, ENTRY_CopyBytes2Mod },                      // FADD, etc.
-    { 0xD9, ENTRY_CopyBytes2Mod },                      // F2XM1, etc.
-    { 0xDA, ENTRY_CopyBytes2Mod },                      // FLADD, etc.
-    { 0xDB, ENTRY_CopyBytes2Mod },                      // FCLEX, etc.
-    { 0xDC, ENTRY_CopyBytes2Mod },                      // FADD/0, etc.
-    { 0xDD, ENTRY_CopyBytes2Mod },                      // FFREE, etc.
-    { 0xDE, ENTRY_CopyBytes2Mod },                      // FADDP, etc.
-    { 0xDF, ENTRY_CopyBytes2Mod },                      // FBLD/4, etc.
-    { 0xE0, ENTRY_CopyBytes2CantJump },                 // LOOPNE cb
-    { 0xE1, ENTRY_CopyBytes2CantJump },                 // LOOPE cb
-    { 0xE2, ENTRY_CopyBytes2CantJump },                 // LOOP cb
-    { 0xE3, ENTRY_CopyBytes2CantJump },                 // JCXZ/JECXZ
-    { 0xE4, ENTRY_CopyBytes2 },                         // IN ib
-    { 0xE5, ENTRY_CopyBytes2 },                         // IN id
-    { 0xE6, ENTRY_CopyBytes2 },                         // OUT ib
-    { 0xE7, ENTRY_CopyBytes2 },                         // OUT ib
-    { 0xE8, ENTRY_CopyBytes3Or5Target },                // CALL cd
-    { 0xE9, ENTRY_CopyBytes3Or5Target },                // JMP cd
-#ifdef DETOURS_X64
-    { 0xEA, ENTRY_Invalid },                            // Invalid
-#else
-    { 0xEA, ENTRY_CopyBytes5Or7Dynamic },               // JMP cp
-#endif
-    { 0xEB, ENTRY_CopyBytes2Jump },                     // JMP cb
-    { 0xEC, ENTRY_CopyBytes1 },                         // IN ib
-    { 0xED, ENTRY_CopyBytes1 },                         // IN id
-    { 0xEE, ENTRY_CopyBytes1 },                         // OUT
-    { 0xEF, ENTRY_CopyBytes1 },                         // OUT
-    { 0xF0, ENTRY_CopyBytesPrefix },                    // LOCK prefix
-    { 0xF1, ENTRY_CopyBytes1Dynamic },                  // INT1 / ICEBP somewhat documented by AMD, not by Intel
-    { 0xF2, ENTRY_CopyF2 },                             // REPNE prefix
-//#ifdef DETOURS_X86
-    { 0xF3, ENTRY_CopyF3 },                             // REPE prefix
-//#else
-// This does presently suffice for AMD64 but it requires tracing
-// through a bunch of code to verify and seems not worth maintaining.
-//  { 0xF3, ENTRY_CopyBytesPrefix },                    // REPE prefix
-//#endif
-    { 0xF4, ENTRY_CopyBytes1 },                         // HLT
-    { 0xF5, ENTRY_CopyBytes1 },                         // CMC
-    { 0xF6, ENTRY_CopyF6 },                             // TEST/0, DIV/6
-    { 0xF7, ENTRY_CopyF7 },                             // TEST/0, DIV/6
-    { 0xF8, ENTRY_CopyBytes1 },                         // CLC
-    { 0xF9, ENTRY_CopyBytes1 },                         // STC
-    { 0xFA, ENTRY_CopyBytes1 },                         // CLI
-    { 0xFB, ENTRY_CopyBytes1 },                         // STI
-    { 0xFC, ENTRY_CopyBytes1 },                         // CLD
-    { 0xFD, ENTRY_CopyBytes1 },                         // STD
-    { 0xFE, ENTRY_CopyBytes2Mod },                      // DEC/1,INC/0
-    { 0xFF, ENTRY_CopyFF },                             // CALL/2
-    { 0, ENTRY_End },
+#include "disasmtab.h"
 };
 
 const CDetourDis::COPYENTRY CDetourDis::s_rceCopyTable0F[257] =
 {
-#ifdef DETOURS_X86
-    { 0x00, ENTRY_Copy0F00 },                           // sldt/0 str/1 lldt/2 ltr/3 err/4 verw/5 jmpe/6/dynamic invalid/7
-#else
-    { 0x00, ENTRY_CopyBytes2Mod },                      // sldt/0 str/1 lldt/2 ltr/3 err/4 verw/5 jmpe/6/dynamic invalid/7
-#endif
-    { 0x01, ENTRY_CopyBytes2Mod },                      // INVLPG/7, etc.
-    { 0x02, ENTRY_CopyBytes2Mod },                      // LAR/r
-    { 0x03, ENTRY_CopyBytes2Mod },                      // LSL/r
-    { 0x04, ENTRY_Invalid },                            // _04
-    { 0x05, ENTRY_CopyBytes1 },                         // SYSCALL
-    { 0x06, ENTRY_CopyBytes1 },                         // CLTS
-    { 0x07, ENTRY_CopyBytes1 },                         // SYSRET
-    { 0x08, ENTRY_CopyBytes1 },                         // INVD
-    { 0x09, ENTRY_CopyBytes1 },                         // WBINVD
-    { 0x0A, ENTRY_Invalid },                            // _0A
-    { 0x0B, ENTRY_CopyBytes1 },                         // UD2
-    { 0x0C, ENTRY_Invalid },                            // _0C
-    { 0x0D, ENTRY_CopyBytes2Mod },                      // PREFETCH
-    { 0x0E, ENTRY_CopyBytes1 },                         // FEMMS (3DNow -- not in Intel documentation)
-    { 0x0F, ENTRY_CopyBytes2Mod1 },                     // 3DNow Opcodes
-    { 0x10, ENTRY_CopyBytes2Mod },                      // MOVSS MOVUPD MOVSD
-    { 0x11, ENTRY_CopyBytes2Mod },                      // MOVSS MOVUPD MOVSD
-    { 0x12, ENTRY_CopyBytes2Mod },                      // MOVLPD
-    { 0x13, ENTRY_CopyBytes2Mod },                      // MOVLPD
-    { 0x14, ENTRY_CopyBytes2Mod },                      // UNPCKLPD
-    { 0x15, ENTRY_CopyBytes2Mod },                      // UNPCKHPD
-    { 0x16, ENTRY_CopyBytes2Mod },                      // MOVHPD
-    { 0x17, ENTRY_CopyBytes2Mod },                      // MOVHPD
-    { 0x18, ENTRY_CopyBytes2Mod },                      // PREFETCHINTA...
-    { 0x19, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1A, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1B, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1C, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1D, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1E, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop, not documented by Intel, documented by AMD
-    { 0x1F, ENTRY_CopyBytes2Mod },                      // NOP/r multi byte nop
-    { 0x20, ENTRY_CopyBytes2Mod },                      // MOV/r
-    { 0x21, ENTRY_CopyBytes2Mod },                      // MOV/r
-    { 0x22, ENTRY_CopyBytes2Mod },                      // MOV/r
-    { 0x23, ENTRY_CopyBytes2Mod },                      // MOV/r
-#ifdef DETOURS_X64
-    { 0x24, ENTRY_Invalid },                            // _24
-#else
-    { 0x24, ENTRY_CopyBytes2Mod },                      // MOV/r,TR TR is test register on 80386 and 80486, removed in Pentium
-#endif
-    { 0x25, ENTRY_Invalid },                            // _25
-#ifdef DETOURS_X64
-    { 0x26, ENTRY_Invalid },                            // _26
-#else
-    { 0x26, ENTRY_CopyBytes2Mod },                      // MOV TR/r TR is test register on 80386 and 80486, removed in Pentium
-#endif
-    { 0x27, ENTRY_Invalid },                            // _27
-    { 0x28, ENTRY_CopyBytes2Mod },                      // MOVAPS MOVAPD
-    { 0x29, ENTRY_CopyBytes2Mod },                      // MOVAPS MOVAPD
-    { 0x2A, ENTRY_CopyBytes2Mod },                      // CVPI2PS &
-    { 0x2B, ENTRY_CopyBytes2Mod },                      // MOVNTPS MOVNTPD
-    { 0x2C, ENTRY_CopyBytes2Mod },                      // CVTTPS2PI &
-    { 0x2D, ENTRY_CopyBytes2Mod },                      // CVTPS2PI &
-    { 0x2E, ENTRY_CopyBytes2Mod },                      // UCOMISS UCOMISD
-    { 0x2F, ENTRY_CopyBytes2Mod },                      // COMISS COMISD
-    { 0x30, ENTRY_CopyBytes1 },                         // WRMSR
-    { 0x31, ENTRY_CopyBytes1 },                         // RDTSC
-    { 0x32, ENTRY_CopyBytes1 },                         // RDMSR
-    { 0x33, ENTRY_CopyBytes1 },                         // RDPMC
-    { 0x34, ENTRY_CopyBytes1 },                         // SYSENTER
-    { 0x35, ENTRY_CopyBytes1 },                         // SYSEXIT
-    { 0x36, ENTRY_Invalid },                            // _36
-    { 0x37, ENTRY_CopyBytes1 },                         // GETSEC
-    { 0x38, ENTRY_CopyBytes3Mod },                      // SSE3 Opcodes
-    { 0x39, ENTRY_Invalid },                            // _39
-    { 0x3A, ENTRY_CopyBytes3Mod1 },                      // SSE3 Opcodes
-    { 0x3B, ENTRY_Invalid },                            // _3B
-    { 0x3C, ENTRY_Invalid },                            // _3C
-    { 0x3D, ENTRY_Invalid },                            // _3D
-    { 0x3E, ENTRY_Invalid },                            // _3E
-    { 0x3F, ENTRY_Invalid },                            // _3F
-    { 0x40, ENTRY_CopyBytes2Mod },                      // CMOVO (0F 40)
-    { 0x41, ENTRY_CopyBytes2Mod },                      // CMOVNO (0F 41)
-    { 0x42, ENTRY_CopyBytes2Mod },                      // CMOVB & CMOVNE (0F 42)
-    { 0x43, ENTRY_CopyBytes2Mod },                      // CMOVAE & CMOVNB (0F 43)
-    { 0x44, ENTRY_CopyBytes2Mod },                      // CMOVE & CMOVZ (0F 44)
-    { 0x45, ENTRY_CopyBytes2Mod },                      // CMOVNE & CMOVNZ (0F 45)
-    { 0x46, ENTRY_CopyBytes2Mod },                      // CMOVBE & CMOVNA (0F 46)
-    { 0x47, ENTRY_CopyBytes2Mod },                      // CMOVA & CMOVNBE (0F 47)
-    { 0x48, ENTRY_CopyBytes2Mod },                      // CMOVS (0F 48)
-    { 0x49, ENTRY_CopyBytes2Mod },                      // CMOVNS (0F 49)
-    { 0x4A, ENTRY_CopyBytes2Mod },                      // CMOVP & CMOVPE (0F 4A)
-    { 0x4B, ENTRY_CopyBytes2Mod },                      // CMOVNP & CMOVPO (0F 4B)
-    { 0x4C, ENTRY_CopyBytes2Mod },                      // CMOVL & CMOVNGE (0F 4C)
-    { 0x4D, ENTRY_CopyBytes2Mod },                      // CMOVGE & CMOVNL (0F 4D)
-    { 0x4E, ENTRY_CopyBytes2Mod },                      // CMOVLE & CMOVNG (0F 4E)
-    { 0x4F, ENTRY_CopyBytes2Mod },                      // CMOVG & CMOVNLE (0F 4F)
-    { 0x50, ENTRY_CopyBytes2Mod },                      // MOVMSKPD MOVMSKPD
-    { 0x51, ENTRY_CopyBytes2Mod },                      // SQRTPS &
-    { 0x52, ENTRY_CopyBytes2Mod },                      // RSQRTTS RSQRTPS
-    { 0x53, ENTRY_CopyBytes2Mod },                      // RCPPS RCPSS
-    { 0x54, ENTRY_CopyBytes2Mod },                      // ANDPS ANDPD
-    { 0x55, ENTRY_CopyBytes2Mod },                      // ANDNPS ANDNPD
-    { 0x56, ENTRY_CopyBytes2Mod },                      // ORPS ORPD
-    { 0x57, ENTRY_CopyBytes2Mod },                      // XORPS XORPD
-    { 0x58, ENTRY_CopyBytes2Mod },                      // ADDPS &
-    { 0x59, ENTRY_CopyBytes2Mod },                      // MULPS &
-    { 0x5A, ENTRY_CopyBytes2Mod },                      // CVTPS2PD &
-    { 0x5B, ENTRY_CopyBytes2Mod },                      // CVTDQ2PS &
-    { 0x5C, ENTRY_CopyBytes2Mod },                      // SUBPS &
-    { 0x5D, ENTRY_CopyBytes2Mod },                      // MINPS &
-    { 0x5E, ENTRY_CopyBytes2Mod },                      // DIVPS &
-    { 0x5F, ENTRY_CopyBytes2Mod },                      // MASPS &
-    { 0x60, ENTRY_CopyBytes2Mod },                      // PUNPCKLBW/r
-    { 0x61, ENTRY_CopyBytes2Mod },                      // PUNPCKLWD/r
-    { 0x62, ENTRY_CopyBytes2Mod },                      // PUNPCKLWD/r
-    { 0x63, ENTRY_CopyBytes2Mod },                      // PACKSSWB/r
-    { 0x64, ENTRY_CopyBytes2Mod },                      // PCMPGTB/r
-    { 0x65, ENTRY_CopyBytes2Mod },                      // PCMPGTW/r
-    { 0x66, ENTRY_CopyBytes2Mod },                      // PCMPGTD/r
-    { 0x67, ENTRY_CopyBytes2Mod },                      // PACKUSWB/r
-    { 0x68, ENTRY_CopyBytes2Mod },                      // PUNPCKHBW/r
-    { 0x69, ENTRY_CopyBytes2Mod },                      // PUNPCKHWD/r
-    { 0x6A, ENTRY_CopyBytes2Mod },                      // PUNPCKHDQ/r
-    { 0x6B, ENTRY_CopyBytes2Mod },                      // PACKSSDW/r
-    { 0x6C, ENTRY_CopyBytes2Mod },                      // PUNPCKLQDQ
-    { 0x6D, ENTRY_CopyBytes2Mod },                      // PUNPCKHQDQ
-    { 0x6E, ENTRY_CopyBytes2Mod },                      // MOVD/r
-    { 0x6F, ENTRY_CopyBytes2Mod },                      // MOV/r
-    { 0x70, ENTRY_CopyBytes2Mod1 },                     // PSHUFW/r ib
-    { 0x71, ENTRY_CopyBytes2Mod1 },                     // PSLLW/6 ib,PSRAW/4 ib,PSRLW/2 ib
-    { 0x72, ENTRY_CopyBytes2Mod1 },                     // PSLLD/6 ib,PSRAD/4 ib,PSRLD/2 ib
-    { 0x73, ENTRY_CopyBytes2Mod1 },                     // PSLLQ/6 ib,PSRLQ/2 ib
-    { 0x74, ENTRY_CopyBytes2Mod },                      // PCMPEQB/r
-    { 0x75, ENTRY_CopyBytes2Mod },                      // PCMPEQW/r
-    { 0x76, ENTRY_CopyBytes2Mod },                      // PCMPEQD/r
-    { 0x77, ENTRY_CopyBytes1 },                         // EMMS
-    // extrq/insertq require mode=3 and are followed by two immediate bytes
-    { 0x78, ENTRY_Copy0F78 },                           // VMREAD/r, 66/EXTRQ/r/ib/ib, F2/INSERTQ/r/ib/ib
-    // extrq/insertq require mod=3, therefore ENTRY_CopyBytes2, but it ends up the same
-    { 0x79, ENTRY_CopyBytes2Mod },                      // VMWRITE/r, 66/EXTRQ/r, F2/INSERTQ/r
-    { 0x7A, ENTRY_Invalid },                            // _7A
-    { 0x7B, ENTRY_Invalid },                            // _7B
-    { 0x7C, ENTRY_CopyBytes2Mod },                      // HADDPS
-    { 0x7D, ENTRY_CopyBytes2Mod },                      // HSUBPS
-    { 0x7E, ENTRY_CopyBytes2Mod },                      // MOVD/r
-    { 0x7F, ENTRY_CopyBytes2Mod },                      // MOV/r
-    { 0x80, ENTRY_CopyBytes3Or5Target },                // JO
-    { 0x81, ENTRY_CopyBytes3Or5Target },                // JNO
-    { 0x82, ENTRY_CopyBytes3Or5Target },                // JB,JC,JNAE
-    { 0x83, ENTRY_CopyBytes3Or5Target },                // JAE,JNB,JNC
-    { 0x84, ENTRY_CopyBytes3Or5Target },                // JE,JZ,JZ
-    { 0x85, ENTRY_CopyBytes3Or5Target },                // JNE,JNZ
-    { 0x86, ENTRY_CopyBytes3Or5Target },                // JBE,JNA
-    { 0x87, ENTRY_CopyBytes3Or5Target },                // JA,JNBE
-    { 0x88, ENTRY_CopyBytes3Or5Target },                // JS
-    { 0x89, ENTRY_CopyBytes3Or5Target },                // JNS
-    { 0x8A, ENTRY_CopyBytes3Or5Target },                // JP,JPE
-    { 0x8B, ENTRY_CopyBytes3Or5Target },                // JNP,JPO
-    { 0x8C, ENTRY_CopyBytes3Or5Target },                // JL,NGE
-    { 0x8D, ENTRY_CopyBytes3Or5Target },                // JGE,JNL
-    { 0x8E, ENTRY_CopyBytes3Or5Target },                // JLE,JNG
-    { 0x8F, ENTRY_CopyBytes3Or5Target },                // JG,JNLE
-    { 0x90, ENTRY_CopyBytes2Mod },                      // CMOVO (0F 40)
-    { 0x91, ENTRY_CopyBytes2Mod },                      // CMOVNO (0F 41)
-    { 0x92, ENTRY_CopyBytes2Mod },                      // CMOVB & CMOVC & CMOVNAE (0F 42)
-    { 0x93, ENTRY_CopyBytes2Mod },                      // CMOVAE & CMOVNB & CMOVNC (0F 43)
-    { 0x94, ENTRY_CopyBytes2Mod },                      // CMOVE & CMOVZ (0F 44)
-    { 0x95, ENTRY_CopyBytes2Mod },                      // CMOVNE & CMOVNZ (0F 45)
-    { 0x96, ENTRY_CopyBytes2Mod },                      // CMOVBE & CMOVNA (0F 46)
-    { 0x97, ENTRY_CopyBytes2Mod },                      // CMOVA & CMOVNBE (0F 47)
-    { 0x98, ENTRY_CopyBytes2Mod },                      // CMOVS (0F 48)
-    { 0x99, ENTRY_CopyBytes2Mod },                      // CMOVNS (0F 49)
-    { 0x9A, ENTRY_CopyBytes2Mod },                      // CMOVP & CMOVPE (0F 4A)
-    { 0x9B, ENTRY_CopyBytes2Mod },                      // CMOVNP & CMOVPO (0F 4B)
-    { 0x9C, ENTRY_CopyBytes2Mod },                      // CMOVL & CMOVNGE (0F 4C)
-    { 0x9D, ENTRY_CopyBytes2Mod },                      // CMOVGE & CMOVNL (0F 4D)
-    { 0x9E, ENTRY_CopyBytes2Mod },                      // CMOVLE & CMOVNG (0F 4E)
-    { 0x9F, ENTRY_CopyBytes2Mod },                      // CMOVG & CMOVNLE (0F 4F)
-    { 0xA0, ENTRY_CopyBytes1 },                         // PUSH
-    { 0xA1, ENTRY_CopyBytes1 },                         // POP
-    { 0xA2, ENTRY_CopyBytes1 },                         // CPUID
-    { 0xA3, ENTRY_CopyBytes2Mod },                      // BT  (0F A3)
-    { 0xA4, ENTRY_CopyBytes2Mod1 },                     // SHLD
-    { 0xA5, ENTRY_CopyBytes2Mod },                      // SHLD
-    { 0xA6, ENTRY_CopyBytes2Mod },                      // XBTS
-    { 0xA7, ENTRY_CopyBytes2Mod },                      // IBTS
-    { 0xA8, ENTRY_CopyBytes1 },                         // PUSH
-    { 0xA9, ENTRY_CopyBytes1 },                         // POP
-    { 0xAA, ENTRY_CopyBytes1 },                         // RSM
-    { 0xAB, ENTRY_CopyBytes2Mod },                      // BTS (0F AB)
-    { 0xAC, ENTRY_CopyBytes2Mod1 },                     // SHRD
-    { 0xAD, ENTRY_CopyBytes2Mod },                      // SHRD
-
-    // 0F AE mod76=mem mod543=0 fxsave
-    // 0F AE mod76=mem mod543=1 fxrstor
-    // 0F AE mod76=mem mod543=2 ldmxcsr
-    // 0F AE mod76=mem mod543=3 stmxcsr
-    // 0F AE mod76=mem mod543=4 xsave
-    // 0F AE mod76=mem mod543=5 xrstor
-    // 0F AE mod76=mem mod543=6 saveopt
-    // 0F AE mod76=mem mod543=7 clflush
-    // 0F AE mod76=11b mod543=5 lfence
-    // 0F AE mod76=11b mod543=6 mfence
-    // 0F AE mod76=11b mod543=7 sfence
-    // F3 0F AE mod76=11b mod543=0 rdfsbase
-    // F3 0F AE mod76=11b mod543=1 rdgsbase
-    // F3 0F AE mod76=11b mod543=2 wrfsbase
-    // F3 0F AE mod76=11b mod543=3 wrgsbase
-    { 0xAE, ENTRY_CopyBytes2Mod },                      // fxsave fxrstor ldmxcsr stmxcsr xsave xrstor saveopt clflush lfence mfence sfence rdfsbase rdgsbase wrfsbase wrgsbase
-    { 0xAF, ENTRY_CopyBytes2Mod },                      // IMUL (0F AF)
-    { 0xB0, ENTRY_CopyBytes2Mod },                      // CMPXCHG (0F B0)
-    { 0xB1, ENTRY_CopyBytes2Mod },                      // CMPXCHG (0F B1)
-    { 0xB2, ENTRY_CopyBytes2Mod },                      // LSS/r
-    { 0xB3, ENTRY_CopyBytes2Mod },                      // BTR (0F B3)
-    { 0xB4, ENTRY_CopyBytes2Mod },                      // LFS/r
-    { 0xB5, ENTRY_CopyBytes2Mod },                      // LGS/r
-    { 0xB6, ENTRY_CopyBytes2Mod },                      // MOVZX/r
-    { 0xB7, ENTRY_CopyBytes2Mod },                      // MOVZX/r
-#ifdef DETOURS_X86
-    { 0xB8, ENTRY_Copy0FB8 },                           // jmpe f3/popcnt
-#else
-    { 0xB8, ENTRY_CopyBytes2Mod },                      // f3/popcnt
-#endif
-    { 0xB9, ENTRY_Invalid },                            // _B9
-    { 0xBA, ENTRY_CopyBytes2Mod1 },                     // BT & BTC & BTR & BTS (0F BA)
-    { 0xBB, ENTRY_CopyBytes2Mod },                      // BTC (0F BB)
-    { 0xBC, ENTRY_CopyBytes2Mod },                      // BSF (0F BC)
-    { 0xBD, ENTRY_CopyBytes2Mod },                      // BSR (0F BD)
-    { 0xBE, ENTRY_CopyBytes2Mod },                      // MOVSX/r
-    { 0xBF, ENTRY_CopyBytes2Mod },                      // MOVSX/r
-    { 0xC0, ENTRY_CopyBytes2Mod },                      // XADD/r
-    { 0xC1, ENTRY_CopyBytes2Mod },                      // XADD/r
-    { 0xC2, ENTRY_CopyBytes2Mod1 },                     // CMPPS &
-    { 0xC3, ENTRY_CopyBytes2Mod },                      // MOVNTI
-    { 0xC4, ENTRY_CopyBytes2Mod1 },                     // PINSRW /r ib
-    { 0xC5, ENTRY_CopyBytes2Mod1 },                     // PEXTRW /r ib
-    { 0xC6, ENTRY_CopyBytes2Mod1 },                     // SHUFPS & SHUFPD
-    { 0xC7, ENTRY_CopyBytes2Mod },                      // CMPXCHG8B (0F C7)
-    { 0xC8, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xC9, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xCA, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xCB, ENTRY_CopyBytes1 },                         // CVTPD2PI BSWAP 0F C8 + rd
-    { 0xCC, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xCD, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xCE, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xCF, ENTRY_CopyBytes1 },                         // BSWAP 0F C8 + rd
-    { 0xD0, ENTRY_CopyBytes2Mod },                      // ADDSUBPS (untestd)
-    { 0xD1, ENTRY_CopyBytes2Mod },                      // PSRLW/r
-    { 0xD2, ENTRY_CopyBytes2Mod },                      // PSRLD/r
-    { 0xD3, ENTRY_CopyBytes2Mod },                      // PSRLQ/r
-    { 0xD4, ENTRY_CopyBytes2Mod },                      // PADDQ
-    { 0xD5, ENTRY_CopyBytes2Mod },                      // PMULLW/r
-    { 0xD6, ENTRY_CopyBytes2Mod },                      // MOVDQ2Q / MOVQ2DQ
-    { 0xD7, ENTRY_CopyBytes2Mod },                      // PMOVMSKB/r
-    { 0xD8, ENTRY_CopyBytes2Mod },                      // PSUBUSB/r
-    { 0xD9, ENTRY_CopyBytes2Mod },                      // PSUBUSW/r
-    { 0xDA, ENTRY_CopyBytes2Mod },                      // PMINUB/r
-    { 0xDB, ENTRY_CopyBytes2Mod },                      // PAND/r
-    { 0xDC, ENTRY_CopyBytes2Mod },                      // PADDUSB/r
-    { 0xDD, ENTRY_CopyBytes2Mod },                      // PADDUSW/r
-    { 0xDE, ENTRY_CopyBytes2Mod },                      // PMAXUB/r
-    { 0xDF, ENTRY_CopyBytes2Mod },                      // PANDN/r
-    { 0xE0, ENTRY_CopyBytes2Mod  },                     // PAVGB
-    { 0xE1, ENTRY_CopyBytes2Mod },                      // PSRAW/r
-    { 0xE2, ENTRY_CopyBytes2Mod },                      // PSRAD/r
-    { 0xE3, ENTRY_CopyBytes2Mod },                      // PAVGW
-    { 0xE4, ENTRY_CopyBytes2Mod },                      // PMULHUW/r
-    { 0xE5, ENTRY_CopyBytes2Mod },                      // PMULHW/r
-    { 0xE6, ENTRY_CopyBytes2Mod },                      // CTDQ2PD &
-    { 0xE7, ENTRY_CopyBytes2Mod },                      // MOVNTQ
-    { 0xE8, ENTRY_CopyBytes2Mod },                      // PSUBB/r
-    { 0xE9, ENTRY_CopyBytes2Mod },                      // PSUBW/r
-    { 0xEA, ENTRY_CopyBytes2Mod },                      // PMINSW/r
-    { 0xEB, ENTRY_CopyBytes2Mod },                      // POR/r
-    { 0xEC, ENTRY_CopyBytes2Mod },                      // PADDSB/r
-    { 0xED, ENTRY_CopyBytes2Mod },                      // PADDSW/r
-    { 0xEE, ENTRY_CopyBytes2Mod },                      // PMAXSW /r
-    { 0xEF, ENTRY_CopyBytes2Mod },                      // PXOR/r
-    { 0xF0, ENTRY_CopyBytes2Mod },                      // LDDQU
-    { 0xF1, ENTRY_CopyBytes2Mod },                      // PSLLW/r
-    { 0xF2, ENTRY_CopyBytes2Mod },                      // PSLLD/r
-    { 0xF3, ENTRY_CopyBytes2Mod },                      // PSLLQ/r
-    { 0xF4, ENTRY_CopyBytes2Mod },                      // PMULUDQ/r
-    { 0xF5, ENTRY_CopyBytes2Mod },                      // PMADDWD/r
-    { 0xF6, ENTRY_CopyBytes2Mod },                      // PSADBW/r
-    { 0xF7, ENTRY_CopyBytes2Mod },                      // MASKMOVQ
-    { 0xF8, ENTRY_CopyBytes2Mod },                      // PSUBB/r
-    { 0xF9, ENTRY_CopyBytes2Mod },                      // PSUBW/r
-    { 0xFA, ENTRY_CopyBytes2Mod },                      // PSUBD/r
-    { 0xFB, ENTRY_CopyBytes2Mod },                      // FSUBQ/r
-    { 0xFC, ENTRY_CopyBytes2Mod },                      // PADDB/r
-    { 0xFD, ENTRY_CopyBytes2Mod },                      // PADDW/r
-    { 0xFE, ENTRY_CopyBytes2Mod },                      // PADDD/r
-    { 0xFF, ENTRY_Invalid },                            // _FF
-    { 0, ENTRY_End },
+#define DETOURS_TABLE_0F
+#include "disasmtab.h"
+#undef DETOURS_TABLE_0F
+};
+
+// The same rows again, folded into PACKEDENTRY by the compiler.
+#undef ENTRY_HANDLER
+#undef ENTRY_HANDLER_NONE
+#define ENTRY_HANDLER(x)            HANDLER_##x
+#define ENTRY_HANDLER_NONE          HANDLER_NONE
+
+const CDetourDis::PACKEDENTRY CDetourDis::s_rpeCopyTable[257] =
+{
+#include "disasmtab.h"
+};
+
+const CDetourDis::PACKEDENTRY CDetourDis::s_rpeCopyTable0F[257] =
+{
+#define DETOURS_TABLE_0F
+#include "disasmtab.h"
+#undef DETOURS_TABLE_0F
 };
 
+#undef ENTRY_HANDLER
+#undef ENTRY_HANDLER_NONE
+#define ENTRY_HANDLER(x)            &CDetourDis::x
+#define ENTRY_HANDLER_NONE          NULL
+
+static_assert(sizeof(CDetourDis::PACKEDENTRY) == 4, "PACKEDENTRY must stay 4 bytes.");
+
+BOOL CDetourDis::SamePackedEntry(REFCOPYENTRY pEntry, REFPACKEDENTRY pPacked)
+{
+    // Indexed by HANDLER_*.
+    static const COPYFUNC s_rpfHandlers[HANDLER_NONE + 1] = {
+        &CDetourDis::CopyBytes,
+        &CDetourDis::CopyBytesPrefix,
+        &CDetourDis::CopyBytesSegment,
+        &CDetourDis::CopyBytesRax,
+        &CDetourDis::CopyBytesJump,
+        &CDetourDis::Invalid,
+        &CDetourDis::Copy0F,
+        &CDetourDis::Copy0F00,
+        &CDetourDis::Copy0F78,
+        &CDetourDis::Copy0FB8,
+        &CDetourDis::Copy66,
+        &CDetourDis::Copy67,
+        &CDetourDis::CopyF2,
+        &CDetourDis::CopyF3,
+        &CDetourDis::CopyF6,
+        &CDetourDis::CopyF7,
+        &CDetourDis::CopyFF,
+        &CDetourDis::CopyVex2,
+        &CDetourDis::CopyVex3,
+        &CDetourDis::CopyEvex,
+        &CDetourDis::CopyXop,
+        NULL,
+    };
+
+    return (pPacked->bHandler <= HANDLER_NONE &&
+            s_rpfHandlers[pPacked->bHandler] == pEntry->pfCopy &&
+            pPacked->FixedSize() == pEntry->nFixedSize &&
+            pPacked->FixedSize16() == pEntry->nFixedSize16 &&
+            pPacked->ModOffset() == pEntry->nModOffset &&
+            pPacked->RelOffset() == pEntry->nRelOffset &&
+            pPacked->bFlagBits == pEntry->nFlagBits);
+}
+
 BOOL CDetourDis::SanityCheckSystem()
 {
     ULONG n = 0;
@@ -1628,6 +1769,19 @@ BOOL CDetourDis::SanityCheckSystem()
         return FALSE;
     }
 
+    // The packed tables used by the decode engine must agree with the
+    // reference tables above, entry for entry, end markers included.
+    for (n = 0; n < 257; n++) {
+        if (!SamePackedEntry(&s_rceCopyTable[n], &s_rpeCopyTable[n])) {
+            ASSERT(!"Packed table differs.");
+            return FALSE;
+        }
+        if (!SamePackedEntry(&s_rceCopyTable0F[n], &s_rpeCopyTable0F[n])) {
+            ASSERT(!"Packed 0F table differs.");
+            return FALSE;
+        }
+    }
+
     return TRUE;
 }
 #endif // defined(DETOURS_X64) || defined(DETOURS_X86)
@@ -4311,10 +4465,17 @@ BOOL WINAPI DetourSetCodeModule(_In_ HMODULE hModule,
     PBYTE pbEnd = (PBYTE)~(ULONG_PTR)0;
 
     if (hModule != NULL) {
+#ifdef _WIN32
         ULONG cbModule = DetourGetModuleSize(hModule);
 
         pbBeg = (PBYTE)hModule;
         pbEnd = (PBYTE)hModule + cbModule;
+#else
+        // No loader to ask for the module size; use a
+        // DETOUR_DISASM_CONTEXT instead.
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+#endif
     }
 
     return CDetourDis::SetCodeModule(pbBeg, pbEnd, fLimitReferencesToModule);
@@ -4327,5 +4488,81 @@ BOOL WINAPI DetourSetCodeModule(_In_ HMODULE hModule,
 #endif
 }
 
+BOOL WINAPI DetourInitializeDisasmContext(_Out_ PDETOUR_DISASM_CONTEXT pContext,
+                                          _In_opt_ PVOID pvModuleBeg,
+                                          _In_opt_ PVOID pvModuleEnd,
+                                          _In_ BOOL fLimitReferencesToModule)
+{
+    PBYTE pbBeg = (PBYTE)pvModuleBeg;
+    PBYTE pbEnd = pvModuleEnd ? (PBYTE)pvModuleEnd : (PBYTE)~(ULONG_PTR)0;
+
+    if (pContext == NULL || pbEnd < pbBeg) {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    pContext->pbModuleBeg = pbBeg;
+    pContext->pbModuleEnd = pbEnd;
+    pContext->fLimitReferencesToModule = fLimitReferencesToModule;
+    return TRUE;
+}
+
+#if !defined(DETOURS_X64) && !defined(DETOURS_X86)
+// Only the x86 and x64 disassemblers look at module bounds.
+PVOID WINAPI DetourCopyInstructionEx(_In_opt_ PVOID pDst,
+                                     _Inout_opt_ PVOID *ppDstPool,
+                                     _In_ PVOID pSrc,
+                                     _Out_opt_ PVOID *ppTarget,
+                                     _Out_opt_ LONG *plExtra,
+                                     _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
+{
+    (void)pContext;
+    return DetourCopyInstruction(pDst, ppDstPool, pSrc, ppTarget, plExtra);
+}
+
+// The decode-only engine exists for x86 and x64 only.
+PVOID WINAPI DetourDecodeInstruction(_In_ PVOID pSrc,
+                                     _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction)
+{
+    return DetourDecodeInstructionEx(pSrc, pInstruction, NULL);
+}
+
+PVOID WINAPI DetourDecodeInstructionEx(_In_ PVOID pSrc,
+                                       _Out_ PDETOUR_DECODED_INSTRUCTION pInstruction,
+                                       _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
+{
+    (void)pSrc;
+    (void)pInstruction;
+    (void)pContext;
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return NULL;
+}
+
+ULONG WINAPI DetourDecodeInstructions(_In_ PVOID pSrc,
+                                      _In_ ULONG cbSrc,
+                                      _Out_writes_to_(cInstructions, return)
+                                      PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                      _In_ ULONG cInstructions)
+{
+    return DetourDecodeInstructionsEx(pSrc, cbSrc, pInstructions, cInstructions, NULL);
+}
+
+ULONG WINAPI DetourDecodeInstructionsEx(_In_ PVOID pSrc,
+                                        _In_ ULONG cbSrc,
+                                        _Out_writes_to_(cInstructions, return)
+                                        PDETOUR_DECODED_INSTRUCTION pInstructions,
+                                        _In_ ULONG cInstructions,
+                                        _In_opt_ const DETOUR_DISASM_CONTEXT *pContext)
+{
+    (void)pSrc;
+    (void)cbSrc;
+    (void)pInstructions;
+    (void)cInstructions;
+    (void)pContext;
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return 0;
+}
+#endif // !defined(DETOURS_X64) && !defined(DETOURS_X86)
+
 //
 ///////////////////////////////////////////////////////////////// End of File.
@@ -0,0 +1,60 @@
+#include "include/detour_job.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "detour/detours.h"
+
+namespace utils {
+
+	void CommitDetourJobs(std::vector<DetourJob>& jobs, bool attach, bool hangAllThread)
+	{
+		std::vector<DetourJob*> pending;
+		for (auto& job : jobs)
+		{
+			job.success = false;
+			if (job.ppPointer && *job.ppPointer && job.detour) pending.push_back(&job);
+		}
+
+		while (!pending.empty())
+		{
+			if (DetourTransactionBegin() != NO_ERROR) return;
+
+			size_t failed = pending.size();
+			for (size_t i = 0; i < pending.size(); ++i)
+			{
+				LONG errorCode = attach ?
+					DetourAttach(pending[i]->ppPointer, pending[i]->detour) :
+					DetourDetach(pending[i]->ppPointer, pending[i]->detour);
+				if (errorCode != NO_ERROR)
+				{
+					failed = i;
+					break;
+				}
+			}
+
+			if (failed == pending.size())
+			{
+				// DetourSetAtomicPatchesÿһԭдʱͲù߳
+#ifdef _WIN32
+				std::deque<WinHandle> closeDeffer;
+				bool updated = DetourTransactionIsAtomic() || DetourUpdateThreads(hangAllThread, closeDeffer);
+#else
+				bool updated = DetourTransactionIsAtomic() ||
+					(hangAllThread ? DetourUpdateAllThreads() : DetourUpdateThread(GetCurrentThread())) == NO_ERROR;
+#endif
+				if (!updated)
+				{
+					DetourTransactionAbort();
+					return;
+				}
+				if (DetourTransactionCommit() != NO_ERROR) return;
+				for (auto job : pending) job->success = true;
+				return;
+			}
+
+			DetourTransactionAbort();
+			pending.erase(pending.begin() + failed);
+		}
+	}
+}
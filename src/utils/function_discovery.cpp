@@ -0,0 +1,386 @@
+#include "include/function_discovery.h"
+#include "include/signature.h"
+#include "include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "detour/detours.h"
+
+namespace utils {
+
+	namespace {
+		// ɨ費κڴ
+		const DETOUR_DISASM_CONTEXT kNoReferences = { nullptr, nullptr, TRUE };
+		// һӱ鿪ͷ֮ǰôֽڿʼɨ裬뱾ʱһѾָ߽ͬ
+		const size_t kSweepOverlap = 64;
+		// Ѻ뵽16ֽ
+		const uint32_t kFunctionAlign = 16;
+		const uint32_t kDirectoryExport = 0;
+
+		enum CandidateFlags : uint8_t
+		{
+			kCandidateCall = 0x01,		// ֱcallĿ
+			kCandidateBoundary = 0x02,	// ǰһָret/jmpмܸ
+			kCandidateInt3 = 0x04,		// ǰint3
+			kCandidateSeed = 0x08,		// ڵ򵼳
+			kCandidateJump = 0x10,		// jmp/jccĿ꣬ǺڵĿ
+		};
+
+		struct Candidate
+		{
+			uint32_t rva;
+			uint32_t padBegin;			// ǰ俪ʼλãûʱrva
+			uint8_t flags;
+		};
+
+		struct Chunk
+		{
+			const PeCodeRange* range;
+			size_t begin;				// range->dataƫ
+			size_t end;
+		};
+
+		struct SweepResult
+		{
+			std::vector<Candidate> candidates;
+			size_t instructions = 0;
+		};
+
+		// ջ֡Ŀͷڲ
+		const char* const kStrongPrologues32[] = {
+			"8B FF 55 8B EC",			// mov edi, edi; push ebp; mov ebp, espȲ
+			"55 8B EC",					// push ebp; mov ebp, esp
+			"55 89 E5",					// gccд
+			"6A ?? 68 ?? ?? ?? ?? E8",	// push -2; push scopetable; call __SEH_prolog4
+			"68 ?? ?? ?? ?? 68 ?? ?? ?? ?? E8",
+			"55 57 56 53",				// gccʡָ֡ʱȱ汻߼Ĵ
+			"53 56 57",
+		};
+
+		// ʡָ֡ʱĿͷڲҲܳ
+		const char* const kWeakPrologues32[] = {
+			"83 EC",					// sub esp, imm8
+			"81 EC",					// sub esp, imm32
+			"56 57",
+			"57 56",
+			"56 53",
+			"55 57",
+		};
+
+		const char* const kStrongPrologues64[] = {
+			"48 89 5C 24",				// mov [rsp+x], rbx
+			"48 89 4C 24",				// ѼĴӰӿռ
+			"48 89 54 24",
+			"4C 89 44 24",
+			"48 8B C4",					// mov rax, rsp
+			"55 48 89 E5",				// gccд
+			"41 57 41 56",
+		};
+
+		const char* const kWeakPrologues64[] = {
+			"40 53", "40 55", "40 56", "40 57",
+			"41 54", "41 55", "41 56", "41 57",
+			"48 83 EC",					// sub rsp, imm8
+			"48 81 EC",					// sub rsp, imm32
+			"55 48 89",					// push rbp; mov rbp, rdi֮
+			"53 48 83 EC",
+		};
+
+		template <size_t N>
+		std::vector<Signature> CompilePrologues(const char* const (&patterns)[N])
+		{
+			std::vector<Signature> signatures;
+			for (auto pattern : patterns) signatures.emplace_back(pattern);
+			return signatures;
+		}
+
+		bool MatchPrologue(const std::vector<Signature>& prologues, const uint8_t* code, size_t available)
+		{
+			for (auto& prologue : prologues)
+			{
+				if (prologue.Length() <= available && prologue.MatchAt(code)) return true;
+			}
+			return false;
+		}
+
+		const PeCodeRange* RangeOf(const std::vector<PeCodeRange>& ranges, uint32_t rva)
+		{
+			auto it = std::upper_bound(ranges.begin(), ranges.end(), rva, [](uint32_t value, const PeCodeRange& range) { return value < range.rva; });
+			if (it == ranges.begin()) return nullptr;
+			--it;
+			return (rva - it->rva < it->size) ? &*it : nullptr;
+		}
+
+		void Sweep(const Chunk& chunk, bool is64, SweepResult& result)
+		{
+			const PeCodeRange& range = *chunk.range;
+			size_t pos = chunk.begin > kSweepOverlap ? chunk.begin - kSweepOverlap : 0;
+
+			// ڿͷ߽ͬ
+			bool flowEnd = (pos == 0);
+			bool padding = false;
+			bool int3 = false;
+			size_t padBegin = pos;
+
+			while (pos < chunk.end)
+			{
+				const uint8_t* code = range.data + pos;
+				size_t available = range.size - pos;
+
+				ULONG fillerAvailable = (ULONG)(std::min)(available, (size_t)16);
+				ULONG filler = is64 ?
+					DetourIsCodeFillerX64((PVOID)code, fillerAvailable) :
+					DetourIsCodeFillerX86((PVOID)code, fillerAvailable);
+				if (filler)
+				{
+					if (!padding)
+					{
+						padding = true;
+						padBegin = pos;
+					}
+					if (code[0] == 0xCC) int3 = true;
+					pos += filler;
+					continue;
+				}
+
+				if (pos >= chunk.begin && (flowEnd || int3))
+				{
+					Candidate candidate;
+					candidate.rva = (uint32_t)(range.rva + pos);
+					candidate.padBegin = (uint32_t)(range.rva + (padding ? padBegin : pos));
+					candidate.flags = (uint8_t)((flowEnd ? kCandidateBoundary : 0) | (int3 ? kCandidateInt3 : 0));
+					result.candidates.push_back(candidate);
+				}
+				padding = false;
+				int3 = false;
+
+				// βһָʱ룬öӳ䷶Χ
+				uint8_t buffer[32] = { 0 };
+				PBYTE decodeAt = (PBYTE)code;
+				if (available < 16)
+				{
+					memcpy(buffer, code, available);
+					decodeAt = buffer;
+				}
+
+				DETOUR_DECODED_INSTRUCTION decoded;
+				PBYTE next = is64 ?
+					(PBYTE)DetourDecodeInstructionExX64(decodeAt, &decoded, &kNoReferences) :
+					(PBYTE)DetourDecodeInstructionExX86(decodeAt, &decoded, &kNoReferences);
+				if (!next || decoded.cbInstruction == 0 || decoded.cbInstruction > available ||
+					(decoded.wFlags & DETOUR_DECODED_INVALID))
+				{
+					// ݻû룬һֽڼ
+					flowEnd = false;
+					++pos;
+					continue;
+				}
+
+				if (pos >= chunk.begin)
+				{
+					++result.instructions;
+					if ((decoded.wFlags & (DETOUR_DECODED_CALL | DETOUR_DECODED_BRANCH)) &&
+						decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE &&
+						decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC)
+					{
+						intptr_t delta = (intptr_t)decoded.pbTarget - (intptr_t)decodeAt;
+						uint32_t target = (uint32_t)(range.rva + pos + delta);
+						// call $+5ȡeipд
+						if (delta != (intptr_t)decoded.cbInstruction)
+						{
+							Candidate candidate;
+							candidate.rva = target;
+							candidate.padBegin = target;
+							candidate.flags = (decoded.wFlags & DETOUR_DECODED_CALL) ? kCandidateCall : kCandidateJump;
+							result.candidates.push_back(candidate);
+						}
+					}
+				}
+
+				flowEnd = (decoded.wFlags & DETOUR_DECODED_RETURN) != 0 ||
+					((decoded.wFlags & DETOUR_DECODED_BRANCH) && !(decoded.wFlags & DETOUR_DECODED_CONDITIONAL));
+				pos += decoded.cbInstruction;
+			}
+		}
+
+		void AddSeed(std::vector<Candidate>& candidates, uint32_t rva)
+		{
+			Candidate candidate;
+			candidate.rva = rva;
+			candidate.padBegin = rva;
+			candidate.flags = kCandidateSeed;
+			candidates.push_back(candidate);
+		}
+
+		// ڴеĺת
+		void AddExports(const PeImage& image, std::vector<Candidate>& candidates)
+		{
+			uint32_t dirRva = 0;
+			uint32_t dirSize = 0;
+			if (!image.DataDirectory(kDirectoryExport, dirRva, dirSize)) return;
+
+			// IMAGE_EXPORT_DIRECTORY
+			const uint8_t* directory = image.RvaToPtr(dirRva, 40);
+			if (!directory) return;
+
+			uint32_t numberOfFunctions = 0;
+			uint32_t addressOfFunctions = 0;
+			memcpy(&numberOfFunctions, directory + 20, 4);
+			memcpy(&addressOfFunctions, directory + 28, 4);
+
+			const uint8_t* functions = image.RvaToPtr(addressOfFunctions, (size_t)numberOfFunctions * 4);
+			if (!functions) return;
+
+			for (uint32_t i = 0; i < numberOfFunctions; ++i)
+			{
+				uint32_t rva = 0;
+				memcpy(&rva, functions + (size_t)i * 4, 4);
+				if (rva == 0 || (rva >= dirRva && rva - dirRva < dirSize)) continue;
+				AddSeed(candidates, rva);
+			}
+		}
+	}
+
+	PeFunctionTable DiscoverFunctions(const PeImage& image, ThreadPool* pool/* = nullptr*/, FunctionDiscoveryStats* stats/* = nullptr*/)
+	{
+		FunctionDiscoveryStats localStats;
+		if (!stats) stats = &localStats;
+		*stats = FunctionDiscoveryStats();
+
+		if (image.Invalid()) return PeFunctionTable();
+
+		bool is64 = image.Is64Bit();
+		std::vector<PeCodeRange> ranges = image.ExecutableRanges();
+		std::sort(ranges.begin(), ranges.end(), [](const PeCodeRange& a, const PeCodeRange& b) { return a.rva < b.rva; });
+
+		std::vector<Chunk> chunks;
+		for (auto& range : ranges)
+		{
+			for (size_t begin = 0; begin < range.size; begin += kDiscoveryChunkSize)
+			{
+				Chunk chunk;
+				chunk.range = &range;
+				chunk.begin = begin;
+				chunk.end = (std::min)(range.size, begin + kDiscoveryChunkSize);
+				chunks.push_back(chunk);
+			}
+		}
+
+		std::vector<SweepResult> results(chunks.size());
+		if (pool && chunks.size() > 1)
+		{
+			pool->ParallelFor(chunks.size(), [&](size_t index) { Sweep(chunks[index], is64, results[index]); });
+		}
+		else
+		{
+			for (size_t i = 0; i < chunks.size(); ++i) Sweep(chunks[i], is64, results[i]);
+		}
+
+		std::vector<Candidate> candidates;
+		size_t total = 0;
+		for (auto& result : results) total += result.candidates.size();
+		candidates.reserve(total + 1);
+		for (auto& result : results)
+		{
+			stats->instructions += result.instructions;
+			candidates.insert(candidates.end(), result.candidates.begin(), result.candidates.end());
+			std::vector<Candidate>().swap(result.candidates);
+		}
+
+		AddSeed(candidates, image.EntryPointRva());
+		AddExports(image, candidates);
+
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.rva < b.rva; });
+
+		const std::vector<Signature> strongPrologues = is64 ? CompilePrologues(kStrongPrologues64) : CompilePrologues(kStrongPrologues32);
+		const std::vector<Signature> weakPrologues = is64 ? CompilePrologues(kWeakPrologues64) : CompilePrologues(kWeakPrologues32);
+
+		// ϶ڣpadBeginȷһĽλ
+		std::vector<Candidate> starts;
+		for (size_t i = 0; i < candidates.size();)
+		{
+			uint32_t rva = candidates[i].rva;
+			uint32_t padBegin = rva;
+			uint8_t flags = 0;
+			size_t calls = 0;
+			for (; i < candidates.size() && candidates[i].rva == rva; ++i)
+			{
+				flags |= candidates[i].flags;
+				if (candidates[i].flags & kCandidateCall) ++calls;
+				if (candidates[i].flags & (kCandidateBoundary | kCandidateInt3)) padBegin = (std::min)(padBegin, candidates[i].padBegin);
+			}
+
+			const PeCodeRange* range = RangeOf(ranges, rva);
+			if (!range) continue;
+
+			if (flags & kCandidateCall) ++stats->callTargets;
+			if (flags & (kCandidateBoundary | kCandidateInt3)) ++stats->boundaries;
+			if (flags & kCandidateSeed) ++stats->seeds;
+
+			bool accept = (flags & kCandidateSeed) != 0;
+
+			// int3䣺뵽16ֽڣǰret/jmpֹ߲һint3
+			// ֻһint3ǰcallĶnoreturn֮󣬺û
+			if (!accept && (flags & kCandidateInt3) && rva % kFunctionAlign == 0 &&
+				((flags & kCandidateBoundary) || rva - padBegin > 1))
+			{
+				accept = true;
+			}
+
+			if (!accept)
+			{
+				// ֻתûcallģʹret֮ͷҲǶѭͷ
+				int needed = ((flags & kCandidateJump) && !calls) ? 3 : 2;
+				int evidence = 0;
+				if (calls) ++evidence;
+				if (calls > 1) ++evidence;
+				if (flags & (kCandidateBoundary | kCandidateInt3)) ++evidence;
+				if (evidence < needed)
+				{
+					size_t offset = rva - range->rva;
+					const uint8_t* code = range->data + offset;
+					size_t available = range->size - offset;
+					if (MatchPrologue(strongPrologues, code, available)) evidence += 2;
+					else if (MatchPrologue(weakPrologues, code, available)) ++evidence;
+				}
+				accept = evidence >= needed;
+			}
+
+			if (accept)
+			{
+				Candidate start;
+				start.rva = rva;
+				start.padBegin = padBegin;
+				start.flags = flags;
+				starts.push_back(start);
+			}
+		}
+
+		std::vector<PeFunction> functions;
+		functions.reserve(starts.size());
+		for (size_t i = 0; i < starts.size(); ++i)
+		{
+			const PeCodeRange* range = RangeOf(ranges, starts[i].rva);
+			uint32_t end = (uint32_t)(range->rva + range->size);
+			if (i + 1 < starts.size() && starts[i + 1].rva < end)
+			{
+				end = starts[i + 1].rva;
+				if (starts[i + 1].padBegin > starts[i].rva) end = starts[i + 1].padBegin;
+			}
+
+			PeFunction function;
+			function.beginRva = starts[i].rva;
+			function.endRva = end;
+			function.unwindRva = 0;
+			function.primary = 0;
+			functions.push_back(function);
+		}
+
+		stats->functions = functions.size();
+		return PeFunctionTable(std::move(functions));
+	}
+}
@@ -4,7 +4,19 @@
 #include "include\stringex.h"
 #include "detour/detours.h"
 #include "include\system.h"
+#include "include\pe_image.h"
+#include "include\signature.h"
+#include "include\thread_pool.h"
+#include "include\signature_cache.h"
+#include "include\xref_index.h"
+#include "include\hook_timing.h"
+#include "include\detour_job.h"
 #include <TlHelp32.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <tuple>
 
@@ -20,7 +32,8 @@ namespace utils {
 	}
 
 	// ֻhangǰ̣߳ҪؾҪ
-	bool DetourUpdateThreads(bool hangAllThread, std::vector<WinHandle>& closeDeffer)
+	// Ҫύָ̻֮߳ٹأdequeΪWinHandleظرգᶯ
+	bool DetourUpdateThreads(bool hangAllThread, std::deque<WinHandle>& closeDeffer)
 	{
 		if (!hangAllThread)
 		{
@@ -28,6 +41,7 @@ namespace utils {
 		}
 
 		bool success = false;
+		bool complete = true;		// ÿ̶߳Detoursûд򲻿ģҲûöٵ
 
 		int loopTime = 10;
 		WinHandle hSnap;
@@ -56,7 +70,7 @@ namespace utils {
 				// ִ̣߳
 				auto iter = tids.find(te.th32ThreadID);
 				if (te.th32OwnerProcessID == dwPID &&
-					te.th32ThreadID == dwTID &&
+					te.th32ThreadID != dwTID &&
 					iter == tids.end())
 				{
 					havNew = true;
@@ -71,6 +85,10 @@ namespace utils {
 							break;
 						}
 					}
+					else
+					{
+						complete = false;
+					}
 				}
 				ret = Thread32Next(hSnap, &te);
 			}
@@ -79,13 +97,24 @@ namespace utils {
 			if (!havNew) break;
 
 			--loopTime;
+			if (loopTime == 0) complete = false;
 
 		} while (loopTime > 0);
 
+		// ̶߳ͣסʱDetoursͷ֮ǰ߳ժµ
+		if (success && complete) DetourSetAllThreadsUpdated();
+
 		return success;
 	}
 
 	bool DetourAttachFunc(void** ppPointer, void* pDetour, bool hangAllThread)
+	{
+		std::vector<DetourJob> jobs = { { ppPointer, pDetour, false } };
+		CommitDetourJobs(jobs, true, hangAllThread);
+		return jobs[0].success;
+	}
+
+	bool DetourDetachFunc(void** ppPointer, void* pDetour)
 	{
 		LONG errorCode = DetourTransactionBegin();
 		if (errorCode != NO_ERROR) return false;
@@ -93,11 +122,10 @@ namespace utils {
 		bool success = false;
 		do 
 		{
-			std::vector<WinHandle> closeDeffer;
-			success = DetourUpdateThreads(hangAllThread, closeDeffer);
-			if (!success) break;
+			errorCode = DetourUpdateThread(GetCurrentThread());
+			if (errorCode != NO_ERROR) break;
 
-			errorCode = DetourAttach(ppPointer, pDetour);
+			errorCode = DetourDetach(ppPointer, pDetour);
 			if (errorCode != NO_ERROR) break;
 
 			success = true;
@@ -108,28 +136,90 @@ namespace utils {
 		return success;
 	}
 
-	bool DetourDetachFunc(void** ppPointer, void* pDetour)
+	struct TimingHook
 	{
-		LONG errorCode = DetourTransactionBegin();
-		if (errorCode != NO_ERROR) return false;
+		TimingTarget* target;
+		void* stub;
+	};
+
+	// Ŀ꺯ַ¼װϵļʱstub
+	static std::mutex timing_hooks_lock;
+	static std::map<void*, TimingHook> timing_hooks;
+
+	bool AttachTimingHook(void* target, const std::string& name, bool handAllThreads)
+	{
+		if (!target || name.empty()) return false;
+
+		std::lock_guard<std::mutex> guard(timing_hooks_lock);
+		if (timing_hooks.count(target)) return false;
+
+		HookStatId id = RegisterHookStat(name);
+		if (id == kInvalidHookStat) return false;
+
+		std::unique_ptr<TimingTarget> timing(new TimingTarget);
+		timing->original = target;
+		timing->id = id;
 
+		if (DetourTransactionBegin() != NO_ERROR) return false;
+
+		std::deque<WinHandle> closeDeffer;
+		void* stub = nullptr;
 		bool success = false;
-		do 
+		do
 		{
-			errorCode = DetourUpdateThread(GetCurrentThread());
-			if (errorCode != NO_ERROR) break;
+			// stubĿ긽ύʱһɿִ
+			stub = DetourAllocateThunk(target, (ULONG)kTimingStubSize);
+			if (!stub || !WriteTimingStub(stub, timing.get())) break;
 
-			errorCode = DetourDetach(ppPointer, pDetour);
-			if (errorCode != NO_ERROR) break;
+			if (DetourAttach(&timing->original, stub) != NO_ERROR) break;
+
+			// stubʱҪɨģҿ϶ڹ֮߳ǰ
+			if (!DetourTransactionIsAtomic() && !DetourUpdateThreads(handAllThreads, closeDeffer)) break;
 
 			success = true;
 
 		} while (false);
 
-		DetourTransactionCommit();
+		if (success)
+		{
+			success = (DetourTransactionCommit() == NO_ERROR);
+		}
+		else
+		{
+			if (stub) DetourFreeThunk(stub);
+			DetourTransactionAbort();
+		}
+
+		if (success) timing_hooks[target] = TimingHook{ timing.release(), stub };
 		return success;
 	}
 
+	bool AttachTimingHook(HMODULE hModule, const std::string& funcName, bool handAllThreads)
+	{
+		if (!hModule || funcName.empty()) return false;
+		return AttachTimingHook((void*)GetProcAddress(hModule, funcName.c_str()), funcName, handAllThreads);
+	}
+
+	bool DetachTimingHook(void* target)
+	{
+		std::lock_guard<std::mutex> guard(timing_hooks_lock);
+		auto it = timing_hooks.find(target);
+		if (it == timing_hooks.end()) return false;
+
+		TimingHook hook = it->second;
+		if (!DetourDetachFunc(&hook.target->original, hook.stub)) return false;
+		timing_hooks.erase(it);
+
+		// жύ֮ǰ߳̿stubһͷţ
+		// ܻ߳stubTimingTargetֻʮֽڣͷ
+		if (DetourTransactionBegin() == NO_ERROR)
+		{
+			DetourFreeThunk(hook.stub);
+			DetourTransactionCommit();
+		}
+		return true;
+	}
+
 	bool HookFuncByName(HMODULE hModule, const std::string& funcName, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads)
 	{
 		if (!hModule || funcName.empty() || !newFuncAddr) return false;
@@ -138,17 +228,128 @@ namespace utils {
 		if (!dstFunc) return false;
 
 		bool ret = DetourAttachFunc(&dstFunc, newFuncAddr, handAllThreads);
-		if (oldFuncAddr) *(DWORD*)oldFuncAddr = (DWORD)dstFunc;
+		if (oldFuncAddr) *(void**)oldFuncAddr = dstFunc;
+		return ret;
+	}
+
+	const size_t kParallelScanSize = 4 * 1024 * 1024;
+
+	static std::mutex signature_cache_lock;
+	static SignatureCache signature_cache;
+	static bool signature_cache_enabled = false;
+
+	void SetSignatureCacheFile(const std::wstring& cacheFile)
+	{
+		std::lock_guard<std::mutex> guard(signature_cache_lock);
+		signature_cache.Close();
+		signature_cache_enabled = !cacheFile.empty();
+		if (signature_cache_enabled) signature_cache.Open(cacheFile);
+	}
+
+	size_t CodeSize(const PeImage& image)
+	{
+		size_t codeSize = 0;
+		for (auto& range : image.ExecutableRanges())
+		{
+			codeSize += range.size;
+		}
+		return codeSize;
+	}
+
+	// Сʱ̲߳㣻ģ飨QtCEFֿ鲢ɨⳤʱ俨סĿUI߳
+	std::vector<const uint8_t*> ScanModule(const PeImage& image, const SignatureSet& signatures)
+	{
+		if (CodeSize(image) < kParallelScanSize)
+		{
+			return signatures.Find(image);
+		}
+
+		ThreadPool pool;
+		return signatures.Find(image, pool);
+	}
+
+	// ֻģĿִнвңÿ׸еַ
+	std::vector<const uint8_t*> FindCodeInModule(HMODULE hModule, const SignatureSet& signatures)
+	{
+		ULONG moduleSize = DetourGetModuleSize(hModule);
+		if (moduleSize == 0) return std::vector<const uint8_t*>(signatures.Size(), nullptr);
+
+		PeImage image(hModule, moduleSize);
+
+		// signature_cache_lockֻܿأԼɨʱ߳̿ͬʱɨͬģ
+		bool cacheEnabled = false;
+		{
+			std::lock_guard<std::mutex> guard(signature_cache_lock);
+			cacheEnabled = signature_cache_enabled;
+		}
+		if (!cacheEnabled) return ScanModule(image, signatures);
+
+		WCHAR modulePath[MAX_PATH + 1] = { 0 };
+		GetModuleFileNameW(hModule, modulePath, MAX_PATH);
+		std::string moduleName = WideToUtf8(FileName(modulePath));
+
+		return FindSignaturesCached(signature_cache, moduleName, image, signatures, [&image](const SignatureSet& missing)
+		{
+			return ScanModule(image, missing);
+		});
+	}
+
+	bool HookFuncBySignature(HMODULE hModule, const Signature& sig, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads)
+	{
+		if (!hModule || sig.Invalid() || !newFuncAddr) return false;
+
+		void* dstFunc = (void*)FindCodeInModule(hModule, SignatureSet({ sig }))[0];
+		if (!dstFunc) return false;
+
+		bool ret = DetourAttachFunc(&dstFunc, newFuncAddr, handAllThreads);
+		if (oldFuncAddr) *(void**)oldFuncAddr = dstFunc;
 		return ret;
 	}
 
-	// ͨģƥHookȽϸӣʵ
 	bool HookFuncByCode(HMODULE hModule, const byte* codeBuffer, size_t codeBufferLen, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads)
 	{
-		if (newFuncAddr == nullptr) return false;
+		if (!codeBuffer || codeBufferLen == 0) return false;
 
-		// todo
-		return false;
+		return HookFuncBySignature(hModule, Signature(codeBuffer, codeBufferLen), newFuncAddr, oldFuncAddr, handAllThreads);
+	}
+
+	bool HookFuncByCode(HMODULE hModule, const std::string& pattern, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads)
+	{
+		return HookFuncBySignature(hModule, Signature(pattern), newFuncAddr, oldFuncAddr, handAllThreads);
+	}
+
+	bool HookFuncsByCode(HMODULE hModule, std::vector<CodeHookInfo>& hooks, bool handAllThreads)
+	{
+		if (!hModule || hooks.empty()) return false;
+
+		std::vector<Signature> signatures;
+		for (auto& hook : hooks)
+		{
+			hook.success = false;
+			signatures.emplace_back(hook.pattern);
+		}
+
+		std::vector<const uint8_t*> found = FindCodeInModule(hModule, SignatureSet(signatures));
+
+		// ҵһװֻһ߳
+		std::vector<void*> dstFuncs(found.begin(), found.end());
+		std::vector<DetourJob> jobs;
+		for (size_t i = 0; i < hooks.size(); ++i)
+		{
+			jobs.push_back(DetourJob{ &dstFuncs[i], hooks[i].newFuncAddr, false });
+		}
+		CommitDetourJobs(jobs, true, handAllThreads);
+
+		bool success = true;
+		for (size_t i = 0; i < hooks.size(); ++i)
+		{
+			CodeHookInfo& hook = hooks[i];
+			hook.success = jobs[i].success;
+			if (dstFuncs[i] && hook.oldFuncAddr) *(void**)hook.oldFuncAddr = dstFuncs[i];
+			success = success && hook.success;
+		}
+
+		return success;
 	}
 
 	bool UnHookFunc(void* newFuncAddr, void* oldFuncAddr)
@@ -157,4 +358,125 @@ namespace utils {
 
 		return DetourDetachFunc(&oldFuncAddr, newFuncAddr);
 	}
+
+	std::vector<void*> FindCallSites(HMODULE hCaller, void* targetFunc)
+	{
+		std::vector<void*> sites;
+		ULONG moduleSize = hCaller ? DetourGetModuleSize(hCaller) : 0;
+		if (moduleSize == 0 || !targetFunc) return sites;
+
+		PeImage image(hCaller, moduleSize);
+		std::unique_ptr<ThreadPool> pool;
+		if (CodeSize(image) >= kParallelScanSize) pool.reset(new ThreadPool);
+		XrefIndex xrefs(image, pool.get());
+
+		// ͬһģڵĺֱcallģĺֻܾ
+		std::vector<uint32_t> sources;
+		const uint8_t* base = image.Base();
+		const uint8_t* code = (const uint8_t*)DetourCodeFromPointer(targetFunc, nullptr);
+		if (code >= base && code < base + moduleSize)
+		{
+			sources = xrefs.RefsTo((uint32_t)(code - base), kXrefCall | kXrefJump);
+		}
+
+		for (auto& entry : image.Imports())
+		{
+			const uint8_t* slot = image.RvaToPtr(entry.slotRva, sizeof(void*));
+			if (!slot) continue;
+
+			void* value = *(void* const*)slot;
+			if (value != targetFunc && value != (void*)code) continue;
+
+			std::vector<uint32_t> callers = xrefs.RefsTo(entry.slotRva, kXrefCallSlot | kXrefJumpSlot);
+			sources.insert(sources.end(), callers.begin(), callers.end());
+		}
+
+		std::sort(sources.begin(), sources.end());
+		sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+		for (auto rva : sources)
+		{
+			sites.push_back((void*)(base + rva));
+		}
+		return sites;
+	}
+
+	bool HookCallSites(const std::vector<void*>& sites, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads)
+	{
+		if (sites.empty() || !newFuncAddr) return false;
+
+		LONG errorCode = DetourTransactionBegin();
+		if (errorCode != NO_ERROR) return false;
+
+		std::deque<WinHandle> closeDeffer;
+		void* original = nullptr;
+		bool success = false;
+		do
+		{
+			success = true;
+			for (auto site : sites)
+			{
+				// еõͬһoldFuncAddrûͬʱ
+				void* siteOriginal = nullptr;
+				errorCode = DetourAttachCallSite(site, newFuncAddr, &siteOriginal);
+				if (errorCode != NO_ERROR || (original && siteOriginal != original))
+				{
+					success = false;
+					break;
+				}
+				original = siteOriginal;
+			}
+
+			// 嶼ٹ̣߳ʱҪɨģ
+			if (success && !DetourUpdateThreads(handAllThreads, closeDeffer)) success = false;
+
+		} while (false);
+
+		if (success)
+		{
+			success = (DetourTransactionCommit() == NO_ERROR);
+		}
+		else
+		{
+			DetourTransactionAbort();
+		}
+
+		if (success && oldFuncAddr) *(void**)oldFuncAddr = original;
+		return success;
+	}
+
+	bool UnHookCallSites(const std::vector<void*>& sites, void* newFuncAddr)
+	{
+		if (sites.empty() || !newFuncAddr) return false;
+
+		LONG errorCode = DetourTransactionBegin();
+		if (errorCode != NO_ERROR) return false;
+
+		bool success = false;
+		do
+		{
+			errorCode = DetourUpdateThread(GetCurrentThread());
+			if (errorCode != NO_ERROR) break;
+
+			success = true;
+			for (auto site : sites)
+			{
+				if (DetourDetachCallSite(site, newFuncAddr) != NO_ERROR)
+				{
+					success = false;
+					break;
+				}
+			}
+
+		} while (false);
+
+		if (success)
+		{
+			success = (DetourTransactionCommit() == NO_ERROR);
+		}
+		else
+		{
+			DetourTransactionAbort();
+		}
+		return success;
+	}
 }
@@ -0,0 +1,104 @@
+#include "include/hook.h"
+#include "include/detour_job.h"
+
+namespace utils {
+
+	// װɵĹ˴룬дfilterTarget->originalûɳʱһʧ
+	static DetourJob FilterDetourJob(HookInfo& hook)
+	{
+		if (hook.filterTarget) return DetourJob{ &hook.filterTarget->original, hook.filterStub, false };
+		return DetourJob{ &hook.trampoline, hook.newFuncAddr, false };
+	}
+
+	bool HookFuncs(HMODULE hModule, std::vector<HookInfo>& hooks, bool handAllThreads)
+	{
+		if (hooks.empty()) return false;
+
+		std::vector<DetourJob> jobs;
+		for (auto& hook : hooks)
+		{
+			hook.success = false;
+			hook.trampoline = hook.funcName.empty() ? hook.funcAddr :
+				(hModule ? (void*)GetProcAddress(hModule, hook.funcName.c_str()) : nullptr);
+
+			if (!hook.filters.empty() && hook.trampoline && hook.newFuncAddr && !hook.filterStub)
+			{
+				hook.filterStub = ReviveFilterThunk(hook.filters, hook.trampoline, hook.newFuncAddr, &hook.filterTarget);
+				if (!hook.filterStub)
+				{
+					hook.filterTarget = new FilterTarget;
+					hook.filterTarget->original = hook.trampoline;
+					hook.filterTarget->detour = hook.newFuncAddr;
+					hook.filterStub = CreateFilterThunk(hook.filters, hook.filterTarget);
+				}
+			}
+			jobs.push_back(FilterDetourJob(hook));
+		}
+		CommitDetourJobs(jobs, true, handAllThreads);
+
+		bool success = true;
+		for (size_t i = 0; i < hooks.size(); ++i)
+		{
+			HookInfo& hook = hooks[i];
+			hook.success = jobs[i].success;
+			if (hook.filterTarget)
+			{
+				if (hook.success)
+				{
+					hook.trampoline = hook.filterTarget->original;
+				}
+				else
+				{
+					// Ĵܻϴµ̣߳һ
+					if (hook.filterStub) RetireFilterThunk(hook.filterStub, hook.filters, hook.filterTarget);
+					else delete hook.filterTarget;
+					hook.filterStub = nullptr;
+					hook.filterTarget = nullptr;
+				}
+			}
+			if (hook.trampoline && hook.oldFuncAddr) *(void**)hook.oldFuncAddr = hook.trampoline;
+			success = success && hook.success;
+		}
+
+		return success;
+	}
+
+	bool UnHookFuncs(std::vector<HookInfo>& hooks, bool handAllThreads)
+	{
+		std::vector<HookInfo*> installed;
+		std::vector<DetourJob> jobs;
+		for (auto& hook : hooks)
+		{
+			if (!hook.success) continue;
+			installed.push_back(&hook);
+			jobs.push_back(FilterDetourJob(hook));
+		}
+		CommitDetourJobs(jobs, false, handAllThreads);
+
+		bool success = true;
+		for (size_t i = 0; i < installed.size(); ++i)
+		{
+			HookInfo& hook = *installed[i];
+			if (!jobs[i].success)
+			{
+				success = false;
+				continue;
+			}
+
+			// ܻ߳ڹ˴ܣfilterTargetͷţۺ´ͬĹҹ
+			if (hook.filterStub)
+			{
+				hook.trampoline = hook.filterTarget->original;
+				RetireFilterThunk(hook.filterStub, hook.filters, hook.filterTarget);
+				hook.filterStub = nullptr;
+				hook.filterTarget = nullptr;
+			}
+
+			// Ѿͷţ÷ԭַĻغ
+			hook.success = false;
+			if (hook.oldFuncAddr) *(void**)hook.oldFuncAddr = hook.trampoline;
+		}
+
+		return success;
+	}
+}
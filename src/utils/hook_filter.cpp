@@ -0,0 +1,233 @@
+#include "include/hook_filter.h"
+#include "include/code_pool.h"
+#include <map>
+#include <mutex>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FILTER_X64
+#endif
+
+namespace utils {
+
+	namespace {
+		// תĿ꣬
+		enum Label
+		{
+			kLabelNext,			// һ
+			kLabelPass,			// ԭ
+		};
+
+		struct Fixup
+		{
+			size_t offset;		// rel32λ
+			Label label;
+		};
+
+		// je/jne rel320
+		void EmitJcc(CodeWriter& code, uint8_t opcode, Label label, std::vector<Fixup>& fixups)
+		{
+			code({ 0x0F, opcode });
+			fixups.push_back(Fixup{ code.Size(), label });
+			code.U32(0);
+		}
+
+		void ResolveFixups(CodeWriter& code, std::vector<Fixup>& fixups, Label label, size_t target)
+		{
+			for (auto it = fixups.begin(); it != fixups.end();)
+			{
+				if (it->label != label)
+				{
+					++it;
+					continue;
+				}
+				code.Patch32(it->offset, (uint32_t)(target - (it->offset + 4)));
+				it = fixups.erase(it);
+			}
+		}
+
+#ifdef FILTER_X64
+#ifdef _WIN32
+		const uint8_t kArgRegisters[] = { 1, 2, 8, 9 };					// rcx, rdx, r8, r9
+		const uint32_t kFirstStackArg = 4;								// 5[rsp + 8 + 32]
+		const uint32_t kStackArgBias = 4;
+#else
+		const uint8_t kArgRegisters[] = { 7, 6, 2, 1, 8, 9 };			// rdi, rsi, rdx, rcx, r8, r9
+		const uint32_t kFirstStackArg = 6;								// 7[rsp + 8]
+		const uint32_t kStackArgBias = 0;
+#endif
+
+		// cmp arg, value÷չimm32ֱӱȣȷŽr11
+		void EmitCompare(CodeWriter& code, uint32_t index, uint8_t size, uint64_t value)
+		{
+			bool imm32 = size == 4 || (int64_t)value == (int64_t)(int32_t)value;
+			uint8_t rexW = size == 8 ? 0x08 : 0;
+			if (!imm32) code({ 0x49, 0xBB }).U64(value);				// mov r11, value
+
+			if (index < kFirstStackArg)
+			{
+				uint8_t reg = kArgRegisters[index];
+				uint8_t rexB = reg >= 8 ? 0x01 : 0;
+				if (imm32)
+				{
+					if (rexW | rexB) code({ (uint8_t)(0x40 | rexW | rexB) });
+					code({ 0x81, (uint8_t)(0xF8 | (reg & 7)) }).U32((uint32_t)value);	// cmp reg, imm32
+				}
+				else
+				{
+					code({ (uint8_t)(0x4C | rexB), 0x39, (uint8_t)(0xD8 | (reg & 7)) });	// cmp reg, r11
+				}
+			}
+			else
+			{
+				uint32_t disp = 8 + 8 * (index - kFirstStackArg + kStackArgBias);
+				if (imm32)
+				{
+					if (rexW) code({ 0x48 });
+					code({ 0x81, 0xBC, 0x24 }).U32(disp).U32((uint32_t)value);	// cmp [rsp + disp], imm32
+				}
+				else
+				{
+					code({ 0x4C, 0x39, 0x9C, 0x24 }).U32(disp);				// cmp [rsp + disp], r11
+				}
+			}
+		}
+
+		// jmp [slot]r11Լﶼ
+		void EmitJumpThrough(CodeWriter& code, void** slot)
+		{
+			code({ 0x49, 0xBB }).Ptr(slot);								// mov r11, slot
+			code({ 0x41, 0xFF, 0x23 });									// jmp [r11]
+		}
+#else
+		void EmitCompare(CodeWriter& code, uint32_t index, uint8_t size, uint64_t value)
+		{
+			(void)size;
+			code({ 0x81, 0xBC, 0x24 }).U32(4 + 4 * index).U32((uint32_t)value);	// cmp dword [esp + 4 + 4 * index], imm32
+		}
+
+		void EmitJumpThrough(CodeWriter& code, void** slot)
+		{
+			code({ 0xFF, 0x25 }).Ptr(slot);								// jmp [slot]
+		}
+#endif
+
+		// ͷʱҪ֪ռ˶
+		std::mutex thunk_sizes_lock;
+		std::map<void*, size_t> thunk_sizes;
+
+		// ժµĹ˴targetͬĹҹʱóãҹĲͬ
+		struct RetiredThunk
+		{
+			void* thunk;
+			size_t size;
+			FilterTarget* target;
+			std::vector<HookArgFilter> filters;
+		};
+		std::vector<RetiredThunk> retired_thunks;
+
+		bool SameFilters(const std::vector<HookArgFilter>& a, const std::vector<HookArgFilter>& b)
+		{
+			if (a.size() != b.size()) return false;
+			for (size_t i = 0; i < a.size(); ++i)
+			{
+				if (a[i].index != b[i].index || a[i].match != b[i].match ||
+					a[i].size != b[i].size || a[i].values != b[i].values) return false;
+			}
+			return true;
+		}
+	}
+
+	bool BuildFilterStub(const std::vector<HookArgFilter>& filters, FilterTarget* target, std::vector<uint8_t>& code)
+	{
+		if (!target) return false;
+
+		CodeWriter writer;
+		std::vector<Fixup> fixups;
+		for (auto& filter : filters)
+		{
+			if (filter.values.empty()) return false;
+#ifdef FILTER_X64
+			if (filter.size != 4 && filter.size != 8) return false;
+#else
+			if (filter.size != 4) return false;
+#endif
+
+			// inκһȥһûоͻԭnot inκһͻԭ
+			for (auto value : filter.values)
+			{
+				EmitCompare(writer, filter.index, filter.size, value);
+				EmitJcc(writer, 0x84, filter.match == kArgIn ? kLabelNext : kLabelPass, fixups);
+			}
+			if (filter.match == kArgIn)
+			{
+				writer({ 0xE9 });										// jmp pass
+				fixups.push_back(Fixup{ writer.Size(), kLabelPass });
+				writer.U32(0);
+			}
+			ResolveFixups(writer, fixups, kLabelNext, writer.Size());
+		}
+
+		EmitJumpThrough(writer, &target->detour);
+		ResolveFixups(writer, fixups, kLabelPass, writer.Size());
+		EmitJumpThrough(writer, &target->original);
+
+		code.assign(writer.Data(), writer.Data() + writer.Size());
+		return true;
+	}
+
+	void* CreateFilterThunk(const std::vector<HookArgFilter>& filters, FilterTarget* target)
+	{
+		std::vector<uint8_t> code;
+		if (!BuildFilterStub(filters, target, code)) return nullptr;
+
+		void* thunk = AllocCode(code.size());
+		if (!thunk) return nullptr;
+		if (!WriteCode(thunk, code.data(), code.size()))
+		{
+			FreeCode(thunk, code.size());
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> guard(thunk_sizes_lock);
+		thunk_sizes[thunk] = code.size();
+		return thunk;
+	}
+
+	void DestroyFilterThunk(void* thunk)
+	{
+		std::lock_guard<std::mutex> guard(thunk_sizes_lock);
+		auto it = thunk_sizes.find(thunk);
+		if (it == thunk_sizes.end()) return;
+
+		FreeCode(thunk, it->second);
+		thunk_sizes.erase(it);
+	}
+
+	void RetireFilterThunk(void* thunk, const std::vector<HookArgFilter>& filters, FilterTarget* target)
+	{
+		std::lock_guard<std::mutex> guard(thunk_sizes_lock);
+		auto it = thunk_sizes.find(thunk);
+		if (it == thunk_sizes.end()) return;
+
+		retired_thunks.push_back(RetiredThunk{ thunk, it->second, target, filters });
+		thunk_sizes.erase(it);
+	}
+
+	void* ReviveFilterThunk(const std::vector<HookArgFilter>& filters, void* original, void* detour, FilterTarget** target)
+	{
+		std::lock_guard<std::mutex> guard(thunk_sizes_lock);
+		for (auto it = retired_thunks.begin(); it != retired_thunks.end(); ++it)
+		{
+			// originalҲҪһھɴ̻߳ᰴtarget->originalȥ
+			if (it->target->original != original || it->target->detour != detour) continue;
+			if (!SameFilters(it->filters, filters)) continue;
+
+			void* thunk = it->thunk;
+			*target = it->target;
+			thunk_sizes[thunk] = it->size;
+			retired_thunks.erase(it);
+			return thunk;
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,316 @@
+#include "include/hook_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace utils {
+
+	namespace detail {
+		std::atomic<bool> g_hookStatsEnabled(false);
+	}
+
+	namespace {
+		// һ̶߳һhookļֻ߳дrelaxedĶдԭӼ
+		struct alignas(64) Slot
+		{
+			std::atomic<uint32_t> epoch;
+			std::atomic<uint64_t> calls;
+			std::atomic<uint64_t> ticks;
+			std::atomic<uint64_t> maxTicks;
+			std::atomic<uint32_t> buckets[kHookStatBuckets];
+		};
+
+		// һ̵߳вۣһμ¼ĳhookʱŷӦĲ
+		struct alignas(64) ThreadSlots
+		{
+			std::atomic<Slot*> slots[kMaxHookStats];
+		};
+
+		struct Totals
+		{
+			uint64_t calls = 0;
+			uint64_t ticks = 0;
+			uint64_t maxTicks = 0;
+			std::vector<uint64_t> buckets = std::vector<uint64_t>(kHookStatBuckets, 0);
+		};
+
+		// ֻǰѼԪһ߳´дʱּԪͬԼĲۣʱɼԪĲ
+		std::atomic<uint32_t> g_epoch(1);
+
+		struct Registry
+		{
+			std::mutex lock;
+			std::vector<std::string> names;
+			std::vector<ThreadSlots*> threads;
+			Totals retired[kMaxHookStats];		// ˳̵߳ļ
+
+			// rdtscȶʱӵ㣬tick
+			uint64_t startTicks = 0;
+			std::chrono::steady_clock::time_point startTime;
+		};
+
+		// ı뵥Ԫھ̬ʼʱעᣬþֲ̬֤ȹ
+		Registry& GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		// C++14new֤16ֽڵĶ룬Ҫз
+		template <typename T>
+		T* AlignedNew()
+		{
+#ifdef _MSC_VER
+			void* memory = _aligned_malloc(sizeof(T), alignof(T));
+#else
+			void* memory = aligned_alloc(alignof(T), sizeof(T));
+#endif
+			if (!memory) throw std::bad_alloc();
+			return new (memory) T();
+		}
+
+		template <typename T>
+		void AlignedDelete(T* object)
+		{
+			object->~T();
+#ifdef _MSC_VER
+			_aligned_free(object);
+#else
+			free(object);
+#endif
+		}
+
+		inline uint32_t HighestBit(uint64_t value)
+		{
+#ifdef _MSC_VER
+			unsigned long index = 0;
+			_BitScanReverse64(&index, value);
+			return (uint32_t)index;
+#else
+			return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+		}
+
+		inline size_t BucketOf(uint64_t ticks)
+		{
+			if (ticks < (2u << kHookStatSubBits)) return (size_t)ticks;
+
+			uint32_t exponent = HighestBit(ticks);
+			if (exponent > kHookStatMaxExponent) return kHookStatBuckets - 1;
+			uint32_t shift = exponent - kHookStatSubBits;
+			return ((size_t)(shift + 1) << kHookStatSubBits) + (size_t)((ticks >> shift) & (kHookStatSubBuckets - 1));
+		}
+
+		void ClearSlot(Slot* slot, uint32_t epoch)
+		{
+			slot->calls.store(0, std::memory_order_relaxed);
+			slot->ticks.store(0, std::memory_order_relaxed);
+			slot->maxTicks.store(0, std::memory_order_relaxed);
+			for (auto& bucket : slot->buckets) bucket.store(0, std::memory_order_relaxed);
+			slot->epoch.store(epoch, std::memory_order_release);
+		}
+
+		void AddSlot(const Slot* slot, uint32_t epoch, Totals& totals)
+		{
+			if (slot->epoch.load(std::memory_order_acquire) != epoch) return;
+
+			totals.calls += slot->calls.load(std::memory_order_relaxed);
+			totals.ticks += slot->ticks.load(std::memory_order_relaxed);
+			totals.maxTicks = (std::max)(totals.maxTicks, slot->maxTicks.load(std::memory_order_relaxed));
+			for (size_t i = 0; i < kHookStatBuckets; ++i)
+			{
+				totals.buckets[i] += slot->buckets[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		// ߳˳ʱԼļregistry.retiredٴбժ
+		class ThreadSlotsOwner
+		{
+		public:
+			~ThreadSlotsOwner()
+			{
+				if (!m_slots) return;
+
+				Registry& registry = GetRegistry();
+				std::lock_guard<std::mutex> guard(registry.lock);
+				uint32_t epoch = g_epoch.load(std::memory_order_relaxed);
+				for (size_t id = 0; id < kMaxHookStats; ++id)
+				{
+					Slot* slot = m_slots->slots[id].load(std::memory_order_relaxed);
+					if (!slot) continue;
+					AddSlot(slot, epoch, registry.retired[id]);
+					AlignedDelete(slot);
+				}
+				registry.threads.erase(std::remove(registry.threads.begin(), registry.threads.end(), m_slots), registry.threads.end());
+				AlignedDelete(m_slots);
+			}
+
+			ThreadSlots* Get()
+			{
+				if (!m_slots)
+				{
+					m_slots = AlignedNew<ThreadSlots>();
+					for (auto& slot : m_slots->slots) slot.store(nullptr, std::memory_order_relaxed);
+
+					Registry& registry = GetRegistry();
+					std::lock_guard<std::mutex> guard(registry.lock);
+					registry.threads.push_back(m_slots);
+				}
+				return m_slots;
+			}
+
+		private:
+			ThreadSlots* m_slots = nullptr;
+		};
+
+		thread_local ThreadSlotsOwner t_slots;
+
+		Slot* NewSlot(uint32_t epoch)
+		{
+			Slot* slot = AlignedNew<Slot>();
+			ClearSlot(slot, epoch);
+			return slot;
+		}
+	}
+
+	HookStatId RegisterHookStat(const std::string& name)
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		auto it = std::find(registry.names.begin(), registry.names.end(), name);
+		if (it != registry.names.end()) return (HookStatId)(it - registry.names.begin());
+		if (registry.names.size() >= kMaxHookStats) return kInvalidHookStat;
+
+		registry.names.push_back(name);
+		return (HookStatId)(registry.names.size() - 1);
+	}
+
+	void EnableHookStats(bool enable)
+	{
+		if (enable)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			if (registry.startTicks == 0)
+			{
+				registry.startTime = std::chrono::steady_clock::now();
+				registry.startTicks = HookStatTicks();
+			}
+		}
+		detail::g_hookStatsEnabled.store(enable, std::memory_order_relaxed);
+	}
+
+	bool HookStatsEnabled()
+	{
+		return detail::g_hookStatsEnabled.load(std::memory_order_relaxed);
+	}
+
+	void RecordHookCall(HookStatId id, uint64_t ticks)
+	{
+		if (id >= kMaxHookStats) return;
+
+		ThreadSlots* slots = t_slots.Get();
+		Slot* slot = slots->slots[id].load(std::memory_order_relaxed);
+		uint32_t epoch = g_epoch.load(std::memory_order_relaxed);
+		if (!slot)
+		{
+			slot = NewSlot(epoch);
+			slots->slots[id].store(slot, std::memory_order_release);
+		}
+		else if (slot->epoch.load(std::memory_order_relaxed) != epoch)
+		{
+			ClearSlot(slot, epoch);
+		}
+
+		// ֻб߳дۣһдؼɣx86϶ͨmov
+		slot->calls.store(slot->calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		slot->ticks.store(slot->ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+		if (ticks > slot->maxTicks.load(std::memory_order_relaxed)) slot->maxTicks.store(ticks, std::memory_order_relaxed);
+		std::atomic<uint32_t>& bucket = slot->buckets[BucketOf(ticks)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	uint64_t HookStatBucketTicks(size_t index)
+	{
+		if (index < (2u << kHookStatSubBits)) return index;
+
+		uint32_t shift = (uint32_t)(index >> kHookStatSubBits) - 1;
+		uint64_t sub = index & (kHookStatSubBuckets - 1);
+		return (kHookStatSubBuckets + sub) << shift;
+	}
+
+	double HookStatSnapshot::MeanNs() const
+	{
+		return calls ? totalNs / calls : 0;
+	}
+
+	double HookStatSnapshot::PercentileNs(double p) const
+	{
+		if (calls == 0) return 0;
+
+		uint64_t rank = (uint64_t)(p * (calls - 1)) + 1;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < buckets.size(); ++i)
+		{
+			seen += buckets[i];
+			if (seen >= rank) return HookStatBucketTicks(i) * nsPerTick;
+		}
+		return maxNs;
+	}
+
+	std::vector<HookStatSnapshot> SnapshotHookStats(bool reset/* = false*/)
+	{
+		std::vector<HookStatSnapshot> snapshots;
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+
+		// rdtscȶʱӸ˶ٻ㣬ʱԽԽ׼
+		double nsPerTick = 0;
+		if (registry.startTicks != 0)
+		{
+			uint64_t ticks = HookStatTicks() - registry.startTicks;
+			double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry.startTime).count();
+			if (ticks) nsPerTick = ns / ticks;
+		}
+
+		uint32_t epoch = g_epoch.load(std::memory_order_relaxed);
+		for (size_t id = 0; id < registry.names.size(); ++id)
+		{
+			Totals totals = registry.retired[id];
+			for (ThreadSlots* thread : registry.threads)
+			{
+				Slot* slot = thread->slots[id].load(std::memory_order_acquire);
+				if (slot) AddSlot(slot, epoch, totals);
+			}
+
+			HookStatSnapshot snapshot;
+			snapshot.name = registry.names[id];
+			snapshot.calls = totals.calls;
+			snapshot.totalNs = totals.ticks * nsPerTick;
+			snapshot.maxNs = totals.maxTicks * nsPerTick;
+			snapshot.nsPerTick = nsPerTick;
+			snapshot.buckets = std::move(totals.buckets);
+			snapshots.push_back(std::move(snapshot));
+		}
+
+		if (reset)
+		{
+			for (auto& retired : registry.retired) retired = Totals();
+			g_epoch.fetch_add(1, std::memory_order_relaxed);
+		}
+		return snapshots;
+	}
+
+	void ResetHookStats()
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (auto& retired : registry.retired) retired = Totals();
+		g_epoch.fetch_add(1, std::memory_order_relaxed);
+	}
+}
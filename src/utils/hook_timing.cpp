@@ -0,0 +1,395 @@
+#include "include/hook_timing.h"
+#include "include/code_pool.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TIMING_X64
+#endif
+
+#if defined(_MSC_VER) && !defined(TIMING_X64)
+#define TIMING_CDECL __cdecl
+#else
+#define TIMING_CDECL
+#endif
+
+namespace utils {
+
+	namespace {
+		struct TimingFrame
+		{
+			void** retSlot;			// ķصַڵջλ
+			void* retAddr;
+			HookStatId id;
+			uint64_t enterTicks;
+		};
+
+		// ÿ߳һframesֻб߳eventsǵߵߵĻhead߳дtailDrainд
+		struct ThreadTiming
+		{
+			uint32_t thread = 0;
+			uint32_t depth = 0;
+			TimingFrame frames[kTimingMaxDepth];
+
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> dropped{ 0 };
+			char pad[64];
+			std::atomic<uint64_t> tail{ 0 };
+			std::atomic<bool> exited{ false };
+			HookTimingEvent events[kTimingRingSize];
+		};
+
+		struct Registry
+		{
+			std::mutex lock;
+			std::vector<ThreadTiming*> threads;
+			uint64_t dropped = 0;				// ͷ̵߳Ķ
+
+			uint8_t* entry = nullptr;			// ڴ
+		};
+
+		Registry& GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		// ڴ룬һɺͷţܻĳ̵߳ջ
+		uint8_t* g_exitCode = nullptr;
+
+		// t_busyڱִ߳мʱʱλڼ䱻ʱĺڴ棩ֱ͸ݹ
+		thread_local bool t_busy = false;
+		thread_local ThreadTiming* t_timing = nullptr;
+
+		uint32_t CurrentThreadId()
+		{
+#ifdef _WIN32
+			return (uint32_t)GetCurrentThreadId();
+#else
+			return (uint32_t)syscall(SYS_gettid);
+#endif
+		}
+
+		void PushEvent(ThreadTiming* timing, const HookTimingEvent& event)
+		{
+			uint64_t head = timing->head.load(std::memory_order_relaxed);
+			if (head - timing->tail.load(std::memory_order_acquire) >= kTimingRingSize)
+			{
+				timing->dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			timing->events[head % kTimingRingSize] = event;
+			timing->head.store(head + 1, std::memory_order_release);
+		}
+
+		// ߳˳ʱֻǣʣµ¼Drainȡͷ
+		class ThreadTimingOwner
+		{
+		public:
+			~ThreadTimingOwner()
+			{
+				t_busy = true;
+				if (t_timing) t_timing->exited.store(true, std::memory_order_release);
+				t_timing = nullptr;
+			}
+
+			void Touch() {}
+		};
+
+		thread_local ThreadTimingOwner t_owner;
+
+		ThreadTiming* CreateThreadTiming()
+		{
+			ThreadTiming* timing = new ThreadTiming;
+			timing->thread = CurrentThreadId();
+			t_owner.Touch();
+
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			registry.threads.push_back(timing);
+			t_timing = timing;
+			return timing;
+		}
+
+		// stub·صַɳڴ룬Ҫȥԭ
+		void* TIMING_CDECL TimingEnter(TimingTarget* target, void** retSlot, uint64_t ticks)
+		{
+			void* original = target->original;
+			if (t_busy) return original;
+
+			t_busy = true;
+			ThreadTiming* timing = t_timing ? t_timing : CreateThreadTiming();
+
+			// صַѾǳڴ룺㱻ʱĺβת߹һصַ
+			// һ֡֡棬ٻصַڴ뷵ʱһ
+			bool chained = *retSlot == g_exitCode;
+
+			// 㻹ŵ֡صַһһ֮ϣڵǱ쳣longjmpģ
+			while (timing->depth > 0 && (timing->frames[timing->depth - 1].retSlot < retSlot ||
+				(!chained && timing->frames[timing->depth - 1].retSlot == retSlot)))
+			{
+				--timing->depth;
+			}
+
+			if (timing->depth == kTimingMaxDepth)
+			{
+				timing->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (chained && (timing->depth == 0 || timing->frames[timing->depth - 1].retSlot != retSlot))
+			{
+				// һ֡ΪǶ̫û£һҲ
+				timing->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				TimingFrame& frame = timing->frames[timing->depth++];
+				frame.retSlot = retSlot;
+				frame.retAddr = *retSlot;
+				frame.id = target->id;
+				frame.enterTicks = ticks;
+				if (!chained) *retSlot = g_exitCode;
+			}
+			t_busy = false;
+			return original;
+		}
+
+		// ڴspԭغջķصַ
+		void* TIMING_CDECL TimingExit(void** sp, uint64_t ticks)
+		{
+			// ڴֻӻصַĵ÷أһ֡һڣ˵ջƻˣûܷصĵط
+			ThreadTiming* timing = t_timing;
+			if (!timing || timing->depth == 0) abort();
+
+			// һretSlotsp֮µ֡һѹŵ֡retSlotspС
+			// retSlotͬβתģһСǱģ
+			uint32_t base = timing->depth - 1;
+			while (base > 0 && timing->frames[base - 1].retSlot < sp)
+			{
+				--base;
+			}
+
+			bool busy = t_busy;
+			t_busy = true;
+			void** retSlot = timing->frames[base].retSlot;
+			for (uint32_t depth = timing->depth; depth-- > base;)
+			{
+				const TimingFrame& frame = timing->frames[depth];
+				if (frame.retSlot != retSlot) continue;
+				RecordHookCall(frame.id, ticks - frame.enterTicks);
+				PushEvent(timing, HookTimingEvent{ frame.id, timing->thread, depth, frame.enterTicks, ticks });
+			}
+			timing->depth = base;
+			t_busy = busy;
+			return timing->frames[base].retAddr;
+		}
+
+		// ڣĴTimingEnter(target, &صַ, rdtsc)ָصĵַ
+		// ڣ淵ֵĴTimingExit(sp, rdtsc)ָķصַ
+		// x64WindowsSysVĲĴһ𱣴棬ǰջ16ֽڶ벢32ֽӰӿռ
+		void GenerateCommonCode(CodeWriter& entry, CodeWriter& exit)
+		{
+#ifdef TIMING_X64
+			entry({ 0x50, 0x51, 0x52, 0x56, 0x57 });			// push rax, rcx, rdx, rsi, rdi
+			entry({ 0x41, 0x50, 0x41, 0x51, 0x41, 0x52 });		// push r8, r9, r10
+			entry({ 0x48, 0x81, 0xEC }).U32(0xA8);				// sub rsp, 32 + 8 * 16 + 8
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				entry({ 0xF3, 0x0F, 0x7F, (uint8_t)(0x84 | (i << 3)), 0x24 }).U32(32 + 16 * i);	// movdqu [rsp + 32 + 16 * i], xmm_i
+			}
+			entry({ 0x0F, 0x31 });								// rdtsc
+			entry({ 0x48, 0xC1, 0xE2, 0x20 });					// shl rdx, 32
+			entry({ 0x48, 0x09, 0xD0 });						// or rax, rdx
+#ifdef _WIN32
+			entry({ 0x49, 0x89, 0xC0 });						// mov r8, rax
+			entry({ 0x48, 0x8D, 0x94, 0x24 }).U32(0xA8 + 64);	// lea rdx, [rsp + 232]
+			entry({ 0x4C, 0x89, 0xD9 });						// mov rcx, r11
+#else
+			entry({ 0x48, 0x89, 0xC2 });						// mov rdx, rax
+			entry({ 0x48, 0x8D, 0xB4, 0x24 }).U32(0xA8 + 64);	// lea rsi, [rsp + 232]
+			entry({ 0x4C, 0x89, 0xDF });						// mov rdi, r11
+#endif
+			entry({ 0x48, 0xB8 }).Ptr((void*)&TimingEnter);		// mov rax, TimingEnter
+			entry({ 0xFF, 0xD0 });								// call rax
+			entry({ 0x49, 0x89, 0xC3 });						// mov r11, rax
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				entry({ 0xF3, 0x0F, 0x6F, (uint8_t)(0x84 | (i << 3)), 0x24 }).U32(32 + 16 * i);	// movdqu xmm_i, [rsp + 32 + 16 * i]
+			}
+			entry({ 0x48, 0x81, 0xC4 }).U32(0xA8);				// add rsp, 0xA8
+			entry({ 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58 });		// pop r10, r9, r8
+			entry({ 0x5F, 0x5E, 0x5A, 0x59, 0x58 });			// pop rdi, rsi, rdx, rcx, rax
+			entry({ 0x41, 0xFF, 0xE3 });						// jmp r11
+
+			exit({ 0x50, 0x52 });								// push rax, rdx
+			exit({ 0x48, 0x81, 0xEC }).U32(0x40);				// sub rsp, 32 + 2 * 16
+			exit({ 0xF3, 0x0F, 0x7F, 0x84, 0x24 }).U32(32);		// movdqu [rsp + 32], xmm0
+			exit({ 0xF3, 0x0F, 0x7F, 0x8C, 0x24 }).U32(48);		// movdqu [rsp + 48], xmm1
+			exit({ 0x0F, 0x31 });								// rdtsc
+			exit({ 0x48, 0xC1, 0xE2, 0x20 });					// shl rdx, 32
+			exit({ 0x48, 0x09, 0xD0 });							// or rax, rdx
+#ifdef _WIN32
+			exit({ 0x48, 0x89, 0xC2 });							// mov rdx, rax
+			exit({ 0x48, 0x8D, 0x8C, 0x24 }).U32(0x40 + 16);	// lea rcx, [rsp + 80]
+#else
+			exit({ 0x48, 0x89, 0xC6 });							// mov rsi, rax
+			exit({ 0x48, 0x8D, 0xBC, 0x24 }).U32(0x40 + 16);	// lea rdi, [rsp + 80]
+#endif
+			exit({ 0x48, 0xB8 }).Ptr((void*)&TimingExit);		// mov rax, TimingExit
+			exit({ 0xFF, 0xD0 });								// call rax
+			exit({ 0x49, 0x89, 0xC3 });							// mov r11, rax
+			exit({ 0xF3, 0x0F, 0x6F, 0x84, 0x24 }).U32(32);		// movdqu xmm0, [rsp + 32]
+			exit({ 0xF3, 0x0F, 0x6F, 0x8C, 0x24 }).U32(48);		// movdqu xmm1, [rsp + 48]
+			exit({ 0x48, 0x81, 0xC4 }).U32(0x40);				// add rsp, 0x40
+			exit({ 0x5A, 0x58 });								// pop rdx, rax
+			exit({ 0x41, 0xFF, 0xE3 });							// jmp r11
+#else
+			// x86Ĳֻջϻecx/edxeaxstubtarget
+			entry({ 0x51, 0x52 });								// push ecx, edx
+			entry({ 0x89, 0xC1 });								// mov ecx, eax
+			entry({ 0x0F, 0x31 });								// rdtsc
+			entry({ 0x52, 0x50 });								// push edx, eax
+			entry({ 0x8D, 0x44, 0x24, 0x10 });					// lea eax, [esp + 16]
+			entry({ 0x50, 0x51 });								// push eax, ecx
+			entry({ 0xB8 }).Ptr((void*)&TimingEnter);			// mov eax, TimingEnter
+			entry({ 0xFF, 0xD0 });								// call eax
+			entry({ 0x83, 0xC4, 0x10 });						// add esp, 16
+			entry({ 0x5A, 0x59 });								// pop edx, ecx
+			entry({ 0xFF, 0xE0 });								// jmp eax
+
+			// st(0)ĸ㷵ֵTimingExit
+			exit({ 0x50, 0x52 });								// push eax, edx
+			exit({ 0x0F, 0x31 });								// rdtsc
+			exit({ 0x52, 0x50 });								// push edx, eax
+			exit({ 0x8D, 0x4C, 0x24, 0x10 });					// lea ecx, [esp + 16]
+			exit({ 0x51 });										// push ecx
+			exit({ 0xB8 }).Ptr((void*)&TimingExit);				// mov eax, TimingExit
+			exit({ 0xFF, 0xD0 });								// call eax
+			exit({ 0x83, 0xC4, 0x0C });							// add esp, 12
+			exit({ 0x89, 0xC1 });								// mov ecx, eax
+			exit({ 0x5A, 0x58 });								// pop edx, eax
+			exit({ 0xFF, 0xE1 });								// jmp ecx
+#endif
+		}
+
+		// stubֻtargetڣx64r11x86eaxڸԼﶼ
+		// atstubڵĵַx86jmp rel32Ҫ
+		void EmitStub(CodeWriter& stub, TimingTarget* target, uint8_t* entry, uint8_t* at)
+		{
+#ifdef TIMING_X64
+			(void)at;
+			stub({ 0x49, 0xBB }).Ptr(target);					// mov r11, target
+			stub({ 0xFF, 0x25 }).U32(0).Ptr(entry);			// jmp [rip]
+#else
+			stub({ 0xB8 }).Ptr(target);							// mov eax, target
+			stub({ 0xE9 }).U32((uint32_t)(entry - (at + kTimingStubSize)));	// jmp entry
+#endif
+		}
+
+		uint8_t* EntryCode()
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			if (registry.entry) return registry.entry;
+
+			CodeWriter entry;
+			CodeWriter exit;
+			GenerateCommonCode(entry, exit);
+			uint8_t* entryCode = (uint8_t*)AllocCode(entry.Size());
+			uint8_t* exitCode = (uint8_t*)AllocCode(exit.Size());
+			if (!entryCode || !exitCode ||
+				!WriteCode(entryCode, entry.Data(), entry.Size()) ||
+				!WriteCode(exitCode, exit.Data(), exit.Size()))
+			{
+				return nullptr;
+			}
+
+			g_exitCode = exitCode;
+			registry.entry = entryCode;
+			return entryCode;
+		}
+	}
+
+	bool WriteTimingStub(void* code, TimingTarget* target)
+	{
+		if (!code || !target) return false;
+
+		uint8_t* entry = EntryCode();
+		if (!entry) return false;
+
+		CodeWriter stub;
+		EmitStub(stub, target, entry, (uint8_t*)code);
+		memcpy(code, stub.Data(), stub.Size());
+		return true;
+	}
+
+	void* CreateTimingThunk(TimingTarget* target)
+	{
+		if (!target) return nullptr;
+
+		uint8_t* entry = EntryCode();
+		uint8_t* thunk = (uint8_t*)AllocCode(kTimingStubSize);
+		if (!entry || !thunk) return nullptr;
+
+		CodeWriter stub;
+		EmitStub(stub, target, entry, thunk);
+		if (!WriteCode(thunk, stub.Data(), stub.Size()))
+		{
+			FreeCode(thunk, kTimingStubSize);
+			return nullptr;
+		}
+		return thunk;
+	}
+
+	void DestroyTimingThunk(void* thunk)
+	{
+		FreeCode(thunk, kTimingStubSize);
+	}
+
+	size_t DrainHookTimingEvents(std::vector<HookTimingEvent>& events)
+	{
+		size_t count = 0;
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (auto it = registry.threads.begin(); it != registry.threads.end();)
+		{
+			ThreadTiming* timing = *it;
+			bool exited = timing->exited.load(std::memory_order_acquire);
+			uint64_t tail = timing->tail.load(std::memory_order_relaxed);
+			uint64_t head = timing->head.load(std::memory_order_acquire);
+			for (; tail != head; ++tail, ++count)
+			{
+				events.push_back(timing->events[tail % kTimingRingSize]);
+			}
+			timing->tail.store(tail, std::memory_order_release);
+
+			if (exited)
+			{
+				registry.dropped += timing->dropped.load(std::memory_order_relaxed);
+				delete timing;
+				it = registry.threads.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return count;
+	}
+
+	uint64_t DroppedHookTimingEvents()
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		uint64_t dropped = registry.dropped;
+		for (auto timing : registry.threads) dropped += timing->dropped.load(std::memory_order_relaxed);
+		return dropped;
+	}
+}
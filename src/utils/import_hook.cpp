@@ -0,0 +1,289 @@
+#include "include/import_hook.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#include "detour/detours.h"
+#else
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+	namespace {
+		struct FoundSlot
+		{
+			void** slot;
+			void* original;		// öʱֵ
+			void* resolved;		// ۵ĵյģӳٰ󶨻ûʱǽĺͬoriginal
+			bool readOnly;
+		};
+
+		// ıԡдĻȥһλ⣬HookͬһҳʱһһոĵԸĻȥ
+		std::mutex import_slots_lock;
+
+		enum SlotExchange
+		{
+			kSlotExchanged,
+			kSlotChanged,		// ֵexpectedexpectedĳɶֵ
+			kSlotProtectFailed,	// Ĳ˱ԣûд
+		};
+
+#ifdef _WIN32
+		bool NameEquals(const char* a, const std::string& b)
+		{
+			size_t i = 0;
+			for (; a[i] && i < b.size(); ++i)
+			{
+				if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+			}
+			return !a[i] && i == b.size();
+		}
+
+		struct ImportSearch
+		{
+			const std::string* importModule;
+			const std::string* funcName;
+			bool inModule;
+			std::vector<FoundSlot>* slots;
+		};
+
+		BOOL CALLBACK ImportFileCallback(PVOID pContext, HMODULE, LPCSTR pszFile)
+		{
+			ImportSearch* search = (ImportSearch*)pContext;
+			search->inModule = pszFile && (search->importModule->empty() || NameEquals(pszFile, *search->importModule));
+			return TRUE;
+		}
+
+		BOOL CALLBACK ImportFuncCallback(PVOID pContext, DWORD, LPCSTR pszFunc, PVOID* ppvFunc)
+		{
+			ImportSearch* search = (ImportSearch*)pContext;
+			if (search->inModule && pszFunc && ppvFunc && *search->funcName == pszFunc)
+			{
+				search->slots->push_back(FoundSlot{ ppvFunc, *ppvFunc, *ppvFunc, true });
+			}
+			return TRUE;
+		}
+
+		void FindImportSlots(HMODULE hModule, const std::string& importModule, const std::string& funcName, std::vector<FoundSlot>& slots)
+		{
+			ImportSearch search = { &importModule, &funcName, false, &slots };
+			DetourEnumerateImportsEx(hModule, &search, ImportFileCallback, ImportFuncCallback);
+		}
+
+		void FindSlots(void* module, const std::string& importModule, const std::string& funcName, std::vector<FoundSlot>& slots)
+		{
+			if (module)
+			{
+				FindImportSlots((HMODULE)module, importModule, funcName, slots);
+				return;
+			}
+
+			for (HMODULE hModule = DetourEnumerateModules(NULL); hModule; hModule = DetourEnumerateModules(hModule))
+			{
+				FindImportSlots(hModule, importModule, funcName, slots);
+			}
+		}
+
+		// IATܺʹͬһҳıʱԭִȨޣ̻߳һҳ
+		SlotExchange ExchangeSlot(void** slot, void*& expected, void* value, bool)
+		{
+			MEMORY_BASIC_INFORMATION mbi;
+			if (!VirtualQuery(slot, &mbi, sizeof(mbi))) return kSlotProtectFailed;
+			const DWORD executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+			DWORD protect = (mbi.Protect & executable) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+			DWORD oldProtect = 0;
+			if (!VirtualProtect(slot, sizeof(void*), protect, &oldProtect)) return kSlotProtectFailed;
+			void* current = InterlockedCompareExchangePointer(slot, value, expected);
+			VirtualProtect(slot, sizeof(void*), oldProtect, &oldProtect);
+			if (current == expected) return kSlotExchanged;
+			expected = current;
+			return kSlotChanged;
+		}
+#else
+		// ELFֻ֧64λx86-64AArch64
+#if defined(__x86_64__)
+		const uint32_t kRelocJumpSlot = R_X86_64_JUMP_SLOT;
+		const uint32_t kRelocGlobDat = R_X86_64_GLOB_DAT;
+#elif defined(__aarch64__)
+		const uint32_t kRelocJumpSlot = R_AARCH64_JUMP_SLOT;
+		const uint32_t kRelocGlobDat = R_AARCH64_GLOB_DAT;
+#else
+#error "import hook: unsupported ELF architecture"
+#endif
+
+		struct GotSearch
+		{
+			const link_map* module;
+			const std::string* funcName;
+			std::vector<FoundSlot>* slots;
+		};
+
+		// glibc.dynamicĵַĳɾԵַʵֲһֶ
+		uintptr_t DynamicPtr(uintptr_t base, uintptr_t value)
+		{
+			return value < base ? base + value : value;
+		}
+
+		void FindGotSlots(dl_phdr_info* info, const std::string& funcName, std::vector<FoundSlot>& slots)
+		{
+			uintptr_t base = info->dlpi_addr;
+			uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+			uintptr_t begin = UINTPTR_MAX, end = 0;
+			uintptr_t relroBegin = 0, relroEnd = 0;
+			const ElfW(Dyn)* dynamic = nullptr;
+			for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+			{
+				const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+				if (phdr.p_type == PT_LOAD)
+				{
+					begin = (std::min)(begin, base + phdr.p_vaddr);
+					end = (std::max)(end, base + phdr.p_vaddr + phdr.p_memsz);
+				}
+				else if (phdr.p_type == PT_DYNAMIC)
+				{
+					dynamic = (const ElfW(Dyn)*)(base + phdr.p_vaddr);
+				}
+				else if (phdr.p_type == PT_GNU_RELRO)
+				{
+					// ֻҳĳֻĩβһҳĲֺ.dataͬһҳȻд
+					relroBegin = (base + phdr.p_vaddr) & ~(pageSize - 1);
+					relroEnd = (base + phdr.p_vaddr + phdr.p_memsz) & ~(pageSize - 1);
+				}
+			}
+			if (!dynamic) return;
+
+			const ElfW(Sym)* symtab = nullptr;
+			const char* strtab = nullptr;
+			const ElfW(Rela)* tables[2] = { nullptr, nullptr };		// .rela.plt.rela.dyn
+			size_t sizes[2] = { 0, 0 };
+			for (const ElfW(Dyn)* dyn = dynamic; dyn->d_tag != DT_NULL; ++dyn)
+			{
+				switch (dyn->d_tag)
+				{
+				case DT_SYMTAB: symtab = (const ElfW(Sym)*)DynamicPtr(base, dyn->d_un.d_ptr); break;
+				case DT_STRTAB: strtab = (const char*)DynamicPtr(base, dyn->d_un.d_ptr); break;
+				case DT_JMPREL: tables[0] = (const ElfW(Rela)*)DynamicPtr(base, dyn->d_un.d_ptr); break;
+				case DT_PLTRELSZ: sizes[0] = dyn->d_un.d_val; break;
+				case DT_RELA: tables[1] = (const ElfW(Rela)*)DynamicPtr(base, dyn->d_un.d_ptr); break;
+				case DT_RELASZ: sizes[1] = dyn->d_un.d_val; break;
+				}
+			}
+			if (!symtab || !strtab) return;
+
+			for (int t = 0; t < 2; ++t)
+			{
+				if (!tables[t]) continue;
+				for (size_t i = 0; i < sizes[t] / sizeof(ElfW(Rela)); ++i)
+				{
+					const ElfW(Rela)& rela = tables[t][i];
+					uint32_t type = (uint32_t)ELF64_R_TYPE(rela.r_info);
+					if (type != kRelocJumpSlot && type != kRelocGlobDat) continue;
+
+					const ElfW(Sym)& sym = symtab[ELF64_R_SYM(rela.r_info)];
+					if (ELF64_ST_TYPE(sym.st_info) == STT_OBJECT || funcName != strtab + sym.st_name) continue;
+
+					void** slot = (void**)(base + rela.r_offset);
+					void* original = *slot;
+					void* resolved = original;
+					// ӳٰ󶨻ûĲָģPLTԭҪԼ
+					if ((uintptr_t)original >= begin && (uintptr_t)original < end)
+					{
+						resolved = dlsym(RTLD_DEFAULT, funcName.c_str());
+						if (!resolved) continue;
+					}
+
+					bool readOnly = (uintptr_t)slot >= relroBegin && (uintptr_t)slot < relroEnd;
+					slots.push_back(FoundSlot{ slot, original, resolved, readOnly });
+				}
+			}
+		}
+
+		int PhdrCallback(dl_phdr_info* info, size_t, void* data)
+		{
+			GotSearch* search = (GotSearch*)data;
+			if (search->module)
+			{
+				const char* name = info->dlpi_name ? info->dlpi_name : "";
+				const char* moduleName = search->module->l_name ? search->module->l_name : "";
+				if (info->dlpi_addr != search->module->l_addr || strcmp(name, moduleName) != 0) return 0;
+			}
+			FindGotSlots(info, *search->funcName, *search->slots);
+			return 0;
+		}
+
+		void FindSlots(void* module, const std::string&, const std::string& funcName, std::vector<FoundSlot>& slots)
+		{
+			GotSearch search = { (const link_map*)module, &funcName, &slots };
+			dl_iterate_phdr(PhdrCallback, &search);
+		}
+
+		// RELROضλֻģд֮ǰʱдȨ
+		SlotExchange ExchangeSlot(void** slot, void*& expected, void* value, bool readOnly)
+		{
+			uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+			void* page = (void*)((uintptr_t)slot & ~(pageSize - 1));
+			if (readOnly && mprotect(page, pageSize, PROT_READ | PROT_WRITE) != 0) return kSlotProtectFailed;
+			bool success = __atomic_compare_exchange_n(slot, &expected, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			if (readOnly) mprotect(page, pageSize, PROT_READ);
+			return success ? kSlotExchanged : kSlotChanged;
+		}
+#endif
+	}
+
+	size_t ImportHook::Attach(void* module, const std::string& importModule, const std::string& funcName, void* newFunc)
+	{
+		if (Attached() || funcName.empty() || !newFunc) return 0;
+
+		std::vector<FoundSlot> found;
+		FindSlots(module, importModule, funcName, found);
+
+		std::lock_guard<std::mutex> guard(import_slots_lock);
+		for (auto& slot : found)
+		{
+			// һ߳̿дۣӳٰ󶨣ֵ˾Ͱֵ
+			// Ĳ˱ʱҲûã
+			void* current = slot.original;
+			SlotExchange result;
+			while ((result = ExchangeSlot(slot.slot, current, newFunc, slot.readOnly)) == kSlotChanged)
+			{
+				if (current == newFunc) break;
+			}
+			if (result != kSlotExchanged) continue;
+
+			// currentDetachʱдöʱͬ˵̸߳սۣԭ
+			void* original = current == slot.original ? slot.resolved : current;
+			if (m_slots.empty()) m_original = original;
+			m_slots.push_back(Slot{ slot.slot, current, slot.readOnly });
+		}
+
+		if (!m_slots.empty()) m_newFunc = newFunc;
+		return m_slots.size();
+	}
+
+	size_t ImportHook::Detach()
+	{
+		if (!Attached()) return 0;
+
+		size_t restored = 0;
+		std::lock_guard<std::mutex> guard(import_slots_lock);
+		for (auto& slot : m_slots)
+		{
+			void* expected = m_newFunc;
+			if (ExchangeSlot(slot.slot, expected, slot.original, slot.readOnly) == kSlotExchanged) ++restored;
+		}
+
+		// m_originalţܸ߳̿մӲnewFuncͨԭ
+		m_slots.clear();
+		m_newFunc = nullptr;
+		return restored;
+	}
+}
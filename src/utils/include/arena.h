@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace utils {
+
+	// ֻ䲻ͷŵڴأϵͳҪڴ棬ʱͷ
+	// ʺһµĴСͼĻͱߣ̰߳ȫ
+	class Arena
+	{
+	public:
+		explicit Arena(size_t chunkSize = 64 * 1024);
+
+		Arena(const Arena&) = delete;
+		Arena& operator = (const Arena&) = delete;
+
+		// align2ݣsizeΪ0ʱҲЧַ
+		void* Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+		// ֻܷƽͣ
+		template <typename T>
+		T* AllocateArray(size_t count)
+		{
+			return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		// ѷȥֽϵͳֽ
+		size_t BytesUsed() const;
+		size_t BytesReserved() const;
+
+	private:
+		std::vector<std::unique_ptr<uint8_t[]>> m_chunks;
+		size_t m_chunkSize = 0;
+		uint8_t* m_cursor = nullptr;
+		size_t m_left = 0;
+		size_t m_used = 0;
+		size_t m_reserved = 0;
+	};
+}
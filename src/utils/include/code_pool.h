@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+namespace utils {
+
+	// ʱɵСδ32ֽһ䣬ͷŵĸӰСŸãҳϵͳ
+	// дʱҳRXRWX֮лȥִȨޣͬһҳϱĴճ
+	void* AllocCode(size_t size);
+	// codedstˢָ棬dstҪAllocCodeֵ
+	bool WriteCode(void* dst, const void* code, size_t size);
+	void FreeCode(void* code, size_t size);
+
+	// ƴ
+	class CodeWriter
+	{
+	public:
+		CodeWriter& operator()(std::initializer_list<uint8_t> bytes)
+		{
+			m_code.insert(m_code.end(), bytes);
+			return *this;
+		}
+
+		CodeWriter& U32(uint32_t value) { return Value(value); }
+		CodeWriter& U64(uint64_t value) { return Value(value); }
+		CodeWriter& Ptr(const void* value) { return Value((uintptr_t)value); }
+
+		// offset32λֵתrel32д0Ŀȷ
+		void Patch32(size_t offset, uint32_t value) { memcpy(&m_code[offset], &value, sizeof(value)); }
+
+		size_t Size() const { return m_code.size(); }
+		const uint8_t* Data() const { return m_code.data(); }
+
+	private:
+		template <typename T>
+		CodeWriter& Value(T value)
+		{
+			const uint8_t* bytes = (const uint8_t*)&value;
+			m_code.insert(m_code.end(), bytes, bytes + sizeof(value));
+			return *this;
+		}
+
+		std::vector<uint8_t> m_code;
+	};
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "arena.h"
+#include "pe_image.h"
+
+namespace utils {
+
+	class ThreadPool;
+
+	// ķʽ
+	enum CfgBlockFlags : uint32_t
+	{
+		kCfgBlockReturn = 0x01,			// ret
+		kCfgBlockIndirect = 0x02,		// Ŀδ֪ļתjmp raxjmp [iat]
+		kCfgBlockJumpTable = 0x04,		// ʶתļתǱĿ
+		kCfgBlockInvalid = 0x08,		// ޷룬ܳ˿ִн
+		kCfgBlockCall = 0x10,			// call
+	};
+
+	struct CfgBlock
+	{
+		uint32_t rva;
+		uint32_t size;
+		uint32_t instructionCount;
+		uint32_t flags;					// CfgBlockFlags
+		const uint32_t* successors;		// ̿CfgFunction::blocks±
+		uint32_t successorCount;
+	};
+
+	struct CfgFunction
+	{
+		uint32_t entryRva;
+		uint32_t entryBlock;			// ڿ±
+		const CfgBlock* blocks;			// rva
+		uint32_t blockCount;
+		const uint32_t* calls;			// ֱcallĿrvaȥ
+		uint32_t callCount;
+		bool truncated;					// ָkCfgMaxInstructionsͼ
+
+		// rvaĿ飬ںڷnullptr
+		const CfgBlock* BlockContaining(uint32_t rva) const;
+	};
+
+	// ָ
+	const size_t kCfgMaxInstructions = 64 * 1024;
+	// תȡûҵcmp/jaϽʱԴΪ
+	const size_t kCfgMaxJumpTable = 2048;
+
+	// detoursĿͼݹ½jcc/jmp/callĿ꣬ʶת
+	// ͱ߶ArenaͶͬڣģǼصҲֱӳļimageҪȶþ
+	// x86/x64PEͷ͵ǰ̵λ޹
+	// βjmpڵıߴ֮صĿ
+	class ControlFlowGraph
+	{
+	public:
+		explicit ControlFlowGraph(const PeImage& image);
+		~ControlFlowGraph();
+
+		ControlFlowGraph(const ControlFlowGraph&) = delete;
+		ControlFlowGraph& operator = (const ControlFlowGraph&) = delete;
+
+		// entriesʼڶ߳ͬʱãfollowCallsΪtrueʱֱcallĿҲΪڼ빤
+		// poolΪʱзִֵ̳߳Уѹڲظĺ
+		size_t Build(const std::vector<uint32_t>& entries, bool followCalls = true, ThreadPool* pool = nullptr);
+
+		// rva
+		const std::vector<const CfgFunction*>& Functions() const;
+		const CfgFunction* FunctionAt(uint32_t entryRva) const;
+
+	private:
+		struct Worker;
+		struct Instruction;
+
+		const PeCodeRange* RangeOf(uint32_t rva) const;
+		bool Claim(uint32_t rva);
+		Worker* AcquireWorker();
+		void ReleaseWorker(Worker* worker);
+
+		void BuildOne(uint32_t entryRva, bool followCalls, ThreadPool* pool, std::vector<uint32_t>* pending);
+		const CfgFunction* BuildFunction(Worker& worker, uint32_t entryRva);
+		bool Decode(uint32_t rva, Instruction& insn) const;
+		void DecodeJumpTable(Worker& worker, size_t jumpIndex, const size_t* history, size_t historyCount);
+		const CfgFunction* Finish(Worker& worker, uint32_t entryRva, bool truncated);
+
+	private:
+		const PeImage& m_image;
+		std::vector<PeCodeRange> m_ranges;	// rva
+		bool m_64bit = false;
+
+		// ǷѾ죬ÿrvaһλ
+		std::unique_ptr<std::atomic<uint64_t>[]> m_claimed;
+		size_t m_claimedWords = 0;
+
+		std::mutex m_lock;
+		std::vector<std::unique_ptr<Worker>> m_workers;	// Arenaڸ
+		std::vector<Worker*> m_idle;
+		std::vector<const CfgFunction*> m_functions;
+	};
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+
+#ifdef _WIN32
+#include <deque>
+#include "system.h"
+#endif
+
+namespace utils {
+
+	// һһppPointerȥĿ꺯װϺ󻻳壬ժʱ
+	struct DetourJob
+	{
+		void** ppPointer;
+		void* detour;
+		bool success;
+	};
+
+	// һύֻ߳ö١һ
+	// ĳһʧܻϣʱֻΪʧܣʣµһ
+	void CommitDetourJobs(std::vector<DetourJob>& jobs, bool attach, bool hangAllThread);
+
+#ifdef _WIN32
+	// ѱ̵߳̽ǰֻhangǰ߳ʱҪcloseDefferύָ̻֮߳ٹ
+	bool DetourUpdateThreads(bool hangAllThread, std::deque<WinHandle>& closeDeffer);
+#endif
+}
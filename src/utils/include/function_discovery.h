@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "pe_image.h"
+
+namespace utils {
+
+	class ThreadPool;
+
+	// ɨʱÿĴС
+	const size_t kDiscoveryChunkSize = 64 * 1024;
+
+	// ʽЧ
+	struct FunctionDiscoveryStats
+	{
+		size_t instructions = 0;	// ɨָ
+		size_t callTargets = 0;		// ڿִнĲֱͬcallĿ
+		size_t boundaries = 0;		// ret/jmp/int3֮λ
+		size_t seeds = 0;			// ڵ͵
+		size_t functions = 0;
+	};
+
+	// û.pdataģ飨Ҫ32λĲϲºڣx64PeFunctionTableһrvaź
+	// ִнȰ鲢ɨ裬ռֱcallĿ꣬Լret/jmp֮int3nop֮λã
+	// ϲ¹϶ڣ
+	//   ڵ͵һǣ
+	//   int3֮λǣֻں֮int3
+	//   λҪcallڱ߽ϡƥ䳣ĺͷദcallҲ
+	// λȡһǰ俪ʼunwindRvaΪ0
+	// x64ģ.pdataʱӦֱPeFunctionTable(image)x64ͬãû.pdataGo
+	PeFunctionTable DiscoverFunctions(const PeImage& image, ThreadPool* pool = nullptr, FunctionDiscoveryStats* stats = nullptr);
+}
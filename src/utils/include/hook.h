@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 #include <Windows.h>
+#include "hook_filter.h"
 
 namespace utils {
 	// idIsTidʾע̡߳
@@ -10,8 +13,155 @@ namespace utils {
 	// ͨHook
 	bool HookFuncByName(HMODULE hModule, const std::string& funcName, void* newFuncAddr, void* oldFuncAddr = nullptr, bool handAllThreads = true);
 
-	// ͨģƥHookȽϸӣʵ
+	// ģĿִн룬дΪHookĺ
 	bool HookFuncByCode(HMODULE hModule, const byte* codeBuffer, size_t codeBufferLen, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads = true);
+	// ģƥ䣬pattern "48 8B ?? ?? 41 57"
+	bool HookFuncByCode(HMODULE hModule, const std::string& pattern, void* newFuncAddr, void* oldFuncAddr, bool handAllThreads = true);
+
+	// 뻺ļ֮HookʱȲ黺棬ģûͲɨ裻չرջ
+	void SetSignatureCacheFile(const std::wstring& cacheFile);
+
+	typedef struct _CodeHookInfo
+	{
+		std::string pattern;			// 룬ʽͬHookFuncByCode
+		void* newFuncAddr = nullptr;
+		void* oldFuncAddr = nullptr;	// ԭַΪ
+		bool success = false;			// ǷHookɹ
+
+	}CodeHookInfo, *PCodeHookInfo;
+
+	// Hookֻɨģһ飬ȫɹŷtrue
+	bool HookFuncsByCode(HMODULE hModule, std::vector<CodeHookInfo>& hooks, bool handAllThreads = true);
+
+	typedef struct _HookInfo
+	{
+		std::string funcName;			// ģĵﰴңΪʱfuncAddr
+		void* funcAddr = nullptr;
+		void* newFuncAddr = nullptr;
+		void* oldFuncAddr = nullptr;	// ԭַ壩ıַΪ
+		void* trampoline = nullptr;		// װָ壬жʱ
+		bool success = false;			// һǷѾHook
+
+		// ǿʱֻвȫĵòŽnewFuncAddrɵĴֱ壬hook_filter.h
+		std::vector<HookArgFilter> filters;
+		void* filterStub = nullptr;		// ڲãɵĹ˴룬װnewFuncAddr
+		FilterTarget* filterTarget = nullptr;
+
+	}HookInfo, *PHookInfo;
+
+	// Hookһﰲװֻ߳ö١һΣÿһ
+	// ÿĽдsuccessĳʧܲӰȫɹŷtrue
+	bool HookFuncs(HMODULE hModule, std::vector<HookInfo>& hooks, bool handAllThreads = true);
+	// жHookFuncsװϵֻͬһoldFuncAddrָıĻԭַ
+	bool UnHookFuncs(std::vector<HookInfo>& hooks, bool handAllThreads = true);
 
 	bool UnHookFunc(void* newFuncAddr, void* oldFuncAddr);
+
+	// hCallerĴҵtargetFunccall rel32call [IAT]ԼβõjmpЩָĵַ
+	std::vector<void*> FindCallSites(HMODULE hCaller, void* targetFunc);
+
+	// ֻдĵõ㣬ǵnewFuncAddrĿ꺯ûѡеĵ÷ԭֱӵ
+	// еõһдһʧܾͶģoldFuncAddrЩõԭõĺ
+	bool HookCallSites(const std::vector<void*>& sites, void* newFuncAddr, void* oldFuncAddr = nullptr, bool handAllThreads = true);
+	bool UnHookCallSites(const std::vector<void*>& sites, void* newFuncAddr);
+
+	// Hook<>õĵײӿڣ*ppPointerȥĿ꺯װϺ󻻳壬жʱ
+	bool DetourAttachFunc(void** ppPointer, void* pDetour, bool hangAllThread);
+	bool DetourDetachFunc(void** ppPointer, void* pDetour);
+
+	// д滻targetװһʱstubһrdtscʱǵhook_statsΪnameһ
+	// ÿεһ¼д̵߳Ļλ壬DrainHookTimingEventsȡƼhook_timing.h
+	bool AttachTimingHook(void* target, const std::string& name, bool handAllThreads = true);
+	// ңͳfuncName
+	bool AttachTimingHook(HMODULE hModule, const std::string& funcName, bool handAllThreads = true);
+	bool DetachTimingHook(void* target);
+
+	// ͵HookFuncǺͣ Hook<decltype(UpdateLayeredWindow)>
+	// Ŀ滻ڱڼ飬ָ룬ʱԶж
+	// operator()ԭǶm_originalһμӵãԼ溯ָһ
+	template <typename Func>
+	class Hook
+	{
+	public:
+		typedef Func* FuncPtr;
+
+		Hook() = default;
+		~Hook() { Detach(); }
+
+		Hook(const Hook&) = delete;
+		Hook& operator=(const Hook&) = delete;
+
+		Hook(Hook&& other)
+			: m_original(other.m_original)
+			, m_detour(other.m_detour)
+		{
+			other.m_original = nullptr;
+			other.m_detour = nullptr;
+		}
+
+		Hook& operator=(Hook&& other)
+		{
+			if (this != &other)
+			{
+				Detach();
+				std::swap(m_original, other.m_original);
+				std::swap(m_detour, other.m_detour);
+			}
+			return *this;
+		}
+
+		bool Attach(FuncPtr target, FuncPtr detour, bool handAllThreads = true)
+		{
+			if (Attached() || !target || !detour) return false;
+
+			m_original = target;
+			if (!DetourAttachFunc((void**)&m_original, (void*)detour, handAllThreads))
+			{
+				m_original = nullptr;
+				return false;
+			}
+			m_detour = detour;
+			return true;
+		}
+
+		bool Attach(HMODULE hModule, const std::string& funcName, FuncPtr detour, bool handAllThreads = true)
+		{
+			if (!hModule || funcName.empty()) return false;
+			return Attach((FuncPtr)GetProcAddress(hModule, funcName.c_str()), detour, handAllThreads);
+		}
+
+		bool Detach()
+		{
+			if (!Attached()) return true;
+			if (!DetourDetachFunc((void**)&m_original, (void*)m_detour)) return false;
+
+			m_original = nullptr;
+			m_detour = nullptr;
+			return true;
+		}
+
+		bool Attached() const { return m_detour != nullptr; }
+
+		// ԭ壬ûװʱΪnullptr
+		FuncPtr Original() const { return m_original; }
+
+		template <typename... Args>
+		auto operator()(Args&&... args) const -> decltype(std::declval<FuncPtr>()(std::forward<Args>(args)...))
+		{
+			return m_original(std::forward<Args>(args)...);
+		}
+
+	private:
+		FuncPtr m_original = nullptr;
+		FuncPtr m_detour = nullptr;
+	};
+
+	// ɲƵͣauto hook = MakeHook(UpdateLayeredWindow, HookUpdateLayeredWindow);
+	template <typename Func>
+	Hook<Func> MakeHook(Func* target, Func* detour, bool handAllThreads = true)
+	{
+		Hook<Func> hook;
+		hook.Attach(target, detour, handAllThreads);
+		return hook;
+	}
 }
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace utils {
+
+	// ˣɵĴȽϲĵֱԭC++滻
+	// indexλx64 Windowsǰ4rcx/rdx/r8/r9SysVǰ6ڼĴջϣ
+	// x86ֻջϵĲfastcall/thiscallecx/edxĲ㡣ֻȽָ룬sizeΪ4ʱֻ32λ
+	enum HookArgMatch : uint8_t
+	{
+		kArgIn,			// valuesеĳһ
+		kArgNotIn,		// valuesеκһ
+	};
+
+	struct HookArgFilter
+	{
+		uint32_t index = 0;
+		HookArgMatch match = kArgIn;
+		uint8_t size = sizeof(void*);		// 48x86ֻ4
+		std::vector<uint64_t> values;
+	};
+
+	inline HookArgFilter ArgIn(uint32_t index, std::initializer_list<uint64_t> values, uint8_t size = sizeof(void*))
+	{
+		HookArgFilter filter;
+		filter.index = index;
+		filter.size = size;
+		filter.values = values;
+		return filter;
+	}
+
+	inline HookArgFilter ArgEquals(uint32_t index, uint64_t value, uint8_t size = sizeof(void*))
+	{
+		return ArgIn(index, { value }, size);
+	}
+
+	inline HookArgFilter ArgNotIn(uint32_t index, std::initializer_list<uint64_t> values, uint8_t size = sizeof(void*))
+	{
+		HookArgFilter filter = ArgIn(index, values, size);
+		filter.match = kArgNotIn;
+		return filter;
+	}
+
+	// ˴ڣǼתҹoriginalĳ
+	typedef struct _FilterTarget
+	{
+		void* original = nullptr;
+		void* detour = nullptr;
+
+	}FilterTarget, *PFilterTarget;
+
+	// йʱtarget->detourtarget->originalλ޹أԿκεط
+	// ϷsizeԡvaluesΪգʱfalse
+	bool BuildFilterStub(const std::vector<HookArgFilter>& filters, FilterTarget* target, std::vector<uint8_t>& code);
+
+	// ڿִڴɹ˴룬ֵҹõ滻targetҪһֱЧ
+	void* CreateFilterThunk(const std::vector<HookArgFilter>& filters, FilterTarget* target);
+	void DestroyFilterThunk(void* thunk);
+
+	// װĹ˴ժܻ߳ܣͷţͬtargetһ£
+	// ͬһͬһ滻ͬٹҹʱReviveFilterThunkȡҲnullptr
+	void RetireFilterThunk(void* thunk, const std::vector<HookArgFilter>& filters, FilterTarget* target);
+	void* ReviveFilterThunk(const std::vector<HookArgFilter>& filters, void* original, void* detour, FilterTarget** target);
+}
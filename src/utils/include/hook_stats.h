@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace utils {
+
+	// HookĵôͺʱͳƣĬϹرգEnableHookStats(true)ż¼
+	// ÿ̸߳ÿhookһжĲֻۣб߳дҲûԭӼӣʱϲ߳
+	// ʱrdtscƣֱͼֶΣÿԷkHookStatSubBucketsݣԼ12%
+	typedef uint32_t HookStatId;
+
+	const HookStatId kInvalidHookStat = (HookStatId)-1;
+	const size_t kMaxHookStats = 64;
+	const uint32_t kHookStatSubBits = 3;
+	const uint32_t kHookStatSubBuckets = 1u << kHookStatSubBits;
+	const uint32_t kHookStatMaxExponent = 40;	// 2^40tick϶һ
+	const size_t kHookStatBuckets = ((kHookStatMaxExponent - kHookStatSubBits + 1) << kHookStatSubBits) + kHookStatSubBuckets;
+
+	// עᣬͬͬһidkMaxHookStatskInvalidHookStat֮ļ¼ᱻ
+	HookStatId RegisterHookStat(const std::string& name);
+	void EnableHookStats(bool enable);
+	bool HookStatsEnabled();
+
+	// һεãticksΪrdtscĲֵ
+	void RecordHookCall(HookStatId id, uint64_t ticks);
+
+	struct HookStatSnapshot
+	{
+		std::string name;
+		uint64_t calls = 0;
+		double totalNs = 0;
+		double maxNs = 0;
+		double nsPerTick = 0;
+		std::vector<uint64_t> buckets;	// ̺߳ϲֱͼ±HookStatBucketTicks
+
+		double MeanNs() const;
+		// pȡ0~1ظ÷λڸӵ½
+		double PercentileNs(double p) const;
+	};
+
+	// index½磬λtick
+	uint64_t HookStatBucketTicks(size_t index);
+
+	// ϲ̵߳ĲۣresetΪtrueʱ㣻д̲߳ʱǽֵ
+	std::vector<HookStatSnapshot> SnapshotHookStats(bool reset = false);
+	void ResetHookStats();
+
+	namespace detail {
+		extern std::atomic<bool> g_hookStatsEnabled;
+	}
+
+	inline uint64_t HookStatTicks()
+	{
+		return __rdtsc();
+	}
+
+	// hookĺʱرͳʱֻһζһ֧
+	class HookStatScope
+	{
+	public:
+		explicit HookStatScope(HookStatId id)
+			: m_id(id)
+			, m_start(detail::g_hookStatsEnabled.load(std::memory_order_relaxed) ? HookStatTicks() : 0)
+		{
+		}
+
+		~HookStatScope()
+		{
+			if (m_start) RecordHookCall(m_id, HookStatTicks() - m_start);
+		}
+
+		HookStatScope(const HookStatScope&) = delete;
+		HookStatScope& operator=(const HookStatScope&) = delete;
+
+	private:
+		HookStatId m_id;
+		uint64_t m_start;
+	};
+}
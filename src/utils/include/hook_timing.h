@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "hook_stats.h"
+
+namespace utils {
+
+	// д滻ܸ⺯ʱʱһСstubʱrdtscѷصַɹĳڴԭ
+	// صʱټһrdtsc¼д̵߳Ļλ壬ʱͬʱǵhook_stats
+	// Ĵջԭԭx86cdecl/stdcall/fastcall/thiscallx64WindowsSysVԼ
+	// ʱĺβתһʱĺʱ㹲һصַͬһʱ̽һ¼
+	// ƣʱĺķصַǳڴ룻쳣longjmpʱһ㲻¼
+	// x64 WindowsĳڴûunwindϢ쳣ܴʱĺymm߰벿֣x86xmmvectorcall
+	typedef struct _TimingTarget
+	{
+		void* original = nullptr;		// stubȥĵַҹ
+		HookStatId id = kInvalidHookStat;
+
+	}TimingTarget, *PTimingTarget;
+
+	struct HookTimingEvent
+	{
+		HookStatId id;
+		uint32_t thread;		// ϵͳ߳id
+		uint32_t depth;			// ͬһ߳㻹мʱĵ
+		uint64_t enterTicks;
+		uint64_t exitTicks;
+	};
+
+#if defined(_M_X64) || defined(__x86_64__)
+	const size_t kTimingStubSize = 24;
+#else
+	const size_t kTimingStubSize = 10;
+#endif
+	const size_t kTimingMaxDepth = 128;		// Ƕֱ͸ʱ
+	const size_t kTimingRingSize = 1024;	// ÿ߳໺ôδȡߵ¼˶µ
+
+	// codeдһkTimingStubSizeֽڵstubǴʱصtarget->originalcodeҪдtargetҪһֱЧ
+	bool WriteTimingStub(void* code, TimingTarget* target);
+
+	// ҹԼĿִҳstubֵԵoriginal
+	void* CreateTimingThunk(TimingTarget* target);
+	void DestroyTimingThunk(void* thunk);
+
+	// ȡ̻߳¼׷ӵeventsȡĸ
+	size_t DrainHookTimingEvents(std::vector<HookTimingEvent>& events);
+	// ΪǶ̫ûµĵ
+	uint64_t DroppedHookTimingEvents();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+	// Hookдģ鵼ĺָۣPEIATELFGOTÿһζԭд̡߳Ĵ
+	// ֻӰ쾭Щ۵ĵãģڲֱӵúGetProcAddress/dlsymõָ벻Ӱ
+	// moduleWindowsHMODULELinuxdlopenصľΪnullptrʱѼصģ
+	// importModuleļȽϣִСдΪʱޣELFضλ¼ĸ⣬LinuxϺ
+	class ImportHook
+	{
+	public:
+		ImportHook() = default;
+		~ImportHook() { Detach(); }
+
+		ImportHook(const ImportHook&) = delete;
+		ImportHook& operator=(const ImportHook&) = delete;
+
+		// ظ˼ۣ0ʾûҵѾװ
+		size_t Attach(void* module, const std::string& importModule, const std::string& funcName, void* newFunc);
+		// ѻָnewFuncĲ۸Ļԭֱֵ֮˸ĹĲ۲ظĻ˼
+		size_t Detach();
+
+		bool Attached() const { return !m_slots.empty(); }
+		// һԭָĺӳٰ󶨻ûʱǽĺ滻ԭDetachԱ滻ĵ
+		void* Original() const { return m_original; }
+
+	private:
+		struct Slot
+		{
+			void** slot;
+			void* original;		// ֵDetachʱд
+			bool readOnly;		// ƽʱֻģд֮ǰҪʱı
+		};
+
+		std::vector<Slot> m_slots;
+		void* m_newFunc = nullptr;
+		void* m_original = nullptr;
+	};
+}
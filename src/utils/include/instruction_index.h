@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "pe_image.h"
+
+namespace utils {
+
+	class ThreadPool;
+
+	// êСʱêǰôֽټһָ
+	const uint32_t kAnchorInterval = 64;
+	const uint32_t kAnchorPageShift = 12;
+
+	// ָ֪ʼλõش𡰵ַXָ
+	// x86ؽ룬Դÿ˳룬ÿkAnchorIntervalֽڼһָΪê㣬
+	// ʱӲַêǰ룬ʱϽ
+	// ê㰴4KBҳ飬ҳһêĲֵ1~2ֽڵı䳤룬ԼǴС2%
+	// imagefunctionsҪþã.pdataҲDiscoverFunctions
+	class InstructionIndex
+	{
+	public:
+		InstructionIndex(const PeImage& image, const PeFunctionTable& functions, ThreadPool* pool = nullptr);
+
+		// rvaָʼrvaͳȣrvaκκڻ߽ʧܷfalse
+		bool InstructionAt(uint32_t rva, uint32_t& startRva, uint32_t& length) const;
+
+		size_t AnchorCount() const;
+		// ҳͲֵռõֽ
+		size_t BytesUsed() const;
+
+	private:
+		struct Page
+		{
+			uint32_t offset;			// ҳһêm_deltasλ
+			uint16_t count;
+			uint16_t reserved;
+		};
+
+		void Build(ThreadPool* pool);
+		void Encode(const std::vector<uint32_t>& anchors);
+		// rvaê㣬ûзfalse
+		bool NearestAnchor(uint32_t rva, uint32_t& anchor) const;
+		bool LastAnchorOfPage(size_t page, uint32_t& anchor) const;
+		bool Decode(const PeCodeRange* range, uint32_t rva, uint32_t& length) const;
+
+	private:
+		const PeImage& m_image;
+		const PeFunctionTable& m_functions;
+		std::vector<PeCodeRange> m_ranges;	// rva
+		bool m_64bit = false;
+
+		uint32_t m_firstPage = 0;
+		std::vector<Page> m_pages;
+		std::vector<uint8_t> m_deltas;
+		size_t m_anchorCount = 0;
+	};
+}
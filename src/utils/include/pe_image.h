@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+	// ϢֶIMAGE_SECTION_HEADERһ
+	struct PeSection
+	{
+		std::string name;
+		uint32_t rva = 0;
+		uint32_t virtualSize = 0;
+		uint32_t rawOffset = 0;
+		uint32_t rawSize = 0;
+		uint32_t characteristics = 0;
+
+		bool Executable() const;
+	};
+
+	// һοֱӶȡĴ
+	struct PeCodeRange
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		uint32_t rva = 0;
+	};
+
+	// һŵʱnameΪ
+	struct PeImport
+	{
+		std::string module;
+		std::string name;
+		uint16_t ordinal = 0;			// ֵʱHint
+		uint32_t slotRva = 0;			// IATӦĲۣcall [slot]/jmp [slot]õľ
+	};
+
+	// ֻPEͼwindows.h
+	// mappedΪtrueʾѰڶأHMODULEfalseʾļԭʼֱ֣ӳdllļ
+	class PeImage
+	{
+	public:
+		PeImage(const void* base, size_t size, bool mapped = true);
+
+		bool Invalid() const;
+		bool Mapped() const;
+		bool Is64Bit() const;
+
+		const uint8_t* Base() const;
+		size_t Size() const;
+
+		uint16_t Machine() const;
+		uint32_t TimeDateStamp() const;
+		uint32_t SizeOfImage() const;
+		uint32_t EntryPointRva() const;
+		uint64_t ImageBase() const;
+
+		const std::vector<PeSection>& Sections() const;
+		// ԭʼڱжģǷȫһ
+		const uint8_t* SectionHeaders() const;
+		size_t SectionHeadersSize() const;
+
+		// Խ緵nullptr
+		const uint8_t* RvaToPtr(uint32_t rva, size_t len = 1) const;
+		bool DataDirectory(uint32_t index, uint32_t& rva, uint32_t& size) const;
+
+		// пִнڴе
+		std::vector<PeCodeRange> ExecutableRanges() const;
+
+		// ȡOriginalFirstThunkIATѾɵַҲܽ
+		std::vector<PeImport> Imports() const;
+		// moduleִСдҲfalse
+		bool FindImportSlot(const std::string& module, const std::string& name, uint32_t& slotRva) const;
+
+	private:
+		bool Parse();
+		bool ReadString(uint32_t rva, std::string& value) const;
+
+	private:
+		const uint8_t* m_base = nullptr;
+		size_t m_size = 0;
+		bool m_mapped = true;
+		bool m_valid = false;
+		bool m_64bit = false;
+
+		uint16_t m_machine = 0;
+		uint32_t m_timeDateStamp = 0;
+		uint32_t m_sizeOfImage = 0;
+		uint32_t m_sizeOfHeaders = 0;
+		uint32_t m_entryPoint = 0;
+		uint64_t m_imageBase = 0;
+		uint32_t m_dataDirOffset = 0;
+		uint32_t m_dataDirCount = 0;
+		uint32_t m_sectionHeaderOffset = 0;
+		std::vector<PeSection> m_sections;
+	};
+
+	// .pdataһRUNTIME_FUNCTIONrvaҿ
+	struct PeFunction
+	{
+		uint32_t beginRva;
+		uint32_t endRva;
+		uint32_t unwindRva;
+		uint32_t primary;				// UNW_FLAG_CHAININFOҵڱ±꣬ϵԼ
+	};
+
+	// x64쳣Ŀ¼ĺbeginRvaFunctionContainingǶֲ
+	// ֻPEݣصģֱӳļãRtlLookupFunctionEntry
+	// x86û.pdataARM64ĸʽͬΪգx86DiscoverFunctionsõͬı
+	class PeFunctionTable
+	{
+	public:
+		PeFunctionTable() = default;
+		explicit PeFunctionTable(const PeImage& image);
+		// ʽõĺ䣨DiscoverFunctionsÿΪ
+		explicit PeFunctionTable(std::vector<PeFunction> functions);
+
+		bool Empty() const;
+		size_t Count() const;
+		const std::vector<PeFunction>& Functions() const;
+
+		// rvaһǺȥһΣchainedκκڷnullptr
+		const PeFunction* FunctionContaining(uint32_t rva) const;
+		// rvaȲֵƬλ鵽ԭ
+		const PeFunction* PrimaryContaining(uint32_t rva) const;
+
+		// ڣ򣬿ֱΪControlFlowGraph::Build
+		std::vector<uint32_t> Entries() const;
+
+	private:
+		void Load(const PeImage& image);
+		uint32_t ResolvePrimary(const PeImage& image, uint32_t index) const;
+		const PeFunction* Find(uint32_t rva) const;
+
+	private:
+		std::vector<PeFunction> m_functions;
+	};
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+	class PeImage;
+	class ThreadPool;
+
+	const size_t kSignatureNotFound = (size_t)-1;
+	// ɨʱÿĴС
+	const size_t kSignatureChunkSize = 1024 * 1024;
+
+	// 룬 "48 8B ?? ?? 41 57""?""??"ʾһֽ
+	class Signature
+	{
+	public:
+		Signature() = default;
+		explicit Signature(const std::string& pattern);
+		// maskΪձʾȫȷƥ䣬mask[i]Ϊ0ֽͨ
+		Signature(const uint8_t* code, size_t codeLen, const uint8_t* mask = nullptr);
+
+		// ʽȫͨ䶼ΪЧ
+		bool Invalid() const;
+		size_t Length() const;
+
+		const std::vector<uint8_t>& Bytes() const;
+		const std::vector<uint8_t>& Mask() const;
+
+		// SIMDԤɸѡȷֽڣڻгֵƵټ
+		size_t Anchor() const;
+		size_t SecondAnchor() const;
+		// ټȷֽڣƥʱϣûΪkSignatureNotFound
+		size_t PairAnchor() const;
+
+		bool MatchAt(const uint8_t* data) const;
+
+	private:
+		void Compile();
+
+	private:
+		std::vector<uint8_t> m_bytes;
+		std::vector<uint8_t> m_mask;
+		size_t m_anchor = 0;
+		size_t m_secondAnchor = 0;
+		size_t m_pairAnchor = kSignatureNotFound;
+		bool m_valid = false;
+	};
+
+	// һڴвң׸еƫƣû򷵻kSignatureNotFound
+	size_t FindSignature(const uint8_t* data, size_t dataLen, const Signature& sig);
+	// еƫƣ
+	std::vector<size_t> FindSignatureAll(const uint8_t* data, size_t dataLen, const Signature& sig);
+
+	// ֻɨPEеĿִнڣ׸еĵַ
+	const uint8_t* FindSignature(const PeImage& image, const Signature& sig);
+
+	// 뵽һֻһڴҵȫ
+	// êȡڵȷֽڣSIMDֽڲɸٲ64KλͼУͰڵ
+	class SignatureSet
+	{
+	public:
+		SignatureSet() = default;
+		// ż±꣬ЧռλԶ
+		explicit SignatureSet(const std::vector<Signature>& signatures);
+
+		size_t Size() const;
+		size_t MaxLength() const;
+		const Signature& At(size_t index) const;
+
+		// ÿ׸ƫƣУδΪkSignatureNotFound
+		std::vector<size_t> Find(const uint8_t* data, size_t dataLen) const;
+		// ÿڿִне׸еַ
+		std::vector<const uint8_t*> Find(const PeImage& image) const;
+		// ִнг໥صMaxLength() - 1ֽڵĿ飬ŵ̳߳ɨ裬͵߳һ
+		std::vector<const uint8_t*> Find(const PeImage& image, ThreadPool& pool, size_t chunkSize = kSignatureChunkSize) const;
+
+	private:
+		struct Entry
+		{
+			uint32_t index;
+			uint32_t anchor;
+		};
+
+		void Compile();
+
+	private:
+		std::vector<Signature> m_signatures;
+		size_t m_maxLength = 0;
+
+		// ֽê㣺64Kλͼ + Ͱе
+		std::vector<uint64_t> m_pairBitmap;
+		std::vector<uint32_t> m_pairBuckets;
+		std::vector<Entry> m_pairEntries;
+		// SIMDԤɸѡõİֽڱֽڵ/ߡֽڵ/
+		uint8_t m_nibbleMasks[4][16] = {};
+		// ûȷֽڵ˻ɵֽê
+		std::vector<uint32_t> m_byteBuckets;
+		std::vector<Entry> m_byteEntries;
+	};
+}
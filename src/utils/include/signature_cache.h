@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+	class PeImage;
+	class Signature;
+	class SignatureSet;
+
+	// ģʶһ²Ϊͬһģ飬ƫƲֱ
+	typedef struct _ModuleIdentity
+	{
+		uint64_t nameHash = 0;			// Сдģ
+		uint32_t timeDateStamp = 0;
+		uint32_t sizeOfImage = 0;
+		uint64_t sectionHash = 0;		// ڱ
+
+	}ModuleIdentity, *PModuleIdentity;
+
+	ModuleIdentity GetModuleIdentity(const std::string& moduleName, const PeImage& image);
+
+	// ǵġģû롱ģʶͲɨ
+	const uint32_t kSignatureCacheMiss = 0xFFFFFFFF;
+
+	// ƫƣRVAĴ̻棬ļֱӳڴ棬(ģ, )ֲ
+	// ģʶԲϣƫƴĴѾƥ䲻룬Ϊ
+	// ԱԼԶ̹߳
+	class SignatureCache
+	{
+	public:
+		SignatureCache() = default;
+		~SignatureCache();
+
+		SignatureCache(const SignatureCache&) = delete;
+		SignatureCache& operator = (const SignatureCache&) = delete;
+
+		// ļڻʽʱջ棬Flushʱ
+		bool Open(const std::string& path);
+#ifdef _WIN32
+		bool Open(const std::wstring& path);
+#endif
+		void Close();
+
+		// ʱrvakSignatureCacheMissʾϴɨģ飬ûҵ
+		bool Lookup(const ModuleIdentity& module, const Signature& sig, uint32_t& rva) const;
+		void Update(const ModuleIdentity& module, const Signature& sig, uint32_t rva);
+
+		// ޸ʱдأдʱļ滻Ȼӳ
+		bool Flush();
+
+	public:
+#pragma pack(push, 1)
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t count;
+			uint32_t reserved;
+		};
+
+		struct Entry
+		{
+			uint64_t nameHash;
+			uint64_t signatureHash;
+			uint64_t sectionHash;
+			uint32_t timeDateStamp;
+			uint32_t sizeOfImage;
+			uint32_t rva;
+			uint32_t reserved;
+		};
+#pragma pack(pop)
+
+	private:
+		bool Map();
+		void Unmap();
+		const Entry* FindMapped(uint64_t nameHash, uint64_t signatureHash) const;
+
+	private:
+		mutable std::mutex m_lock;
+#ifdef _WIN32
+		std::wstring m_path;
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		std::string m_path;
+		int m_file = -1;
+#endif
+		const uint8_t* m_view = nullptr;
+		size_t m_viewSize = 0;
+		const Entry* m_entries = nullptr;
+		size_t m_count = 0;
+
+		// ûдļ޸
+		std::map<std::pair<uint64_t, uint64_t>, Entry> m_pending;
+	};
+
+	// ȱʧʱɨģ飬Ϊʱ߳ɨ
+	typedef std::function<std::vector<const uint8_t*>(const SignatureSet& signatures)> SignatureScanner;
+
+	// Ȳ黺棬ȱʧڵɨģ鲢дػ棬ҲҲ£ͬSignatureSet::Find
+	// ֻڲ黺дʱcacheɨʱ
+	std::vector<const uint8_t*> FindSignaturesCached(SignatureCache& cache, const std::string& moduleName, const PeImage& image,
+		const SignatureSet& signatures, const SignatureScanner& scanner = nullptr);
+}
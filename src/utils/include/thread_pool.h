@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+	// ȡ̳߳أÿ߳ԼĶУԼӶβȡʱӱĶͷ͵
+	// ԼSubmitŽǰ̵߳Ķ
+	class ThreadPool
+	{
+	public:
+		// threadCountΪ0ʱȡCPU
+		explicit ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator = (const ThreadPool&) = delete;
+
+		size_t ThreadCount() const;
+
+		void Submit(std::function<void()> task);
+		// ȴ񣨰Ͷݵģɣȴ߳Ҳæִ
+		void Wait();
+
+		// [0, count)ִtaskʱȫ
+		void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+	private:
+		struct Worker
+		{
+			std::mutex lock;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void WorkLoop(size_t index);
+		bool RunOne(size_t index);
+		bool Pop(size_t index, std::function<void()>& task);
+		bool Steal(size_t index, std::function<void()>& task);
+
+	private:
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::vector<std::thread> m_threads;
+
+		std::mutex m_lock;
+		std::condition_variable m_wake;
+		std::condition_variable m_idle;
+		std::atomic<size_t> m_pending;
+		std::atomic<size_t> m_next;
+		size_t m_queued = 0;	// ﻹûȡߵm_lock
+		bool m_stop = false;
+	};
+}
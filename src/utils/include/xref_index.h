@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "pe_image.h"
+
+namespace utils {
+
+	class ThreadPool;
+
+	// õ࣬λ壬ѯʱϳ
+	enum XrefKind : uint8_t
+	{
+		kXrefCall = 0x01,			// call rel32
+		kXrefJump = 0x02,			// jmp rel8/rel32βҲ
+		kXrefCallSlot = 0x04,		// call [mem]Ŀǲ۵λãIAT
+		kXrefJumpSlot = 0x08,		// jmp [mem]뺯ת׮
+		kXrefData = 0x10,			// RIP(x64)[disp32](x86)ڴ
+		kXrefAll = 0x1F,
+	};
+
+	// ָͬһĿãԴrva
+	struct XrefRange
+	{
+		const uint32_t* sources = nullptr;	// ָʼrva
+		const uint8_t* kinds = nullptr;
+		size_t count = 0;
+	};
+
+	// ģڵĽش˭callX˭дȫֱX˭IATۡ
+	// ִнڰ鲢ɨ裬¼ֱcall/jmpĿڴĵַתǣںڲ
+	// ϲ(Ŀ, Դ)ɼƽ飬ѯǶĿ֣ڴ
+	// ɨǶڴݣתҲָ룬дõ֮ǰҪУȷʵǶӦָ
+	// imageҪþ
+	class XrefIndex
+	{
+	public:
+		XrefIndex(const PeImage& image, ThreadPool* pool = nullptr);
+
+		// targetRvaãûʱcountΪ0
+		XrefRange RefsTo(uint32_t targetRva) const;
+		// ֻȡkinds࣬kXrefCall | kXrefJumpõֱӵ
+		std::vector<uint32_t> RefsTo(uint32_t targetRva, uint8_t kinds) const;
+		// 뺯еõ㣨call/jmp [slot]ԼѲ۵ַָ
+		std::vector<uint32_t> RefsToImport(const std::string& module, const std::string& name, uint8_t kinds = kXrefAll) const;
+
+		size_t Count() const;
+		size_t TargetCount() const;
+		size_t BytesUsed() const;
+
+	private:
+		struct Xref
+		{
+			uint32_t target;
+			uint32_t source;
+			uint8_t kind;
+		};
+
+		void Build(ThreadPool* pool);
+		void Sweep(const PeCodeRange& range, size_t begin, size_t end, std::vector<Xref>& refs) const;
+
+	private:
+		const PeImage& m_image;
+		bool m_64bit = false;
+
+		// m_targetsȥ򣬵iĿm_sources/m_kinds[m_offsets[i], m_offsets[i + 1])
+		std::vector<uint32_t> m_targets;
+		std::vector<uint32_t> m_offsets;
+		std::vector<uint32_t> m_sources;
+		std::vector<uint8_t> m_kinds;
+	};
+}
@@ -0,0 +1,251 @@
+#include "include/instruction_index.h"
+#include "include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "detour/detours.h"
+
+namespace utils {
+
+	namespace {
+		// ֻҪָȣκڴ
+		const DETOUR_DISASM_CONTEXT kNoReferences = { nullptr, nullptr, TRUE };
+		// йʱÿĺ
+		const size_t kFunctionsPerTask = 256;
+		const uint32_t kPageSize = 1u << kAnchorPageShift;
+
+		const PeCodeRange* RangeOf(const std::vector<PeCodeRange>& ranges, uint32_t rva)
+		{
+			auto it = std::upper_bound(ranges.begin(), ranges.end(), rva, [](uint32_t value, const PeCodeRange& range) { return value < range.rva; });
+			if (it == ranges.begin()) return nullptr;
+			--it;
+			return (rva - it->rva < it->size) ? &*it : nullptr;
+		}
+
+		// ҳڲֵС4096ֽ
+		inline void PutDelta(std::vector<uint8_t>& out, uint32_t delta)
+		{
+			if (delta < 0x80)
+			{
+				out.push_back((uint8_t)delta);
+			}
+			else
+			{
+				out.push_back((uint8_t)(0x80 | (delta & 0x7F)));
+				out.push_back((uint8_t)(delta >> 7));
+			}
+		}
+
+		inline uint32_t GetDelta(const uint8_t*& p)
+		{
+			uint32_t delta = *p++;
+			if (delta & 0x80) delta = (delta & 0x7F) | ((uint32_t)*p++ << 7);
+			return delta;
+		}
+	}
+
+	InstructionIndex::InstructionIndex(const PeImage& image, const PeFunctionTable& functions, ThreadPool* pool/* = nullptr*/)
+		: m_image(image)
+		, m_functions(functions)
+	{
+		if (m_image.Invalid()) return;
+
+		m_64bit = m_image.Is64Bit();
+		m_ranges = m_image.ExecutableRanges();
+		std::sort(m_ranges.begin(), m_ranges.end(), [](const PeCodeRange& a, const PeCodeRange& b) { return a.rva < b.rva; });
+		Build(pool);
+	}
+
+	bool InstructionIndex::Decode(const PeCodeRange* range, uint32_t rva, uint32_t& length) const
+	{
+		length = 1;
+		if (!range || rva - range->rva >= range->size) return false;
+
+		PBYTE code = (PBYTE)range->data + (rva - range->rva);
+		size_t available = range->size - (rva - range->rva);
+
+		// βһָʱ룬öӳ䷶Χ
+		uint8_t buffer[32] = { 0 };
+		if (available < 16)
+		{
+			memcpy(buffer, code, available);
+			code = buffer;
+		}
+
+		DETOUR_DECODED_INSTRUCTION decoded;
+		PBYTE next = m_64bit ?
+			(PBYTE)DetourDecodeInstructionExX64(code, &decoded, &kNoReferences) :
+			(PBYTE)DetourDecodeInstructionExX86(code, &decoded, &kNoReferences);
+		if (!next || decoded.cbInstruction == 0 || decoded.cbInstruction > available ||
+			(decoded.wFlags & DETOUR_DECODED_INVALID))
+		{
+			return false;
+		}
+
+		length = decoded.cbInstruction;
+		return true;
+	}
+
+	void InstructionIndex::Build(ThreadPool* pool)
+	{
+		const std::vector<PeFunction>& functions = m_functions.Functions();
+		size_t taskCount = (functions.size() + kFunctionsPerTask - 1) / kFunctionsPerTask;
+		std::vector<std::vector<uint32_t>> results(taskCount);
+
+		// ͲҰͬĹǰʧֽܵڵ1ָ
+		auto task = [&](size_t index)
+		{
+			std::vector<uint32_t>& anchors = results[index];
+			size_t last = (std::min)(functions.size(), (index + 1) * kFunctionsPerTask);
+			for (size_t i = index * kFunctionsPerTask; i < last; ++i)
+			{
+				uint32_t rva = functions[i].beginRva;
+				uint32_t nextAnchor = rva;
+				const PeCodeRange* range = RangeOf(m_ranges, rva);
+				while (rva < functions[i].endRva)
+				{
+					if (rva >= nextAnchor)
+					{
+						anchors.push_back(rva);
+						nextAnchor = rva + kAnchorInterval;
+					}
+
+					uint32_t length = 1;
+					Decode(range, rva, length);
+					rva += length;
+				}
+			}
+		};
+
+		if (pool && taskCount > 1)
+		{
+			pool->ParallelFor(taskCount, task);
+		}
+		else
+		{
+			for (size_t i = 0; i < taskCount; ++i) task(i);
+		}
+
+		std::vector<uint32_t> anchors;
+		size_t total = 0;
+		for (auto& result : results) total += result.size();
+		anchors.reserve(total);
+		for (auto& result : results)
+		{
+			anchors.insert(anchors.end(), result.begin(), result.end());
+			std::vector<uint32_t>().swap(result);
+		}
+
+		// صֻǷֹⲿı
+		if (!std::is_sorted(anchors.begin(), anchors.end()))
+		{
+			std::sort(anchors.begin(), anchors.end());
+			anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+		}
+
+		Encode(anchors);
+	}
+
+	void InstructionIndex::Encode(const std::vector<uint32_t>& anchors)
+	{
+		m_anchorCount = anchors.size();
+		if (anchors.empty()) return;
+
+		m_firstPage = anchors.front() >> kAnchorPageShift;
+		uint32_t lastPage = anchors.back() >> kAnchorPageShift;
+		m_pages.assign(lastPage - m_firstPage + 1, Page());
+		m_deltas.reserve(anchors.size() + anchors.size() / 4);
+
+		uint32_t previous = 0;
+		for (uint32_t anchor : anchors)
+		{
+			Page& page = m_pages[(anchor >> kAnchorPageShift) - m_firstPage];
+			if (page.count == 0)
+			{
+				page.offset = (uint32_t)m_deltas.size();
+				previous = anchor & ~(kPageSize - 1);
+			}
+			PutDelta(m_deltas, anchor - previous);
+			previous = anchor;
+			++page.count;
+		}
+	}
+
+	bool InstructionIndex::LastAnchorOfPage(size_t page, uint32_t& anchor) const
+	{
+		const Page& entry = m_pages[page];
+		if (entry.count == 0) return false;
+
+		const uint8_t* p = m_deltas.data() + entry.offset;
+		anchor = (uint32_t)(m_firstPage + page) << kAnchorPageShift;
+		for (uint16_t i = 0; i < entry.count; ++i) anchor += GetDelta(p);
+		return true;
+	}
+
+	bool InstructionIndex::NearestAnchor(uint32_t rva, uint32_t& anchor) const
+	{
+		if (m_pages.empty() || (rva >> kAnchorPageShift) < m_firstPage) return false;
+
+		size_t page = (rva >> kAnchorPageShift) - m_firstPage;
+		if (page >= m_pages.size()) return LastAnchorOfPage(m_pages.size() - 1, anchor);
+
+		const Page& entry = m_pages[page];
+		const uint8_t* p = m_deltas.data() + entry.offset;
+		uint32_t current = rva & ~(kPageSize - 1);
+		bool found = false;
+		for (uint16_t i = 0; i < entry.count; ++i)
+		{
+			current += GetDelta(p);
+			if (current > rva) break;
+			anchor = current;
+			found = true;
+		}
+		if (found) return true;
+
+		// ҳrva֮ǰûê㣬ȡǰһҳһ
+		while (page-- > 0)
+		{
+			if (LastAnchorOfPage(page, anchor)) return true;
+		}
+		return false;
+	}
+
+	bool InstructionIndex::InstructionAt(uint32_t rva, uint32_t& startRva, uint32_t& length) const
+	{
+		startRva = length = 0;
+
+		// ڱê㣬êһͬһ
+		const PeFunction* function = m_functions.FunctionContaining(rva);
+		uint32_t anchor = 0;
+		if (!function || !NearestAnchor(rva, anchor) || anchor < function->beginRva) return false;
+
+		const PeCodeRange* range = RangeOf(m_ranges, anchor);
+		uint32_t current = anchor;
+		for (;;)
+		{
+			uint32_t size = 1;
+			bool valid = Decode(range, current, size);
+			if (rva - current < size)
+			{
+				if (!valid) return false;
+				startRva = current;
+				length = size;
+				return true;
+			}
+			current += size;
+		}
+	}
+
+	size_t InstructionIndex::AnchorCount() const
+	{
+		return m_anchorCount;
+	}
+
+	size_t InstructionIndex::BytesUsed() const
+	{
+		return m_pages.size() * sizeof(Page) + m_deltas.size();
+	}
+}
@@ -0,0 +1,492 @@
+#include "include/pe_image.h"
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+namespace utils {
+
+	namespace {
+		const uint16_t kDosSignature = 0x5A4D;		// MZ
+		const uint32_t kNtSignature = 0x00004550;	// PE00
+		const uint16_t kOptionalMagic32 = 0x10b;
+		const uint16_t kOptionalMagic64 = 0x20b;
+		const uint32_t kScnCntCode = 0x00000020;
+		const uint32_t kScnMemExecute = 0x20000000;
+		const size_t kSectionHeaderSize = 40;
+		const uint16_t kMachineAmd64 = 0x8664;
+		const uint32_t kDirectoryException = 3;
+		const size_t kRuntimeFunctionSize = 12;
+		const uint8_t kUnwFlagChainInfo = 0x04;
+		const int kMaxChainDepth = 32;			// ֹĻ
+		const uint32_t kDirectoryImport = 1;
+		const size_t kImportDescriptorSize = 20;
+		const size_t kMaxNameLength = 512;
+
+		template <typename T>
+		inline bool ReadAt(const uint8_t* base, size_t size, size_t offset, T& value)
+		{
+			if (offset > size || size - offset < sizeof(T)) return false;
+			memcpy(&value, base + offset, sizeof(T));
+			return true;
+		}
+	}
+
+	bool PeSection::Executable() const
+	{
+		return (characteristics & (kScnCntCode | kScnMemExecute)) != 0;
+	}
+
+	PeImage::PeImage(const void* base, size_t size, bool mapped/* = true*/)
+		: m_base(static_cast<const uint8_t*>(base))
+		, m_size(size)
+		, m_mapped(mapped)
+	{
+		m_valid = Parse();
+	}
+
+	bool PeImage::Parse()
+	{
+		if (!m_base || m_size == 0) return false;
+
+		uint16_t dosMagic = 0;
+		uint32_t ntOffset = 0;
+		if (!ReadAt(m_base, m_size, 0, dosMagic) || dosMagic != kDosSignature) return false;
+		if (!ReadAt(m_base, m_size, 0x3C, ntOffset)) return false;
+
+		uint32_t ntSignature = 0;
+		if (!ReadAt(m_base, m_size, ntOffset, ntSignature) || ntSignature != kNtSignature) return false;
+
+		// IMAGE_FILE_HEADER
+		size_t fileHeader = (size_t)ntOffset + 4;
+		uint16_t numberOfSections = 0;
+		uint16_t sizeOfOptionalHeader = 0;
+		if (!ReadAt(m_base, m_size, fileHeader, m_machine) ||
+			!ReadAt(m_base, m_size, fileHeader + 2, numberOfSections) ||
+			!ReadAt(m_base, m_size, fileHeader + 4, m_timeDateStamp) ||
+			!ReadAt(m_base, m_size, fileHeader + 16, sizeOfOptionalHeader))
+		{
+			return false;
+		}
+
+		// IMAGE_OPTIONAL_HEADER32/64
+		size_t optionalHeader = fileHeader + 20;
+		uint16_t magic = 0;
+		if (!ReadAt(m_base, m_size, optionalHeader, magic)) return false;
+		if (magic == kOptionalMagic64)
+		{
+			m_64bit = true;
+			if (!ReadAt(m_base, m_size, optionalHeader + 24, m_imageBase)) return false;
+			if (!ReadAt(m_base, m_size, optionalHeader + 108, m_dataDirCount)) return false;
+			m_dataDirOffset = (uint32_t)(optionalHeader + 112);
+		}
+		else if (magic == kOptionalMagic32)
+		{
+			uint32_t imageBase32 = 0;
+			if (!ReadAt(m_base, m_size, optionalHeader + 28, imageBase32)) return false;
+			if (!ReadAt(m_base, m_size, optionalHeader + 92, m_dataDirCount)) return false;
+			m_imageBase = imageBase32;
+			m_dataDirOffset = (uint32_t)(optionalHeader + 96);
+		}
+		else
+		{
+			return false;
+		}
+
+		if (!ReadAt(m_base, m_size, optionalHeader + 16, m_entryPoint) ||
+			!ReadAt(m_base, m_size, optionalHeader + 56, m_sizeOfImage) ||
+			!ReadAt(m_base, m_size, optionalHeader + 60, m_sizeOfHeaders))
+		{
+			return false;
+		}
+
+		// Ŀ¼ܳѡͷ
+		size_t dataDirEnd = (size_t)m_dataDirOffset + (size_t)m_dataDirCount * 8;
+		if (dataDirEnd > optionalHeader + sizeOfOptionalHeader)
+		{
+			m_dataDirCount = (uint32_t)((optionalHeader + sizeOfOptionalHeader - m_dataDirOffset) / 8);
+		}
+
+		size_t sectionHeader = optionalHeader + sizeOfOptionalHeader;
+		if (sectionHeader + (size_t)numberOfSections * kSectionHeaderSize > m_size) return false;
+
+		m_sectionHeaderOffset = (uint32_t)sectionHeader;
+		m_sections.reserve(numberOfSections);
+		for (uint16_t i = 0; i < numberOfSections; ++i)
+		{
+			const uint8_t* header = m_base + sectionHeader + i * kSectionHeaderSize;
+
+			PeSection section;
+			char name[9] = { 0 };
+			memcpy(name, header, 8);
+			section.name = name;
+			memcpy(&section.virtualSize, header + 8, 4);
+			memcpy(&section.rva, header + 12, 4);
+			memcpy(&section.rawSize, header + 16, 4);
+			memcpy(&section.rawOffset, header + 20, 4);
+			memcpy(&section.characteristics, header + 36, 4);
+			m_sections.push_back(section);
+		}
+
+		return true;
+	}
+
+	bool PeImage::Invalid() const
+	{
+		return !m_valid;
+	}
+
+	bool PeImage::Mapped() const
+	{
+		return m_mapped;
+	}
+
+	bool PeImage::Is64Bit() const
+	{
+		return m_64bit;
+	}
+
+	const uint8_t* PeImage::Base() const
+	{
+		return m_base;
+	}
+
+	size_t PeImage::Size() const
+	{
+		return m_size;
+	}
+
+	uint16_t PeImage::Machine() const
+	{
+		return m_machine;
+	}
+
+	uint32_t PeImage::TimeDateStamp() const
+	{
+		return m_timeDateStamp;
+	}
+
+	uint32_t PeImage::SizeOfImage() const
+	{
+		return m_sizeOfImage;
+	}
+
+	uint32_t PeImage::EntryPointRva() const
+	{
+		return m_entryPoint;
+	}
+
+	uint64_t PeImage::ImageBase() const
+	{
+		return m_imageBase;
+	}
+
+	const std::vector<PeSection>& PeImage::Sections() const
+	{
+		return m_sections;
+	}
+
+	const uint8_t* PeImage::SectionHeaders() const
+	{
+		return m_valid ? m_base + m_sectionHeaderOffset : nullptr;
+	}
+
+	size_t PeImage::SectionHeadersSize() const
+	{
+		return m_sections.size() * kSectionHeaderSize;
+	}
+
+	const uint8_t* PeImage::RvaToPtr(uint32_t rva, size_t len/* = 1*/) const
+	{
+		if (!m_valid) return nullptr;
+
+		size_t offset = rva;
+		if (!m_mapped && rva >= m_sizeOfHeaders)
+		{
+			// ļҪͨڱ
+			bool found = false;
+			for (auto& section : m_sections)
+			{
+				uint32_t span = section.virtualSize ? section.virtualSize : section.rawSize;
+				if (rva >= section.rva && rva - section.rva < span)
+				{
+					if (rva - section.rva + len > section.rawSize) return nullptr;
+					offset = (size_t)section.rawOffset + (rva - section.rva);
+					found = true;
+					break;
+				}
+			}
+			if (!found) return nullptr;
+		}
+
+		if (offset > m_size || m_size - offset < len) return nullptr;
+		return m_base + offset;
+	}
+
+	bool PeImage::DataDirectory(uint32_t index, uint32_t& rva, uint32_t& size) const
+	{
+		rva = size = 0;
+		if (!m_valid || index >= m_dataDirCount) return false;
+
+		size_t entry = (size_t)m_dataDirOffset + (size_t)index * 8;
+		if (!ReadAt(m_base, m_size, entry, rva) || !ReadAt(m_base, m_size, entry + 4, size)) return false;
+		return rva != 0 && size != 0;
+	}
+
+	std::vector<PeCodeRange> PeImage::ExecutableRanges() const
+	{
+		std::vector<PeCodeRange> ranges;
+		if (!m_valid) return ranges;
+
+		for (auto& section : m_sections)
+		{
+			if (!section.Executable()) continue;
+
+			size_t begin = 0;
+			size_t length = 0;
+			if (m_mapped)
+			{
+				begin = section.rva;
+				length = section.virtualSize ? section.virtualSize : section.rawSize;
+			}
+			else
+			{
+				begin = section.rawOffset;
+				length = section.virtualSize ? (std::min)(section.virtualSize, section.rawSize) : section.rawSize;
+			}
+
+			if (begin >= m_size) continue;
+			length = (std::min)(length, m_size - begin);
+			if (length == 0) continue;
+
+			PeCodeRange range;
+			range.data = m_base + begin;
+			range.size = length;
+			range.rva = section.rva;
+			ranges.push_back(range);
+		}
+
+		return ranges;
+	}
+
+	bool PeImage::ReadString(uint32_t rva, std::string& value) const
+	{
+		value.clear();
+		for (size_t i = 0; i < kMaxNameLength; ++i)
+		{
+			const uint8_t* p = RvaToPtr(rva + (uint32_t)i);
+			if (!p) return false;
+			if (*p == 0) return true;
+			value.push_back((char)*p);
+		}
+		return false;
+	}
+
+	std::vector<PeImport> PeImage::Imports() const
+	{
+		std::vector<PeImport> imports;
+		uint32_t dirRva = 0;
+		uint32_t dirSize = 0;
+		if (!DataDirectory(kDirectoryImport, dirRva, dirSize)) return imports;
+
+		size_t thunkSize = m_64bit ? 8 : 4;
+		uint64_t ordinalFlag = m_64bit ? 0x8000000000000000ull : 0x80000000ull;
+
+		// ȫ0βĿ¼СֻΪ
+		for (size_t offset = 0; offset + kImportDescriptorSize <= dirSize; offset += kImportDescriptorSize)
+		{
+			const uint8_t* descriptor = RvaToPtr(dirRva + (uint32_t)offset, kImportDescriptorSize);
+			if (!descriptor) break;
+
+			uint32_t originalFirstThunk = 0;
+			uint32_t nameRva = 0;
+			uint32_t firstThunk = 0;
+			memcpy(&originalFirstThunk, descriptor, 4);
+			memcpy(&nameRva, descriptor + 12, 4);
+			memcpy(&firstThunk, descriptor + 16, 4);
+			if (nameRva == 0 && firstThunk == 0) break;
+
+			std::string module;
+			if (!ReadString(nameRva, module)) continue;
+
+			// ϵдOriginalFirstThunkֻܴIATغģͽ
+			uint32_t lookup = originalFirstThunk ? originalFirstThunk : firstThunk;
+			for (uint32_t index = 0; ; ++index)
+			{
+				const uint8_t* thunk = RvaToPtr(lookup + index * (uint32_t)thunkSize, thunkSize);
+				if (!thunk) break;
+
+				uint64_t value = 0;
+				memcpy(&value, thunk, thunkSize);
+				if (value == 0) break;
+
+				PeImport entry;
+				entry.module = module;
+				entry.slotRva = firstThunk + index * (uint32_t)thunkSize;
+				if (value & ordinalFlag)
+				{
+					entry.ordinal = (uint16_t)value;
+				}
+				else
+				{
+					// IMAGE_IMPORT_BY_NAME: Hint + Name
+					const uint8_t* hint = RvaToPtr((uint32_t)value, 2);
+					if (!hint || !ReadString((uint32_t)value + 2, entry.name)) break;
+					memcpy(&entry.ordinal, hint, 2);
+				}
+				imports.push_back(entry);
+			}
+		}
+
+		return imports;
+	}
+
+	bool PeImage::FindImportSlot(const std::string& module, const std::string& name, uint32_t& slotRva) const
+	{
+		slotRva = 0;
+		auto sameModule = [&module](const std::string& other)
+		{
+			return other.size() == module.size() && std::equal(other.begin(), other.end(), module.begin(),
+				[](char a, char b) { return ::tolower((unsigned char)a) == ::tolower((unsigned char)b); });
+		};
+
+		for (auto& entry : Imports())
+		{
+			if (entry.name == name && sameModule(entry.module))
+			{
+				slotRva = entry.slotRva;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	PeFunctionTable::PeFunctionTable(const PeImage& image)
+	{
+		Load(image);
+	}
+
+	PeFunctionTable::PeFunctionTable(std::vector<PeFunction> functions)
+		: m_functions(std::move(functions))
+	{
+		std::sort(m_functions.begin(), m_functions.end(), [](const PeFunction& a, const PeFunction& b) { return a.beginRva < b.beginRva; });
+		for (uint32_t i = 0; i < (uint32_t)m_functions.size(); ++i)
+		{
+			m_functions[i].primary = i;
+		}
+	}
+
+	void PeFunctionTable::Load(const PeImage& image)
+	{
+		if (image.Invalid() || image.Machine() != kMachineAmd64) return;
+
+		uint32_t dirRva = 0;
+		uint32_t dirSize = 0;
+		if (!image.DataDirectory(kDirectoryException, dirRva, dirSize)) return;
+
+		// ļĿ¼ܳڵԭʼСȡܶĲ
+		size_t count = dirSize / kRuntimeFunctionSize;
+		const uint8_t* entries = nullptr;
+		while (count && !(entries = image.RvaToPtr(dirRva, count * kRuntimeFunctionSize))) --count;
+		if (!entries) return;
+
+		m_functions.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			PeFunction function;
+			memcpy(&function.beginRva, entries + i * kRuntimeFunctionSize, 4);
+			memcpy(&function.endRva, entries + i * kRuntimeFunctionSize + 4, 4);
+			memcpy(&function.unwindRva, entries + i * kRuntimeFunctionSize + 8, 4);
+			function.primary = 0;
+
+			// ȫ0룬յĺԽ
+			if (function.beginRva >= function.endRva || function.endRva > image.SizeOfImage()) continue;
+			m_functions.push_back(function);
+		}
+
+		// ģֻǷֹ޸Ĺļ
+		auto lessBegin = [](const PeFunction& a, const PeFunction& b) { return a.beginRva < b.beginRva; };
+		if (!std::is_sorted(m_functions.begin(), m_functions.end(), lessBegin))
+		{
+			std::sort(m_functions.begin(), m_functions.end(), lessBegin);
+		}
+
+		for (uint32_t i = 0; i < (uint32_t)m_functions.size(); ++i)
+		{
+			m_functions[i].primary = ResolvePrimary(image, i);
+		}
+	}
+
+	uint32_t PeFunctionTable::ResolvePrimary(const PeImage& image, uint32_t index) const
+	{
+		uint32_t current = index;
+		for (int depth = 0; depth < kMaxChainDepth; ++depth)
+		{
+			// UNWIND_INFO: VersionAndFlags, SizeOfProlog, CountOfCodes, FrameRegisterAndOffset, UnwindCode[]
+			const uint8_t* unwind = image.RvaToPtr(m_functions[current].unwindRva, 4);
+			if (!unwind || !((unwind[0] >> 3) & kUnwFlagChainInfo)) break;
+
+			// ӵRUNTIME_FUNCTIONUnwindCode棬鰴ż
+			uint32_t codes = ((uint32_t)unwind[2] + 1) & ~1u;
+			uint32_t chainRva = m_functions[current].unwindRva + 4 + codes * 2;
+			const uint8_t* chained = image.RvaToPtr(chainRva, kRuntimeFunctionSize);
+			if (!chained) break;
+
+			uint32_t beginRva = 0;
+			memcpy(&beginRva, chained, 4);
+			const PeFunction* parent = Find(beginRva);
+			if (!parent || parent->beginRva != beginRva) break;
+
+			uint32_t next = (uint32_t)(parent - m_functions.data());
+			if (next == current) break;
+			current = next;
+		}
+		return current;
+	}
+
+	const PeFunction* PeFunctionTable::Find(uint32_t rva) const
+	{
+		// һbeginRvarvaǰһ
+		auto it = std::upper_bound(m_functions.begin(), m_functions.end(), rva,
+			[](uint32_t value, const PeFunction& function) { return value < function.beginRva; });
+		if (it == m_functions.begin()) return nullptr;
+		--it;
+		return rva < it->endRva ? &*it : nullptr;
+	}
+
+	bool PeFunctionTable::Empty() const
+	{
+		return m_functions.empty();
+	}
+
+	size_t PeFunctionTable::Count() const
+	{
+		return m_functions.size();
+	}
+
+	const std::vector<PeFunction>& PeFunctionTable::Functions() const
+	{
+		return m_functions;
+	}
+
+	const PeFunction* PeFunctionTable::FunctionContaining(uint32_t rva) const
+	{
+		return Find(rva);
+	}
+
+	const PeFunction* PeFunctionTable::PrimaryContaining(uint32_t rva) const
+	{
+		const PeFunction* function = Find(rva);
+		return function ? &m_functions[function->primary] : nullptr;
+	}
+
+	std::vector<uint32_t> PeFunctionTable::Entries() const
+	{
+		std::vector<uint32_t> entries;
+		entries.reserve(m_functions.size());
+		for (uint32_t i = 0; i < (uint32_t)m_functions.size(); ++i)
+		{
+			if (m_functions[i].primary == i) entries.push_back(m_functions[i].beginRva);
+		}
+		return entries;
+	}
+}
@@ -0,0 +1,713 @@
+#include "include/signature.h"
+#include "include/pe_image.h"
+#include "include/thread_pool.h"
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SIGNATURE_USE_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIGNATURE_TARGET_SSE2
+#define SIGNATURE_TARGET_SSSE3
+#define SIGNATURE_TARGET_AVX2
+#else
+#define SIGNATURE_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIGNATURE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SIGNATURE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace utils {
+
+	namespace {
+		// x86/x64ֽڣԽǰԽê㾡ܿ
+		const uint8_t kCommonCodeBytes[] = {
+			0x00, 0xFF, 0x48, 0x8B, 0xCC, 0x89, 0x24, 0x44, 0x4C, 0x0F, 0xE8, 0x01,
+			0x83, 0x85, 0x8D, 0xC0, 0x45, 0x74, 0x08, 0x10, 0x20, 0x40, 0x41, 0x75,
+			0x90, 0xC3, 0x33, 0x49, 0x18, 0x4D, 0xEB, 0x04, 0x28, 0x30, 0x38, 0x50,
+		};
+
+		// ֵԽԽ
+		int ByteCommonness(uint8_t value)
+		{
+			const int count = (int)sizeof(kCommonCodeBytes);
+			for (int i = 0; i < count; ++i)
+			{
+				if (kCommonCodeBytes[i] == value) return count - i;
+			}
+			return 0;
+		}
+
+		inline int HexValue(char ch)
+		{
+			if (ch >= '0' && ch <= '9') return ch - '0';
+			if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+			if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+			return -1;
+		}
+
+		inline uint32_t LowestBit(uint32_t bits)
+		{
+#if defined(_MSC_VER)
+			unsigned long index = 0;
+			_BitScanForward(&index, bits);
+			return index;
+#else
+			return (uint32_t)__builtin_ctz(bits);
+#endif
+		}
+
+		// trueʾֹͣɨ裻hitsΪʱֻռУ
+		inline bool ReportHit(size_t offset, std::vector<size_t>* hits)
+		{
+			if (!hits) return true;
+			hits->push_back(offset);
+			return false;
+		}
+
+		// candidatesΪΪλødataLen - sig.Length() + 1
+		size_t ScanScalar(const uint8_t* data, size_t begin, size_t candidates, const Signature& sig, std::vector<size_t>* hits)
+		{
+			const size_t anchor = sig.Anchor();
+			const uint8_t anchorByte = sig.Bytes()[anchor];
+
+			size_t i = begin;
+			while (i < candidates)
+			{
+				const uint8_t* found = (const uint8_t*)memchr(data + i + anchor, anchorByte, candidates - i);
+				if (!found) break;
+
+				size_t pos = (size_t)(found - data) - anchor;
+				if (sig.MatchAt(data + pos) && ReportHit(pos, hits)) return pos;
+				i = pos + 1;
+			}
+
+			return kSignatureNotFound;
+		}
+
+#ifdef SIGNATURE_USE_SIMD
+		enum CpuLevel {
+			CPU_LEVEL_SSE2 = 0,
+			CPU_LEVEL_SSSE3,
+			CPU_LEVEL_AVX2,
+		};
+
+		CpuLevel DetectCpuLevel()
+		{
+#if defined(_MSC_VER)
+			int info[4] = { 0 };
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			bool ssse3 = (info[2] & (1 << 9)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+			{
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5)) return CPU_LEVEL_AVX2;
+			}
+			return ssse3 ? CPU_LEVEL_SSSE3 : CPU_LEVEL_SSE2;
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) return CPU_LEVEL_AVX2;
+			if (__builtin_cpu_supports("ssse3")) return CPU_LEVEL_SSSE3;
+			return CPU_LEVEL_SSE2;
+#endif
+		}
+
+		CpuLevel GetCpuLevel()
+		{
+			static const CpuLevel level = DetectCpuLevel();
+			return level;
+		}
+
+		// êͬʱȽϣһɸ16㣬ʣµĽ
+		SIGNATURE_TARGET_SSE2
+		size_t ScanSse2(const uint8_t* data, size_t candidates, const Signature& sig, std::vector<size_t>* hits)
+		{
+			const uint8_t* first = data + sig.Anchor();
+			const uint8_t* second = data + sig.SecondAnchor();
+			const __m128i firstByte = _mm_set1_epi8((char)sig.Bytes()[sig.Anchor()]);
+			const __m128i secondByte = _mm_set1_epi8((char)sig.Bytes()[sig.SecondAnchor()]);
+
+			size_t i = 0;
+			for (; i + 16 <= candidates; i += 16)
+			{
+				__m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(first + i)), firstByte);
+				__m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(second + i)), secondByte);
+				uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_and_si128(eq1, eq2));
+				while (bits)
+				{
+					size_t pos = i + LowestBit(bits);
+					if (sig.MatchAt(data + pos) && ReportHit(pos, hits)) return pos;
+					bits &= bits - 1;
+				}
+			}
+
+			return ScanScalar(data, i, candidates, sig, hits);
+		}
+
+		SIGNATURE_TARGET_AVX2
+		size_t ScanAvx2(const uint8_t* data, size_t candidates, const Signature& sig, std::vector<size_t>* hits)
+		{
+			const uint8_t* first = data + sig.Anchor();
+			const uint8_t* second = data + sig.SecondAnchor();
+			const __m256i firstByte = _mm256_set1_epi8((char)sig.Bytes()[sig.Anchor()]);
+			const __m256i secondByte = _mm256_set1_epi8((char)sig.Bytes()[sig.SecondAnchor()]);
+
+			size_t i = 0;
+			for (; i + 32 <= candidates; i += 32)
+			{
+				__m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(first + i)), firstByte);
+				__m256i eq2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(second + i)), secondByte);
+				uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq1, eq2));
+				while (bits)
+				{
+					size_t pos = i + LowestBit(bits);
+					if (sig.MatchAt(data + pos) && ReportHit(pos, hits)) return pos;
+					bits &= bits - 1;
+				}
+			}
+
+			return ScanScalar(data, i, candidates, sig, hits);
+		}
+
+		// êԤɸѡêֽڵĸߵͰֽڸһűõ8Ͱλ룬
+		// ű벻Ϊ0λòſСbeginʼɨ裬ѡλдout
+		// һδɨλãʣ಻һʱԭ
+		SIGNATURE_TARGET_SSSE3
+		size_t FilterAnchorsSsse3(const uint8_t* data, size_t begin, size_t dataLen, const uint8_t (*masks)[16], size_t* out, size_t outCap, size_t& outCount)
+		{
+			const __m128i lowNibble = _mm_set1_epi8(0x0F);
+			const __m128i firstLow = _mm_loadu_si128((const __m128i*)masks[0]);
+			const __m128i firstHigh = _mm_loadu_si128((const __m128i*)masks[1]);
+			const __m128i secondLow = _mm_loadu_si128((const __m128i*)masks[2]);
+			const __m128i secondHigh = _mm_loadu_si128((const __m128i*)masks[3]);
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t pos = begin;
+			outCount = 0;
+			while (pos + 17 <= dataLen && outCount + 16 <= outCap)
+			{
+				__m128i first = _mm_loadu_si128((const __m128i*)(data + pos));
+				__m128i second = _mm_loadu_si128((const __m128i*)(data + pos + 1));
+				__m128i match = _mm_and_si128(
+					_mm_and_si128(_mm_shuffle_epi8(firstLow, _mm_and_si128(first, lowNibble)),
+						_mm_shuffle_epi8(firstHigh, _mm_and_si128(_mm_srli_epi16(first, 4), lowNibble))),
+					_mm_and_si128(_mm_shuffle_epi8(secondLow, _mm_and_si128(second, lowNibble)),
+						_mm_shuffle_epi8(secondHigh, _mm_and_si128(_mm_srli_epi16(second, 4), lowNibble))));
+				uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(match, zero)) ^ 0xFFFF;
+				while (bits)
+				{
+					out[outCount++] = pos + LowestBit(bits);
+					bits &= bits - 1;
+				}
+				pos += 16;
+			}
+
+			return pos;
+		}
+
+		SIGNATURE_TARGET_AVX2
+		size_t FilterAnchorsAvx2(const uint8_t* data, size_t begin, size_t dataLen, const uint8_t (*masks)[16], size_t* out, size_t outCap, size_t& outCount)
+		{
+			const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+			const __m256i firstLow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)masks[0]));
+			const __m256i firstHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)masks[1]));
+			const __m256i secondLow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)masks[2]));
+			const __m256i secondHigh = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)masks[3]));
+			const __m256i zero = _mm256_setzero_si256();
+
+			size_t pos = begin;
+			outCount = 0;
+			while (pos + 33 <= dataLen && outCount + 32 <= outCap)
+			{
+				__m256i first = _mm256_loadu_si256((const __m256i*)(data + pos));
+				__m256i second = _mm256_loadu_si256((const __m256i*)(data + pos + 1));
+				__m256i match = _mm256_and_si256(
+					_mm256_and_si256(_mm256_shuffle_epi8(firstLow, _mm256_and_si256(first, lowNibble)),
+						_mm256_shuffle_epi8(firstHigh, _mm256_and_si256(_mm256_srli_epi16(first, 4), lowNibble))),
+					_mm256_and_si256(_mm256_shuffle_epi8(secondLow, _mm256_and_si256(second, lowNibble)),
+						_mm256_shuffle_epi8(secondHigh, _mm256_and_si256(_mm256_srli_epi16(second, 4), lowNibble))));
+				uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(match, zero));
+				while (bits)
+				{
+					out[outCount++] = pos + LowestBit(bits);
+					bits &= bits - 1;
+				}
+				pos += 32;
+			}
+
+			return pos;
+		}
+#endif
+
+		size_t Scan(const uint8_t* data, size_t dataLen, const Signature& sig, std::vector<size_t>* hits)
+		{
+			if (!data || sig.Invalid() || dataLen < sig.Length()) return kSignatureNotFound;
+
+			size_t candidates = dataLen - sig.Length() + 1;
+#ifdef SIGNATURE_USE_SIMD
+			if (GetCpuLevel() == CPU_LEVEL_AVX2) return ScanAvx2(data, candidates, sig, hits);
+			return ScanSse2(data, candidates, sig, hits);
+#else
+			return ScanScalar(data, 0, candidates, sig, hits);
+#endif
+		}
+	}
+
+	Signature::Signature(const std::string& pattern)
+	{
+		size_t i = 0;
+		while (i < pattern.length())
+		{
+			char ch = pattern[i];
+			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+			{
+				++i;
+				continue;
+			}
+
+			size_t end = i;
+			while (end < pattern.length() && pattern[end] != ' ' && pattern[end] != '\t' && pattern[end] != '\r' && pattern[end] != '\n') ++end;
+
+			std::string token = pattern.substr(i, end - i);
+			i = end;
+
+			if (token == "?" || token == "??")
+			{
+				m_bytes.push_back(0);
+				m_mask.push_back(0);
+				continue;
+			}
+
+			int high = token.length() == 2 ? HexValue(token[0]) : 0;
+			int low = HexValue(token[token.length() - 1]);
+			if (token.length() > 2 || high < 0 || low < 0)
+			{
+				m_bytes.clear();
+				m_mask.clear();
+				return;
+			}
+
+			m_bytes.push_back((uint8_t)((high << 4) | low));
+			m_mask.push_back(0xFF);
+		}
+
+		Compile();
+	}
+
+	Signature::Signature(const uint8_t* code, size_t codeLen, const uint8_t* mask/* = nullptr*/)
+	{
+		if (!code || codeLen == 0) return;
+
+		m_bytes.assign(code, code + codeLen);
+		m_mask.assign(codeLen, 0xFF);
+		if (mask)
+		{
+			for (size_t i = 0; i < codeLen; ++i)
+			{
+				m_mask[i] = mask[i] ? 0xFF : 0;
+				m_bytes[i] &= m_mask[i];
+			}
+		}
+
+		Compile();
+	}
+
+	void Signature::Compile()
+	{
+		m_valid = false;
+
+		int firstScore = -1;
+		int secondScore = -1;
+		for (size_t i = 0; i < m_bytes.size(); ++i)
+		{
+			if (!m_mask[i]) continue;
+
+			int score = 255 - ByteCommonness(m_bytes[i]);
+			if (score > firstScore)
+			{
+				m_secondAnchor = m_anchor;
+				secondScore = firstScore;
+				m_anchor = i;
+				firstScore = score;
+			}
+			else if (score > secondScore)
+			{
+				m_secondAnchor = i;
+				secondScore = score;
+			}
+		}
+
+		// ֻһȷֽʱêغ
+		if (firstScore < 0) return;
+		if (secondScore < 0) m_secondAnchor = m_anchor;
+
+		int pairScore = -1;
+		for (size_t i = 0; i + 1 < m_bytes.size(); ++i)
+		{
+			if (!m_mask[i] || !m_mask[i + 1]) continue;
+
+			int score = 510 - ByteCommonness(m_bytes[i]) - ByteCommonness(m_bytes[i + 1]);
+			if (score > pairScore)
+			{
+				m_pairAnchor = i;
+				pairScore = score;
+			}
+		}
+
+		m_valid = true;
+	}
+
+	bool Signature::Invalid() const
+	{
+		return !m_valid;
+	}
+
+	size_t Signature::Length() const
+	{
+		return m_bytes.size();
+	}
+
+	const std::vector<uint8_t>& Signature::Bytes() const
+	{
+		return m_bytes;
+	}
+
+	const std::vector<uint8_t>& Signature::Mask() const
+	{
+		return m_mask;
+	}
+
+	size_t Signature::Anchor() const
+	{
+		return m_anchor;
+	}
+
+	size_t Signature::SecondAnchor() const
+	{
+		return m_secondAnchor;
+	}
+
+	size_t Signature::PairAnchor() const
+	{
+		return m_pairAnchor;
+	}
+
+	bool Signature::MatchAt(const uint8_t* data) const
+	{
+		const size_t length = m_bytes.size();
+		const uint8_t* bytes = m_bytes.data();
+		const uint8_t* mask = m_mask.data();
+		for (size_t i = 0; i < length; ++i)
+		{
+			if ((data[i] & mask[i]) != bytes[i]) return false;
+		}
+		return true;
+	}
+
+	size_t FindSignature(const uint8_t* data, size_t dataLen, const Signature& sig)
+	{
+		return Scan(data, dataLen, sig, nullptr);
+	}
+
+	std::vector<size_t> FindSignatureAll(const uint8_t* data, size_t dataLen, const Signature& sig)
+	{
+		std::vector<size_t> hits;
+		Scan(data, dataLen, sig, &hits);
+		return hits;
+	}
+
+	const uint8_t* FindSignature(const PeImage& image, const Signature& sig)
+	{
+		if (image.Invalid() || sig.Invalid()) return nullptr;
+
+		for (auto& range : image.ExecutableRanges())
+		{
+			size_t offset = FindSignature(range.data, range.size, sig);
+			if (offset != kSignatureNotFound) return range.data + offset;
+		}
+
+		return nullptr;
+	}
+
+	SignatureSet::SignatureSet(const std::vector<Signature>& signatures)
+		: m_signatures(signatures)
+	{
+		Compile();
+	}
+
+	void SignatureSet::Compile()
+	{
+		std::vector<std::vector<Entry>> pairs(0x10000);
+		std::vector<std::vector<Entry>> bytes(0x100);
+
+		for (size_t i = 0; i < m_signatures.size(); ++i)
+		{
+			const Signature& sig = m_signatures[i];
+			if (sig.Invalid()) continue;
+
+			m_maxLength = (std::max)(m_maxLength, sig.Length());
+
+			Entry entry;
+			entry.index = (uint32_t)i;
+			if (sig.PairAnchor() != kSignatureNotFound)
+			{
+				entry.anchor = (uint32_t)sig.PairAnchor();
+				uint32_t key = sig.Bytes()[entry.anchor] | (sig.Bytes()[entry.anchor + 1] << 8);
+				pairs[key].push_back(entry);
+			}
+			else
+			{
+				entry.anchor = (uint32_t)sig.Anchor();
+				bytes[sig.Bytes()[entry.anchor]].push_back(entry);
+			}
+		}
+
+		// չ飬ͰiΪ[buckets[i], buckets[i + 1])
+		m_pairBitmap.assign(0x10000 / 64, 0);
+		m_pairBuckets.assign(0x10000 + 1, 0);
+		for (uint32_t key = 0; key < 0x10000; ++key)
+		{
+			m_pairBuckets[key] = (uint32_t)m_pairEntries.size();
+			if (pairs[key].empty()) continue;
+
+			m_pairBitmap[key >> 6] |= 1ull << (key & 63);
+			m_pairEntries.insert(m_pairEntries.end(), pairs[key].begin(), pairs[key].end());
+		}
+		m_pairBuckets[0x10000] = (uint32_t)m_pairEntries.size();
+
+		// ͬêŽ8ͰֽêԵڶֽڲ
+		memset(m_nibbleMasks, 0, sizeof(m_nibbleMasks));
+		uint32_t bucket = 0;
+		for (uint32_t key = 0; key < 0x10000; ++key)
+		{
+			if (pairs[key].empty()) continue;
+
+			uint8_t bit = (uint8_t)(1 << (bucket++ % 8));
+			m_nibbleMasks[0][key & 0x0F] |= bit;
+			m_nibbleMasks[1][(key >> 4) & 0x0F] |= bit;
+			m_nibbleMasks[2][(key >> 8) & 0x0F] |= bit;
+			m_nibbleMasks[3][(key >> 12) & 0x0F] |= bit;
+		}
+		for (uint32_t key = 0; key < 0x100; ++key)
+		{
+			if (bytes[key].empty()) continue;
+
+			uint8_t bit = (uint8_t)(1 << (bucket++ % 8));
+			m_nibbleMasks[0][key & 0x0F] |= bit;
+			m_nibbleMasks[1][key >> 4] |= bit;
+			for (int i = 0; i < 16; ++i)
+			{
+				m_nibbleMasks[2][i] |= bit;
+				m_nibbleMasks[3][i] |= bit;
+			}
+		}
+
+		m_byteBuckets.assign(0x100 + 1, 0);
+		for (uint32_t key = 0; key < 0x100; ++key)
+		{
+			m_byteBuckets[key] = (uint32_t)m_byteEntries.size();
+			m_byteEntries.insert(m_byteEntries.end(), bytes[key].begin(), bytes[key].end());
+		}
+		m_byteBuckets[0x100] = (uint32_t)m_byteEntries.size();
+	}
+
+	size_t SignatureSet::Size() const
+	{
+		return m_signatures.size();
+	}
+
+	size_t SignatureSet::MaxLength() const
+	{
+		return m_maxLength;
+	}
+
+	const Signature& SignatureSet::At(size_t index) const
+	{
+		return m_signatures[index];
+	}
+
+	std::vector<size_t> SignatureSet::Find(const uint8_t* data, size_t dataLen) const
+	{
+		std::vector<size_t> hits(m_signatures.size(), kSignatureNotFound);
+		if (!data || dataLen == 0) return hits;
+
+		// ֻһʱģʽSIMDɨ
+		if (m_signatures.size() == 1)
+		{
+			hits[0] = FindSignature(data, dataLen, m_signatures[0]);
+			return hits;
+		}
+
+		size_t remaining = m_pairEntries.size() + m_byteEntries.size();
+
+		// ͬһêƫƹ̶оǰ
+		auto check = [&](const Entry* begin, const Entry* end, size_t pos)
+		{
+			for (const Entry* entry = begin; entry != end; ++entry)
+			{
+				if (hits[entry->index] != kSignatureNotFound || pos < entry->anchor) continue;
+
+				size_t start = pos - entry->anchor;
+				const Signature& sig = m_signatures[entry->index];
+				if (dataLen - start < sig.Length() || !sig.MatchAt(data + start)) continue;
+
+				hits[entry->index] = start;
+				--remaining;
+			}
+		};
+
+		const uint64_t* bitmap = m_pairBitmap.data();
+		const uint32_t* pairBuckets = m_pairBuckets.data();
+		const Entry* pairEntries = m_pairEntries.data();
+		const uint32_t* byteBuckets = m_byteBuckets.data();
+		const Entry* byteEntries = m_byteEntries.data();
+		const bool checkBytes = !m_byteEntries.empty();
+
+		// һֽڴղֽê㣬ֻ鵥ֽͰ
+		auto visit = [&](size_t pos)
+		{
+			if (pos + 1 < dataLen)
+			{
+				uint32_t key = data[pos] | (data[pos + 1] << 8);
+				if (bitmap[key >> 6] & (1ull << (key & 63)))
+				{
+					check(pairEntries + pairBuckets[key], pairEntries + pairBuckets[key + 1], pos);
+				}
+			}
+
+			if (checkBytes)
+			{
+				uint8_t first = data[pos];
+				check(byteEntries + byteBuckets[first], byteEntries + byteBuckets[first + 1], pos);
+			}
+		};
+
+		size_t pos = 0;
+#ifdef SIGNATURE_USE_SIMD
+		CpuLevel level = GetCpuLevel();
+		if (level != CPU_LEVEL_SSE2)
+		{
+			size_t candidates[256];
+			while (remaining > 0)
+			{
+				size_t count = 0;
+				size_t next = level == CPU_LEVEL_AVX2 ?
+					FilterAnchorsAvx2(data, pos, dataLen, m_nibbleMasks, candidates, 256, count) :
+					FilterAnchorsSsse3(data, pos, dataLen, m_nibbleMasks, candidates, 256, count);
+				for (size_t i = 0; i < count && remaining > 0; ++i) visit(candidates[i]);
+
+				if (next == pos) break;
+				pos = next;
+			}
+		}
+#endif
+
+		for (; pos < dataLen && remaining > 0; ++pos) visit(pos);
+
+		return hits;
+	}
+
+	std::vector<const uint8_t*> SignatureSet::Find(const PeImage& image) const
+	{
+		std::vector<const uint8_t*> found(m_signatures.size(), nullptr);
+		if (image.Invalid()) return found;
+
+		size_t remaining = m_signatures.size();
+		for (auto& range : image.ExecutableRanges())
+		{
+			std::vector<size_t> hits = Find(range.data, range.size);
+			for (size_t i = 0; i < hits.size(); ++i)
+			{
+				if (found[i] || hits[i] == kSignatureNotFound) continue;
+
+				found[i] = range.data + hits[i];
+				--remaining;
+			}
+
+			if (remaining == 0) break;
+		}
+
+		return found;
+	}
+
+	std::vector<const uint8_t*> SignatureSet::Find(const PeImage& image, ThreadPool& pool, size_t chunkSize/* = kSignatureChunkSize*/) const
+	{
+		std::vector<const uint8_t*> found(m_signatures.size(), nullptr);
+		if (image.Invalid() || m_signatures.empty()) return found;
+		if (chunkSize == 0) chunkSize = kSignatureChunkSize;
+
+		// ֻ[0, scanSize)Уصֵйһ
+		struct Chunk
+		{
+			const uint8_t* data;
+			size_t size;
+			size_t scanSize;
+		};
+
+		std::vector<Chunk> chunks;
+		size_t overlap = m_maxLength ? m_maxLength - 1 : 0;
+		for (auto& range : image.ExecutableRanges())
+		{
+			for (size_t offset = 0; offset < range.size; offset += chunkSize)
+			{
+				Chunk chunk;
+				chunk.data = range.data + offset;
+				chunk.scanSize = (std::min)(chunkSize, range.size - offset);
+				chunk.size = (std::min)(chunk.scanSize + overlap, range.size - offset);
+				chunks.push_back(chunk);
+			}
+		}
+
+		size_t validCount = 0;
+		for (auto& sig : m_signatures)
+		{
+			if (!sig.Invalid()) ++validCount;
+		}
+
+		// ĳһѾȫĿ鶼ɨ
+		std::vector<std::vector<size_t>> results(chunks.size());
+		std::atomic<size_t> lastChunk(chunks.size());
+		pool.ParallelFor(chunks.size(), [&](size_t index)
+		{
+			if (index > lastChunk) return;
+
+			const Chunk& chunk = chunks[index];
+			std::vector<size_t>& hits = results[index];
+			hits = Find(chunk.data, chunk.size);
+
+			size_t hitCount = 0;
+			for (auto& hit : hits)
+			{
+				if (hit >= chunk.scanSize) hit = kSignatureNotFound;
+				if (hit != kSignatureNotFound) ++hitCount;
+			}
+
+			if (hitCount < validCount || validCount == 0) return;
+
+			size_t current = lastChunk;
+			while (index < current && !lastChunk.compare_exchange_weak(current, index));
+		});
+
+		// ˳ϲ֤ȡǰ
+		for (size_t index = 0; index < chunks.size() && index <= lastChunk; ++index)
+		{
+			const std::vector<size_t>& hits = results[index];
+			for (size_t i = 0; i < hits.size(); ++i)
+			{
+				if (found[i] || hits[i] == kSignatureNotFound) continue;
+				found[i] = chunks[index].data + hits[i];
+			}
+		}
+
+		return found;
+	}
+}
@@ -0,0 +1,355 @@
+#include "include/signature_cache.h"
+#include "include/signature.h"
+#include "include/pe_image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include "include/stringex.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+	namespace {
+		const uint32_t kCacheMagic = 0x48434753;	// SGCH
+		const uint32_t kCacheVersion = 1;
+
+		uint64_t Fnv1a(const void* data, size_t len, uint64_t hash = 0xcbf29ce484222325ull)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < len; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 0x100000001b3ull;
+			}
+			return hash;
+		}
+
+		uint64_t SignatureHash(const Signature& sig)
+		{
+			uint64_t hash = Fnv1a(sig.Bytes().data(), sig.Bytes().size());
+			return Fnv1a(sig.Mask().data(), sig.Mask().size(), hash);
+		}
+
+		bool EntryLess(const SignatureCache::Entry& left, const SignatureCache::Entry& right)
+		{
+			if (left.nameHash != right.nameHash) return left.nameHash < right.nameHash;
+			return left.signatureHash < right.signatureHash;
+		}
+
+		bool SameModule(const SignatureCache::Entry& entry, const ModuleIdentity& module)
+		{
+			return entry.timeDateStamp == module.timeDateStamp &&
+				entry.sizeOfImage == module.sizeOfImage &&
+				entry.sectionHash == module.sectionHash;
+		}
+	}
+
+	ModuleIdentity GetModuleIdentity(const std::string& moduleName, const PeImage& image)
+	{
+		ModuleIdentity module;
+		if (image.Invalid()) return module;
+
+		std::string name = moduleName;
+		std::transform(name.begin(), name.end(), name.begin(), [](char ch) { return (ch >= 'A' && ch <= 'Z') ? (char)(ch - 'A' + 'a') : ch; });
+
+		module.nameHash = Fnv1a(name.data(), name.size());
+		module.timeDateStamp = image.TimeDateStamp();
+		module.sizeOfImage = image.SizeOfImage();
+		module.sectionHash = Fnv1a(image.SectionHeaders(), image.SectionHeadersSize());
+		return module;
+	}
+
+	SignatureCache::~SignatureCache()
+	{
+		Close();
+	}
+
+	bool SignatureCache::Open(const std::string& path)
+	{
+#ifdef _WIN32
+		return Open(Utf8ToWide(path));
+#else
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_pending.clear();
+		m_path = path;
+		return Map();
+#endif
+	}
+
+#ifdef _WIN32
+	bool SignatureCache::Open(const std::wstring& path)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_pending.clear();
+		m_path = path;
+		return Map();
+	}
+#endif
+
+	void SignatureCache::Close()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		Unmap();
+		m_pending.clear();
+		m_path.clear();
+	}
+
+	bool SignatureCache::Map()
+	{
+		Unmap();
+		if (m_path.empty()) return false;
+
+#ifdef _WIN32
+		HANDLE file = CreateFileW(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		m_file = file;
+
+		LARGE_INTEGER fileSize = { 0 };
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header))
+		{
+			Unmap();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!m_mapping)
+		{
+			Unmap();
+			return false;
+		}
+
+		m_view = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		m_viewSize = (size_t)fileSize.QuadPart;
+#else
+		m_file = open(m_path.c_str(), O_RDONLY);
+		if (m_file < 0) return false;
+
+		struct stat st;
+		if (fstat(m_file, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+		{
+			Unmap();
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, m_file, 0);
+		m_view = (view == MAP_FAILED) ? nullptr : (const uint8_t*)view;
+		m_viewSize = (size_t)st.st_size;
+#endif
+		if (!m_view)
+		{
+			Unmap();
+			return false;
+		}
+
+		// ļͷУʧܾ͵ջ
+		Header header;
+		memcpy(&header, m_view, sizeof(header));
+		if (header.magic != kCacheMagic || header.version != kCacheVersion ||
+			(m_viewSize - sizeof(Header)) / sizeof(Entry) < header.count)
+		{
+			Unmap();
+			return false;
+		}
+
+		m_entries = (const Entry*)(m_view + sizeof(Header));
+		m_count = header.count;
+		return true;
+	}
+
+	void SignatureCache::Unmap()
+	{
+#ifdef _WIN32
+		if (m_view) UnmapViewOfFile(m_view);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file) CloseHandle(m_file);
+		m_mapping = nullptr;
+		m_file = nullptr;
+#else
+		if (m_view) munmap((void*)m_view, m_viewSize);
+		if (m_file >= 0) close(m_file);
+		m_file = -1;
+#endif
+		m_view = nullptr;
+		m_viewSize = 0;
+		m_entries = nullptr;
+		m_count = 0;
+	}
+
+	const SignatureCache::Entry* SignatureCache::FindMapped(uint64_t nameHash, uint64_t signatureHash) const
+	{
+		if (!m_entries) return nullptr;
+
+		Entry key = {};
+		key.nameHash = nameHash;
+		key.signatureHash = signatureHash;
+		const Entry* end = m_entries + m_count;
+		const Entry* found = std::lower_bound(m_entries, end, key, EntryLess);
+		if (found == end || found->nameHash != nameHash || found->signatureHash != signatureHash) return nullptr;
+		return found;
+	}
+
+	bool SignatureCache::Lookup(const ModuleIdentity& module, const Signature& sig, uint32_t& rva) const
+	{
+		uint64_t signatureHash = SignatureHash(sig);
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		const Entry* entry = nullptr;
+		auto iter = m_pending.find(std::make_pair(module.nameHash, signatureHash));
+		if (iter != m_pending.end()) entry = &iter->second;
+		else entry = FindMapped(module.nameHash, signatureHash);
+
+		if (!entry || !SameModule(*entry, module)) return false;
+
+		rva = entry->rva;
+		return true;
+	}
+
+	void SignatureCache::Update(const ModuleIdentity& module, const Signature& sig, uint32_t rva)
+	{
+		Entry entry = {};
+		entry.nameHash = module.nameHash;
+		entry.signatureHash = SignatureHash(sig);
+		entry.sectionHash = module.sectionHash;
+		entry.timeDateStamp = module.timeDateStamp;
+		entry.sizeOfImage = module.sizeOfImage;
+		entry.rva = rva;
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_pending[std::make_pair(entry.nameHash, entry.signatureHash)] = entry;
+	}
+
+	bool SignatureCache::Flush()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_pending.empty()) return true;
+		if (m_path.empty()) return false;
+
+		// еĺ޸ĵĺϲµĸǾɵģ߶
+		std::vector<Entry> entries;
+		entries.reserve(m_count + m_pending.size());
+		auto iter = m_pending.begin();
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			const Entry& old = m_entries[i];
+			while (iter != m_pending.end() && EntryLess(iter->second, old))
+			{
+				entries.push_back(iter->second);
+				++iter;
+			}
+
+			if (iter != m_pending.end() && !EntryLess(old, iter->second)) continue;
+			entries.push_back(old);
+		}
+		for (; iter != m_pending.end(); ++iter)
+		{
+			entries.push_back(iter->second);
+		}
+
+		Header header = {};
+		header.magic = kCacheMagic;
+		header.version = kCacheVersion;
+		header.count = (uint32_t)entries.size();
+
+		// Ľ̿ͬʱдʱļϽ̺
+#ifdef _WIN32
+		std::wstring tempPath = m_path + Format(L".%lu.tmp", GetCurrentProcessId());
+		FILE* file = _wfopen(tempPath.c_str(), L"wb");
+#else
+		std::string tempPath = m_path + "." + std::to_string(getpid()) + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+#endif
+		if (!file) return false;
+
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			(entries.empty() || fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size());
+		written = (fclose(file) == 0) && written;
+
+		// 滻ǰȽӳ
+		Unmap();
+
+#ifdef _WIN32
+		bool replaced = written && MoveFileExW(tempPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING);
+		if (!replaced) DeleteFileW(tempPath.c_str());
+#else
+		bool replaced = written && rename(tempPath.c_str(), m_path.c_str()) == 0;
+		if (!replaced) unlink(tempPath.c_str());
+#endif
+
+		// 滻ʧҲ޸ģ´д
+		if (replaced) m_pending.clear();
+		Map();
+		return replaced;
+	}
+
+	std::vector<const uint8_t*> FindSignaturesCached(SignatureCache& cache, const std::string& moduleName, const PeImage& image,
+		const SignatureSet& signatures, const SignatureScanner& scanner/* = nullptr*/)
+	{
+		std::vector<const uint8_t*> found(signatures.Size(), nullptr);
+		if (image.Invalid()) return found;
+
+		ModuleIdentity module = GetModuleIdentity(moduleName, image);
+
+		// кҪȷƫƴȷʵδ
+		std::vector<size_t> missing;
+		std::vector<Signature> missingSignatures;
+		for (size_t i = 0; i < signatures.Size(); ++i)
+		{
+			const Signature& sig = signatures.At(i);
+			if (sig.Invalid()) continue;
+
+			uint32_t rva = 0;
+			if (cache.Lookup(module, sig, rva))
+			{
+				if (rva == kSignatureCacheMiss) continue;
+
+				const uint8_t* code = image.RvaToPtr(rva, sig.Length());
+				if (code && sig.MatchAt(code))
+				{
+					found[i] = code;
+					continue;
+				}
+			}
+
+			missing.push_back(i);
+			missingSignatures.push_back(sig);
+		}
+
+		if (missing.empty()) return found;
+
+		SignatureSet missingSet(missingSignatures);
+		std::vector<const uint8_t*> scanned = scanner ? scanner(missingSet) : missingSet.Find(image);
+
+		// еַRVAд棬ûҵļǳkSignatureCacheMiss
+		std::vector<PeCodeRange> ranges = image.ExecutableRanges();
+		for (size_t i = 0; i < missing.size(); ++i)
+		{
+			const uint8_t* code = scanned[i];
+			if (!code)
+			{
+				cache.Update(module, missingSignatures[i], kSignatureCacheMiss);
+				continue;
+			}
+
+			found[missing[i]] = code;
+			for (auto& range : ranges)
+			{
+				if (code >= range.data && code < range.data + range.size)
+				{
+					cache.Update(module, missingSignatures[i], range.rva + (uint32_t)(code - range.data));
+					break;
+				}
+			}
+		}
+
+		cache.Flush();
+		return found;
+	}
+}
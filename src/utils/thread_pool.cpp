@@ -0,0 +1,172 @@
+#include "include/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace utils {
+
+	namespace {
+		// ǰ̳߳߳غͶ±꣬ڳ߳ʹһ
+		thread_local ThreadPool* t_pool = nullptr;
+		thread_local size_t t_index = 0;
+	}
+
+	ThreadPool::ThreadPool(size_t threadCount/* = 0*/)
+		: m_pending(0)
+		, m_next(0)
+	{
+		if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0) threadCount = 1;
+
+		for (size_t i = 0; i < threadCount + 1; ++i)
+		{
+			m_workers.emplace_back(new Worker);
+		}
+
+		for (size_t i = 0; i < threadCount; ++i)
+		{
+			m_threads.emplace_back(&ThreadPool::WorkLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		Wait();
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+
+		for (auto& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	size_t ThreadPool::ThreadCount() const
+	{
+		return m_threads.size();
+	}
+
+	void ThreadPool::Submit(std::function<void()> task)
+	{
+		if (!task) return;
+
+		// Ͷݵָ̣߳ͶݵķŵԼβ
+		size_t index = (t_pool == this) ? t_index : (m_next++ % m_threads.size());
+
+		// ȼӣȡʱɸ
+		++m_pending;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			++m_queued;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(m_workers[index]->lock);
+			m_workers[index]->tasks.push_back(std::move(task));
+		}
+		m_wake.notify_one();
+	}
+
+	void ThreadPool::Wait()
+	{
+		size_t index = (t_pool == this) ? t_index : m_threads.size();
+
+		while (m_pending > 0)
+		{
+			if (RunOne(index)) continue;
+
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_idle.wait_for(guard, std::chrono::milliseconds(1), [this]() { return m_pending == 0 || m_queued > 0; });
+		}
+	}
+
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task)
+	{
+		if (count == 0) return;
+
+		// ±궯̬ȡķƬס
+		auto next = std::make_shared<std::atomic<size_t>>(0);
+		auto body = [next, count, &task]()
+		{
+			for (size_t i = (*next)++; i < count; i = (*next)++)
+			{
+				task(i);
+			}
+		};
+
+		size_t taskCount = (std::min)(count, m_threads.size());
+		for (size_t i = 0; i < taskCount; ++i)
+		{
+			Submit(body);
+		}
+
+		Wait();
+	}
+
+	void ThreadPool::WorkLoop(size_t index)
+	{
+		t_pool = this;
+		t_index = index;
+
+		for (;;)
+		{
+			if (RunOne(index)) continue;
+
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_wake.wait(guard, [this]() { return m_stop || m_queued > 0; });
+			if (m_stop && m_queued == 0) break;
+		}
+
+		t_pool = nullptr;
+	}
+
+	bool ThreadPool::RunOne(size_t index)
+	{
+		std::function<void()> task;
+		if (!Pop(index, task) && !Steal(index, task)) return false;
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			--m_queued;
+		}
+
+		task();
+
+		if (--m_pending == 0)
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_idle.notify_all();
+		}
+		return true;
+	}
+
+	bool ThreadPool::Pop(size_t index, std::function<void()>& task)
+	{
+		Worker& worker = *m_workers[index];
+		std::lock_guard<std::mutex> guard(worker.lock);
+		if (worker.tasks.empty()) return false;
+
+		task = std::move(worker.tasks.back());
+		worker.tasks.pop_back();
+		return true;
+	}
+
+	bool ThreadPool::Steal(size_t index, std::function<void()>& task)
+	{
+		size_t count = m_workers.size();
+		for (size_t i = 1; i < count; ++i)
+		{
+			Worker& victim = *m_workers[(index + i) % count];
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (victim.tasks.empty()) continue;
+
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+}
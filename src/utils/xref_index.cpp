@@ -0,0 +1,214 @@
+#include "include/xref_index.h"
+#include "include/thread_pool.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "detour/detours.h"
+
+namespace utils {
+
+	namespace {
+		// ֻҪĿͲַκڴ
+		const DETOUR_DISASM_CONTEXT kNoReferences = { nullptr, nullptr, TRUE };
+		// һӱ鿪ͷ֮ǰôֽڿʼɨ裬뱾ʱһѾָ߽ͬ
+		const size_t kSweepOverlap = 64;
+		const size_t kSweepChunkSize = 64 * 1024;
+
+		struct Chunk
+		{
+			const PeCodeRange* range;
+			size_t begin;				// range->dataƫ
+			size_t end;
+		};
+	}
+
+	XrefIndex::XrefIndex(const PeImage& image, ThreadPool* pool/* = nullptr*/)
+		: m_image(image)
+	{
+		if (m_image.Invalid()) return;
+
+		m_64bit = m_image.Is64Bit();
+		Build(pool);
+	}
+
+	void XrefIndex::Sweep(const PeCodeRange& range, size_t begin, size_t end, std::vector<Xref>& refs) const
+	{
+		uint32_t imageSize = m_image.SizeOfImage();
+		uint64_t imageBase = m_image.ImageBase();
+		size_t pos = begin > kSweepOverlap ? begin - kSweepOverlap : 0;
+
+		while (pos < end)
+		{
+			const uint8_t* code = range.data + pos;
+			size_t available = range.size - pos;
+
+			// βһָʱ룬öӳ䷶Χ
+			uint8_t buffer[32] = { 0 };
+			PBYTE decodeAt = (PBYTE)code;
+			if (available < 16)
+			{
+				memcpy(buffer, code, available);
+				decodeAt = buffer;
+			}
+
+			DETOUR_DECODED_INSTRUCTION decoded;
+			PBYTE next = m_64bit ?
+				(PBYTE)DetourDecodeInstructionExX64(decodeAt, &decoded, &kNoReferences) :
+				(PBYTE)DetourDecodeInstructionExX86(decodeAt, &decoded, &kNoReferences);
+			if (!next || decoded.cbInstruction == 0 || decoded.cbInstruction > available ||
+				(decoded.wFlags & DETOUR_DECODED_INVALID))
+			{
+				++pos;
+				continue;
+			}
+
+			uint32_t source = (uint32_t)(range.rva + pos);
+			if (pos >= begin)
+			{
+				// ֱתĿ꣬ת
+				if ((decoded.wFlags & (DETOUR_DECODED_CALL | DETOUR_DECODED_BRANCH)) &&
+					!(decoded.wFlags & DETOUR_DECODED_CONDITIONAL) &&
+					decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_NONE &&
+					decoded.pbTarget != (PBYTE)DETOUR_INSTRUCTION_TARGET_DYNAMIC)
+				{
+					intptr_t delta = (intptr_t)decoded.pbTarget - (intptr_t)decodeAt;
+					uint32_t target = (uint32_t)(source + delta);
+					// call $+5ȡeipд
+					if (delta != (intptr_t)decoded.cbInstruction && target < imageSize)
+					{
+						uint8_t kind = (decoded.wFlags & DETOUR_DECODED_CALL) ? kXrefCall : kXrefJump;
+						refs.push_back(Xref{ target, source, kind });
+					}
+				}
+
+				// x64һָƫƣx86moffsǾԵַ
+				uint64_t data = 0;
+				bool hasData = false;
+				if (decoded.wFlags & DETOUR_DECODED_RIP_RELATIVE)
+				{
+					data = (uint64_t)(int64_t)(source + ((intptr_t)decoded.pbData - (intptr_t)decodeAt));
+					hasData = true;
+				}
+				else if (decoded.wFlags & DETOUR_DECODED_ABSOLUTE)
+				{
+					data = (uint64_t)(uintptr_t)decoded.pbData - imageBase;
+					hasData = true;
+				}
+
+				if (hasData && data < imageSize)
+				{
+					uint8_t kind = kXrefData;
+					if (decoded.wFlags & DETOUR_DECODED_CALL) kind = kXrefCallSlot;
+					else if (decoded.wFlags & DETOUR_DECODED_BRANCH) kind = kXrefJumpSlot;
+					refs.push_back(Xref{ (uint32_t)data, source, kind });
+				}
+			}
+
+			pos += decoded.cbInstruction;
+		}
+	}
+
+	void XrefIndex::Build(ThreadPool* pool)
+	{
+		std::vector<PeCodeRange> ranges = m_image.ExecutableRanges();
+		std::vector<Chunk> chunks;
+		for (auto& range : ranges)
+		{
+			for (size_t begin = 0; begin < range.size; begin += kSweepChunkSize)
+			{
+				chunks.push_back(Chunk{ &range, begin, (std::min)(range.size, begin + kSweepChunkSize) });
+			}
+		}
+
+		std::vector<std::vector<Xref>> results(chunks.size());
+		auto task = [&](size_t index)
+		{
+			Sweep(*chunks[index].range, chunks[index].begin, chunks[index].end, results[index]);
+		};
+
+		if (pool && chunks.size() > 1)
+		{
+			pool->ParallelFor(chunks.size(), task);
+		}
+		else
+		{
+			for (size_t i = 0; i < chunks.size(); ++i) task(i);
+		}
+
+		std::vector<Xref> refs;
+		size_t total = 0;
+		for (auto& result : results) total += result.size();
+		refs.reserve(total);
+		for (auto& result : results)
+		{
+			refs.insert(refs.end(), result.begin(), result.end());
+			std::vector<Xref>().swap(result);
+		}
+
+		// ԴѾ򣬰ĿͬһĿ԰Դ
+		std::stable_sort(refs.begin(), refs.end(), [](const Xref& a, const Xref& b) { return a.target < b.target; });
+
+		m_sources.reserve(refs.size());
+		m_kinds.reserve(refs.size());
+		for (auto& ref : refs)
+		{
+			if (m_targets.empty() || m_targets.back() != ref.target)
+			{
+				m_targets.push_back(ref.target);
+				m_offsets.push_back((uint32_t)m_sources.size());
+			}
+			m_sources.push_back(ref.source);
+			m_kinds.push_back(ref.kind);
+		}
+		m_offsets.push_back((uint32_t)m_sources.size());
+	}
+
+	XrefRange XrefIndex::RefsTo(uint32_t targetRva) const
+	{
+		XrefRange range;
+		auto it = std::lower_bound(m_targets.begin(), m_targets.end(), targetRva);
+		if (it == m_targets.end() || *it != targetRva) return range;
+
+		size_t index = it - m_targets.begin();
+		range.sources = m_sources.data() + m_offsets[index];
+		range.kinds = m_kinds.data() + m_offsets[index];
+		range.count = m_offsets[index + 1] - m_offsets[index];
+		return range;
+	}
+
+	std::vector<uint32_t> XrefIndex::RefsTo(uint32_t targetRva, uint8_t kinds) const
+	{
+		std::vector<uint32_t> sources;
+		XrefRange range = RefsTo(targetRva);
+		for (size_t i = 0; i < range.count; ++i)
+		{
+			if (range.kinds[i] & kinds) sources.push_back(range.sources[i]);
+		}
+		return sources;
+	}
+
+	std::vector<uint32_t> XrefIndex::RefsToImport(const std::string& module, const std::string& name, uint8_t kinds/* = kXrefAll*/) const
+	{
+		uint32_t slotRva = 0;
+		if (!m_image.FindImportSlot(module, name, slotRva)) return std::vector<uint32_t>();
+		return RefsTo(slotRva, kinds);
+	}
+
+	size_t XrefIndex::Count() const
+	{
+		return m_sources.size();
+	}
+
+	size_t XrefIndex::TargetCount() const
+	{
+		return m_targets.size();
+	}
+
+	size_t XrefIndex::BytesUsed() const
+	{
+		return (m_targets.size() + m_offsets.size() + m_sources.size()) * sizeof(uint32_t) + m_kinds.size();
+	}
+}